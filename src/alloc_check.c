@@ -0,0 +1,28 @@
+#include "alloc_check.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+static _Atomic uint64_t calls;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  atomic_fetch_add_explicit(&calls, 1, memory_order_relaxed);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  atomic_fetch_add_explicit(&calls, 1, memory_order_relaxed);
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+  atomic_fetch_add_explicit(&calls, 1, memory_order_relaxed);
+  return __real_realloc(pointer, size);
+}
+
+uint64_t alloc_check_calls(void) {
+  return atomic_load_explicit(&calls, memory_order_relaxed);
+}
@@ -0,0 +1,12 @@
+#ifndef ALLOC_CHECK_H
+#define ALLOC_CHECK_H
+
+#include <stdint.h>
+
+// Counts every malloc, calloc and realloc made by this program's own code.
+// Only linked into the allocation check build, where the linker routes those
+// calls here (-Wl,--wrap=malloc,...); libraries and drivers keep calling the
+// real allocator and are not counted.
+uint64_t alloc_check_calls(void);
+
+#endif
@@ -0,0 +1,124 @@
+#include "arena.h"
+#include "color.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static _Thread_local Arena scratch;
+static _Atomic uint64_t heapAllocations;
+
+static size_t alignUp(size_t value, size_t align) {
+  return (value + align - 1) & ~(align - 1);
+}
+
+bool arena_create(Arena *arena, const char *name, size_t capacity) {
+  memset(arena, 0, sizeof(*arena));
+  arena->name = name;
+  arena->base = malloc(capacity);
+  if (!arena->base) {
+    printf(RED "[ERROR] " RESET "failed to allocate %zu bytes for arena %s\n", capacity, name);
+    return false;
+  }
+  arena->capacity = capacity;
+  arena_note_heap_allocation();
+  return true;
+}
+
+void arena_destroy(Arena *arena) {
+  if (!arena) return;
+  arena_reset_to(arena, 0);
+  free(arena->base);
+  memset(arena, 0, sizeof(*arena));
+}
+
+void *arena_alloc(Arena *arena, size_t size, size_t align) {
+  if (!arena->chunks) {
+    size_t offset = alignUp(arena->used, align);
+    if (offset + size <= arena->capacity) {
+      arena->used = offset + size;
+      if (arena->used > arena->highWater) arena->highWater = arena->used;
+      return arena->base + offset;
+    }
+  }
+
+  // Doesn't fit: a chunk of its own, padded so the payload can be aligned
+  Arena_Chunk *chunk = malloc(sizeof(Arena_Chunk) + size + align);
+  if (!chunk) {
+    printf(RED "[ERROR] " RESET "arena %s: failed to allocate %zu bytes\n", arena->name, size);
+    return NULL;
+  }
+  arena_note_heap_allocation();
+  chunk->next = arena->chunks;
+  chunk->offset = arena->used;
+  chunk->size = size + align;
+  arena->chunks = chunk;
+  arena->used += chunk->size;
+  arena->overflows++;
+  if (arena->used > arena->highWater) arena->highWater = arena->used;
+
+  uintptr_t payload = (uintptr_t)(chunk + 1);
+  return (void *)((payload + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+size_t arena_mark(const Arena *arena) {
+  return arena->used;
+}
+
+void arena_reset_to(Arena *arena, size_t mark) {
+  if (mark >= arena->used) return;
+
+  while (arena->chunks && arena->chunks->offset >= mark) {
+    Arena_Chunk *chunk = arena->chunks;
+    arena->chunks = chunk->next;
+    free(chunk);
+  }
+#ifdef DEBUG
+  size_t end = arena->used < arena->capacity ? arena->used : arena->capacity;
+  if (!arena->chunks && mark < end) memset(arena->base + mark, ARENA_POISON, end - mark);
+#endif
+  arena->used = mark;
+}
+
+void arena_reset(Arena *arena) {
+  bool overflowed = arena->chunks != NULL;
+  arena_reset_to(arena, 0);
+  arena->resets++;
+
+  // Outgrew the block: replace it with one that fits the high-water mark
+  if (overflowed) {
+    size_t capacity = arena->capacity * 2;
+    while (capacity < arena->highWater) capacity *= 2;
+    uint8_t *base = malloc(capacity);
+    if (base) {
+      free(arena->base);
+      arena->base = base;
+      arena->capacity = capacity;
+      arena_note_heap_allocation();
+    }
+  }
+}
+
+void arena_print_stats(const Arena *arena) {
+  printf(CYAN "[PROFILE] " RESET "arena %s: high water %zu / %zu bytes, %llu resets, %llu overflows\n",
+         arena->name, arena->highWater, arena->capacity,
+         (unsigned long long)arena->resets, (unsigned long long)arena->overflows);
+}
+
+Arena *arena_scratch(void) {
+  if (!scratch.base) arena_create(&scratch, "scratch", ARENA_SCRATCH_SIZE);
+  return &scratch;
+}
+
+void arena_scratch_release(void) {
+  if (scratch.base) arena_print_stats(&scratch);
+  arena_destroy(&scratch);
+}
+
+uint64_t arena_heap_allocations(void) {
+  return atomic_load_explicit(&heapAllocations, memory_order_relaxed);
+}
+
+void arena_note_heap_allocation(void) {
+  atomic_fetch_add_explicit(&heapAllocations, 1, memory_order_relaxed);
+}
@@ -0,0 +1,61 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_SCRATCH_SIZE (256 * 1024)
+#define ARENA_POISON 0xCD  // freed bytes in DEBUG builds
+
+typedef struct Arena_Chunk Arena_Chunk;
+struct Arena_Chunk {
+  Arena_Chunk *next;
+  size_t offset;  // logical arena offset the chunk starts at
+  size_t size;
+};
+
+// Linear allocator. Allocation is a pointer bump; reset (to a mark or to
+// empty) is O(1) apart from DEBUG poisoning. A request that doesn't fit is
+// served from a heap chunk so callers never see a failure; the next full
+// reset frees the chunks and grows the block past the high-water mark, so a
+// steady workload settles into zero heap traffic.
+typedef struct {
+  const char *name;
+  uint8_t *base;
+  size_t capacity;
+  size_t used;        // logical offset: block bytes, then chunk bytes
+  Arena_Chunk *chunks;  // newest first; once set, every allocation goes to a chunk
+
+  size_t highWater;
+  uint64_t resets;
+  uint64_t overflows;
+} Arena;
+
+bool arena_create(Arena *arena, const char *name, size_t capacity);
+void arena_destroy(Arena *arena);
+
+// align must be a power of two. Returns NULL only when the heap is exhausted.
+void *arena_alloc(Arena *arena, size_t size, size_t align);
+#define ARENA_ALLOC(arena, type, count) ((type *)arena_alloc((arena), sizeof(type) * (count), _Alignof(type)))
+
+size_t arena_mark(const Arena *arena);
+void arena_reset_to(Arena *arena, size_t mark);
+void arena_reset(Arena *arena);
+
+void arena_print_stats(const Arena *arena);
+
+// Per-thread arena for short-lived query results (init, swapchain rebuilds).
+// Take a mark, allocate, and reset to the mark before returning.
+Arena *arena_scratch(void);
+void arena_scratch_release(void);
+
+// Heap allocations made on the frame path: arena growth, buffer growth in the
+// sprite batch and mesh renderer, and the deletion queue, readback scratch
+// and memory tracking growing. Constant once the workload is steady. Code
+// that allocates without reporting here is only caught by the allocation
+// check build (alloc_check.h).
+uint64_t arena_heap_allocations(void);
+void arena_note_heap_allocation(void);
+
+#endif
@@ -0,0 +1,200 @@
+#include "batch.h"
+#include "color.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ========== WORK QUEUE ==========
+
+static bool dequeTake(Batch_Deque *deque, Batch_Range *range) {
+  pthread_mutex_lock(&deque->mutex);
+  bool found = deque->head < deque->tail;
+  if (found) *range = deque->items[deque->head++];
+  pthread_mutex_unlock(&deque->mutex);
+  return found;
+}
+
+static bool dequeSteal(Batch_Deque *deque, Batch_Range *range) {
+  pthread_mutex_lock(&deque->mutex);
+  bool found = deque->head < deque->tail;
+  if (found) *range = deque->items[--deque->tail];
+  pthread_mutex_unlock(&deque->mutex);
+  return found;
+}
+
+// Own work first, then the other contexts' in turn. Nothing is ever added,
+// so a full pass that finds nothing means the batch is done.
+static bool nextRange(Batch_Worker *worker, Batch_Range *range) {
+  if (dequeTake(&worker->deque, range)) return true;
+  Batch_Context *batch = worker->batch;
+  for (uint32_t k = 1; k < batch->config.contexts; k++) {
+    Batch_Worker *victim = &batch->workers[(worker->index + k) % batch->config.contexts];
+    if (dequeSteal(&victim->deque, range)) {
+      worker->steals++;
+      return true;
+    }
+  }
+  return false;
+}
+
+// ========== WORKERS ==========
+
+static void markReady(Batch_Context *batch) {
+  pthread_mutex_lock(&batch->gateMutex);
+  batch->ready++;
+  pthread_cond_broadcast(&batch->gateCond);
+  pthread_mutex_unlock(&batch->gateMutex);
+}
+
+static void *workerThread(void *arg) {
+  Batch_Worker *worker = arg;
+  Batch_Context *batch = worker->batch;
+
+  // Contexts are spread over the suitable devices; with one they all share it
+  double start = profiler_now_ms();
+  worker->vulkan.deviceIndex = worker->index;
+  worker->rendering.config = batch->config.rendering;
+  worker->rendering.config.offscreen = true;
+  worker->rendering.config.tracePath = NULL;
+  bool vulkanOk = vulkan_create(&worker->vulkan, NULL);
+  worker->ok = vulkanOk && rendering_create(&worker->rendering, &worker->vulkan, NULL) &&
+               (!batch->config.prepare || batch->config.prepare(&worker->rendering, batch->config.userData));
+  worker->createMs = profiler_now_ms() - start;
+  if (!worker->ok) printf(RED "[ERROR] " RESET "batch: context %u failed to start\n", worker->index);
+
+  markReady(batch);
+  pthread_mutex_lock(&batch->gateMutex);
+  while (!batch->open) pthread_cond_wait(&batch->gateCond, &batch->gateMutex);
+  pthread_mutex_unlock(&batch->gateMutex);
+
+  // A failed context takes nothing; its frames are stolen by the others
+  Batch_Range range;
+  while (worker->ok && nextRange(worker, &range)) {
+    for (uint64_t frame = range.begin; frame < range.end; frame++) {
+      // Names the capture, whichever context renders it
+      worker->rendering.frameNumber = frame;
+      if (batch->config.draw) batch->config.draw(&worker->rendering, frame, batch->config.userData);
+      rendering_draw(&worker->rendering);
+      worker->framesRendered++;
+    }
+  }
+
+  // Waits for the device and flushes the captures still queued. Without a
+  // device rendering was never started; a partial instance setup is undone
+  // by vulkan_destroy alone.
+  if (vulkanOk) rendering_destroy(&worker->rendering);
+  vulkan_destroy(&worker->vulkan);
+  arena_scratch_release();
+  return NULL;
+}
+
+// ========== BATCH ==========
+
+bool batch_run(Batch_Context *batch, const Batch_Config *config) {
+  if (!batch || !config) return false;
+  memset(batch, 0, sizeof(*batch));
+  batch->config = *config;
+  uint32_t count = config->contexts;
+  if (count == 0) count = 1;
+  if (count > BATCH_MAX_CONTEXTS) count = BATCH_MAX_CONTEXTS;
+  batch->config.contexts = count;
+
+  // One sequence file can't be shared between writers
+  const char *path = config->rendering.capture.path;
+  Readback_Pattern pattern;
+  if (path && !readback_parse_pattern(path, &pattern)) {
+    printf(RED "[ERROR] " RESET "batch: capture path needs a frame number pattern, e.g. frame%%05u.png\n");
+    return false;
+  }
+
+  batch->workers = calloc(count, sizeof(Batch_Worker));
+  if (!batch->workers) {
+    printf(RED "[ERROR] " RESET "batch: failed to allocate %u contexts\n", count);
+    return false;
+  }
+  pthread_mutex_init(&batch->gateMutex, NULL);
+  pthread_cond_init(&batch->gateCond, NULL);
+  for (uint32_t i = 0; i < count; i++) pthread_mutex_init(&batch->workers[i].deque.mutex, NULL);
+
+  // Each context starts with a contiguous slice, cut into chunks to steal
+  uint64_t chunk = config->frames / ((uint64_t)count * BATCH_CHUNKS_PER_CONTEXT);
+  if (chunk == 0) chunk = 1;
+  for (uint32_t i = 0; i < count; i++) {
+    Batch_Worker *worker = &batch->workers[i];
+    worker->batch = batch;
+    worker->index = i;
+
+    uint64_t begin = config->frames * i / count;
+    uint64_t end = config->frames * (i + 1) / count;
+    worker->deque.items = calloc((size_t)((end - begin + chunk - 1) / chunk) + 1, sizeof(Batch_Range));
+    if (!worker->deque.items) {
+      printf(RED "[ERROR] " RESET "batch: failed to allocate the work queue\n");
+      return false;
+    }
+    for (uint64_t f = begin; f < end; f += chunk) {
+      Batch_Range *range = &worker->deque.items[worker->deque.tail++];
+      range->begin = f;
+      range->end = f + chunk < end ? f + chunk : end;
+    }
+  }
+
+  double start = profiler_now_ms();
+  for (uint32_t i = 0; i < count; i++) {
+    Batch_Worker *worker = &batch->workers[i];
+    worker->started = pthread_create(&worker->thread, NULL, workerThread, worker) == 0;
+    if (!worker->started) {
+      printf(RED "[ERROR] " RESET "batch: failed to start context %u\n", i);
+      markReady(batch);
+    }
+  }
+
+  pthread_mutex_lock(&batch->gateMutex);
+  while (batch->ready < count) pthread_cond_wait(&batch->gateCond, &batch->gateMutex);
+  double renderStart = profiler_now_ms();
+  batch->startupMs = renderStart - start;
+  batch->open = true;
+  pthread_cond_broadcast(&batch->gateCond);
+  pthread_mutex_unlock(&batch->gateMutex);
+
+  for (uint32_t i = 0; i < count; i++) {
+    Batch_Worker *worker = &batch->workers[i];
+    if (!worker->started) continue;
+    pthread_join(worker->thread, NULL);
+    batch->framesRendered += worker->framesRendered;
+    batch->steals += worker->steals;
+  }
+  batch->renderMs = profiler_now_ms() - renderStart;
+
+  if (batch->framesRendered != config->frames) {
+    printf(RED "[ERROR] " RESET "batch: rendered %llu of %llu frames\n",
+           (unsigned long long)batch->framesRendered, (unsigned long long)config->frames);
+    return false;
+  }
+  return true;
+}
+
+void batch_print_stats(const Batch_Context *batch) {
+  if (!batch || !batch->workers) return;
+  for (uint32_t i = 0; i < batch->config.contexts; i++) {
+    const Batch_Worker *worker = &batch->workers[i];
+    printf(CYAN "[PROFILE] " RESET "  context %u: %llu frames, %u steals, created in %.1f ms\n",
+           i, (unsigned long long)worker->framesRendered, worker->steals, worker->createMs);
+  }
+  double seconds = batch->renderMs / 1000.0;
+  printf(CYAN "[PROFILE] " RESET "batch, %u contexts: %llu frames in %.1f ms, %.1f fps (startup %.1f ms, %u steals)\n",
+         batch->config.contexts, (unsigned long long)batch->framesRendered, batch->renderMs,
+         seconds > 0.0 ? (double)batch->framesRendered / seconds : 0.0, batch->startupMs, batch->steals);
+}
+
+void batch_destroy(Batch_Context *batch) {
+  if (!batch || !batch->workers) return;
+  for (uint32_t i = 0; i < batch->config.contexts; i++) {
+    free(batch->workers[i].deque.items);
+    pthread_mutex_destroy(&batch->workers[i].deque.mutex);
+  }
+  pthread_mutex_destroy(&batch->gateMutex);
+  pthread_cond_destroy(&batch->gateCond);
+  free(batch->workers);
+  batch->workers = NULL;
+}
@@ -0,0 +1,82 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "rendering.h"
+
+#define BATCH_MAX_CONTEXTS 64
+#define BATCH_CHUNKS_PER_CONTEXT 8  // work items each context starts with; smaller ones balance better
+
+// Frames [begin, end) rendered as one work item
+typedef struct {
+  uint64_t begin;
+  uint64_t end;
+} Batch_Range;
+
+// One context's work. The owner takes from the front, so it renders its own
+// frames in order; idle contexts steal from the back, the work furthest away.
+typedef struct {
+  pthread_mutex_t mutex;
+  Batch_Range *items;
+  uint32_t head;
+  uint32_t tail;
+} Batch_Deque;
+
+// Called on the context's own thread. prepare runs once after the context is
+// created (e.g. to upload meshes), draw once per frame before rendering_draw.
+typedef bool (*Batch_Prepare_Fn)(Rendering_Context *r, void *userData);
+typedef void (*Batch_Draw_Fn)(Rendering_Context *r, uint64_t frame, void *userData);
+
+typedef struct {
+  uint32_t contexts;
+  uint64_t frames;
+  Rendering_Config rendering;  // offscreenExtent and capture are used; offscreen is forced
+  Batch_Prepare_Fn prepare;
+  Batch_Draw_Fn draw;
+  void *userData;
+} Batch_Config;
+
+typedef struct {
+  struct Batch_Context *batch;
+  uint32_t index;
+  pthread_t thread;
+  bool started;
+  bool ok;  // its device and renderer came up
+
+  Vulkan_Context vulkan;
+  Rendering_Context rendering;
+  Batch_Deque deque;
+
+  uint64_t framesRendered;
+  uint32_t steals;
+  double createMs;
+} Batch_Worker;
+
+// N independent headless renderers, each with its own VkDevice and queue on
+// its own thread. Frame numbers name the capture files (config.capture.path
+// must be a per-frame pattern), so the output doesn't depend on who rendered
+// what.
+typedef struct Batch_Context Batch_Context;
+struct Batch_Context {
+  Batch_Config config;
+  Batch_Worker *workers;
+
+  // Every context waits here after creation so startup stays out of the rate
+  pthread_mutex_t gateMutex;
+  pthread_cond_t gateCond;
+  uint32_t ready;
+  bool open;
+
+  double startupMs;  // until every context was created
+  double renderMs;   // from the gate opening until the last frame was written
+  uint64_t framesRendered;
+  uint32_t steals;
+};
+
+bool batch_run(Batch_Context *batch, const Batch_Config *config);
+void batch_print_stats(const Batch_Context *batch);
+void batch_destroy(Batch_Context *batch);
+
+#endif
@@ -0,0 +1,876 @@
+#include "bench.h"
+#include "color.h"
+#include "platform.h"
+#include "profiler.h"
+#include "mesh.h"
+#include "texture.h"
+#include "service.h"
+#include "scene.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+uint32_t bench_xorshift(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+// Recreates the swapchain N times, alternating between two window sizes
+static void benchResize(Rendering_Context *r, uint32_t iterations) {
+  uint32_t baseWidth = r->platform->width;
+  uint32_t baseHeight = r->platform->height;
+
+  for (uint32_t i = 0; i < iterations; i++) {
+    uint32_t grow = (i & 1) ? 0 : 64;
+    platform_set_size(r->platform, baseWidth + grow, baseHeight + grow);
+    rendering_recreate_swapchain(r);
+    rendering_draw(r);
+  }
+  platform_set_size(r->platform, baseWidth, baseHeight);
+}
+
+// Pushes N random sprites per frame over a few textures, blend modes and
+// layers, and reports CPU submission throughput.
+static void benchSprites(Rendering_Context *ctx, uint32_t spriteCount) {
+  const uint32_t frames = 300;
+  Sprite_Batch *batch = &ctx->sprites;
+
+  // Distinct descriptor sets are enough to exercise the texture sort key
+  uint16_t textures[8];
+  textures[0] = SPRITE_WHITE_TEXTURE;
+  for (uint32_t i = 1; i < 8; i++) {
+    textures[i] = sprite_batch_add_texture(batch, batch->whiteView, VK_NULL_HANDLE);
+  }
+
+  Profiler_Stat submitStat = {0};
+  Profiler_Stat frameStat = {0};
+  uint32_t seed = 0x9E3779B9u;
+  float width = (float)ctx->swapChainExtent.width;
+  float height = (float)ctx->swapChainExtent.height;
+
+  for (uint32_t f = 0; f < frames && !platform_should_close(ctx->platform); f++) {
+    platform_events();
+    double frameStart = profiler_now_ms();
+
+    for (uint32_t i = 0; i < spriteCount; i++) {
+      uint32_t r = bench_xorshift(&seed);
+      Sprite sprite = {0};
+      sprite.x = (float)(r % 1024) / 1024.0f * width;
+      sprite.y = (float)((r >> 10) % 1024) / 1024.0f * height;
+      sprite.w = 4.0f + (float)((r >> 20) & 7);
+      sprite.h = sprite.w;
+      sprite.u1 = 1.0f;
+      sprite.v1 = 1.0f;
+      sprite.color = 0x80000000u | (r & 0x00FFFFFFu);
+      sprite.rotation = (float)(r & 0xFF) * 0.0245f;
+      sprite.texture = textures[(r >> 23) & 7];
+      sprite.blend = (uint8_t)((r >> 26) & 1);
+      sprite.layer = (uint8_t)((r >> 27) & 3);
+      sprite_batch_push(batch, &sprite);
+    }
+    profiler_stat_add(&submitStat, profiler_now_ms() - frameStart);
+
+    rendering_draw(ctx);
+    profiler_stat_add(&frameStat, profiler_now_ms() - frameStart);
+  }
+
+  double cpuMs = profiler_stat_avg(&submitStat) + profiler_stat_avg(&batch->flushStat);
+  profiler_stat_print("sprite submit", &submitStat);
+  profiler_stat_print("sprite sort+upload", &batch->flushStat);
+  profiler_stat_print("frame", &frameStat);
+  printf(CYAN "[PROFILE] " RESET "%u sprites, %u draw calls/frame, %.1f sprites/ms (CPU), %.1f sprites/ms (frame)\n",
+         spriteCount, batch->lastDrawCount,
+         cpuMs > 0.0 ? (double)spriteCount / cpuMs : 0.0,
+         profiler_stat_avg(&frameStat) > 0.0 ? (double)spriteCount / profiler_stat_avg(&frameStat) : 0.0);
+}
+
+// Frames with the same sprites every frame (static) and with the same sprites
+// moving (mostly static: new instance data, same draw list), each recorded
+// every frame and then replayed from the command cache.
+static void benchCache(Rendering_Context *ctx, uint32_t spriteCount) {
+  const uint32_t frames = 300;
+  float width = (float)ctx->swapChainExtent.width;
+  float height = (float)ctx->swapChainExtent.height;
+  static const char *labels[] = {"static", "mostly static"};
+
+  for (uint32_t scene = 0; scene < 2; scene++) {
+    for (uint32_t cached = 0; cached < 2; cached++) {
+      ctx->config.cacheCommands = cached != 0;
+      memset(&ctx->recordStat, 0, sizeof(ctx->recordStat));
+      uint64_t hits = ctx->cacheHits;
+      Profiler_Stat frameStat = {0};
+      double cpuStart = profiler_cpu_ms();
+
+      for (uint32_t f = 0; f < frames && !platform_should_close(ctx->platform); f++) {
+        platform_events();
+        double frameStart = profiler_now_ms();
+        uint32_t seed = 0x9E3779B9u;
+        float drift = scene == 1 ? (float)(f % 64) : 0.0f;
+        for (uint32_t i = 0; i < spriteCount; i++) {
+          uint32_t r = bench_xorshift(&seed);
+          float x = (float)(r % 1024) / 1024.0f * width;
+          float y = (float)((r >> 10) % 1024) / 1024.0f * height;
+          sprite_batch_quad(&ctx->sprites, x + drift, y, 8.0f, 8.0f, 0xFF000000u | (r & 0x00FFFFFFu),
+                            SPRITE_WHITE_TEXTURE);
+        }
+        rendering_draw(ctx);
+        profiler_stat_add(&frameStat, profiler_now_ms() - frameStart);
+      }
+
+      double cpuMs = profiler_cpu_ms() - cpuStart;
+      printf(CYAN "[PROFILE] " RESET "%s, %s: CPU %.3f ms/frame, record %.3f ms/frame, %llu replays\n",
+             labels[scene], cached ? "cached" : "recorded", frameStat.count ? cpuMs / frameStat.count : 0.0,
+             profiler_stat_avg(&ctx->recordStat), (unsigned long long)(ctx->cacheHits - hits));
+      profiler_stat_print("frame", &frameStat);
+    }
+  }
+}
+
+// Procedural RGBA8 content, different per texture
+static void fillTexture(uint8_t *pixels, uint32_t size, uint32_t index) {
+  for (uint32_t y = 0; y < size; y++) {
+    for (uint32_t x = 0; x < size; x++) {
+      uint8_t *p = &pixels[((size_t)y * size + x) * 4];
+      bool check = (((x >> 4) ^ (y >> 4)) & 1) != 0;
+      p[0] = (uint8_t)(x * 255 / size);
+      p[1] = (uint8_t)(y * 255 / size);
+      p[2] = check ? (uint8_t)(index * 37) : 0x40;
+      p[3] = 0xFF;
+    }
+  }
+}
+
+static uint16_t packRgb565(const uint8_t *p) {
+  return (uint16_t)(((p[0] >> 3) << 11) | ((p[1] >> 2) << 5) | (p[2] >> 3));
+}
+
+// Stand-in for an offline compressor: BC1 with the block's darkest and
+// brightest pixels as endpoints, each pixel snapped to the nearest of the four
+static void encodeBc1(const uint8_t *pixels, uint32_t size, uint8_t *out) {
+  uint32_t blocks = size / 4 ? size / 4 : 1;
+  for (uint32_t by = 0; by < blocks; by++) {
+    for (uint32_t bx = 0; bx < blocks; bx++) {
+      const uint8_t *lo = NULL, *hi = NULL;
+      uint32_t loSum = UINT32_MAX, hiSum = 0;
+      for (uint32_t i = 0; i < 16; i++) {
+        uint32_t x = bx * 4 + (i & 3), y = by * 4 + (i >> 2);
+        const uint8_t *p = &pixels[((size_t)(y < size ? y : size - 1) * size + (x < size ? x : size - 1)) * 4];
+        uint32_t sum = (uint32_t)p[0] + p[1] + p[2];
+        if (sum < loSum) { loSum = sum; lo = p; }
+        if (sum >= hiSum) { hiSum = sum; hi = p; }
+      }
+      uint16_t c0 = packRgb565(hi), c1 = packRgb565(lo);
+      uint32_t indices = 0;
+      if (c0 > c1) {
+        // Palette order 0, 2, 3, 1 runs from hi to lo
+        static const uint32_t ramp[4] = {0, 2, 3, 1};
+        uint32_t range = hiSum - loSum;
+        for (uint32_t i = 0; i < 16; i++) {
+          uint32_t x = bx * 4 + (i & 3), y = by * 4 + (i >> 2);
+          const uint8_t *p = &pixels[((size_t)(y < size ? y : size - 1) * size + (x < size ? x : size - 1)) * 4];
+          uint32_t sum = (uint32_t)p[0] + p[1] + p[2];
+          uint32_t step = range ? ((hiSum - sum) * 3 + range / 2) / range : 0;
+          indices |= ramp[step] << (i * 2);
+        }
+      } else {
+        c0 = c1;
+      }
+      uint8_t *block = &out[((size_t)by * blocks + bx) * 8];
+      block[0] = (uint8_t)c0; block[1] = (uint8_t)(c0 >> 8);
+      block[2] = (uint8_t)c1; block[3] = (uint8_t)(c1 >> 8);
+      block[4] = (uint8_t)indices; block[5] = (uint8_t)(indices >> 8);
+      block[6] = (uint8_t)(indices >> 16); block[7] = (uint8_t)(indices >> 24);
+    }
+  }
+}
+
+// With --memory-budget: the textures are streamed in under a capped budget
+// while a window of a quarter of them sweeps through, touched every frame.
+// Residency evicts the ones left behind and downgrades the rest as needed.
+static void benchResidency(Rendering_Context *r, uint32_t count, const uint8_t *rgba, uint32_t size) {
+  Vulkan_Context *vk = &r->vulkan_context;
+  size_t rgbaSize = (size_t)size * size * 4;
+  const uint32_t frames = 600;
+  uint32_t window = count / 4 ? count / 4 : 1;
+
+  Texture *textures = calloc(count, sizeof(Texture));
+  if (!textures) return;
+  Texture_Residency residency;
+  texture_residency_create(&residency, vk, r->commandPool, &r->deletion);
+
+  // Each texture is loaded the first time the window reaches it
+  uint32_t loaded = 0;
+  double start = profiler_now_ms();
+  for (uint32_t frame = 0; frame < frames; frame++) {
+    uint32_t first = (uint32_t)((uint64_t)frame * count / frames);
+    uint32_t end = first + window < count ? first + window : count;
+    if (loaded < end) {
+      Texture_Loader loader;
+      texture_loader_create(&loader, vk, r->commandPool);
+      for (; loaded < end; loaded++) {
+        if (texture_loader_add_rgba8(&loader, &textures[loaded], size, size, true, 0, rgba + rgbaSize * loaded)) {
+          texture_residency_add(&residency, &textures[loaded]);
+        }
+      }
+      texture_loader_flush(&loader);
+      texture_loader_destroy(&loader);
+    }
+    for (uint32_t t = first; t < end; t++) texture_residency_touch(&residency, &textures[t]);
+    texture_residency_update(&residency);
+    rendering_draw(r);
+  }
+  double ms = profiler_now_ms() - start;
+
+  uint32_t full = 0;
+  for (uint32_t t = 0; t < count; t++) full += textures[t].image != VK_NULL_HANDLE && textures[t].droppedLevels == 0;
+  printf(CYAN "[PROFILE] " RESET "residency, %u textures through a %u texture window under %.0f MB: "
+         "%u frames in %.1f ms, %u at full resolution at the end, pressure %.0f%%\n",
+         count, window, (double)vk->memoryLimit / (1024.0 * 1024.0), frames, ms, full,
+         memory_budget_pressure(vk->budget) * 100.0);
+  texture_residency_print_stats(&residency);
+
+  vkDeviceWaitIdle(vk->device);
+  for (uint32_t t = 0; t < count; t++) texture_destroy(vk, &textures[t]);
+  texture_residency_destroy(&residency);
+  free(textures);
+}
+
+// Renders N frames at the highest scale, then N more with the controller
+// steering. Without --dynamic-resolution the target is half the fixed-scale
+// GPU time, which the controller has to shrink the scene to meet.
+static void benchResolution(const Bench_Config *bench, Rendering_Context *r, uint32_t frames) {
+  Resolution_Controller *rc = &r->resolution;
+  if (!r->resolutionEnabled) {
+    printf(YELLOW "[WARNING] " RESET "dynamic resolution is disabled, nothing to measure\n");
+    return;
+  }
+  float minScale = rc->minScale, maxScale = rc->maxScale;
+
+  resolution_set_range(rc, maxScale, maxScale);
+  for (uint32_t f = 0; f < frames && !platform_should_close(r->platform); f++) {
+    platform_events();
+    rendering_draw(r);
+  }
+  double fixedMs = profiler_stat_avg(&rc->gpuStat);
+  VkExtent2D fixedExtent = r->renderExtent;
+
+  resolution_set_range(rc, minScale, maxScale);
+  rc->targetMs = bench->resolutionTargetMs > 0.0f ? bench->resolutionTargetMs : (float)(fixedMs * 0.5);
+  memset(&rc->gpuStat, 0, sizeof(rc->gpuStat));
+  uint32_t changes = rc->increases + rc->decreases;
+  Profiler_Stat settledStat = {0};
+  for (uint32_t f = 0; f < frames && !platform_should_close(r->platform); f++) {
+    platform_events();
+    uint64_t samples = rc->gpuStat.count;
+    double total = rc->gpuStat.total;
+    rendering_draw(r);
+    // The second half, once the scale had time to settle
+    if (f >= frames / 2 && rc->gpuStat.count > samples) profiler_stat_add(&settledStat, rc->gpuStat.total - total);
+  }
+
+  printf(CYAN "[PROFILE] " RESET "dynamic resolution, %u frames each: fixed %ux%u at %.3f ms GPU; "
+         "steered to %.3f ms: %ux%u (scale %.2f) at %.3f ms GPU (settled half), %u scale changes\n",
+         frames, fixedExtent.width, fixedExtent.height, fixedMs, rc->targetMs, r->renderExtent.width,
+         r->renderExtent.height, rc->scale, profiler_stat_avg(&settledStat),
+         rc->increases + rc->decreases - changes);
+}
+
+// Runs the fountain at a fixed 60 Hz step until it has reached its steady
+// state (every particle has lived its longest lifetime), then times as many
+// frames again. Throughput is particles through emission and simulation per
+// millisecond of the compute passes' GPU time.
+static void benchParticles(Rendering_Context *r) {
+  Particle_System *ps = &r->particles;
+  const uint32_t warmup = 240, frames = 240;
+  ps->fixedDt = 1.0f / 60.0f;
+  for (uint32_t f = 0; f < warmup && !platform_should_close(r->platform); f++) {
+    platform_events();
+    rendering_draw(r);
+  }
+
+  memset(&ps->gpuStat, 0, sizeof(ps->gpuStat));
+  ps->simulated = 0;
+  uint64_t aliveSum = 0;
+  double start = profiler_now_ms();
+  for (uint32_t f = 0; f < frames && !platform_should_close(r->platform); f++) {
+    platform_events();
+    rendering_draw(r);
+    aliveSum += ps->lastAlive;
+  }
+  double wallMs = profiler_now_ms() - start;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(r->vulkan_context.physicalDevice, &properties);
+  double gpuMs = ps->gpuStat.total;
+  printf(CYAN "[PROFILE] " RESET "particles on %s: capacity %u, %.0f alive on average, %.3f ms GPU per frame, "
+         "%.0f particles/ms simulated, %.2f ms per frame overall\n",
+         properties.deviceName, ps->capacity, (double)aliveSum / frames, profiler_stat_avg(&ps->gpuStat),
+         gpuMs > 0.0 ? (double)ps->simulated / gpuMs : 0.0, wallMs / frames);
+}
+
+// Scene store at 10k, 100k and 1M objects: one root per 64 objects, each
+// object parenting the next four, so up to four levels. Full updates are
+// timed with every kernel this CPU runs (best of five); partial ones move 1%
+// of the roots, scattered, and recompute only the blocks under them.
+static void benchScene(void) {
+  const uint32_t sizes[] = {10000, 100000, 1000000};
+  const uint32_t repeats = 5;
+  for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    uint32_t count = sizes[s];
+    uint32_t roots = count / 64;
+    Scene_Store store;
+    if (!scene_store_create(&store, count)) return;
+    srand(s + 1);
+    for (uint32_t i = 0; i < count; i++) {
+      Scene_Object object = {0};
+      object.parent = i < roots ? SCENE_NONE : (i - roots) / 4;
+      float length = 0.0f;
+      for (uint32_t c = 0; c < 4; c++) {
+        object.rotation[c] = (float)rand() / (float)RAND_MAX - 0.5f;
+        length += object.rotation[c] * object.rotation[c];
+      }
+      length = sqrtf(length) > 0.0f ? 1.0f / sqrtf(length) : 0.0f;
+      for (uint32_t c = 0; c < 4; c++) object.rotation[c] *= length;
+      for (uint32_t c = 0; c < 3; c++) {
+        object.position[c] = ((float)rand() / (float)RAND_MAX - 0.5f) * 10.0f;
+        object.scale[c] = 1.0f;
+        object.boundsExtent[c] = 0.5f;
+      }
+      scene_store_add(&store, &object);
+    }
+
+    // The first update sorts, then recomputes everything
+    double start = profiler_now_ms();
+    scene_store_update(&store);
+    double firstMs = profiler_now_ms() - start;
+    printf(CYAN "[PROFILE] " RESET "scene %u objects, %u levels: first update %.3f ms (sort %.3f ms)\n", count,
+           store.levelCount, firstMs, store.sortStat.total);
+
+    Scene_Kernel best = scene_best_kernel();
+    for (uint32_t k = SCENE_KERNEL_SCALAR; k <= (uint32_t)best; k++) {
+      scene_store_set_kernel(&store, (Scene_Kernel)k);
+      double bestMs = 0.0;
+      for (uint32_t i = 0; i < repeats; i++) {
+        scene_store_invalidate(&store);
+        start = profiler_now_ms();
+        scene_store_update(&store);
+        double ms = profiler_now_ms() - start;
+        if (i == 0 || ms < bestMs) bestMs = ms;
+      }
+      printf(CYAN "[PROFILE] " RESET "  full update, %s: %.3f ms, %.2f ns/object\n",
+             scene_kernel_name((Scene_Kernel)k), bestMs, bestMs * 1e6 / count);
+    }
+
+    uint32_t moved = roots / 100 > 0 ? roots / 100 : 1;
+    Profiler_Stat partialStat = {0};
+    uint64_t recomputed = 0;
+    for (uint32_t i = 0; i < repeats; i++) {
+      for (uint32_t m = 0; m < moved; m++) {
+        float position[3] = {(float)(rand() % 10), 0.0f, (float)(rand() % 10)};
+        scene_store_set_position(&store, (uint32_t)rand() % roots, position);
+      }
+      start = profiler_now_ms();
+      scene_store_update(&store);
+      profiler_stat_add(&partialStat, profiler_now_ms() - start);
+      recomputed += store.updatedObjects;
+    }
+    printf(CYAN "[PROFILE] " RESET "  %u roots moved: update %.3f ms, %.0f of %u objects recomputed\n", moved,
+           profiler_stat_avg(&partialStat), (double)recomputed / repeats, count);
+    scene_store_destroy(&store);
+  }
+}
+
+// Loads N textures through the uncompressed path (base level upload, mips
+// blitted on the GPU) and then as pre-compressed BC1 chains, and compares the
+// load time and memory. The BC1 payloads are built before the timing starts,
+// as an offline tool would have.
+static void benchTextures(Rendering_Context *r, uint32_t count) {
+  const uint32_t size = 512;
+  Vulkan_Context *vk = &r->vulkan_context;
+  uint32_t levels = texture_mip_count(size, size);
+  size_t rgbaSize = (size_t)size * size * 4;
+  size_t bc1Size = 0;
+  for (uint32_t l = 0; l < levels; l++) {
+    uint32_t s = size >> l ? size >> l : 1;
+    bc1Size += (size_t)texture_level_size(VK_FORMAT_BC1_RGB_SRGB_BLOCK, s, s);
+  }
+
+  uint8_t *rgba = malloc(rgbaSize * count);
+  uint8_t *bc1 = malloc(bc1Size * count);
+  uint8_t *level = malloc(rgbaSize);
+  Texture *textures = calloc(count, sizeof(Texture));
+  if (!rgba || !bc1 || !level || !textures) {
+    printf(RED "[ERROR] " RESET "failed to allocate %u textures\n", count);
+    free(rgba); free(bc1); free(level); free(textures);
+    return;
+  }
+  for (uint32_t t = 0; t < count; t++) {
+    uint8_t *base = rgba + rgbaSize * t;
+    fillTexture(base, size, t);
+    // Box-filtered chain, each level encoded in turn
+    memcpy(level, base, rgbaSize);
+    uint8_t *out = bc1 + bc1Size * t;
+    for (uint32_t l = 0, s = size; l < levels; l++, s = s > 1 ? s / 2 : 1) {
+      encodeBc1(level, s, out);
+      out += texture_level_size(VK_FORMAT_BC1_RGB_SRGB_BLOCK, s, s);
+      uint32_t half = s > 1 ? s / 2 : 1;
+      for (uint32_t y = 0; y < half; y++) {
+        for (uint32_t x = 0; x < half; x++) {
+          for (uint32_t c = 0; c < 4; c++) {
+            uint32_t sum = 0;
+            for (uint32_t k = 0; k < 4; k++) {
+              uint32_t sx = x * 2 + (k & 1), sy = y * 2 + (k >> 1);
+              sum += level[((size_t)(sy < s ? sy : s - 1) * s + (sx < s ? sx : s - 1)) * 4 + c];
+            }
+            level[((size_t)y * half + x) * 4 + c] = (uint8_t)(sum / 4);
+          }
+        }
+      }
+    }
+  }
+
+  for (uint32_t path = 0; path < 2; path++) {
+    bool compressed = path == 1;
+    if (compressed && !texture_format_sampled(vk, VK_FORMAT_BC1_RGB_SRGB_BLOCK)) {
+      printf(YELLOW "[WARNING] " RESET "BC1 can't be sampled on this device, skipping the compressed path\n");
+      break;
+    }
+    Texture_Loader loader;
+    texture_loader_create(&loader, vk, r->commandPool);
+    bool ok = true;
+    for (uint32_t t = 0; t < count && ok; t++) {
+      ok = compressed ? texture_loader_add_compressed(&loader, &textures[t], VK_FORMAT_BC1_RGB_SRGB_BLOCK,
+                                                      size, size, levels, bc1 + bc1Size * t, bc1Size)
+                      : texture_loader_add_rgba8(&loader, &textures[t], size, size, true, 0, rgba + rgbaSize * t);
+    }
+    if (ok) ok = texture_loader_flush(&loader);
+
+    VkDeviceSize memory = compressed ? loader.compressedMemory : loader.uncompressedMemory;
+    printf(CYAN "[PROFILE] " RESET "%u %ux%u textures, %s: load %.3f ms, uploaded %.2f MiB, memory %.2f MiB%s\n",
+           count, size, size, compressed ? "pre-compressed BC1" : "RGBA8 + GPU mips", loader.loadMs,
+           (double)loader.uploadedBytes / (1024.0 * 1024.0), (double)memory / (1024.0 * 1024.0),
+           ok ? "" : " (failed)");
+    texture_loader_destroy(&loader);
+    for (uint32_t t = 0; t < count; t++) texture_destroy(vk, &textures[t]);
+  }
+
+  if (vk->memoryLimit > 0) benchResidency(r, count, rgba, size);
+
+  free(rgba);
+  free(bc1);
+  free(level);
+  free(textures);
+}
+
+// Records the per-draw state commands (viewport, scissor, push constants) N
+// times through the loader trampolines and then through the device dispatch
+// table. Nothing is submitted; only CPU recording cost is measured.
+static void benchDispatch(Rendering_Context *r, uint32_t draws) {
+  Vulkan_Context *vk = &r->vulkan_context;
+  const Vulkan_Dispatch *vkd = &vk->dispatch;
+  const uint32_t rounds = 5;
+
+  VkCommandBufferAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = r->commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBufferBeginInfo beginInfo = {0};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  VkViewport viewport = {0};
+  viewport.width = (float)r->swapChainExtent.width;
+  viewport.height = (float)r->swapChainExtent.height;
+  viewport.maxDepth = 1.0f;
+  VkRect2D scissor = {0};
+  scissor.extent = r->swapChainExtent;
+  float push[2] = {0.0f, 0.0f};  // matches the sprite vertex push range
+  VkPipelineLayout layout = r->sprites.pipelineLayout;
+
+  // Alternate the two paths so clock and cache effects hit both equally
+  double best[2] = {0.0, 0.0};
+  for (uint32_t round = 0; round < rounds * 2; round++) {
+    bool direct = round & 1;
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    if (vkAllocateCommandBuffers(vk->device, &allocInfo, &cmd) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to allocate benchmark command buffer\n");
+      return;
+    }
+    vkBeginCommandBuffer(cmd, &beginInfo);
+
+    double start = profiler_now_ms();
+    if (direct) {
+      for (uint32_t i = 0; i < draws; i++) {
+        vkd->vkCmdSetViewport(cmd, 0, 1, &viewport);
+        vkd->vkCmdSetScissor(cmd, 0, 1, &scissor);
+        vkd->vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), push);
+      }
+    } else {
+      for (uint32_t i = 0; i < draws; i++) {
+        vkCmdSetViewport(cmd, 0, 1, &viewport);
+        vkCmdSetScissor(cmd, 0, 1, &scissor);
+        vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), push);
+      }
+    }
+    double ms = profiler_now_ms() - start;
+
+    vkEndCommandBuffer(cmd);
+    vkFreeCommandBuffers(vk->device, r->commandPool, 1, &cmd);
+    if (round < 2 || ms < best[direct]) best[direct] = ms;
+  }
+
+  double perDraw[2];
+  for (uint32_t i = 0; i < 2; i++) {
+    perDraw[i] = draws > 0 ? best[i] * 1.0e6 / (double)draws : 0.0;
+  }
+  printf(CYAN "[PROFILE] " RESET "%u draws x 3 commands, best of %u\n", draws, rounds);
+  printf(CYAN "[PROFILE] " RESET "loader trampoline: %.3f ms (%.1f ns/draw)\n", best[0], perDraw[0]);
+  printf(CYAN "[PROFILE] " RESET "dispatch table:    %.3f ms (%.1f ns/draw)\n", best[1], perDraw[1]);
+  printf(CYAN "[PROFILE] " RESET "saved %.1f ns/draw (%.1f%%)\n", perDraw[0] - perDraw[1],
+         perDraw[0] > 0.0 ? (perDraw[0] - perDraw[1]) * 100.0 / perDraw[0] : 0.0);
+}
+
+// Builds the meshlets and LOD chain of one mesh at load time and uploads it.
+// Without --mesh a bumpy sphere stands in: large enough to be vertex bound,
+// with facets pointing every way so cone culling has something to reject.
+bool bench_load_meshes(const Bench_Config *bench, Rendering_Context *r, uint32_t segments, uint32_t rings) {
+  Mesh_Data mesh = {0};
+  bool ok = bench->meshPath ? mesh_load_obj(&mesh, bench->meshPath)
+                            : mesh_generate_sphere(&mesh, segments, rings, 0.08f);
+  if (!ok) return false;
+
+  Mesh_Meshlets meshlets = {0};
+  ok = mesh_build_meshlets(&mesh, &meshlets);
+  mesh_data_free(&mesh);
+  if (!ok) return false;
+
+  printf(CYAN "[PROFILE] " RESET "meshlets built in %.1f ms: %u vertices, %u meshlets, %u LODs\n",
+         meshlets.buildMs, meshlets.vertexCount, meshlets.meshletCount, meshlets.lodCount);
+  for (uint32_t l = 0; l < meshlets.lodCount; l++) {
+    const Mesh_Lod *lod = &meshlets.lods[l];
+    printf(CYAN "[PROFILE] " RESET "  LOD %u: %u triangles in %u meshlets (%.1f per meshlet), error %.5f\n",
+           l, lod->triangleCount, lod->meshletCount,
+           lod->meshletCount ? (double)lod->triangleCount / (double)lod->meshletCount : 0.0, lod->error);
+  }
+
+  Mesh_Renderer *mr = &r->meshes;
+  mr->lodThreshold = bench->lodThreshold;
+  mr->occlusion = !bench->noOcclusion;
+  ok = mesh_renderer_upload(mr, &meshlets, 1);
+  mesh_meshlets_free(&meshlets);
+  return ok;
+}
+
+// Pushes a side x side grid of instances of mesh 0 around the origin
+void bench_push_mesh_grid(Rendering_Context *r, uint32_t count, float spacing) {
+  Mesh_Renderer *mr = &r->meshes;
+  uint32_t side = (uint32_t)ceil(sqrt((double)count));
+  float half = 0.5f * spacing * (float)(side - 1);
+  for (uint32_t i = 0; i < count; i++) {
+    Mesh_Instance instance = {0};
+    instance.position[0] = (float)(i % side) * spacing - half;
+    instance.position[2] = (float)(i / side) * spacing - half;
+    instance.scale = 1.0f;
+    instance.rotation = (float)(i % 7) * 0.9f;
+    instance.color = 0xFF000000u | (0x40 + (i * 37) % 0xC0) | ((0x40 + (i * 91) % 0xC0) << 8) | (0xC0u << 16);
+    mesh_renderer_push(mr, &instance);
+  }
+}
+
+// Renders a grid of the large mesh from an orbiting camera, first with every
+// instance forced to full detail, then with screen-space LOD selection, and
+// reports GPU time and triangle throughput for both.
+static void benchMeshlets(const Bench_Config *bench, Rendering_Context *r, uint32_t instances) {
+  const uint32_t frames = 300;
+  Mesh_Renderer *mr = &r->meshes;
+  if (!bench_load_meshes(bench, r, 1024, 512)) return;
+
+  const float spacing = 3.0f;
+  uint32_t side = (uint32_t)ceil(sqrt((double)instances));
+  float extent = spacing * (float)side;
+  const char *phases[] = {"LOD 0", "auto LOD"};
+
+  for (uint32_t phase = 0; phase < 2; phase++) {
+    mr->forceLod = phase == 0 ? 0 : -1;
+    memset(&mr->gpuStat, 0, sizeof(mr->gpuStat));
+    memset(&mr->flushStat, 0, sizeof(mr->flushStat));
+    Profiler_Stat frameStat = {0};
+    double triangles = 0.0, meshlets = 0.0;
+
+    for (uint32_t f = 0; f < frames && !platform_should_close(r->platform); f++) {
+      platform_events();
+      double frameStart = profiler_now_ms();
+
+      float angle = (float)f * 0.02f;
+      float eye[3] = {cosf(angle) * extent * 0.6f, extent * 0.25f + 2.0f, sinf(angle) * extent * 0.6f};
+      float target[3] = {0.0f, 0.0f, 0.0f};
+      mesh_renderer_set_camera(mr, eye, target, 1.0f, 0.1f, extent * 4.0f);
+      bench_push_mesh_grid(r, instances, spacing);
+      rendering_draw(r);
+
+      profiler_stat_add(&frameStat, profiler_now_ms() - frameStart);
+      triangles += (double)mr->lastTriangles;
+      meshlets += (double)mr->lastMeshlets;
+    }
+    vkDeviceWaitIdle(r->vulkan_context.device);
+
+    double n = (double)(frameStat.count ? frameStat.count : 1);
+    double gpuMs = profiler_stat_avg(&mr->gpuStat);
+    printf(CYAN "[PROFILE] " RESET "%s: %u instances, %.0f meshlets, %.2f M triangles/frame submitted\n",
+           phases[phase], instances, meshlets / n, triangles / n / 1.0e6);
+    profiler_stat_print("mesh LOD select+upload", &mr->flushStat);
+    profiler_stat_print("mesh cull+draw (GPU)", &mr->gpuStat);
+    profiler_stat_print("frame", &frameStat);
+    printf(CYAN "[PROFILE] " RESET "%s: %.1f M triangles/s (GPU)\n", phases[phase],
+           gpuMs > 0.0 ? triangles / n / gpuMs / 1000.0 : 0.0);
+  }
+}
+
+// A wall of large instances right in front of the camera hides a grid of
+// instances behind it. Renders the scene with occlusion culling off, then on,
+// and reports how many instances the depth pyramid rejected and what that saved.
+static void benchOcclusion(const Bench_Config *bench, Rendering_Context *r, uint32_t instances) {
+  const uint32_t frames = 300;
+  Mesh_Renderer *mr = &r->meshes;
+  if (!bench_load_meshes(bench, r, 256, 128)) return;
+
+  const float spacing = 3.0f;
+  uint32_t side = (uint32_t)ceil(sqrt((double)instances));
+  float extent = spacing * (float)side;
+  float wallZ = extent * 0.5f + 4.0f;
+  const char *phases[] = {"occlusion off", "occlusion on"};
+  double gpuMs[2] = {0.0, 0.0}, frameMs[2] = {0.0, 0.0};
+
+  for (uint32_t phase = 0; phase < 2; phase++) {
+    mr->occlusion = phase == 1;
+    memset(&mr->gpuStat, 0, sizeof(mr->gpuStat));
+    Profiler_Stat frameStat = {0};
+    double tested = 0.0, occluded = 0.0, disoccluded = 0.0, triangles = 0.0;
+
+    for (uint32_t f = 0; f < frames && !platform_should_close(r->platform); f++) {
+      platform_events();
+      double frameStart = profiler_now_ms();
+
+      // Sway a little so the pyramid is always one frame behind the camera
+      float eye[3] = {sinf((float)f * 0.05f), 1.5f, wallZ + 8.0f};
+      float target[3] = {0.0f, 1.5f, 0.0f};
+      mesh_renderer_set_camera(mr, eye, target, 1.0f, 0.1f, extent * 4.0f);
+      // Overlapping spheres leave no gaps across the view
+      for (int y = 0; y < 3; y++) {
+        for (int x = -2; x <= 2; x++) {
+          Mesh_Instance wall = {0};
+          wall.position[0] = (float)x * 3.5f;
+          wall.position[1] = -2.0f + (float)y * 3.5f;
+          wall.position[2] = wallZ;
+          wall.scale = 3.0f;
+          wall.color = 0xFF808080u;
+          mesh_renderer_push(mr, &wall);
+        }
+      }
+      bench_push_mesh_grid(r, instances, spacing);
+      rendering_draw(r);
+
+      profiler_stat_add(&frameStat, profiler_now_ms() - frameStart);
+      tested += (double)mr->lastTested;
+      occluded += (double)mr->lastOccluded;
+      disoccluded += (double)mr->lastDisoccluded;
+      triangles += (double)mr->lastTriangles;
+    }
+    vkDeviceWaitIdle(r->vulkan_context.device);
+
+    double n = (double)(frameStat.count ? frameStat.count : 1);
+    gpuMs[phase] = profiler_stat_avg(&mr->gpuStat);
+    frameMs[phase] = profiler_stat_avg(&frameStat);
+    printf(CYAN "[PROFILE] " RESET "%s: %.0f instances tested/frame, %.1f%% culled, %.1f disoccluded, "
+           "%.2f M triangles submitted\n", phases[phase], tested / n,
+           tested > 0.0 ? occluded * 100.0 / tested : 0.0, disoccluded / n, triangles / n / 1.0e6);
+    profiler_stat_print("mesh cull+draw (GPU)", &mr->gpuStat);
+    profiler_stat_print("frame", &frameStat);
+  }
+  printf(CYAN "[PROFILE] " RESET "occlusion culling saved %.3f ms GPU (%.1f%%), %.3f ms per frame (%.1f%%)\n",
+         gpuMs[0] - gpuMs[1], gpuMs[0] > 0.0 ? (gpuMs[0] - gpuMs[1]) * 100.0 / gpuMs[0] : 0.0,
+         frameMs[0] - frameMs[1], frameMs[0] > 0.0 ? (frameMs[0] - frameMs[1]) * 100.0 / frameMs[0] : 0.0);
+  mr->occlusion = !bench->noOcclusion;
+}
+
+// ========== SERVICE CLIENT ==========
+
+// Reads one byte per cache line, so every page of the frame is faulted in
+// and read like a consumer would
+static uint64_t touchFrame(const Service_Client *client, int32_t slot) {
+  const uint8_t *pixels = service_client_pixels(client, slot);
+  if (!pixels) return 0;
+  size_t size = (size_t)client->header->width * client->header->height * 4;
+  uint64_t sum = 0;
+  for (size_t i = 0; i < size; i += 64) sum += pixels[i];
+  return sum;
+}
+
+static bool requestFrame(Service_Client *client, uint32_t id) {
+  // Orbit the camera so no two frames are the same work
+  float angle = (float)id * 0.05f;
+  Service_Command camera = {0};
+  camera.type = SERVICE_COMMAND_CAMERA;
+  camera.camera.eye[0] = 10.0f * sinf(angle);
+  camera.camera.eye[1] = 4.0f;
+  camera.camera.eye[2] = 10.0f * cosf(angle);
+  camera.camera.fovY = 1.0f;
+  Service_Command frame = {0};
+  frame.type = SERVICE_COMMAND_FRAME;
+  frame.id = id;
+  return service_client_send(client, &camera) && service_client_send(client, &frame);
+}
+
+static bool releaseFrame(Service_Client *client, int32_t slot) {
+  Service_Command release = {0};
+  release.type = SERVICE_COMMAND_RELEASE;
+  release.slot = slot;
+  return slot < 0 || service_client_send(client, &release);
+}
+
+// Client of a running --serve process: request-to-frame latency one frame at
+// a time, then sustained throughput with every ring slot kept busy.
+// Returns the process exit code.
+int bench_service(const Bench_Config *bench) {
+  Service_Client client;
+  if (!service_client_connect(&client, bench->serviceSocket)) return 1;
+  const Service_Shared_Header *header = client.header;
+  uint32_t frames = bench->serviceFrames ? bench->serviceFrames : 1;
+  printf(GREEN "[OK] " RESET "connected to %s: %ux%u, %u slots, %s\n", bench->serviceSocket,
+         header->width, header->height, header->slotCount,
+         (header->flags & SERVICE_FLAG_ZERO_COPY) ? "zero-copy" : "copied into the ring");
+
+  bool ok = true;
+  uint32_t failed = 0;
+  uint64_t checksum = 0;
+  uint32_t id = 0;
+  Service_Frame_Ready ready;
+
+  Profiler_Stat latencyStat = {0};
+  for (uint32_t i = 0; i < frames && ok; i++) {
+    double start = profiler_now_ms();
+    ok = requestFrame(&client, id++) && service_client_wait(&client, &ready);
+    if (!ok) break;
+    profiler_stat_add(&latencyStat, profiler_now_ms() - start);
+    if (ready.slot < 0) failed++;
+    checksum += touchFrame(&client, ready.slot);
+    ok = releaseFrame(&client, ready.slot);
+  }
+
+  uint32_t sent = 0, received = 0;
+  double start = profiler_now_ms();
+  while (ok && received < frames) {
+    while (ok && sent < frames && sent - received < header->slotCount) {
+      ok = requestFrame(&client, id++);
+      sent++;
+    }
+    if (!ok || !service_client_wait(&client, &ready)) {
+      ok = false;
+      break;
+    }
+    received++;
+    if (ready.slot < 0) failed++;
+    checksum += touchFrame(&client, ready.slot);
+    ok = releaseFrame(&client, ready.slot);
+  }
+  double elapsedMs = profiler_now_ms() - start;
+  service_client_close(&client);
+
+  if (!ok) {
+    printf(RED "[ERROR] " RESET "service connection lost\n");
+    return 1;
+  }
+  printf(CYAN "[PROFILE] " RESET "service latency (%u frames, one outstanding):\n", frames);
+  profiler_stat_print("request to frame", &latencyStat);
+  printf(CYAN "[PROFILE] " RESET "service throughput: %u frames in %.1f ms, %.1f fps (%u outstanding), "
+         "%u failed, checksum %llx\n",
+         frames, elapsedMs, elapsedMs > 0.0 ? (double)frames * 1000.0 / elapsedMs : 0.0, header->slotCount,
+         failed, (unsigned long long)checksum);
+  return failed ? 1 : 0;
+}
+
+// ========== COMMAND LINE ==========
+
+bool bench_parse_arg(Bench_Config *bench, int argc, char **argv, int *i) {
+  const char *arg = argv[*i];
+  bool value = *i + 1 < argc;
+  if (strcmp(arg, "--bench-resize") == 0 && value) {
+    bench->resize = (uint32_t)strtoul(argv[++*i], NULL, 10);
+  } else if (strcmp(arg, "--bench-sprites") == 0 && value) {
+    bench->sprites = (uint32_t)strtoul(argv[++*i], NULL, 10);
+  } else if (strcmp(arg, "--bench-cache") == 0 && value) {
+    bench->cache = (uint32_t)strtoul(argv[++*i], NULL, 10);
+  } else if (strcmp(arg, "--bench-textures") == 0 && value) {
+    bench->textures = (uint32_t)strtoul(argv[++*i], NULL, 10);
+  } else if (strcmp(arg, "--bench-resolution") == 0 && value) {
+    bench->resolution = (uint32_t)strtoul(argv[++*i], NULL, 10);
+  } else if (strcmp(arg, "--bench-particles") == 0 && value) {
+    bench->particles = (uint32_t)strtoul(argv[++*i], NULL, 10);
+  } else if (strcmp(arg, "--bench-scene") == 0) {
+    bench->scene = true;
+  } else if (strcmp(arg, "--bench-dispatch") == 0 && value) {
+    bench->dispatch = (uint32_t)strtoul(argv[++*i], NULL, 10);
+  } else if (strcmp(arg, "--bench-meshlets") == 0 && value) {
+    bench->meshlets = (uint32_t)strtoul(argv[++*i], NULL, 10);
+  } else if (strcmp(arg, "--bench-occlusion") == 0 && value) {
+    bench->occlusion = (uint32_t)strtoul(argv[++*i], NULL, 10);
+  } else if (strcmp(arg, "--bench-service") == 0 && *i + 2 < argc) {
+    bench->serviceSocket = argv[++*i];
+    bench->serviceFrames = (uint32_t)strtoul(argv[++*i], NULL, 10);
+  } else if (strcmp(arg, "--mesh") == 0 && value) {
+    bench->meshPath = argv[++*i];
+  } else if (strcmp(arg, "--lod-threshold") == 0 && value) {
+    bench->lodThreshold = strtof(argv[++*i], NULL);
+  } else if (strcmp(arg, "--no-occlusion") == 0) {
+    bench->noOcclusion = true;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void bench_configure(Bench_Config *bench, Rendering_Config *config) {
+  bench->resolutionTargetMs = config->resolutionTargetMs;
+  if (bench->resolution > 0 && config->resolutionTargetMs <= 0.0f) {
+    // Never reached; the bench sets a real target once it has a baseline
+    config->resolutionTargetMs = 1000.0f;
+  }
+  if (bench->particles > 0) config->particles = bench->particles;
+  if (bench->meshlets > 0 || bench->occlusion > 0) config->meshes = true;
+}
+
+bool bench_run(const Bench_Config *bench, Rendering_Context *r) {
+  if (bench->dispatch > 0) {
+    benchDispatch(r, bench->dispatch);
+  } else if (bench->meshlets > 0) {
+    benchMeshlets(bench, r, bench->meshlets);
+  } else if (bench->occlusion > 0) {
+    benchOcclusion(bench, r, bench->occlusion);
+  } else if (bench->sprites > 0) {
+    benchSprites(r, bench->sprites);
+  } else if (bench->cache > 0) {
+    benchCache(r, bench->cache);
+  } else if (bench->textures > 0) {
+    benchTextures(r, bench->textures);
+  } else if (bench->resolution > 0) {
+    benchResolution(bench, r, bench->resolution);
+  } else if (bench->particles > 0) {
+    benchParticles(r);
+  } else if (bench->scene) {
+    benchScene();
+  } else if (bench->resize > 0) {
+    benchResize(r, bench->resize);
+    printf(CYAN "[PROFILE] " RESET "resize path: %s\n", r->dynamicRendering ? "dynamic rendering" : "render pass");
+    profiler_stat_print("swapchain recreate", &r->resizeStat);
+  } else {
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,49 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "rendering.h"
+
+// Benchmarks selected on the command line; at most one runs, in the order
+// bench_run checks them. Counts of 0 leave a benchmark off.
+typedef struct {
+  uint32_t resize;
+  uint32_t sprites;
+  uint32_t cache;        // sprites in the static / mostly-static command cache comparison
+  uint32_t textures;     // textures loaded through each ingestion path
+  uint32_t resolution;   // frames at a fixed scale and then steered, each
+  float resolutionTargetMs;  // --dynamic-resolution, 0 when not given
+  uint32_t particles;    // particle capacity, filled and then timed
+  bool scene;            // scene store updates at 10k, 100k and 1M objects
+  uint32_t dispatch;
+  uint32_t meshlets;     // instances of the large mesh
+  uint32_t occlusion;    // instances hidden behind a wall
+
+  // Client of a running --serve process
+  const char *serviceSocket;
+  uint32_t serviceFrames;
+
+  // Mesh loading, shared with the mesh scenes
+  const char *meshPath;  // OBJ to use instead of the generated sphere
+  float lodThreshold;    // pixels of simplification error allowed per instance
+  bool noOcclusion;      // draw every instance the frustum keeps
+} Bench_Config;
+
+// Consumes argv[*i] (and its value) when it is a benchmark or mesh flag,
+// leaving *i on the last argument used. Returns false for anything else.
+bool bench_parse_arg(Bench_Config *bench, int argc, char **argv, int *i);
+// After parsing: the rendering features the chosen benchmark needs
+void bench_configure(Bench_Config *bench, Rendering_Config *config);
+// Runs the chosen benchmark on the window's renderer. Returns false, having
+// done nothing, when none was asked for.
+bool bench_run(const Bench_Config *bench, Rendering_Context *r);
+// Needs no device of its own. Returns the process exit code.
+int bench_service(const Bench_Config *bench);
+
+// Helpers shared with the regression scenes
+uint32_t bench_xorshift(uint32_t *state);
+bool bench_load_meshes(const Bench_Config *bench, Rendering_Context *r, uint32_t segments, uint32_t rings);
+void bench_push_mesh_grid(Rendering_Context *r, uint32_t count, float spacing);
+
+#endif
@@ -0,0 +1,130 @@
+#include "deletion.h"
+#include "color.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DELETION_INITIAL_CAPACITY 64
+
+static void destroyEntry(Deletion_Queue *queue, const Deletion_Entry *entry) {
+  VkDevice device = queue->device;
+  switch (entry->type) {
+    case DELETION_BUFFER: vkDestroyBuffer(device, (VkBuffer)entry->handle, NULL); break;
+    case DELETION_IMAGE: vkDestroyImage(device, (VkImage)entry->handle, NULL); break;
+    case DELETION_IMAGE_VIEW: vkDestroyImageView(device, (VkImageView)entry->handle, NULL); break;
+    case DELETION_MEMORY:
+      memory_budget_untrack(queue->budget, (VkDeviceMemory)entry->handle);
+      vkFreeMemory(device, (VkDeviceMemory)entry->handle, NULL);
+      break;
+    case DELETION_SAMPLER: vkDestroySampler(device, (VkSampler)entry->handle, NULL); break;
+    case DELETION_FRAMEBUFFER: vkDestroyFramebuffer(device, (VkFramebuffer)entry->handle, NULL); break;
+    case DELETION_RENDER_PASS: vkDestroyRenderPass(device, (VkRenderPass)entry->handle, NULL); break;
+    case DELETION_PIPELINE: vkDestroyPipeline(device, (VkPipeline)entry->handle, NULL); break;
+    case DELETION_PIPELINE_LAYOUT: vkDestroyPipelineLayout(device, (VkPipelineLayout)entry->handle, NULL); break;
+    case DELETION_SHADER_MODULE: vkDestroyShaderModule(device, (VkShaderModule)entry->handle, NULL); break;
+    case DELETION_DESCRIPTOR_POOL: vkDestroyDescriptorPool(device, (VkDescriptorPool)entry->handle, NULL); break;
+    case DELETION_SEMAPHORE: vkDestroySemaphore(device, (VkSemaphore)entry->handle, NULL); break;
+    case DELETION_SWAPCHAIN: vkDestroySwapchainKHR(device, (VkSwapchainKHR)entry->handle, NULL); break;
+    case DELETION_SURFACE: vkDestroySurfaceKHR(queue->instance, (VkSurfaceKHR)entry->handle, NULL); break;
+    case DELETION_COMMAND_BUFFERS:
+      vkFreeCommandBuffers(device, entry->pool, entry->bufferCount, entry->buffers);
+      free(entry->buffers);
+      break;
+  }
+  queue->destroyedCount++;
+}
+
+// Keeps the ring in order when it grows
+static bool grow(Deletion_Queue *queue) {
+  uint32_t capacity = queue->capacity ? queue->capacity * 2 : DELETION_INITIAL_CAPACITY;
+  Deletion_Entry *entries = malloc(capacity * sizeof(Deletion_Entry));
+  if (!entries) return false;
+  arena_note_heap_allocation();
+  for (uint32_t i = 0; i < queue->count; i++) {
+    entries[i] = queue->entries[(queue->head + i) % queue->capacity];
+  }
+  free(queue->entries);
+  queue->entries = entries;
+  queue->head = 0;
+  queue->capacity = capacity;
+  return true;
+}
+
+static void pushEntry(Deletion_Queue *queue, const Deletion_Entry *entry) {
+  queue->retiredCount++;
+  if (queue->count == queue->capacity && !grow(queue)) {
+    printf(YELLOW "[WARNING] " RESET "deletion queue full, waiting for the device\n");
+    vkDeviceWaitIdle(queue->device);
+    deletion_queue_flush(queue);
+    destroyEntry(queue, entry);
+    return;
+  }
+  Deletion_Entry *slot = &queue->entries[(queue->head + queue->count) % queue->capacity];
+  *slot = *entry;
+  slot->retired = queue->submitted;
+  queue->count++;
+  if (queue->count > queue->peakCount) queue->peakCount = queue->count;
+}
+
+bool deletion_queue_create(Deletion_Queue *queue, VkInstance instance, VkDevice device) {
+  if (!queue) return false;
+  memset(queue, 0, sizeof(*queue));
+  queue->instance = instance;
+  queue->device = device;
+  return grow(queue);
+}
+
+void deletion_queue_destroy(Deletion_Queue *queue) {
+  if (!queue) return;
+  deletion_queue_flush(queue);
+  free(queue->entries);
+  queue->entries = NULL;
+  queue->capacity = 0;
+}
+
+void deletion_queue_push(Deletion_Queue *queue, Deletion_Type type, uint64_t handle) {
+  if (!queue || handle == 0) return;
+  Deletion_Entry entry = {0};
+  entry.type = type;
+  entry.handle = handle;
+  pushEntry(queue, &entry);
+}
+
+void deletion_queue_push_commands(Deletion_Queue *queue, VkCommandPool pool, VkCommandBuffer *buffers,
+                                  uint32_t count) {
+  if (!queue || !buffers) return;
+  Deletion_Entry entry = {0};
+  entry.type = DELETION_COMMAND_BUFFERS;
+  entry.pool = pool;
+  entry.buffers = buffers;
+  entry.bufferCount = count;
+  pushEntry(queue, &entry);
+}
+
+uint64_t deletion_queue_submit(Deletion_Queue *queue) {
+  return ++queue->submitted;
+}
+
+void deletion_queue_collect(Deletion_Queue *queue, uint64_t completed) {
+  if (!queue) return;
+  if (completed > queue->completed) queue->completed = completed;
+  while (queue->count > 0) {
+    Deletion_Entry *entry = &queue->entries[queue->head];
+    if (entry->retired > queue->completed) break;
+    destroyEntry(queue, entry);
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+  }
+}
+
+void deletion_queue_flush(Deletion_Queue *queue) {
+  if (!queue) return;
+  deletion_queue_collect(queue, queue->submitted);
+}
+
+void deletion_queue_print_stats(const Deletion_Queue *queue) {
+  if (!queue || queue->retiredCount == 0) return;
+  printf(CYAN "[PROFILE] " RESET "deferred deletion: %llu retired, %llu destroyed, at most %u pending\n",
+         (unsigned long long)queue->retiredCount, (unsigned long long)queue->destroyedCount, queue->peakCount);
+}
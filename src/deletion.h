@@ -0,0 +1,82 @@
+#ifndef DELETION_H
+#define DELETION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "memory_budget.h"
+
+typedef enum {
+  DELETION_BUFFER,
+  DELETION_IMAGE,
+  DELETION_IMAGE_VIEW,
+  DELETION_MEMORY,
+  DELETION_SAMPLER,
+  DELETION_FRAMEBUFFER,
+  DELETION_RENDER_PASS,
+  DELETION_PIPELINE,
+  DELETION_PIPELINE_LAYOUT,
+  DELETION_SHADER_MODULE,
+  DELETION_DESCRIPTOR_POOL,
+  DELETION_SEMAPHORE,
+  DELETION_SWAPCHAIN,
+  DELETION_SURFACE,
+  DELETION_COMMAND_BUFFERS,  // an array of them, freed back to their pool and then free()d
+} Deletion_Type;
+
+typedef struct {
+  Deletion_Type type;
+  uint64_t retired;  // submissions made when it was retired
+  uint64_t handle;   // any non-dispatchable handle, cast
+  // DELETION_COMMAND_BUFFERS
+  VkCommandPool pool;
+  VkCommandBuffer *buffers;
+  uint32_t bufferCount;
+} Deletion_Entry;
+
+// Objects the GPU may still be using, destroyed once it can't be anymore.
+// Entries are tagged with the number of submissions made when they were
+// retired; any of those may reference them, none after can. Whoever waits on
+// a submission's fence reports it done with deletion_queue_collect, which
+// destroys everything retired up to that point, in retirement order (so a
+// swapchain retired before its surface goes first). Nothing here waits.
+typedef struct {
+  VkDevice device;
+  VkInstance instance;  // for surfaces
+  Memory_Budget *budget;  // untracks freed memory when set
+
+  Deletion_Entry *entries;  // ring, oldest at head
+  uint32_t head;
+  uint32_t count;
+  uint32_t capacity;
+
+  uint64_t submitted;  // submissions made so far; also the next entry's tag
+  uint64_t completed;  // highest submission known finished
+
+  uint64_t retiredCount;
+  uint64_t destroyedCount;
+  uint32_t peakCount;
+} Deletion_Queue;
+
+bool deletion_queue_create(Deletion_Queue *queue, VkInstance instance, VkDevice device);
+// Destroys whatever is left; the device must be idle
+void deletion_queue_destroy(Deletion_Queue *queue);
+
+// Queues a handle; VK_NULL_HANDLE is ignored. If the entry can't be stored
+// the device is idled and it is destroyed right away.
+void deletion_queue_push(Deletion_Queue *queue, Deletion_Type type, uint64_t handle);
+// Takes ownership of a malloc'd array of command buffers from pool
+void deletion_queue_push_commands(Deletion_Queue *queue, VkCommandPool pool, VkCommandBuffer *buffers,
+                                  uint32_t count);
+
+// Counts a submission and returns its value, i.e. what to pass to
+// deletion_queue_collect once its fence has signaled
+uint64_t deletion_queue_submit(Deletion_Queue *queue);
+// Destroys everything retired before submission `completed` finished
+void deletion_queue_collect(Deletion_Queue *queue, uint64_t completed);
+// Destroys everything; only valid while the device is idle
+void deletion_queue_flush(Deletion_Queue *queue);
+
+void deletion_queue_print_stats(const Deletion_Queue *queue);
+
+#endif
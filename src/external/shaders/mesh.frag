@@ -0,0 +1,12 @@
+// mesh.frag
+#version 450
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec4 fragColor;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 light = normalize(vec3(0.4, 0.8, 0.45));
+    float diffuse = max(dot(normalize(fragNormal), light), 0.0);
+    outColor = vec4(fragColor.rgb * (0.2 + 0.8 * diffuse), fragColor.a);
+}
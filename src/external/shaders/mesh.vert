@@ -0,0 +1,44 @@
+// mesh.vert
+#version 450
+
+// Indexed-indirect meshlet path; firstInstance selects the instance
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+
+struct Instance {
+    vec4 positionScale;
+    vec4 sphere;  // world-space bounds
+    float cosYaw;
+    float sinYaw;
+    uint color;
+    uint firstMeshlet;
+    uint meshletCount;
+    uint drawOffset;
+    uint pad0;
+    uint pad1;
+};
+
+layout(std140, set = 0, binding = 0) uniform Camera {
+    mat4 viewProj;
+    vec4 planes[6];
+    vec4 position;
+    uint slotCount;
+    uint instanceCount;
+} camera;
+
+layout(std430, set = 0, binding = 2) readonly buffer Instances { Instance instances[]; };
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec4 fragColor;
+
+vec3 rotateYaw(vec3 v, Instance inst) {
+    return vec3(inst.cosYaw * v.x + inst.sinYaw * v.z, v.y, -inst.sinYaw * v.x + inst.cosYaw * v.z);
+}
+
+void main() {
+    Instance inst = instances[gl_InstanceIndex];
+    vec3 world = rotateYaw(inPosition, inst) * inst.positionScale.w + inst.positionScale.xyz;
+    gl_Position = camera.viewProj * vec4(world, 1.0);
+    fragNormal = rotateYaw(inNormal, inst);
+    fragColor = unpackUnorm4x8(inst.color);
+}
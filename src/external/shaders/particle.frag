@@ -0,0 +1,10 @@
+// particle.frag
+#version 450
+
+// Additive: overlapping points accumulate, which is what dense clouds want
+layout(location = 0) in vec4 fragColor;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(fragColor.rgb * fragColor.a, 0.0);
+}
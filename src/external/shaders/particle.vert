@@ -0,0 +1,43 @@
+// particle.vert
+#version 450
+
+// One point per particle in the list the simulation just compacted into;
+// the draw's vertex count is that list's length.
+struct Particle {
+    vec2 position;
+    vec2 velocity;
+    float life;
+    float lifetime;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Particles { Particle particles[]; };
+layout(std430, set = 0, binding = 1) readonly buffer Indices { uint indices[]; };
+
+layout(push_constant) uniform Params {
+    vec2 emitter;
+    vec2 gravity;
+    vec2 speed;
+    vec2 lifetime;
+    vec2 extent;
+    float direction;
+    float spread;
+    float drag;
+    float dt;
+    uint emitCount;
+    uint capacity;
+    uint current;
+    uint seed;
+    uint colorStart;
+    uint colorEnd;
+} params;
+
+layout(location = 0) out vec4 fragColor;
+
+void main() {
+    uint next = 1u - params.current;
+    Particle p = particles[indices[(1u + next) * params.capacity + uint(gl_VertexIndex)]];
+    gl_Position = vec4(p.position / params.extent * 2.0 - 1.0, 0.0, 1.0);
+    gl_PointSize = 1.0;
+    float age = 1.0 - p.life / p.lifetime;
+    fragColor = mix(unpackUnorm4x8(params.colorStart), unpackUnorm4x8(params.colorEnd), age);
+}
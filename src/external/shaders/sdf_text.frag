@@ -0,0 +1,16 @@
+// sdf_text.frag
+#version 450
+
+// Single-channel distance field, 0.5 on the glyph edge
+layout(set = 0, binding = 0) uniform sampler2D fontAtlas;
+
+layout(location = 0) in vec2 fragUV;
+layout(location = 1) in vec4 fragColor;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    float distance = texture(fontAtlas, fragUV).r;
+    float width = max(fwidth(distance), 1e-4);
+    float coverage = smoothstep(0.5 - width, 0.5 + width, distance);
+    outColor = vec4(fragColor.rgb, fragColor.a * coverage);
+}
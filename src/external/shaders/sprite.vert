@@ -0,0 +1,37 @@
+// sprite.vert
+#version 450
+
+// Per-instance data, see Sprite_Instance
+layout(location = 0) in vec4 inRect;      // x, y, w, h in pixels
+layout(location = 1) in vec4 inUV;        // u0, v0, u1, v1
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in float inRotation;
+
+layout(push_constant) uniform Push {
+    vec2 scale;  // 2 / viewport size
+} pc;
+
+layout(location = 0) out vec2 fragUV;
+layout(location = 1) out vec4 fragColor;
+
+vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0),
+    vec2(1.0, 0.0),
+    vec2(1.0, 1.0),
+    vec2(0.0, 0.0),
+    vec2(1.0, 1.0),
+    vec2(0.0, 1.0)
+);
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 local = (corner - 0.5) * inRect.zw;
+    float s = sin(inRotation);
+    float c = cos(inRotation);
+    vec2 rotated = vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+    vec2 position = inRect.xy + 0.5 * inRect.zw + rotated;
+
+    gl_Position = vec4(position * pc.scale - 1.0, 0.0, 1.0);
+    fragUV = mix(inUV.xy, inUV.zw, corner);
+    fragColor = inColor;
+}
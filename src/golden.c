@@ -0,0 +1,164 @@
+#include "golden.h"
+#include "color.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GOLDEN_MAX_LINE 256
+#define GOLDEN_MAX_SCENES 64
+
+// ========== PPM ==========
+
+// Next header integer, skipping whitespace and comments
+static bool readHeaderValue(FILE *file, uint32_t *value) {
+  int c = fgetc(file);
+  for (;;) {
+    if (c == '#') {
+      while (c != '\n' && c != EOF) c = fgetc(file);
+    } else if (c != EOF && isspace(c)) {
+      c = fgetc(file);
+    } else {
+      break;
+    }
+  }
+  if (c == EOF || !isdigit(c)) return false;
+
+  uint32_t v = 0;
+  while (c != EOF && isdigit(c)) {
+    if (v > 100000000u) return false;
+    v = v * 10 + (uint32_t)(c - '0');
+    c = fgetc(file);
+  }
+  // Exactly one whitespace byte separates the header from the pixels
+  *value = v;
+  return c != EOF && isspace(c);
+}
+
+bool golden_load_ppm(const char *path, Golden_Image *image) {
+  memset(image, 0, sizeof(*image));
+
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    printf(RED "[ERROR] " RESET "failed to open %s\n", path);
+    return false;
+  }
+
+  char magic[2];
+  uint32_t width = 0, height = 0, maxValue = 0;
+  if (fread(magic, 1, 2, file) != 2 || magic[0] != 'P' || magic[1] != '6' ||
+      !readHeaderValue(file, &width) || !readHeaderValue(file, &height) ||
+      !readHeaderValue(file, &maxValue) || maxValue != 255 || width == 0 || height == 0) {
+    printf(RED "[ERROR] " RESET "%s is not an 8-bit binary PPM\n", path);
+    fclose(file);
+    return false;
+  }
+
+  size_t size = (size_t)width * height * 3;
+  image->pixels = malloc(size);
+  if (!image->pixels || fread(image->pixels, 1, size, file) != size) {
+    printf(RED "[ERROR] " RESET "%s is truncated\n", path);
+    fclose(file);
+    golden_free(image);
+    return false;
+  }
+  fclose(file);
+
+  image->width = width;
+  image->height = height;
+  return true;
+}
+
+void golden_free(Golden_Image *image) {
+  if (!image) return;
+  free(image->pixels);
+  memset(image, 0, sizeof(*image));
+}
+
+bool golden_compare(const Golden_Image *actual, const Golden_Image *expected, uint32_t tolerance, Golden_Diff *diff) {
+  memset(diff, 0, sizeof(*diff));
+  if (actual->width != expected->width || actual->height != expected->height) return false;
+
+  uint64_t total = 0;
+  diff->pixelCount = (uint64_t)actual->width * actual->height;
+  for (uint64_t i = 0; i < diff->pixelCount; i++) {
+    const uint8_t *a = actual->pixels + i * 3;
+    const uint8_t *e = expected->pixels + i * 3;
+    bool bad = false;
+    for (int c = 0; c < 3; c++) {
+      uint32_t d = (uint32_t)abs((int)a[c] - (int)e[c]);
+      total += d;
+      if (d > diff->maxDiff) diff->maxDiff = d;
+      if (d > tolerance) bad = true;
+    }
+    if (bad) diff->badPixels++;
+  }
+  diff->meanDiff = diff->pixelCount ? (double)total / (double)(diff->pixelCount * 3) : 0.0;
+  return true;
+}
+
+// ========== BASELINES ==========
+
+bool golden_baseline_load(const char *path, const char *scene, Golden_Baseline *baseline) {
+  FILE *file = fopen(path, "r");
+  if (!file) return false;
+
+  char line[GOLDEN_MAX_LINE];
+  bool found = false;
+  while (!found && fgets(line, sizeof(line), file)) {
+    char name[GOLDEN_MAX_LINE];
+    double startup, frame;
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%255s %lf %lf", name, &startup, &frame) == 3 && strcmp(name, scene) == 0) {
+      baseline->startupMs = startup;
+      baseline->frameMs = frame;
+      found = true;
+    }
+  }
+  fclose(file);
+  return found;
+}
+
+// Rewrites the file with this scene's line replaced (or appended), keeping
+// the other scenes and comments as they were.
+bool golden_baseline_store(const char *path, const char *scene, const Golden_Baseline *baseline) {
+  char lines[GOLDEN_MAX_SCENES][GOLDEN_MAX_LINE];
+  uint32_t lineCount = 0;
+
+  FILE *file = fopen(path, "r");
+  if (file) {
+    char line[GOLDEN_MAX_LINE];
+    while (fgets(line, sizeof(line), file)) {
+      char name[GOLDEN_MAX_LINE];
+      if (line[0] != '#' && sscanf(line, "%255s", name) == 1 && strcmp(name, scene) == 0) continue;
+      // Rewriting a truncated copy would lose the rest of the file
+      if (lineCount == GOLDEN_MAX_SCENES) {
+        printf(RED "[ERROR] " RESET "%s has more than %d lines, not updated\n", path, GOLDEN_MAX_SCENES);
+        fclose(file);
+        return false;
+      }
+      memcpy(lines[lineCount++], line, sizeof(line));
+    }
+    fclose(file);
+  }
+
+  file = fopen(path, "w");
+  if (!file) {
+    printf(RED "[ERROR] " RESET "failed to write %s\n", path);
+    return false;
+  }
+  if (lineCount == 0) fprintf(file, "# scene startup_ms frame_ms\n");
+  for (uint32_t i = 0; i < lineCount; i++) {
+    size_t length = strlen(lines[i]);
+    fputs(lines[i], file);
+    if (length && lines[i][length - 1] != '\n') fputc('\n', file);
+  }
+  fprintf(file, "%s %.3f %.3f\n", scene, baseline->startupMs, baseline->frameMs);
+  fclose(file);
+  return true;
+}
+
+bool golden_within_budget(double measured, double baseline, double percent) {
+  if (baseline <= 0.0) return true;
+  return measured <= baseline * (1.0 + percent / 100.0);
+}
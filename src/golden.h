@@ -0,0 +1,40 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 8-bit RGB, rows top to bottom (what the readback PPM writer produces)
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint8_t *pixels;
+} Golden_Image;
+
+typedef struct {
+  uint64_t pixelCount;
+  uint64_t badPixels;  // any channel differs by more than the tolerance
+  uint32_t maxDiff;
+  double meanDiff;     // per channel
+} Golden_Diff;
+
+// Reference timings for one scene on one machine
+typedef struct {
+  double startupMs;
+  double frameMs;
+} Golden_Baseline;
+
+bool golden_load_ppm(const char *path, Golden_Image *image);
+void golden_free(Golden_Image *image);
+
+// Returns false when the sizes don't match
+bool golden_compare(const Golden_Image *actual, const Golden_Image *expected, uint32_t tolerance, Golden_Diff *diff);
+
+// Baseline files hold one "scene startup_ms frame_ms" line per scene; '#' starts a comment.
+bool golden_baseline_load(const char *path, const char *scene, Golden_Baseline *baseline);
+bool golden_baseline_store(const char *path, const char *scene, const Golden_Baseline *baseline);
+
+// measured <= baseline * (1 + percent / 100); a zero baseline always passes
+bool golden_within_budget(double measured, double baseline, double percent);
+
+#endif
@@ -1,31 +1,714 @@
 #include "platform.h"
 #include "rendering.h"
 #include "vulkan_init.h"
+#include "profiler.h"
+#include "golden.h"
+#include "sim.h"
+#include "batch.h"
+#include "service.h"
+#include "bench.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "color.h"
+#ifdef ALLOC_CHECK
+#include "alloc_check.h"
+#endif
 
 struct Global {
   Platform_Context platform;
+  // Further windows drawn and presented with the main one
+  Platform_Context extraWindows[RENDERING_MAX_VIEWS];
+  uint32_t windows;  // total, including the main window
   Vulkan_Context vulkan;
   Rendering_Context rendering;
 
   bool msaa_enabled;
   uint32_t msaa_sample;
+
+  Bench_Config bench;
+  bool showStats;
+  uint32_t captureFrames;
+
+  // Bodies simulated on their own thread, 0 to run without a simulation
+  uint32_t simBodies;
+  Sim_Context sim;
+
+  // Redraw only when something changed, sleeping in the event wait otherwise
+  bool onDemand;
+  double idleTimeoutMs;
+
+  // Offline batch: frames spread over independent headless contexts
+  uint64_t batchFrames;
+  uint32_t batchContexts;
+  bool batchSweep;  // also run with 1, 2, 4... contexts up to batchContexts
+
+  uint64_t steadyAllocations;  // heap allocations during the timed offscreen frames, see heapAllocations
+
+  // Local render service
+  const char *serveSocket;
+  Render_Service service;
+
+  // Headless regression run: render a scene, check it against a golden
+  // image and the timings against a baseline
+  bool offscreen;
+  const char *scene;
+  uint32_t frames;
+  const char *output;
+  const char *golden;
+  bool updateGolden;
+  uint32_t tolerance;
+  double maxBadPercent;
+  const char *baseline;
+  bool updateBaseline;
+  double budgetPercent;
 };
 struct Global global;
 
-int main(void) {
-  platform_create(&global.platform , 600, 500, "vulkan");
-  vulkan_create(&global.vulkan, &global.platform);
-  rendering_create(&global.rendering, &global.vulkan, &global.platform);
+static const char *sceneNames[] = {"triangle", "sprites", "overdraw", "text", "meshes", "depth", "msaa"};
+
+static bool sceneExists(const char *name) {
+  for (size_t i = 0; i < sizeof(sceneNames) / sizeof(sceneNames[0]); i++) {
+    if (strcmp(sceneNames[i], name) == 0) return true;
+  }
+  return false;
+}
+
+static bool sceneNeedsMeshes(const char *name) {
+  return strcmp(name, "meshes") == 0 || strcmp(name, "depth") == 0;
+}
+
+static bool parseArgs(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (bench_parse_arg(&global.bench, argc, argv, &i)) {
+      continue;
+    } else if (strcmp(argv[i], "--render-pass") == 0) {
+      global.rendering.config.forceRenderPass = true;
+    } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+      const char *path = argv[++i];
+      const char *ext = strrchr(path, '.');
+      global.rendering.config.capture.path = path;
+      if (ext && strcmp(ext, ".png") == 0) global.rendering.config.capture.format = READBACK_FORMAT_PNG;
+      else if (ext && strcmp(ext, ".ppm") == 0) global.rendering.config.capture.format = READBACK_FORMAT_PPM;
+      else global.rendering.config.capture.format = READBACK_FORMAT_RAW;
+    } else if (strcmp(argv[i], "--capture-format") == 0 && i + 1 < argc) {
+      const char *format = argv[++i];
+      if (strcmp(format, "png") == 0) global.rendering.config.capture.format = READBACK_FORMAT_PNG;
+      else if (strcmp(format, "ppm") == 0) global.rendering.config.capture.format = READBACK_FORMAT_PPM;
+      else global.rendering.config.capture.format = READBACK_FORMAT_RAW;
+    } else if (strcmp(argv[i], "--capture-frames") == 0 && i + 1 < argc) {
+      global.captureFrames = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--stats") == 0) {
+      global.showStats = true;
+    } else if (strcmp(argv[i], "--no-mesh-shader") == 0) {
+      global.rendering.config.meshFallback = true;
+    } else if (strcmp(argv[i], "--post") == 0 && i + 1 < argc) {
+      global.rendering.config.post = argv[++i];
+    } else if (strcmp(argv[i], "--windows") == 0 && i + 1 < argc) {
+      global.windows = (uint32_t)strtoul(argv[++i], NULL, 10);
+      if (global.windows == 0 || global.windows > RENDERING_MAX_VIEWS + 1) {
+        printf(RED "[ERROR] " RESET "--windows expects 1 to %u\n", RENDERING_MAX_VIEWS + 1);
+        return false;
+      }
+    } else if (strcmp(argv[i], "--cache-commands") == 0) {
+      global.rendering.config.cacheCommands = true;
+    } else if (strcmp(argv[i], "--dynamic-resolution") == 0 && i + 1 < argc) {
+      global.rendering.config.resolutionTargetMs = strtof(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--resolution-range") == 0 && i + 1 < argc) {
+      Rendering_Config *config = &global.rendering.config;
+      if (sscanf(argv[++i], "%f,%f", &config->resolutionMin, &config->resolutionMax) != 2 ||
+          config->resolutionMin <= 0.0f || config->resolutionMin > config->resolutionMax) {
+        printf(RED "[ERROR] " RESET "--resolution-range expects MIN,MAX with 0 < MIN <= MAX\n");
+        return false;
+      }
+    } else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) {
+      global.msaa_sample = (uint32_t)strtoul(argv[++i], NULL, 10);
+      if (global.msaa_sample == 0 || global.msaa_sample > 64 || (global.msaa_sample & (global.msaa_sample - 1))) {
+        printf(RED "[ERROR] " RESET "--msaa expects a sample count of 1, 2, 4 ... 64\n");
+        return false;
+      }
+      global.msaa_enabled = global.msaa_sample > 1;
+    } else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+      global.rendering.config.particles = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--memory-budget") == 0 && i + 1 < argc) {
+      global.vulkan.memoryLimit = (VkDeviceSize)(strtod(argv[++i], NULL) * 1024.0 * 1024.0);
+    } else if (strcmp(argv[i], "--on-demand") == 0) {
+      global.onDemand = true;
+    } else if (strcmp(argv[i], "--idle-timeout") == 0 && i + 1 < argc) {
+      global.idleTimeoutMs = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--sim") == 0 && i + 1 < argc) {
+      global.simBodies = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      global.rendering.config.tracePath = argv[++i];
+    } else if (strcmp(argv[i], "--offscreen") == 0) {
+      global.offscreen = true;
+    } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+      global.serveSocket = argv[++i];
+    } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+      global.batchFrames = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--contexts") == 0 && i + 1 < argc) {
+      global.batchContexts = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--sweep") == 0) {
+      global.batchSweep = true;
+    } else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc) {
+      global.scene = argv[++i];
+      if (!sceneExists(global.scene)) {
+        printf(RED "[ERROR] " RESET "unknown scene: %s\n", global.scene);
+        return false;
+      }
+    } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+      global.frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      unsigned width = 0, height = 0;
+      if (sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+        printf(RED "[ERROR] " RESET "--size expects WIDTHxHEIGHT\n");
+        return false;
+      }
+      global.rendering.config.offscreenExtent.width = width;
+      global.rendering.config.offscreenExtent.height = height;
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      global.output = argv[++i];
+    } else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc) {
+      global.golden = argv[++i];
+    } else if (strcmp(argv[i], "--update-golden") == 0) {
+      global.updateGolden = true;
+    } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+      global.tolerance = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--max-bad") == 0 && i + 1 < argc) {
+      global.maxBadPercent = strtod(argv[++i], NULL);
+    } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+      global.baseline = argv[++i];
+    } else if (strcmp(argv[i], "--update-baseline") == 0) {
+      global.updateBaseline = true;
+    } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+      global.budgetPercent = strtod(argv[++i], NULL);
+    } else {
+      printf(RED "[ERROR] " RESET "unknown argument: %s\n", argv[i]);
+      printf("usage: %s [--render-pass] [--bench-resize N] [--bench-sprites N] [--bench-dispatch N] [--stats]\n"
+             "       [--bench-meshlets INSTANCES] [--mesh PATH.obj] [--lod-threshold PX] [--no-mesh-shader]\n"
+             "       [--bench-occlusion INSTANCES] [--no-occlusion]\n"
+             "       [--post exposure,bloom,tonemap,grade,vignette]\n"
+             "       [--capture PATH|-] [--capture-format raw|ppm|png] [--capture-frames N]\n"
+             "       [--scene triangle|sprites|overdraw|text|meshes|depth|msaa] [--msaa SAMPLES]\n"
+             "       [--trace PATH] [--sim BODIES]\n"
+             "       [--on-demand [--idle-timeout MS]] [--windows N] [--cache-commands] [--bench-cache SPRITES]\n"
+             "       [--bench-textures N] [--memory-budget MB]\n"
+             "       [--dynamic-resolution MS [--resolution-range MIN,MAX]] [--bench-resolution FRAMES]\n"
+             "       [--particles N] [--bench-particles N] [--bench-scene]\n"
+             "       [--batch FRAMES [--contexts N] [--sweep]] (with --scene, --size, --capture PATTERN)\n"
+             "       [--serve SOCKET] (with --scene, --size) [--bench-service SOCKET FRAMES]\n"
+             "       [--offscreen [--size WxH] [--frames N] [--output PATH]\n"
+             "        [--golden PATH [--update-golden] [--tolerance N] [--max-bad PERCENT]]\n"
+             "        [--baseline PATH [--update-baseline] [--budget PERCENT]]]\n", argv[0]);
+      return false;
+    }
+  }
+
+  if (global.offscreen) {
+    // Only the frame after the timed loop is captured, straight to PPM
+    Rendering_Config *config = &global.rendering.config;
+    config->offscreen = true;
+    if (config->offscreenExtent.width == 0) {
+      config->offscreenExtent.width = 256;
+      config->offscreenExtent.height = 256;
+    }
+    if (!global.scene) global.scene = "triangle";
+    if (global.frames == 0) global.frames = 100;
+    if (!global.output) global.output = "offscreen.ppm";
+    config->capture.path = global.updateGolden && global.golden ? global.golden : global.output;
+    config->capture.format = READBACK_FORMAT_PPM;
+    config->captureOnRequest = true;
+  }
+  if (global.batchFrames > 0) {
+    // Every frame is captured when a --capture pattern is given
+    Rendering_Config *config = &global.rendering.config;
+    if (config->offscreenExtent.width == 0) {
+      config->offscreenExtent.width = 256;
+      config->offscreenExtent.height = 256;
+    }
+    if (!global.scene) global.scene = "triangle";
+    if (global.batchContexts == 0) global.batchContexts = 1;
+  }
+  if (global.serveSocket) {
+    // Frames are only rendered and captured when a client asks; the capture
+    // config is filled in by service_create
+    Rendering_Config *config = &global.rendering.config;
+    config->offscreen = true;
+    if (config->offscreenExtent.width == 0) {
+      config->offscreenExtent.width = 256;
+      config->offscreenExtent.height = 256;
+    }
+    if (!global.scene) global.scene = "triangle";
+    config->captureOnRequest = true;
+  }
+  bench_configure(&global.bench, &global.rendering.config);
+  if (global.scene && sceneNeedsMeshes(global.scene)) global.rendering.config.meshes = true;
+  // The msaa scene is only worth comparing with its edges resolved
+  if (global.scene && strcmp(global.scene, "msaa") == 0 && global.msaa_sample == 0) {
+    global.msaa_enabled = true;
+    global.msaa_sample = 4;
+  }
+  if (global.msaa_enabled) global.rendering.config.samples = (VkSampleCountFlagBits)global.msaa_sample;
+  return true;
+}
+
+// Canonical content for regression runs. Every frame is identical, so any
+// frame can be compared against the golden image.
+static void drawScene(Rendering_Context *r, const char *scene) {
+  float width = (float)r->swapChainExtent.width;
+  float height = (float)r->swapChainExtent.height;
+
+  if (strcmp(scene, "sprites") == 0) {
+    // Many small instances across both sprite blend modes and a few layers
+    uint32_t seed = 0x2545F491u;
+    for (uint32_t i = 0; i < 2000; i++) {
+      uint32_t rnd = bench_xorshift(&seed);
+      Sprite sprite = {0};
+      sprite.x = (float)(rnd % 1024) / 1024.0f * width;
+      sprite.y = (float)((rnd >> 10) % 1024) / 1024.0f * height;
+      sprite.w = 4.0f + (float)((rnd >> 20) & 7);
+      sprite.h = sprite.w;
+      sprite.u1 = 1.0f;
+      sprite.v1 = 1.0f;
+      sprite.color = 0xC0000000u | (rnd & 0x00FFFFFFu);
+      sprite.rotation = (float)(rnd & 0xFF) * 0.0245f;
+      sprite.blend = (uint8_t)((rnd >> 26) & 1);
+      sprite.layer = (uint8_t)((rnd >> 27) & 3);
+      sprite_batch_push(&r->sprites, &sprite);
+    }
+  } else if (strcmp(scene, "overdraw") == 0) {
+    // Stacked full-screen translucent layers; fill-rate bound
+    for (uint32_t i = 0; i < 32; i++) {
+      Sprite sprite = {0};
+      sprite.w = width;
+      sprite.h = height;
+      sprite.u1 = 1.0f;
+      sprite.v1 = 1.0f;
+      sprite.color = (i & 1) ? 0x100040FFu : 0x10FF4000u;
+      sprite.layer = (uint8_t)i;
+      sprite_batch_push(&r->sprites, &sprite);
+    }
+  } else if (strcmp(scene, "meshes") == 0) {
+    float eye[3] = {0.0f, 4.0f, 10.0f};
+    float target[3] = {0.0f, 0.0f, 0.0f};
+    mesh_renderer_set_camera(&r->meshes, eye, target, 1.0f, 0.1f, 100.0f);
+    bench_push_mesh_grid(r, 16, 2.5f);
+  } else if (strcmp(scene, "depth") == 0) {
+    // Interpenetrating rows receding from a low camera, pushed front to
+    // back: without a working depth test the far rows paint over the near ones
+    float eye[3] = {0.0f, 0.8f, 6.0f};
+    float target[3] = {0.0f, 0.0f, -10.0f};
+    mesh_renderer_set_camera(&r->meshes, eye, target, 1.0f, 0.1f, 100.0f);
+    for (uint32_t i = 0; i < 24; i++) {
+      uint32_t row = i / 4;
+      Mesh_Instance instance = {0};
+      instance.position[0] = ((float)(i % 4) - 1.5f) * 1.4f + ((row & 1) ? 0.7f : 0.0f);
+      instance.position[2] = -(float)row * 1.2f;
+      instance.scale = 1.0f;
+      instance.rotation = (float)i * 0.4f;
+      instance.color = 0xFF000000u | ((0x30 + row * 0x24) << (8 * (row % 3)));
+      mesh_renderer_push(&r->meshes, &instance);
+    }
+  } else if (strcmp(scene, "msaa") == 0) {
+    // Thin rotated bars over the triangle: all edge, nearly no interior
+    for (uint32_t i = 0; i < 24; i++) {
+      Sprite sprite = {0};
+      sprite.x = width * (0.1f + 0.8f * (float)(i % 6) / 5.0f);
+      sprite.y = height * (0.2f + 0.6f * (float)(i / 6) / 3.0f);
+      sprite.w = width * 0.12f;
+      sprite.h = 1.5f;
+      sprite.u1 = 1.0f;
+      sprite.v1 = 1.0f;
+      sprite.color = 0xFFFFFFFFu;
+      sprite.rotation = 0.1f + (float)i * 0.13f;
+      sprite_batch_push(&r->sprites, &sprite);
+    }
+  } else if (strcmp(scene, "text") == 0) {
+    float y = 8.0f;
+    for (uint32_t i = 0; i < 8; i++) {
+      float size = 10.0f + 4.0f * (float)i;
+      text_printf(&r->text, 8.0f, y, size, 0xFFFFFFFFu, "The quick brown fox %u", i);
+      y += size * 1.25f;
+    }
+  }
+}
+
+// Every malloc/calloc/realloc in the allocation check build; otherwise only
+// what the frame path reports to the arena counter
+static uint64_t heapAllocations(void) {
+#ifdef ALLOC_CHECK
+  return alloc_check_calls();
+#else
+  return arena_heap_allocations();
+#endif
+}
+
+// Times a scene headless and captures the frame after the timed loop.
+// Returns the average frame time in milliseconds.
+static double renderOffscreen(void) {
+  Rendering_Context *r = &global.rendering;
+  const uint32_t warmup = 10;
+
+  // Pipeline creation, glyph rasterization and first-use costs stay out of the timing
+  for (uint32_t i = 0; i < warmup; i++) {
+    drawScene(r, global.scene);
+    rendering_draw(r);
+  }
+  vkDeviceWaitIdle(r->vulkan_context.device);
+
+  uint64_t allocations = heapAllocations();
+  double start = profiler_now_ms();
+  for (uint32_t i = 0; i < global.frames; i++) {
+    drawScene(r, global.scene);
+    rendering_draw(r);
+  }
+  vkDeviceWaitIdle(r->vulkan_context.device);
+  double frameMs = (profiler_now_ms() - start) / (double)global.frames;
+  global.steadyAllocations = heapAllocations() - allocations;
+
+  r->captureRequested = true;
+  drawScene(r, global.scene);
+  rendering_draw(r);
+  return frameMs;
+}
+
+// Batch callbacks; each runs on its context's thread
+static bool batchPrepare(Rendering_Context *r, void *userData) {
+  (void)userData;
+  return !r->config.meshes || bench_load_meshes(&global.bench, r, 128, 64);
+}
+
+static void batchDraw(Rendering_Context *r, uint64_t frame, void *userData) {
+  (void)frame;
+  drawScene(r, userData);
+}
+
+// Renders the batch on N contexts, or with --sweep on 1, 2, 4... up to N to
+// show how the frame rate scales with the context count.
+// Returns the process exit code.
+static int runBatch(void) {
+  uint32_t counts[16];
+  double fps[16];
+  uint32_t runs = 0;
+  uint32_t failures = 0;
+
+  uint32_t contexts = global.batchSweep ? 1 : global.batchContexts;
+  while (runs < 16) {
+    Batch_Config config = {0};
+    config.contexts = contexts;
+    config.frames = global.batchFrames;
+    config.rendering = global.rendering.config;
+    config.prepare = batchPrepare;
+    config.draw = batchDraw;
+    config.userData = (void *)global.scene;
+
+    Batch_Context batch;
+    if (!batch_run(&batch, &config)) failures++;
+    batch_print_stats(&batch);
+    counts[runs] = batch.config.contexts;
+    fps[runs] = batch.renderMs > 0.0 ? (double)batch.framesRendered * 1000.0 / batch.renderMs : 0.0;
+    runs++;
+    batch_destroy(&batch);
 
-  while (!platform_should_close(&global.platform)) {
-    platform_events();
-    rendering_draw(&global.rendering);
+    if (contexts >= global.batchContexts) break;
+    contexts = contexts * 2 < global.batchContexts ? contexts * 2 : global.batchContexts;
+  }
+
+  if (runs > 1) {
+    printf(CYAN "[PROFILE] " RESET "batch scaling (%s, %llu frames):\n", global.scene,
+           (unsigned long long)global.batchFrames);
+    for (uint32_t i = 0; i < runs; i++) {
+      printf(CYAN "[PROFILE] " RESET "  %2u contexts: %8.1f fps, %.2fx\n", counts[i], fps[i],
+             fps[0] > 0.0 ? fps[i] / fps[0] : 0.0);
+    }
+  }
+  return failures ? 1 : 0;
+}
+
+// --serve draw callback: the requested scene, if this run can draw it, seen
+// through the client's camera
+static void serveDraw(Rendering_Context *r, const Service_View *view, void *userData) {
+  (void)userData;
+  const char *scene = global.scene;
+  if (sceneExists(view->scene) && (!sceneNeedsMeshes(view->scene) || r->config.meshes)) scene = view->scene;
+  drawScene(r, scene);
+  if (view->camera && sceneNeedsMeshes(scene)) {
+    mesh_renderer_set_camera(&r->meshes, view->eye, view->target, view->fovY, 0.1f, 100.0f);
+  }
+}
+
+// Runs after rendering_destroy, once the capture has been written.
+// Returns the process exit code.
+static int checkOffscreen(double startupMs, double frameMs) {
+  uint32_t failures = 0;
+  printf(CYAN "[PROFILE] " RESET "scene %s: startup %.3f ms, frame %.3f ms (%u frames)\n",
+         global.scene, startupMs, frameMs, global.frames);
+
+  // The frame loop must not touch the heap once warmed up
+  if (global.steadyAllocations > 0) {
+    printf(RED "[ERROR] " RESET "%llu heap allocations in steady-state frames\n",
+           (unsigned long long)global.steadyAllocations);
+    failures++;
+  } else {
+    printf(GREEN "[OK] " RESET "no heap allocations in steady-state frames\n");
+  }
+
+  FILE *golden = global.golden && !global.updateGolden ? fopen(global.golden, "rb") : NULL;
+  if (golden) fclose(golden);
+  if (global.golden && global.updateGolden) {
+    printf(GREEN "[OK] " RESET "golden image written to %s\n", global.golden);
+  } else if (global.golden && !golden) {
+    printf(RED "[ERROR] " RESET "no golden image at %s; render one with --update-golden\n", global.golden);
+    failures++;
+  } else if (global.golden) {
+    Golden_Image actual, expected;
+    Golden_Diff diff;
+    if (!golden_load_ppm(global.output, &actual) || !golden_load_ppm(global.golden, &expected)) {
+      failures++;
+    } else if (!golden_compare(&actual, &expected, global.tolerance, &diff)) {
+      printf(RED "[ERROR] " RESET "golden %s is %ux%u, rendered %ux%u\n",
+             global.golden, expected.width, expected.height, actual.width, actual.height);
+      failures++;
+    } else {
+      double badPercent = 100.0 * (double)diff.badPixels / (double)diff.pixelCount;
+      bool pass = badPercent <= global.maxBadPercent;
+      printf("%sgolden %s: %llu pixels over tolerance %u (%.3f%%, limit %.3f%%), max diff %u, mean %.3f\n",
+             pass ? GREEN "[OK] " RESET : RED "[ERROR] " RESET, global.golden,
+             (unsigned long long)diff.badPixels, global.tolerance, badPercent, global.maxBadPercent,
+             diff.maxDiff, diff.meanDiff);
+      if (!pass) failures++;
+    }
+    golden_free(&actual);
+    golden_free(&expected);
+  }
+
+  if (global.baseline) {
+    Golden_Baseline measured = {startupMs, frameMs};
+    Golden_Baseline baseline;
+    if (global.updateBaseline) {
+      if (!golden_baseline_store(global.baseline, global.scene, &measured)) failures++;
+      else printf(GREEN "[OK] " RESET "baseline for %s written to %s\n", global.scene, global.baseline);
+    } else if (!golden_baseline_load(global.baseline, global.scene, &baseline)) {
+      printf(RED "[ERROR] " RESET "no baseline for %s in %s; record one with --update-baseline\n", global.scene,
+             global.baseline);
+      failures++;
+    } else {
+      bool startupOk = golden_within_budget(startupMs, baseline.startupMs, global.budgetPercent);
+      bool frameOk = golden_within_budget(frameMs, baseline.frameMs, global.budgetPercent);
+      printf("%sstartup %.3f ms, baseline %.3f ms (+%.0f%% allowed)\n",
+             startupOk ? GREEN "[OK] " RESET : RED "[ERROR] " RESET, startupMs, baseline.startupMs, global.budgetPercent);
+      printf("%sframe %.3f ms, baseline %.3f ms (+%.0f%% allowed)\n",
+             frameOk ? GREEN "[OK] " RESET : RED "[ERROR] " RESET, frameMs, baseline.frameMs, global.budgetPercent);
+      if (!startupOk) failures++;
+      if (!frameOk) failures++;
+    }
+  }
+
+  return failures ? 1 : 0;
+}
+
+// Hands the latest input to the simulation and draws its newest state,
+// interpolated between the last two ticks.
+static void drawSim(void) {
+  Rendering_Context *r = &global.rendering;
+  Platform_Context *p = &global.platform;
+  sim_set_bounds(&global.sim, (float)r->swapChainExtent.width, (float)r->swapChainExtent.height);
+  sim_set_input(&global.sim, p->cursorX, p->cursorY, p->mouseDown);
+
+  const Sim_State *state = sim_acquire(&global.sim);
+  float alpha = sim_alpha(&global.sim, state, profiler_now_ms());
+  for (uint32_t i = 0; i < state->bodyCount; i++) {
+    const Sim_Body *body = &state->bodies[i];
+    float x = body->prevX + (body->x - body->prevX) * alpha;
+    float y = body->prevY + (body->y - body->prevY) * alpha;
+    sprite_batch_quad(&r->sprites, x, y, body->size, body->size, body->color, SPRITE_WHITE_TEXTURE);
+  }
+}
+
+// Diagnostic overlay, drawn through the text cache every frame
+static void drawStats(const Profiler_Stat *frameStat) {
+  Rendering_Context *r = &global.rendering;
+  Text_Context *text = &r->text;
+  uint64_t lookups = text->cacheHits + text->cacheMisses;
+
+  float y = 8.0f;
+  const float size = 16.0f;
+  const float line = size * 1.25f;
+  text_printf(text, 8.0f, y, size, 0xFFFFFFFFu, "frame %.2f ms (min %.2f, max %.2f)",
+              profiler_stat_avg(frameStat), frameStat->min, frameStat->max);
+  y += line;
+  text_printf(text, 8.0f, y, size, 0xFFFFFFFFu, "%ux%u  %s",
+              r->swapChainExtent.width, r->swapChainExtent.height,
+              r->dynamicRendering ? "dynamic rendering" : "render pass");
+  y += line;
+  text_printf(text, 8.0f, y, size, 0xFFFFFFFFu, "sprites %u in %u draws",
+              r->sprites.lastSpriteCount, r->sprites.lastDrawCount);
+  y += line;
+  text_printf(text, 8.0f, y, size, 0xFFFFFFFFu, "text cache %.1f%% hits, %llu atlas bytes uploaded",
+              lookups ? 100.0 * (double)text->cacheHits / (double)lookups : 0.0,
+              (unsigned long long)text->uploadedBytes);
+  if (r->postEnabled) {
+    // Running averages of each post pass that has been timed so far
+    char passes[160];
+    int used = 0;
+    for (uint32_t i = 0; i < POST_PASS_COUNT && used < (int)sizeof(passes); i++) {
+      const Profiler_Stat *stat = &r->post.passStats[i];
+      if (stat->count == 0) continue;
+      used += snprintf(passes + used, sizeof(passes) - (size_t)used, "%s%s %.3f", used ? ", " : "",
+                       post_pass_name((Post_Pass)i), profiler_stat_avg(stat));
+    }
+    y += line;
+    text_printf(text, 8.0f, y, size, 0xFFFFFFFFu, "post gpu ms: %s", used ? passes : "n/a");
+  }
+}
+
+int main(int argc, char **argv) {
+  global.tolerance = 2;
+  global.maxBadPercent = 0.1;
+  global.budgetPercent = 25.0;
+  global.idleTimeoutMs = 500.0;
+  global.bench.lodThreshold = 1.0f;
+  if (!parseArgs(argc, argv)) return 1;
+
+  // Batch contexts are all headless and own their devices
+  if (global.batchFrames > 0) {
+    int code = runBatch();
+    arena_scratch_release();
+    return code;
+  }
+
+  // The client benchmark talks to another process and needs no device
+  if (global.bench.serviceSocket) return bench_service(&global.bench);
+
+  // Offscreen runs never touch the window system
+  Platform_Context *platform = global.offscreen || global.serveSocket ? NULL : &global.platform;
+  if (platform) platform_create(platform, 600, 500, "vulkan");
+
+  double start = profiler_now_ms();
+  bool vulkanOk = vulkan_create(&global.vulkan, platform);
+  double vulkanMs = profiler_now_ms() - start;
+  // The ring is sized and imported before rendering creates the readback
+  if (vulkanOk && global.serveSocket) {
+    vulkanOk = service_create(&global.service, &global.vulkan, global.serveSocket,
+                              global.rendering.config.offscreenExtent, global.scene,
+                              &global.rendering.config.capture);
+  }
+  if (!vulkanOk || !rendering_create(&global.rendering, &global.vulkan, platform)) {
+    // Rendering was only started, and only has something to undo, with a device
+    if (vulkanOk) rendering_destroy(&global.rendering);
+    service_destroy(&global.service);
+    vulkan_destroy(&global.vulkan);
+    if (platform) platform_destroy(platform);
+    return 1;
+  }
+  if (global.rendering.config.meshes && !global.bench.meshlets && !global.bench.occlusion &&
+      !bench_load_meshes(&global.bench, &global.rendering, 128, 64)) {
+    rendering_destroy(&global.rendering);
+    service_destroy(&global.service);
+    vulkan_destroy(&global.vulkan);
+    if (platform) platform_destroy(platform);
+    return 1;
+  }
+  // Extra windows only draw the triangle and sprites; a failed one is dropped
+  for (uint32_t i = 0; platform && i + 1 < global.windows; i++) {
+    Platform_Context *extra = &global.extraWindows[i];
+    if (!platform_create(extra, 400, 300, "vulkan view")) break;
+    if (!rendering_add_window(&global.rendering, extra)) {
+      platform_destroy(extra);
+      break;
+    }
+  }
+  const char *path = global.rendering.dynamicRendering ? "dynamic rendering" : "render pass";
+  printf(CYAN "[PROFILE] " RESET "startup (%s): vulkan %.3f ms, rendering %.3f ms\n",
+         path, vulkanMs, global.rendering.createTimeMs);
+
+  double frameMs = 0.0;
+  bool failed = false;
+  if (global.offscreen) {
+    frameMs = renderOffscreen();
+  } else if (global.serveSocket) {
+    if (!service_run(&global.service, &global.rendering, serveDraw, NULL)) failed = true;
+  } else if (!bench_run(&global.bench, &global.rendering)) {
+    Profiler_Stat frameStat = {0};
+    double last = profiler_now_ms();
+    double loopStart = last;
+    double cpuStart = profiler_cpu_ms();
+    uint64_t framesDrawn = 0;
+    if (global.simBodies > 0) {
+      sim_create(&global.sim, global.simBodies, (float)global.rendering.swapChainExtent.width,
+                 (float)global.rendering.swapChainExtent.height);
+    }
+    while (!platform_should_close(&global.platform)) {
+      // A running simulation animates every frame; anything else waits for
+      // input, resize/expose, an explicit request or (for the overlay) the timeout
+      bool waitForRedraw = global.onDemand && !global.sim.started;
+      if (waitForRedraw) {
+        platform_wait_events_timeout(global.idleTimeoutMs / 1000.0);
+      } else {
+        platform_events();
+      }
+      // Closed windows go at once, whether or not this wakeup draws
+      for (uint32_t i = 0; i < RENDERING_MAX_VIEWS; i++) {
+        Platform_Context *extra = &global.extraWindows[i];
+        if (extra->window && platform_should_close(extra)) {
+          rendering_remove_window(&global.rendering, extra);
+          platform_destroy(extra);
+        }
+      }
+      if (waitForRedraw) {
+        bool redraw = platform_take_redraw(&global.platform);
+        for (uint32_t i = 0; i < RENDERING_MAX_VIEWS; i++) {
+          Platform_Context *extra = &global.extraWindows[i];
+          if (extra->window && (platform_take_redraw(extra) || extra->framebufferResized)) redraw = true;
+        }
+        if (global.showStats && profiler_now_ms() - last >= global.idleTimeoutMs) redraw = true;
+        if (!redraw && !global.platform.framebufferResized) continue;
+      }
+      double frameStart = global.onDemand ? profiler_now_ms() : last;
+
+      if (global.sim.started) drawSim();
+      if (global.scene) drawScene(&global.rendering, global.scene);
+      if (global.showStats) drawStats(&frameStat);
+      rendering_draw(&global.rendering);
+
+      double now = profiler_now_ms();
+      profiler_stat_add(&frameStat, now - frameStart);
+      last = now;
+      framesDrawn++;
+      // Keep the overlay a recent average rather than a lifetime one
+      if (frameStat.count >= 120) memset(&frameStat, 0, sizeof(frameStat));
+
+      if (global.captureFrames && global.rendering.frameNumber >= global.captureFrames) break;
+    }
+    sim_destroy(&global.sim);
+
+    // Compare runs with and without --on-demand on a static scene
+    double wallMs = profiler_now_ms() - loopStart;
+    double cpuMs = profiler_cpu_ms() - cpuStart;
+    printf(CYAN "[PROFILE] " RESET "main loop (%s): %.1f s, %llu frames drawn, CPU %.1f%% of one core\n",
+           global.onDemand ? "on demand" : "continuous", wallMs / 1000.0, (unsigned long long)framesDrawn,
+           wallMs > 0.0 ? 100.0 * cpuMs / wallMs : 0.0);
+    if (global.rendering.captureEnabled) {
+      profiler_stat_print("frame fence wait", &global.rendering.fenceStat);
+    }
+    if (global.rendering.config.cacheCommands) {
+      profiler_stat_print("command record", &global.rendering.recordStat);
+    }
+    if (global.windows > 1) {
+      printf(CYAN "[PROFILE] " RESET "present covers %u windows\n", rendering_window_count(&global.rendering));
+      profiler_stat_print("present", &global.rendering.presentStat);
+    }
   }
   rendering_destroy(&global.rendering);
+  service_destroy(&global.service);
   vulkan_destroy(&global.vulkan);
-  platform_destroy(&global.platform);
+  // The surfaces are gone; the last window terminates GLFW
+  for (uint32_t i = 0; i < RENDERING_MAX_VIEWS; i++) platform_destroy(&global.extraWindows[i]);
+  if (platform) platform_destroy(platform);
+  arena_scratch_release();
+
+  if (global.offscreen) return checkOffscreen(vulkanMs + global.rendering.createTimeMs, frameMs);
+  return failed ? 1 : 0;
 }
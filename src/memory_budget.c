@@ -0,0 +1,153 @@
+#include "memory_budget.h"
+#include "color.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MB(bytes) ((double)(bytes) / (1024.0 * 1024.0))
+
+bool memory_budget_create(Memory_Budget *budget, VkPhysicalDevice physicalDevice, bool extension, VkDeviceSize limit) {
+  if (!budget) return false;
+  memset(budget, 0, sizeof(*budget));
+  budget->physicalDevice = physicalDevice;
+  budget->extension = extension;
+  budget->limit = limit;
+
+  VkPhysicalDeviceMemoryProperties properties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+  budget->heapCount = properties.memoryHeapCount;
+  for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+    budget->typeHeaps[i] = properties.memoryTypes[i].heapIndex;
+  }
+  for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+    budget->heaps[i].size = properties.memoryHeaps[i].size;
+    budget->heaps[i].deviceLocal = (properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+  }
+  memory_budget_update(budget);
+  return true;
+}
+
+void memory_budget_destroy(Memory_Budget *budget) {
+  if (!budget) return;
+  if (budget->allocationCount > 0) {
+    printf(YELLOW "[WARNING] " RESET "memory: %u allocations still live at shutdown\n", budget->allocationCount);
+  }
+  free(budget->allocations);
+  budget->allocations = NULL;
+  budget->allocationCount = 0;
+  budget->allocationCapacity = 0;
+}
+
+// ========== TRACKING ==========
+
+void memory_budget_track(Memory_Budget *budget, VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType) {
+  if (!budget || memory == VK_NULL_HANDLE || memoryType >= VK_MAX_MEMORY_TYPES) return;
+  if (budget->allocationCount == budget->allocationCapacity) {
+    uint32_t capacity = budget->allocationCapacity ? budget->allocationCapacity * 2 : 64;
+    Memory_Allocation *allocations = realloc(budget->allocations, capacity * sizeof(Memory_Allocation));
+    if (!allocations) return;  // only the estimate suffers
+    arena_note_heap_allocation();
+    budget->allocations = allocations;
+    budget->allocationCapacity = capacity;
+  }
+  uint32_t heap = budget->typeHeaps[memoryType];
+  budget->allocations[budget->allocationCount++] = (Memory_Allocation){memory, size, heap};
+  budget->heaps[heap].tracked += size;
+}
+
+// One allocation per buffer or image, so there are few; short-lived ones
+// (staging) are the newest, which is where the search starts
+void memory_budget_untrack(Memory_Budget *budget, VkDeviceMemory memory) {
+  if (!budget || memory == VK_NULL_HANDLE) return;
+  for (uint32_t i = budget->allocationCount; i-- > 0;) {
+    Memory_Allocation *allocation = &budget->allocations[i];
+    if (allocation->memory != memory) continue;
+    budget->heaps[allocation->heap].tracked -= allocation->size;
+    *allocation = budget->allocations[--budget->allocationCount];
+    return;
+  }
+}
+
+// ========== BUDGET ==========
+
+void memory_budget_update(Memory_Budget *budget) {
+  if (!budget) return;
+  double start = profiler_now_ms();
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT reported = {0};
+  reported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  if (budget->extension) {
+    VkPhysicalDeviceMemoryProperties2 properties = {0};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &reported;
+    vkGetPhysicalDeviceMemoryProperties2(budget->physicalDevice, &properties);
+  }
+
+  for (uint32_t i = 0; i < budget->heapCount; i++) {
+    Memory_Heap *heap = &budget->heaps[i];
+    if (budget->extension) {
+      heap->budget = reported.heapBudget[i];
+      heap->usage = reported.heapUsage[i];
+    } else {
+      heap->budget = (VkDeviceSize)((double)heap->size * MEMORY_BUDGET_ESTIMATE);
+      heap->usage = heap->tracked;
+    }
+    if (heap->deviceLocal && budget->limit > 0 && heap->budget > budget->limit) heap->budget = budget->limit;
+    if (heap->usage > heap->peakUsage) heap->peakUsage = heap->usage;
+  }
+  budget->updates++;
+
+  // Logged when crossing, not every frame spent above it
+  bool over = memory_budget_pressure(budget) > MEMORY_BUDGET_WARN;
+  if (over && !budget->overWarning) {
+    for (uint32_t i = 0; i < budget->heapCount; i++) {
+      const Memory_Heap *heap = &budget->heaps[i];
+      if (!heap->deviceLocal || heap->budget == 0) continue;
+      if ((double)heap->usage / (double)heap->budget <= MEMORY_BUDGET_WARN) continue;
+      printf(YELLOW "[WARNING] " RESET "memory: heap %u at %.1f of %.1f MB budget\n", i, MB(heap->usage),
+             MB(heap->budget));
+    }
+  }
+  budget->overWarning = over;
+  profiler_stat_add(&budget->updateStat, profiler_now_ms() - start);
+}
+
+double memory_budget_pressure(const Memory_Budget *budget) {
+  if (!budget) return 0.0;
+  double pressure = 0.0;
+  for (uint32_t i = 0; i < budget->heapCount; i++) {
+    const Memory_Heap *heap = &budget->heaps[i];
+    if (!heap->deviceLocal || heap->budget == 0) continue;
+    double p = (double)heap->usage / (double)heap->budget;
+    if (p > pressure) pressure = p;
+  }
+  return pressure;
+}
+
+VkDeviceSize memory_budget_excess(const Memory_Budget *budget, double share) {
+  if (!budget) return 0;
+  VkDeviceSize excess = 0;
+  for (uint32_t i = 0; i < budget->heapCount; i++) {
+    const Memory_Heap *heap = &budget->heaps[i];
+    if (!heap->deviceLocal) continue;
+    VkDeviceSize target = (VkDeviceSize)((double)heap->budget * share);
+    if (heap->usage > target && heap->usage - target > excess) excess = heap->usage - target;
+  }
+  return excess;
+}
+
+void memory_budget_print(const Memory_Budget *budget) {
+  if (!budget) return;
+  for (uint32_t i = 0; i < budget->heapCount; i++) {
+    const Memory_Heap *heap = &budget->heaps[i];
+    printf(CYAN "[PROFILE] " RESET "memory heap %u (%s, %.0f MB): %.1f MB used of %.1f MB budget, "
+           "peak %.1f MB, ours %.1f MB\n",
+           i, heap->deviceLocal ? "device" : "host", MB(heap->size), MB(heap->usage), MB(heap->budget),
+           MB(heap->peakUsage), MB(heap->tracked));
+  }
+  printf(CYAN "[PROFILE] " RESET "memory budget: %s, %llu failed allocations\n",
+         budget->extension ? "VK_EXT_memory_budget" : "estimated from our allocations",
+         (unsigned long long)budget->failedAllocations);
+  profiler_stat_print("memory budget update", &budget->updateStat);
+}
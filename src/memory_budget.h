@@ -0,0 +1,70 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan_core.h>
+#include "profiler.h"
+
+// Share of a heap assumed usable when the driver can't report a budget;
+// the OS, compositor and other processes want the rest
+#define MEMORY_BUDGET_ESTIMATE 0.8
+// Pressure at which memory_budget_update logs a warning
+#define MEMORY_BUDGET_WARN 0.9
+
+typedef struct {
+  VkDeviceSize size;
+  VkDeviceSize budget;     // what this process can use before allocations fail or page
+  VkDeviceSize usage;      // this process, as the driver reports it (or tracked when estimated)
+  VkDeviceSize tracked;    // our own live allocations
+  VkDeviceSize peakUsage;
+  bool deviceLocal;
+} Memory_Heap;
+
+typedef struct {
+  VkDeviceMemory memory;
+  VkDeviceSize size;
+  uint32_t heap;
+} Memory_Allocation;
+
+// Per-heap usage against budget. With VK_EXT_memory_budget the numbers come
+// from the driver each update and cover everything the process allocated;
+// without it they are estimated from the allocations made through
+// vulkan_allocate_memory and a fixed share of each heap.
+typedef struct {
+  VkPhysicalDevice physicalDevice;
+  bool extension;      // VK_EXT_memory_budget
+  VkDeviceSize limit;  // caps every device-local budget when nonzero
+
+  uint32_t heapCount;
+  uint32_t typeHeaps[VK_MAX_MEMORY_TYPES];
+  Memory_Heap heaps[VK_MAX_MEMORY_HEAPS];
+
+  // Live allocations, so frees know their size and heap
+  Memory_Allocation *allocations;
+  uint32_t allocationCount;
+  uint32_t allocationCapacity;
+
+  uint64_t updates;
+  uint64_t failedAllocations;
+  bool overWarning;  // pressure was above MEMORY_BUDGET_WARN at the last update
+  Profiler_Stat updateStat;
+} Memory_Budget;
+
+bool memory_budget_create(Memory_Budget *budget, VkPhysicalDevice physicalDevice, bool extension, VkDeviceSize limit);
+void memory_budget_destroy(Memory_Budget *budget);
+
+void memory_budget_track(Memory_Budget *budget, VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType);
+void memory_budget_untrack(Memory_Budget *budget, VkDeviceMemory memory);
+
+// Refreshes usage and budget; cheap enough to call once per frame
+void memory_budget_update(Memory_Budget *budget);
+// Highest usage / budget over the device-local heaps
+double memory_budget_pressure(const Memory_Budget *budget);
+// Bytes to free on the most loaded device-local heap to get back to
+// share * budget; 0 when every heap is under it
+VkDeviceSize memory_budget_excess(const Memory_Budget *budget, double share);
+
+void memory_budget_print(const Memory_Budget *budget);
+
+#endif
@@ -0,0 +1,548 @@
+#include "mesh.h"
+#include "color.h"
+#include "profiler.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MESH_PI 3.14159265358979f
+#define MESH_MIN_LOD_TRIANGLES 128
+#define MESH_CLUSTER_ATTEMPTS 24
+#define MESH_CLUSTER_STEP 0.85f
+#define MESH_EMPTY UINT32_MAX
+
+// ========== HELPERS ==========
+
+static bool reserve(void **data, uint32_t *capacity, uint32_t needed, size_t elementSize) {
+  if (needed <= *capacity) return true;
+  uint32_t newCapacity = *capacity ? *capacity : 256;
+  while (newCapacity < needed) newCapacity *= 2;
+  void *grown = realloc(*data, (size_t)newCapacity * elementSize);
+  if (!grown) {
+    printf(RED "[ERROR] " RESET "out of memory building mesh (%u elements)\n", newCapacity);
+    return false;
+  }
+  *data = grown;
+  *capacity = newCapacity;
+  return true;
+}
+
+static void faceNormal(const float *a, const float *b, const float *c, float n[3]) {
+  float e0[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+  float e1[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+  n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+  n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+  n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+static bool normalize3(float v[3]) {
+  float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (length <= 1e-20f) return false;
+  v[0] /= length;
+  v[1] /= length;
+  v[2] /= length;
+  return true;
+}
+
+// Area-weighted vertex normals from the faces
+static void computeNormals(Mesh_Data *mesh) {
+  for (uint32_t i = 0; i < mesh->vertexCount; i++) {
+    memset(mesh->vertices[i].normal, 0, sizeof(mesh->vertices[i].normal));
+  }
+  for (uint32_t i = 0; i + 2 < mesh->indexCount; i += 3) {
+    Mesh_Vertex *v[3] = {&mesh->vertices[mesh->indices[i]], &mesh->vertices[mesh->indices[i + 1]],
+                         &mesh->vertices[mesh->indices[i + 2]]};
+    float n[3];
+    faceNormal(v[0]->position, v[1]->position, v[2]->position, n);
+    for (uint32_t k = 0; k < 3; k++) {
+      v[k]->normal[0] += n[0];
+      v[k]->normal[1] += n[1];
+      v[k]->normal[2] += n[2];
+    }
+  }
+  for (uint32_t i = 0; i < mesh->vertexCount; i++) {
+    float *n = mesh->vertices[i].normal;
+    if (!normalize3(n)) {
+      n[0] = 0.0f;
+      n[1] = 1.0f;
+      n[2] = 0.0f;
+    }
+  }
+}
+
+// ========== SOURCE GEOMETRY ==========
+
+bool mesh_generate_sphere(Mesh_Data *mesh, uint32_t segments, uint32_t rings, float bumpiness) {
+  if (!mesh || segments < 3 || rings < 2) return false;
+  memset(mesh, 0, sizeof(*mesh));
+
+  uint32_t vertexCount = (segments + 1) * (rings + 1);
+  mesh->vertices = malloc((size_t)vertexCount * sizeof(Mesh_Vertex));
+  mesh->indices = malloc((size_t)segments * rings * 6 * sizeof(uint32_t));
+  if (!mesh->vertices || !mesh->indices) {
+    printf(RED "[ERROR] " RESET "failed to allocate sphere (%u vertices)\n", vertexCount);
+    mesh_data_free(mesh);
+    return false;
+  }
+
+  for (uint32_t r = 0; r <= rings; r++) {
+    float theta = (float)r / (float)rings * MESH_PI;
+    for (uint32_t s = 0; s <= segments; s++) {
+      float phi = (float)s / (float)segments * 2.0f * MESH_PI;
+      // Bumps vanish at the poles and match across the seam
+      float radius = 1.0f + bumpiness * sinf(theta * 7.0f) * sinf(phi * 5.0f);
+      Mesh_Vertex *v = &mesh->vertices[mesh->vertexCount++];
+      v->position[0] = sinf(theta) * cosf(phi) * radius;
+      v->position[1] = cosf(theta) * radius;
+      v->position[2] = sinf(theta) * sinf(phi) * radius;
+    }
+  }
+
+  // Quads (a, d, c, b) wound counter-clockwise seen from outside; the pole
+  // rows collapse to single triangles
+  for (uint32_t r = 0; r < rings; r++) {
+    for (uint32_t s = 0; s < segments; s++) {
+      uint32_t a = r * (segments + 1) + s;
+      uint32_t b = a + segments + 1;
+      uint32_t c = b + 1;
+      uint32_t d = a + 1;
+      if (r > 0) {
+        mesh->indices[mesh->indexCount++] = a;
+        mesh->indices[mesh->indexCount++] = d;
+        mesh->indices[mesh->indexCount++] = b;
+      }
+      if (r + 1 < rings) {
+        mesh->indices[mesh->indexCount++] = d;
+        mesh->indices[mesh->indexCount++] = c;
+        mesh->indices[mesh->indexCount++] = b;
+      }
+    }
+  }
+
+  computeNormals(mesh);
+  return true;
+}
+
+static bool parseObjIndex(const char *token, uint32_t vertexCount, uint32_t *out) {
+  long index = strtol(token, NULL, 10);
+  if (index < 0) index += (long)vertexCount + 1;
+  if (index < 1 || index > (long)vertexCount) return false;
+  *out = (uint32_t)(index - 1);
+  return true;
+}
+
+bool mesh_load_obj(Mesh_Data *mesh, const char *path) {
+  if (!mesh || !path) return false;
+  memset(mesh, 0, sizeof(*mesh));
+
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    printf(RED "[ERROR] " RESET "failed to open mesh: %s\n", path);
+    return false;
+  }
+
+  uint32_t vertexCapacity = 0;
+  uint32_t indexCapacity = 0;
+  bool ok = true;
+  char line[1024];
+  uint32_t lineNumber = 0;
+
+  while (ok && fgets(line, sizeof(line), file)) {
+    lineNumber++;
+    if (line[0] == 'v' && line[1] == ' ') {
+      if (!reserve((void **)&mesh->vertices, &vertexCapacity, mesh->vertexCount + 1, sizeof(Mesh_Vertex))) {
+        ok = false;
+        break;
+      }
+      Mesh_Vertex *v = &mesh->vertices[mesh->vertexCount];
+      memset(v, 0, sizeof(*v));
+      if (sscanf(line + 2, "%f %f %f", &v->position[0], &v->position[1], &v->position[2]) != 3) {
+        printf(RED "[ERROR] " RESET "%s:%u: bad vertex\n", path, lineNumber);
+        ok = false;
+        break;
+      }
+      mesh->vertexCount++;
+    } else if (line[0] == 'f' && line[1] == ' ') {
+      // Fan the polygon around its first corner
+      uint32_t first = 0, previous = 0, corners = 0;
+      for (char *token = strtok(line + 2, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+        uint32_t index;
+        if (!parseObjIndex(token, mesh->vertexCount, &index)) {
+          printf(RED "[ERROR] " RESET "%s:%u: bad face index '%s'\n", path, lineNumber, token);
+          ok = false;
+          break;
+        }
+        if (corners >= 2) {
+          if (!reserve((void **)&mesh->indices, &indexCapacity, mesh->indexCount + 3, sizeof(uint32_t))) {
+            ok = false;
+            break;
+          }
+          mesh->indices[mesh->indexCount++] = first;
+          mesh->indices[mesh->indexCount++] = previous;
+          mesh->indices[mesh->indexCount++] = index;
+        }
+        if (corners == 0) first = index;
+        previous = index;
+        corners++;
+      }
+    }
+  }
+  fclose(file);
+
+  if (ok && mesh->indexCount == 0) {
+    printf(RED "[ERROR] " RESET "%s: no faces\n", path);
+    ok = false;
+  }
+  if (!ok) {
+    mesh_data_free(mesh);
+    return false;
+  }
+  computeNormals(mesh);
+  return true;
+}
+
+void mesh_data_free(Mesh_Data *mesh) {
+  if (!mesh) return;
+  free(mesh->vertices);
+  free(mesh->indices);
+  memset(mesh, 0, sizeof(*mesh));
+}
+
+// ========== MESHLETS ==========
+
+typedef struct {
+  Mesh_Meshlets *out;
+  uint32_t vertexCapacity;
+  uint32_t meshletCapacity;
+  uint32_t meshletVertexCapacity;
+  uint32_t meshletTriangleCapacity;
+  uint32_t indexCapacity;
+
+  // Per vertex: id + 1 of the meshlet that last took it, and its slot there
+  uint32_t *stamp;
+  uint32_t *local;
+  uint32_t stampCapacity;
+  uint32_t localCapacity;
+} Meshlet_Builder;
+
+static void meshletBounds(Mesh_Meshlets *out, Meshlet *meshlet) {
+  const uint32_t *vertices = out->meshletVertices + meshlet->vertexOffset;
+  const uint32_t *indices = out->indices + meshlet->firstIndex;
+  uint32_t vertexCount = meshlet->counts & 0xFF;
+  uint32_t triangleCount = meshlet->counts >> 8;
+
+  float lo[3], hi[3];
+  memcpy(lo, out->vertices[vertices[0]].position, sizeof(lo));
+  memcpy(hi, lo, sizeof(hi));
+  for (uint32_t i = 1; i < vertexCount; i++) {
+    const float *p = out->vertices[vertices[i]].position;
+    for (uint32_t k = 0; k < 3; k++) {
+      if (p[k] < lo[k]) lo[k] = p[k];
+      if (p[k] > hi[k]) hi[k] = p[k];
+    }
+  }
+  float radius = 0.0f;
+  for (uint32_t k = 0; k < 3; k++) meshlet->center[k] = (lo[k] + hi[k]) * 0.5f;
+  for (uint32_t i = 0; i < vertexCount; i++) {
+    const float *p = out->vertices[vertices[i]].position;
+    float d[3] = {p[0] - meshlet->center[0], p[1] - meshlet->center[1], p[2] - meshlet->center[2]};
+    float r = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    if (r > radius) radius = r;
+  }
+  meshlet->radius = radius;
+
+  // Normal cone: the meshlet is entirely back-facing from any point that sees
+  // the axis at more than 90 degrees minus the cone's half-angle
+  float axis[3] = {0.0f, 0.0f, 0.0f};
+  for (uint32_t t = 0; t < triangleCount; t++) {
+    float n[3];
+    faceNormal(out->vertices[indices[t * 3]].position, out->vertices[indices[t * 3 + 1]].position,
+               out->vertices[indices[t * 3 + 2]].position, n);
+    if (!normalize3(n)) continue;
+    axis[0] += n[0];
+    axis[1] += n[1];
+    axis[2] += n[2];
+  }
+  float minDot = 1.0f;
+  if (normalize3(axis)) {
+    for (uint32_t t = 0; t < triangleCount; t++) {
+      float n[3];
+      faceNormal(out->vertices[indices[t * 3]].position, out->vertices[indices[t * 3 + 1]].position,
+                 out->vertices[indices[t * 3 + 2]].position, n);
+      if (!normalize3(n)) continue;
+      float d = n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2];
+      if (d < minDot) minDot = d;
+    }
+  } else {
+    minDot = -1.0f;
+  }
+  memcpy(meshlet->coneAxis, axis, sizeof(axis));
+  meshlet->coneCutoff = minDot <= 0.0f ? 1.0f : sqrtf(1.0f - minDot * minDot);
+}
+
+// Greedy split in index order: a meshlet is closed as soon as the next
+// triangle would exceed the vertex or triangle limit.
+static bool buildLodMeshlets(Meshlet_Builder *b, const uint32_t *indices, uint32_t indexCount, Mesh_Lod *lod) {
+  Mesh_Meshlets *out = b->out;
+  if (!reserve((void **)&b->stamp, &b->stampCapacity, out->vertexCount, sizeof(uint32_t)) ||
+      !reserve((void **)&b->local, &b->localCapacity, out->vertexCount, sizeof(uint32_t)) ||
+      !reserve((void **)&out->indices, &b->indexCapacity, out->indexCount + indexCount, sizeof(uint32_t))) {
+    return false;
+  }
+  memset(b->stamp, 0, out->vertexCount * sizeof(uint32_t));
+
+  lod->firstMeshlet = out->meshletCount;
+  lod->triangleCount = indexCount / 3;
+
+  uint32_t current = MESH_EMPTY;
+  uint32_t vertexCount = 0, triangleCount = 0;
+  for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+    const uint32_t *tri = indices + i;
+    uint32_t stamp = current + 1;
+    uint32_t newVertices = 0;
+    for (uint32_t k = 0; k < 3; k++) {
+      if (current == MESH_EMPTY || b->stamp[tri[k]] != stamp) newVertices++;
+    }
+
+    if (current == MESH_EMPTY || vertexCount + newVertices > MESHLET_MAX_VERTICES ||
+        triangleCount + 1 > MESHLET_MAX_TRIANGLES) {
+      if (current != MESH_EMPTY) meshletBounds(out, &out->meshlets[current]);
+      if (!reserve((void **)&out->meshlets, &b->meshletCapacity, out->meshletCount + 1, sizeof(Meshlet))) {
+        return false;
+      }
+      current = out->meshletCount++;
+      stamp = current + 1;
+      Meshlet *meshlet = &out->meshlets[current];
+      memset(meshlet, 0, sizeof(*meshlet));
+      meshlet->vertexOffset = out->meshletVertexCount;
+      meshlet->triangleOffset = out->meshletTriangleCount;
+      meshlet->firstIndex = out->indexCount;
+      vertexCount = 0;
+      triangleCount = 0;
+    }
+
+    if (!reserve((void **)&out->meshletVertices, &b->meshletVertexCapacity, out->meshletVertexCount + 3,
+                 sizeof(uint32_t)) ||
+        !reserve((void **)&out->meshletTriangles, &b->meshletTriangleCapacity, out->meshletTriangleCount + 1,
+                 sizeof(uint32_t))) {
+      return false;
+    }
+    uint32_t packed = 0;
+    for (uint32_t k = 0; k < 3; k++) {
+      uint32_t v = tri[k];
+      if (b->stamp[v] != stamp) {
+        b->stamp[v] = stamp;
+        b->local[v] = vertexCount++;
+        out->meshletVertices[out->meshletVertexCount++] = v;
+      }
+      packed |= b->local[v] << (k * 8);
+      out->indices[out->indexCount++] = v;
+    }
+    out->meshletTriangles[out->meshletTriangleCount++] = packed;
+    triangleCount++;
+    out->meshlets[current].counts = vertexCount | (triangleCount << 8);
+  }
+  if (current != MESH_EMPTY) meshletBounds(out, &out->meshlets[current]);
+
+  lod->meshletCount = out->meshletCount - lod->firstMeshlet;
+  return lod->meshletCount > 0;
+}
+
+// ========== LOD CHAIN ==========
+
+typedef struct {
+  uint64_t *keys;
+  uint32_t *values;
+  uint32_t tableMask;
+  uint32_t *remap;     // LOD 0 vertex -> cluster
+  float *sums;         // per cluster: position sum, normal sum
+  uint32_t *counts;
+  uint32_t clusterCount;
+  uint32_t *indices;   // surviving triangles in cluster ids
+  uint32_t indexCount;
+} Cluster_Scratch;
+
+static uint32_t clusterOf(Cluster_Scratch *s, uint64_t key) {
+  uint32_t slot = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & s->tableMask;
+  while (s->values[slot] != MESH_EMPTY && s->keys[slot] != key) {
+    slot = (slot + 1) & s->tableMask;
+  }
+  if (s->values[slot] == MESH_EMPTY) {
+    s->keys[slot] = key;
+    s->values[slot] = s->clusterCount++;
+  }
+  return s->values[slot];
+}
+
+// Snaps LOD 0 to a grid of cellSize and keeps the triangles whose corners
+// land in three different cells. Returns the surviving triangle count.
+static uint32_t clusterVertices(const Mesh_Data *mesh, const float origin[3], float cellSize, Cluster_Scratch *s) {
+  memset(s->values, 0xFF, ((size_t)s->tableMask + 1) * sizeof(uint32_t));
+  s->clusterCount = 0;
+  float inv = 1.0f / cellSize;
+  for (uint32_t i = 0; i < mesh->vertexCount; i++) {
+    const float *p = mesh->vertices[i].position;
+    uint64_t ix = (uint64_t)((p[0] - origin[0]) * inv) & 0x1FFFFF;
+    uint64_t iy = (uint64_t)((p[1] - origin[1]) * inv) & 0x1FFFFF;
+    uint64_t iz = (uint64_t)((p[2] - origin[2]) * inv) & 0x1FFFFF;
+    s->remap[i] = clusterOf(s, ix | (iy << 21) | (iz << 42));
+  }
+
+  s->indexCount = 0;
+  for (uint32_t i = 0; i + 2 < mesh->indexCount; i += 3) {
+    uint32_t a = s->remap[mesh->indices[i]];
+    uint32_t b = s->remap[mesh->indices[i + 1]];
+    uint32_t c = s->remap[mesh->indices[i + 2]];
+    if (a == b || b == c || a == c) continue;
+    s->indices[s->indexCount++] = a;
+    s->indices[s->indexCount++] = b;
+    s->indices[s->indexCount++] = c;
+  }
+  return s->indexCount / 3;
+}
+
+// Appends the averaged cluster vertices and rebases the triangles onto them
+static bool appendClusters(Meshlet_Builder *b, const Mesh_Data *mesh, Cluster_Scratch *s) {
+  Mesh_Meshlets *out = b->out;
+  memset(s->sums, 0, (size_t)s->clusterCount * 6 * sizeof(float));
+  memset(s->counts, 0, (size_t)s->clusterCount * sizeof(uint32_t));
+  for (uint32_t i = 0; i < mesh->vertexCount; i++) {
+    float *sum = s->sums + (size_t)s->remap[i] * 6;
+    for (uint32_t k = 0; k < 3; k++) {
+      sum[k] += mesh->vertices[i].position[k];
+      sum[3 + k] += mesh->vertices[i].normal[k];
+    }
+    s->counts[s->remap[i]]++;
+  }
+
+  uint32_t base = out->vertexCount;
+  if (!reserve((void **)&out->vertices, &b->vertexCapacity, base + s->clusterCount, sizeof(Mesh_Vertex))) {
+    return false;
+  }
+  for (uint32_t c = 0; c < s->clusterCount; c++) {
+    Mesh_Vertex *v = &out->vertices[base + c];
+    float *sum = s->sums + (size_t)c * 6;
+    float count = s->counts[c] > 0 ? (float)s->counts[c] : 1.0f;
+    for (uint32_t k = 0; k < 3; k++) {
+      v->position[k] = sum[k] / count;
+      v->normal[k] = sum[3 + k];
+    }
+    if (!normalize3(v->normal)) {
+      v->normal[0] = 0.0f;
+      v->normal[1] = 1.0f;
+      v->normal[2] = 0.0f;
+    }
+  }
+  out->vertexCount += s->clusterCount;
+  for (uint32_t i = 0; i < s->indexCount; i++) s->indices[i] += base;
+  return true;
+}
+
+bool mesh_build_meshlets(const Mesh_Data *mesh, Mesh_Meshlets *out) {
+  if (!mesh || !out || mesh->vertexCount == 0 || mesh->indexCount < 3) return false;
+  memset(out, 0, sizeof(*out));
+  double start = profiler_now_ms();
+
+  Meshlet_Builder b = {0};
+  b.out = out;
+  Cluster_Scratch s = {0};
+  uint32_t tableSize = 1;
+  while (tableSize < mesh->vertexCount * 2) tableSize <<= 1;
+  s.tableMask = tableSize - 1;
+  s.keys = malloc((size_t)tableSize * sizeof(uint64_t));
+  s.values = malloc((size_t)tableSize * sizeof(uint32_t));
+  s.remap = malloc((size_t)mesh->vertexCount * sizeof(uint32_t));
+  s.sums = malloc((size_t)mesh->vertexCount * 6 * sizeof(float));
+  s.counts = malloc((size_t)mesh->vertexCount * sizeof(uint32_t));
+  s.indices = malloc((size_t)mesh->indexCount * sizeof(uint32_t));
+
+  bool ok = s.keys && s.values && s.remap && s.sums && s.counts && s.indices &&
+            reserve((void **)&out->vertices, &b.vertexCapacity, mesh->vertexCount, sizeof(Mesh_Vertex));
+  if (ok) {
+    memcpy(out->vertices, mesh->vertices, (size_t)mesh->vertexCount * sizeof(Mesh_Vertex));
+    out->vertexCount = mesh->vertexCount;
+  }
+
+  float lo[3], hi[3];
+  memcpy(lo, mesh->vertices[0].position, sizeof(lo));
+  memcpy(hi, lo, sizeof(hi));
+  for (uint32_t i = 1; i < mesh->vertexCount; i++) {
+    for (uint32_t k = 0; k < 3; k++) {
+      float p = mesh->vertices[i].position[k];
+      if (p < lo[k]) lo[k] = p;
+      if (p > hi[k]) hi[k] = p;
+    }
+  }
+  float extent = 0.0f;
+  for (uint32_t k = 0; k < 3; k++) {
+    out->center[k] = (lo[k] + hi[k]) * 0.5f;
+    if (hi[k] - lo[k] > extent) extent = hi[k] - lo[k];
+  }
+  for (uint32_t i = 0; i < mesh->vertexCount; i++) {
+    const float *p = mesh->vertices[i].position;
+    float d[3] = {p[0] - out->center[0], p[1] - out->center[1], p[2] - out->center[2]};
+    float r = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    if (r > out->radius) out->radius = r;
+  }
+
+  ok = ok && buildLodMeshlets(&b, mesh->indices, mesh->indexCount, &out->lods[0]);
+  if (ok) out->lodCount = 1;
+
+  // Each level clusters LOD 0 directly, coarsening the grid until the
+  // triangle count at least halves; the resolution carries over between
+  // levels so later ones need only a step or two.
+  float resolution = sqrtf((float)(mesh->indexCount / 3));
+  uint32_t previous = mesh->indexCount / 3;
+  while (ok && out->lodCount < MESH_MAX_LODS && previous / 2 >= MESH_MIN_LOD_TRIANGLES && extent > 0.0f) {
+    uint32_t target = previous / 2;
+    uint32_t triangles = 0;
+    float cellSize = 0.0f;
+    bool found = false;
+    for (uint32_t attempt = 0; attempt < MESH_CLUSTER_ATTEMPTS && resolution >= 2.0f; attempt++) {
+      cellSize = extent / resolution;
+      triangles = clusterVertices(mesh, lo, cellSize, &s);
+      if (triangles > 0 && triangles <= target) {
+        found = true;
+        break;
+      }
+      resolution *= MESH_CLUSTER_STEP;
+    }
+    if (!found || triangles < MESH_MIN_LOD_TRIANGLES / 2) break;
+
+    Mesh_Lod *lod = &out->lods[out->lodCount];
+    ok = appendClusters(&b, mesh, &s) && buildLodMeshlets(&b, s.indices, s.indexCount, lod);
+    if (!ok) break;
+    // Averaging a cell can move a point by up to the cell's diagonal
+    lod->error = cellSize * 1.7320508f;
+    out->lodCount++;
+    previous = triangles;
+  }
+
+  free(s.keys);
+  free(s.values);
+  free(s.remap);
+  free(s.sums);
+  free(s.counts);
+  free(s.indices);
+  free(b.stamp);
+  free(b.local);
+
+  if (!ok) {
+    printf(RED "[ERROR] " RESET "failed to build meshlets\n");
+    mesh_meshlets_free(out);
+    return false;
+  }
+  out->buildMs = profiler_now_ms() - start;
+  return true;
+}
+
+void mesh_meshlets_free(Mesh_Meshlets *meshlets) {
+  if (!meshlets) return;
+  free(meshlets->vertices);
+  free(meshlets->meshlets);
+  free(meshlets->meshletVertices);
+  free(meshlets->meshletTriangles);
+  free(meshlets->indices);
+  memset(meshlets, 0, sizeof(*meshlets));
+}
@@ -0,0 +1,76 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESH_MAX_LODS 8
+
+typedef struct {
+  float position[3];
+  float normal[3];
+} Mesh_Vertex;
+
+// Indexed triangle list as generated or loaded, counter-clockwise front faces
+typedef struct {
+  Mesh_Vertex *vertices;
+  uint32_t vertexCount;
+  uint32_t *indices;
+  uint32_t indexCount;
+} Mesh_Data;
+
+// GPU layout (std430). Bounds are in mesh space.
+typedef struct {
+  float center[3];
+  float radius;
+  float coneAxis[3];
+  float coneCutoff;         // sin of the normal cone half-angle; 1 disables the backface test
+  uint32_t vertexOffset;    // into meshletVertices
+  uint32_t triangleOffset;  // into meshletTriangles
+  uint32_t firstIndex;      // into indices, for the indexed-indirect path
+  uint32_t counts;          // vertexCount | triangleCount << 8
+} Meshlet;
+
+typedef struct {
+  uint32_t firstMeshlet;
+  uint32_t meshletCount;
+  uint32_t triangleCount;
+  float error;  // mesh-space distance a surface point may have moved from LOD 0
+} Mesh_Lod;
+
+// A mesh split into meshlets for every level of its LOD chain. All levels
+// share the arrays; meshlet vertex and index values refer to vertices[].
+typedef struct {
+  Mesh_Vertex *vertices;
+  uint32_t vertexCount;
+  Meshlet *meshlets;
+  uint32_t meshletCount;
+  uint32_t *meshletVertices;
+  uint32_t meshletVertexCount;
+  uint32_t *meshletTriangles;  // local indices packed as i0 | i1 << 8 | i2 << 16
+  uint32_t meshletTriangleCount;
+  uint32_t *indices;           // meshlet triangles expanded to vertex indices
+  uint32_t indexCount;
+
+  Mesh_Lod lods[MESH_MAX_LODS];
+  uint32_t lodCount;
+  float center[3];
+  float radius;
+  double buildMs;
+} Mesh_Meshlets;
+
+// Unit sphere with (segments x rings) quads; bumpiness > 0 displaces the
+// surface so neighbouring meshlets face different ways.
+bool mesh_generate_sphere(Mesh_Data *mesh, uint32_t segments, uint32_t rings, float bumpiness);
+// Positions and faces only (polygons are fanned); normals are recomputed
+bool mesh_load_obj(Mesh_Data *mesh, const char *path);
+void mesh_data_free(Mesh_Data *mesh);
+
+// Builds the LOD chain by vertex clustering, each level roughly halving the
+// triangle count, and splits every level into meshlets.
+bool mesh_build_meshlets(const Mesh_Data *mesh, Mesh_Meshlets *out);
+void mesh_meshlets_free(Mesh_Meshlets *meshlets);
+
+#endif
@@ -0,0 +1,1302 @@
+#include "mesh_renderer.h"
+#include "color.h"
+#include "arena.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *cull_comp_path = "external/shaders/meshlet_cull.comp.spv";
+static const char *mesh_vert_path = "external/shaders/mesh.vert.spv";
+static const char *mesh_frag_path = "external/shaders/mesh.frag.spv";
+static const char *meshlet_task_path = "external/shaders/meshlet.task.spv";
+static const char *meshlet_mesh_path = "external/shaders/meshlet.mesh.spv";
+static const char *instance_cull_comp_path = "external/shaders/instance_cull.comp.spv";
+static const char *hiz_build_comp_path = "external/shaders/hiz_build.comp.spv";
+
+#define MESH_BINDING_COUNT 10
+#define MESH_BINDING_HIZ 8  // the only image binding; 0 is the camera, the rest storage buffers
+
+_Static_assert(sizeof(Meshlet) == 48, "Meshlet must match the std430 shader layout");
+_Static_assert(sizeof(Mesh_Gpu_Instance) == 64, "Mesh_Gpu_Instance must match the std430 shader layout");
+_Static_assert(sizeof(Mesh_Camera_Data) == 192, "Mesh_Camera_Data must match the std140 shader layout");
+
+// ========== MATH ==========
+
+static void normalize3(float v[3]) {
+  float len = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (len > 0.0f) {
+    v[0] /= len;
+    v[1] /= len;
+    v[2] /= len;
+  }
+}
+
+static void cross3(const float a[3], const float b[3], float out[3]) {
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+static float dot3(const float a[3], const float b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Column-major, right-handed, +Y up
+static void lookAt(const float eye[3], const float target[3], float m[16]) {
+  float f[3] = {target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]};
+  normalize3(f);
+  const float up[3] = {0.0f, 1.0f, 0.0f};
+  float s[3];
+  cross3(f, up, s);
+  normalize3(s);
+  float u[3];
+  cross3(s, f, u);
+
+  memset(m, 0, 16 * sizeof(float));
+  m[0] = s[0]; m[4] = s[1]; m[8] = s[2];
+  m[1] = u[0]; m[5] = u[1]; m[9] = u[2];
+  m[2] = -f[0]; m[6] = -f[1]; m[10] = -f[2];
+  m[12] = -dot3(s, eye);
+  m[13] = -dot3(u, eye);
+  m[14] = dot3(f, eye);
+  m[15] = 1.0f;
+}
+
+// Vulkan clip space: y points down, depth maps near..far to 0..1
+static void perspective(float fovY, float aspect, float zNear, float zFar, float m[16]) {
+  float f = 1.0f / tanf(fovY * 0.5f);
+  memset(m, 0, 16 * sizeof(float));
+  m[0] = f / aspect;
+  m[5] = -f;
+  m[10] = zFar / (zNear - zFar);
+  m[11] = -1.0f;
+  m[14] = zNear * zFar / (zNear - zFar);
+}
+
+static void multiply(const float a[16], const float b[16], float out[16]) {
+  for (int c = 0; c < 4; c++) {
+    for (int r = 0; r < 4; r++) {
+      float sum = 0.0f;
+      for (int k = 0; k < 4; k++) sum += a[k * 4 + r] * b[c * 4 + k];
+      out[c * 4 + r] = sum;
+    }
+  }
+}
+
+// Gribb-Hartmann: left, right, bottom, top, near, far
+static void extractPlanes(const float m[16], float planes[6][4]) {
+  for (int i = 0; i < 4; i++) {
+    float row0 = m[i * 4 + 0], row1 = m[i * 4 + 1], row2 = m[i * 4 + 2], row3 = m[i * 4 + 3];
+    planes[0][i] = row3 + row0;
+    planes[1][i] = row3 - row0;
+    planes[2][i] = row3 + row1;
+    planes[3][i] = row3 - row1;
+    planes[4][i] = row2;
+    planes[5][i] = row3 - row2;
+  }
+  for (int p = 0; p < 6; p++) {
+    float len = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+    if (len > 0.0f) {
+      for (int i = 0; i < 4; i++) planes[p][i] /= len;
+    }
+  }
+}
+
+// ========== RESOURCES ==========
+
+static void destroyBuffer(Mesh_Renderer *mr, Mesh_Buffer *buffer) {
+  if (buffer->buffer != VK_NULL_HANDLE) vkDestroyBuffer(mr->vk->device, buffer->buffer, NULL);
+  if (buffer->memory != VK_NULL_HANDLE) vulkan_free_memory(mr->vk, buffer->memory);
+  buffer->buffer = VK_NULL_HANDLE;
+  buffer->memory = VK_NULL_HANDLE;
+}
+
+static bool createMappedBuffer(Mesh_Renderer *mr, VkDeviceSize size, VkBufferUsageFlags usage,
+                               Mesh_Buffer *buffer, void **mapped) {
+  if (!vulkan_create_buffer(mr->vk, size, usage,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &buffer->buffer, &buffer->memory)) {
+    return false;
+  }
+  if (vkMapMemory(mr->vk->device, buffer->memory, 0, size, 0, mapped) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to map mesh buffer\n");
+    destroyBuffer(mr, buffer);
+    return false;
+  }
+  return true;
+}
+
+// Device-local copy of data through a one-off staging buffer
+static bool uploadBuffer(Mesh_Renderer *mr, const void *data, VkDeviceSize size, VkBufferUsageFlags usage,
+                         Mesh_Buffer *buffer) {
+  Vulkan_Context *vk = mr->vk;
+  Mesh_Buffer staging = {0};
+  void *mapped = NULL;
+  if (!createMappedBuffer(mr, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, &staging, &mapped)) return false;
+  memcpy(mapped, data, size);
+  vkUnmapMemory(vk->device, staging.memory);
+
+  bool ok = vulkan_create_buffer(vk, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &buffer->buffer, &buffer->memory);
+  if (ok) {
+    VkCommandBuffer cmd = vulkan_begin_one_time_commands(vk, mr->commandPool);
+    ok = cmd != VK_NULL_HANDLE;
+    if (ok) {
+      VkBufferCopy region = {0};
+      region.size = size;
+      vk->dispatch.vkCmdCopyBuffer(cmd, staging.buffer, buffer->buffer, 1, &region);
+      ok = vulkan_end_one_time_commands(vk, mr->commandPool, cmd);
+    }
+  }
+  destroyBuffer(mr, &staging);
+  return ok;
+}
+
+static void destroyFrameInstances(Mesh_Renderer *mr, Mesh_Frame *frame) {
+  if (frame->mappedInstances) vkUnmapMemory(mr->vk->device, frame->instances.memory);
+  destroyBuffer(mr, &frame->instances);
+  destroyBuffer(mr, &frame->visibility);
+  frame->mappedInstances = NULL;
+  frame->instanceCapacity = 0;
+}
+
+// Only touches this frame's slot, which the caller has fenced
+static bool growFrameInstances(Mesh_Renderer *mr, Mesh_Frame *frame, uint32_t capacity) {
+  destroyFrameInstances(mr, frame);
+  arena_note_heap_allocation();
+  void *mapped = NULL;
+  if (!createMappedBuffer(mr, (VkDeviceSize)capacity * sizeof(Mesh_Gpu_Instance),
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &frame->instances, &mapped)) {
+    return false;
+  }
+  frame->mappedInstances = mapped;
+  if (!vulkan_create_buffer(mr->vk, (VkDeviceSize)capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->visibility.buffer, &frame->visibility.memory)) {
+    destroyFrameInstances(mr, frame);
+    return false;
+  }
+  frame->instanceCapacity = capacity;
+  frame->descriptorsDirty = true;
+  return true;
+}
+
+static bool growFrameDraws(Mesh_Renderer *mr, Mesh_Frame *frame, uint32_t capacity) {
+  destroyBuffer(mr, &frame->draws);
+  frame->drawCapacity = 0;
+  arena_note_heap_allocation();
+  if (!vulkan_create_buffer(mr->vk, (VkDeviceSize)capacity * sizeof(VkDrawIndexedIndirectCommand),
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->draws.buffer, &frame->draws.memory)) {
+    return false;
+  }
+  frame->drawCapacity = capacity;
+  frame->descriptorsDirty = true;
+  return true;
+}
+
+static VkDescriptorType bindingType(uint32_t binding) {
+  if (binding == 0) return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  if (binding == MESH_BINDING_HIZ) return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+}
+
+// Stages reading the occlusion phase push constant
+static VkShaderStageFlags phaseStages(const Mesh_Renderer *mr) {
+  return VK_SHADER_STAGE_COMPUTE_BIT | (mr->useMeshShader ? VK_SHADER_STAGE_TASK_BIT_EXT : 0);
+}
+
+static void writeDescriptors(Mesh_Renderer *mr, Mesh_Frame *frame) {
+  VkDescriptorBufferInfo infos[MESH_BINDING_COUNT] = {{0}};
+  VkBuffer buffers[MESH_BINDING_COUNT] = {
+    frame->camera.buffer, mr->meshlets.buffer, frame->instances.buffer, frame->draws.buffer,
+    mr->vertices.buffer, mr->meshletVertices.buffer, mr->meshletTriangles.buffer, frame->visibility.buffer,
+    VK_NULL_HANDLE, frame->counters.buffer,
+  };
+  VkDescriptorImageInfo pyramidInfo = {mr->hizSampler, mr->hizView, VK_IMAGE_LAYOUT_GENERAL};
+  VkWriteDescriptorSet writes[MESH_BINDING_COUNT] = {{0}};
+  uint32_t writeCount = 0;
+  for (uint32_t i = 0; i < MESH_BINDING_COUNT; i++) {
+    // The mesh shader path has no draw buffer; the pyramid comes with the targets
+    if (i == MESH_BINDING_HIZ ? mr->hizView == VK_NULL_HANDLE : buffers[i] == VK_NULL_HANDLE) continue;
+    VkWriteDescriptorSet *write = &writes[writeCount++];
+    write->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write->dstSet = frame->set;
+    write->dstBinding = i;
+    write->descriptorCount = 1;
+    write->descriptorType = bindingType(i);
+    if (i == MESH_BINDING_HIZ) {
+      write->pImageInfo = &pyramidInfo;
+      continue;
+    }
+    infos[i].buffer = buffers[i];
+    infos[i].offset = 0;
+    infos[i].range = VK_WHOLE_SIZE;
+    write->pBufferInfo = &infos[i];
+  }
+  vkUpdateDescriptorSets(mr->vk->device, writeCount, writes, 0, NULL);
+  frame->descriptorsDirty = false;
+}
+
+static bool createDescriptors(Mesh_Renderer *mr) {
+  VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+  if (mr->useMeshShader) stages |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+
+  VkDescriptorSetLayoutBinding bindings[MESH_BINDING_COUNT] = {{0}};
+  for (uint32_t i = 0; i < MESH_BINDING_COUNT; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = bindingType(i);
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = stages;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = MESH_BINDING_COUNT;
+  layoutInfo.pBindings = bindings;
+  if (vkCreateDescriptorSetLayout(mr->vk->device, &layoutInfo, NULL, &mr->descriptorSetLayout) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create mesh descriptor set layout\n");
+    return false;
+  }
+
+  VkDescriptorPoolSize poolSizes[3] = {{0}};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  poolSizes[0].descriptorCount = MESH_MAX_FRAMES;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSizes[1].descriptorCount = (MESH_BINDING_COUNT - 2) * MESH_MAX_FRAMES;
+  poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[2].descriptorCount = MESH_MAX_FRAMES;
+
+  VkDescriptorPoolCreateInfo poolInfo = {0};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = 3;
+  poolInfo.pPoolSizes = poolSizes;
+  poolInfo.maxSets = MESH_MAX_FRAMES;
+  if (vkCreateDescriptorPool(mr->vk->device, &poolInfo, NULL, &mr->descriptorPool) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create mesh descriptor pool\n");
+    return false;
+  }
+
+  for (uint32_t i = 0; i < mr->frameCount; i++) {
+    VkDescriptorSetAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = mr->descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &mr->descriptorSetLayout;
+    if (vkAllocateDescriptorSets(mr->vk->device, &allocInfo, &mr->frames[i].set) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to allocate mesh descriptor set\n");
+      return false;
+    }
+  }
+
+  VkPushConstantRange pushRange = {0};
+  pushRange.stageFlags = phaseStages(mr);
+  pushRange.size = sizeof(uint32_t);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &mr->descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+  if (vkCreatePipelineLayout(mr->vk->device, &pipelineLayoutInfo, NULL, &mr->pipelineLayout) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create mesh pipeline layout\n");
+    return false;
+  }
+  return true;
+}
+
+// Depth target, source level, destination level
+static bool createPyramidDescriptors(Mesh_Renderer *mr) {
+  VkDevice device = mr->vk->device;
+
+  VkSamplerCreateInfo samplerInfo = {0};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+  if (vkCreateSampler(device, &samplerInfo, NULL, &mr->hizSampler) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create depth pyramid sampler\n");
+    return false;
+  }
+
+  VkDescriptorSetLayoutBinding bindings[3] = {{0}};
+  for (uint32_t i = 0; i < 3; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = 3;
+  layoutInfo.pBindings = bindings;
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, NULL, &mr->hizSetLayout) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create depth pyramid set layout\n");
+    return false;
+  }
+
+  VkDescriptorPoolSize poolSizes[2] = {{0}};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = MESH_HIZ_MAX_LEVELS;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  poolSizes[1].descriptorCount = 2 * MESH_HIZ_MAX_LEVELS;
+  VkDescriptorPoolCreateInfo poolInfo = {0};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = 2;
+  poolInfo.pPoolSizes = poolSizes;
+  poolInfo.maxSets = MESH_HIZ_MAX_LEVELS;
+  if (vkCreateDescriptorPool(device, &poolInfo, NULL, &mr->hizDescriptorPool) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create depth pyramid descriptor pool\n");
+    return false;
+  }
+
+  VkDescriptorSetLayout layouts[MESH_HIZ_MAX_LEVELS];
+  for (uint32_t i = 0; i < MESH_HIZ_MAX_LEVELS; i++) layouts[i] = mr->hizSetLayout;
+  VkDescriptorSetAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = mr->hizDescriptorPool;
+  allocInfo.descriptorSetCount = MESH_HIZ_MAX_LEVELS;
+  allocInfo.pSetLayouts = layouts;
+  if (vkAllocateDescriptorSets(device, &allocInfo, mr->hizSets) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to allocate depth pyramid descriptor sets\n");
+    return false;
+  }
+
+  VkPushConstantRange pushRange = {0};
+  pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushRange.size = 5 * sizeof(uint32_t);
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &mr->hizSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &mr->hizPipelineLayout) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create depth pyramid pipeline layout\n");
+    return false;
+  }
+  return true;
+}
+
+static VkShaderModule loadShader(Mesh_Renderer *mr, const char *path) {
+  size_t size;
+  char *code = readFile(path, &size);
+  if (!code) return VK_NULL_HANDLE;
+  VkShaderModule module = createShaderModule(code, size, mr->vk);
+  free(code);
+  return module;
+}
+
+// ========== PIPELINES ==========
+
+static void destroyFramebuffers(Mesh_Renderer *mr) {
+  if (!mr->framebuffers) return;
+  for (uint32_t i = 0; i < mr->framebufferCount; i++) {
+    if (mr->framebuffers[i] != VK_NULL_HANDLE) vkDestroyFramebuffer(mr->vk->device, mr->framebuffers[i], NULL);
+  }
+  free(mr->framebuffers);
+  mr->framebuffers = NULL;
+  mr->framebufferCount = 0;
+}
+
+static void destroyPipelines(Mesh_Renderer *mr) {
+  VkDevice device = mr->vk->device;
+  if (mr->drawPipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, mr->drawPipeline, NULL);
+  if (mr->renderPass != VK_NULL_HANDLE) vkDestroyRenderPass(device, mr->renderPass, NULL);
+  if (mr->loadRenderPass != VK_NULL_HANDLE) vkDestroyRenderPass(device, mr->loadRenderPass, NULL);
+  mr->drawPipeline = VK_NULL_HANDLE;
+  mr->renderPass = VK_NULL_HANDLE;
+  mr->loadRenderPass = VK_NULL_HANDLE;
+  destroyFramebuffers(mr);
+}
+
+// The early draw clears color and depth, the late draw and the passes after
+// it load them. Both are compatible with the same framebuffers and pipeline.
+static bool createRenderPass(Mesh_Renderer *mr, VkFormat colorFormat, VkAttachmentLoadOp loadOp,
+                             VkRenderPass *renderPass) {
+  VkAttachmentDescription attachments[2] = {{0}};
+  attachments[0].format = colorFormat;
+  attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[0].loadOp = loadOp;
+  attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  // The render graph owns layout transitions and synchronization
+  attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  attachments[1].format = MESH_DEPTH_FORMAT;
+  attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+  attachments[1].loadOp = loadOp;
+  attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentReference colorRef = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference depthRef = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpass = {0};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorRef;
+  subpass.pDepthStencilAttachment = &depthRef;
+
+  VkRenderPassCreateInfo renderPassInfo = {0};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 2;
+  renderPassInfo.pAttachments = attachments;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+
+  if (vkCreateRenderPass(mr->vk->device, &renderPassInfo, NULL, renderPass) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create mesh render pass\n");
+    return false;
+  }
+  return true;
+}
+
+bool mesh_renderer_rebuild_pipelines(Mesh_Renderer *mr, VkFormat colorFormat) {
+  if (!mr || !mr->vk) return false;
+  destroyPipelines(mr);
+  if (!mr->dynamicRendering &&
+      (!createRenderPass(mr, colorFormat, VK_ATTACHMENT_LOAD_OP_CLEAR, &mr->renderPass) ||
+       !createRenderPass(mr, colorFormat, VK_ATTACHMENT_LOAD_OP_LOAD, &mr->loadRenderPass))) {
+    return false;
+  }
+
+  VkPipelineShaderStageCreateInfo shaderStages[3] = {{0}, {0}, {0}};
+  uint32_t stageCount = 0;
+  if (mr->useMeshShader) {
+    shaderStages[stageCount].stage = VK_SHADER_STAGE_TASK_BIT_EXT;
+    shaderStages[stageCount++].module = mr->taskShaderModule;
+    shaderStages[stageCount].stage = VK_SHADER_STAGE_MESH_BIT_EXT;
+    shaderStages[stageCount++].module = mr->meshShaderModule;
+  } else {
+    shaderStages[stageCount].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[stageCount++].module = mr->vertShaderModule;
+  }
+  shaderStages[stageCount].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  shaderStages[stageCount++].module = mr->fragShaderModule;
+  for (uint32_t i = 0; i < stageCount; i++) {
+    shaderStages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[i].pName = "main";
+  }
+
+  VkVertexInputBindingDescription binding = {0};
+  binding.binding = 0;
+  binding.stride = sizeof(Mesh_Vertex);
+  binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+  VkVertexInputAttributeDescription attributes[2] = {{0}};
+  attributes[0].location = 0;
+  attributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+  attributes[0].offset = offsetof(Mesh_Vertex, position);
+  attributes[1].location = 1;
+  attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+  attributes[1].offset = offsetof(Mesh_Vertex, normal);
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo = {0};
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.pVertexBindingDescriptions = &binding;
+  vertexInputInfo.vertexAttributeDescriptionCount = 2;
+  vertexInputInfo.pVertexAttributeDescriptions = attributes;
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly = {0};
+  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  VkPipelineViewportStateCreateInfo viewportState = {0};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer = {0};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  // The projection flips y, so counter-clockwise meshes stay counter-clockwise on screen
+  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling = {0};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.minSampleShading = 1.0f;
+
+  VkPipelineDepthStencilStateCreateInfo depthStencil = {0};
+  depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = VK_TRUE;
+  depthStencil.depthWriteEnable = VK_TRUE;
+  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment = {0};
+  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.blendEnable = VK_FALSE;
+
+  VkPipelineColorBlendStateCreateInfo colorBlending = {0};
+  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.attachmentCount = 1;
+  colorBlending.pAttachments = &colorBlendAttachment;
+
+  VkDynamicState dynamicStates[] = {
+    VK_DYNAMIC_STATE_VIEWPORT,
+    VK_DYNAMIC_STATE_SCISSOR
+  };
+  VkPipelineDynamicStateCreateInfo dynamicState = {0};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
+
+  VkPipelineRenderingCreateInfo renderingInfo = {0};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachmentFormats = &colorFormat;
+  renderingInfo.depthAttachmentFormat = MESH_DEPTH_FORMAT;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo = {0};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = mr->dynamicRendering ? &renderingInfo : NULL;
+  pipelineInfo.stageCount = stageCount;
+  pipelineInfo.pStages = shaderStages;
+  // Mesh pipelines have no vertex input stage
+  pipelineInfo.pVertexInputState = mr->useMeshShader ? NULL : &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = mr->useMeshShader ? NULL : &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = mr->pipelineLayout;
+  pipelineInfo.renderPass = mr->renderPass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.basePipelineIndex = -1;
+
+  if (vkCreateGraphicsPipelines(mr->vk->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &mr->drawPipeline) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create mesh pipeline\n");
+    return false;
+  }
+  return true;
+}
+
+static bool createComputePipeline(Mesh_Renderer *mr, VkShaderModule module, VkPipelineLayout layout,
+                                  const char *name, VkPipeline *pipeline) {
+  VkComputePipelineCreateInfo pipelineInfo = {0};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = module;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = layout;
+  pipelineInfo.basePipelineIndex = -1;
+
+  if (vkCreateComputePipelines(mr->vk->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, pipeline) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create %s pipeline\n", name);
+    return false;
+  }
+  return true;
+}
+
+// ========== DEPTH PYRAMID ==========
+
+static void destroyDepthPyramid(Mesh_Renderer *mr) {
+  VkDevice device = mr->vk->device;
+  for (uint32_t i = 0; i < mr->hizLevels; i++) vkDestroyImageView(device, mr->hizLevelViews[i], NULL);
+  if (mr->hizView != VK_NULL_HANDLE) vkDestroyImageView(device, mr->hizView, NULL);
+  if (mr->hiz != VK_NULL_HANDLE) vkDestroyImage(device, mr->hiz, NULL);
+  if (mr->hizMemory != VK_NULL_HANDLE) vulkan_free_memory(mr->vk, mr->hizMemory);
+  memset(mr->hizLevelViews, 0, sizeof(mr->hizLevelViews));
+  mr->hizView = VK_NULL_HANDLE;
+  mr->hiz = VK_NULL_HANDLE;
+  mr->hizMemory = VK_NULL_HANDLE;
+  mr->hizLevels = 0;
+  mr->hizValid = false;
+}
+
+static uint32_t floorPow2(uint32_t v) {
+  uint32_t p = 1;
+  while (p <= v / 2) p *= 2;
+  return p;
+}
+
+// Level 0 is the largest power of two not above the depth target, so every
+// level halves exactly and a texel never covers more than 3x3 depth pixels
+static bool createDepthPyramid(Mesh_Renderer *mr, VkImageView depthView, VkExtent2D extent) {
+  Vulkan_Context *vk = mr->vk;
+  destroyDepthPyramid(mr);
+  mr->depthExtent = extent;
+  mr->hizExtent.width = floorPow2(extent.width);
+  mr->hizExtent.height = floorPow2(extent.height);
+  uint32_t largest = mr->hizExtent.width > mr->hizExtent.height ? mr->hizExtent.width : mr->hizExtent.height;
+  uint32_t levels = 1;
+  while ((largest >> levels) > 0 && levels < MESH_HIZ_MAX_LEVELS) levels++;
+
+  if (!vulkan_create_image(vk, mr->hizExtent.width, mr->hizExtent.height, levels, MESH_HIZ_FORMAT,
+                           VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, &mr->hiz, &mr->hizMemory)) {
+    return false;
+  }
+  mr->hizView = vulkan_create_image_view(vk, mr->hiz, MESH_HIZ_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, levels);
+  if (mr->hizView == VK_NULL_HANDLE) return false;
+  for (uint32_t i = 0; i < levels; i++) {
+    VkImageViewCreateInfo viewInfo = {0};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = mr->hiz;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = MESH_HIZ_FORMAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = i;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(vk->device, &viewInfo, NULL, &mr->hizLevelViews[i]) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to create depth pyramid level view\n");
+      return false;
+    }
+    mr->hizLevels = i + 1;
+  }
+
+  // Lives in GENERAL from here on; the contents stay unused until the first build
+  VkCommandBuffer cmd = vulkan_begin_one_time_commands(vk, mr->commandPool);
+  if (cmd == VK_NULL_HANDLE) return false;
+  VkImageMemoryBarrier barrier = {0};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = mr->hiz;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = levels;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vk->dispatch.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                    0, 0, NULL, 0, NULL, 1, &barrier);
+  if (!vulkan_end_one_time_commands(vk, mr->commandPool, cmd)) return false;
+
+  // Level 0 reads the depth target; its unused source binding still needs a view
+  for (uint32_t i = 0; i < levels; i++) {
+    VkDescriptorImageInfo images[3] = {
+      {mr->hizSampler, depthView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+      {VK_NULL_HANDLE, mr->hizLevelViews[i > 0 ? i - 1 : 0], VK_IMAGE_LAYOUT_GENERAL},
+      {VK_NULL_HANDLE, mr->hizLevelViews[i], VK_IMAGE_LAYOUT_GENERAL},
+    };
+    VkWriteDescriptorSet writes[3] = {{0}};
+    for (uint32_t b = 0; b < 3; b++) {
+      writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[b].dstSet = mr->hizSets[i];
+      writes[b].dstBinding = b;
+      writes[b].descriptorCount = 1;
+      writes[b].descriptorType = b == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+      writes[b].pImageInfo = &images[b];
+    }
+    vkUpdateDescriptorSets(vk->device, 3, writes, 0, NULL);
+  }
+  for (uint32_t i = 0; i < mr->frameCount; i++) mr->frames[i].descriptorsDirty = true;
+  return true;
+}
+
+bool mesh_renderer_set_targets(Mesh_Renderer *mr, const VkImageView *colorViews, uint32_t count,
+                               VkImageView depthView, VkExtent2D extent) {
+  if (!mr || !mr->vk) return false;
+  destroyFramebuffers(mr);
+  if (!createDepthPyramid(mr, depthView, extent)) {
+    printf(RED "[ERROR] " RESET "failed to create depth pyramid\n");
+    return false;
+  }
+  if (mr->dynamicRendering) return true;
+
+  mr->framebuffers = calloc(count, sizeof(VkFramebuffer));
+  if (!mr->framebuffers) {
+    printf(RED "[ERROR] " RESET "failed to allocate mesh framebuffers\n");
+    return false;
+  }
+  mr->framebufferCount = count;
+
+  for (uint32_t i = 0; i < count; i++) {
+    VkImageView attachments[] = {colorViews[i], depthView};
+
+    VkFramebufferCreateInfo framebufferInfo = {0};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = mr->renderPass;
+    framebufferInfo.attachmentCount = 2;
+    framebufferInfo.pAttachments = attachments;
+    framebufferInfo.width = extent.width;
+    framebufferInfo.height = extent.height;
+    framebufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(mr->vk->device, &framebufferInfo, NULL, &mr->framebuffers[i]) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to create mesh framebuffer\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+// ========== LIFECYCLE ==========
+
+bool mesh_renderer_create(Mesh_Renderer *mr, Vulkan_Context *vk, VkCommandPool commandPool, uint32_t framesInFlight,
+                          bool dynamicRendering, bool useMeshShader, VkFormat colorFormat) {
+  if (!mr || !vk || framesInFlight == 0 || framesInFlight > MESH_MAX_FRAMES) return false;
+
+  memset(mr, 0, sizeof(*mr));
+  mr->vk = vk;
+  mr->commandPool = commandPool;
+  mr->frameCount = framesInFlight;
+  mr->dynamicRendering = dynamicRendering;
+  mr->useMeshShader = useMeshShader && vk->meshShader;
+  mr->fovY = 1.0f;
+  mr->zNear = 0.1f;
+  mr->zFar = 1000.0f;
+  mr->eye[2] = 5.0f;
+  mr->lodThreshold = 1.0f;
+  mr->forceLod = -1;
+  mr->occlusion = true;
+
+  // Culled meshlets are instanceCount 0 draws; the instance comes from firstInstance
+  if (!mr->useMeshShader && !vk->drawIndirectFirstInstance) {
+    printf(YELLOW "[WARNING] " RESET "meshes need mesh shaders or drawIndirectFirstInstance\n");
+    memset(mr, 0, sizeof(*mr));
+    return false;
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(vk->physicalDevice, &properties);
+  mr->maxDrawIndirectCount = vk->multiDrawIndirect ? properties.limits.maxDrawIndirectCount : 1;
+  if (properties.limits.timestampComputeAndGraphics) {
+    VkQueryPoolCreateInfo queryInfo = {0};
+    queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = 2 * MESH_MAX_FRAMES;
+    if (vkCreateQueryPool(vk->device, &queryInfo, NULL, &mr->queryPool) == VK_SUCCESS) {
+      mr->timestampPeriod = properties.limits.timestampPeriod;
+    }
+  }
+
+  if (!createDescriptors(mr) || !createPyramidDescriptors(mr)) return false;
+
+  mr->instanceCullShaderModule = loadShader(mr, instance_cull_comp_path);
+  mr->hizShaderModule = loadShader(mr, hiz_build_comp_path);
+  if (!mr->instanceCullShaderModule || !mr->hizShaderModule) return false;
+  if (!createComputePipeline(mr, mr->instanceCullShaderModule, mr->pipelineLayout, "instance cull",
+                             &mr->instanceCullPipeline) ||
+      !createComputePipeline(mr, mr->hizShaderModule, mr->hizPipelineLayout, "depth pyramid", &mr->hizPipeline)) {
+    return false;
+  }
+
+  mr->fragShaderModule = loadShader(mr, mesh_frag_path);
+  if (mr->useMeshShader) {
+    mr->taskShaderModule = loadShader(mr, meshlet_task_path);
+    mr->meshShaderModule = loadShader(mr, meshlet_mesh_path);
+    if (!mr->taskShaderModule || !mr->meshShaderModule) return false;
+  } else {
+    mr->cullShaderModule = loadShader(mr, cull_comp_path);
+    mr->vertShaderModule = loadShader(mr, mesh_vert_path);
+    if (!mr->cullShaderModule || !mr->vertShaderModule) return false;
+    if (!createComputePipeline(mr, mr->cullShaderModule, mr->pipelineLayout, "meshlet cull", &mr->cullPipeline)) {
+      return false;
+    }
+  }
+  if (!mr->fragShaderModule) return false;
+  if (!mesh_renderer_rebuild_pipelines(mr, colorFormat)) return false;
+
+  mr->pendingCapacity = MESH_INITIAL_INSTANCES;
+  mr->pending = malloc(mr->pendingCapacity * sizeof(Mesh_Instance));
+  if (!mr->pending) return false;
+
+  for (uint32_t i = 0; i < mr->frameCount; i++) {
+    Mesh_Frame *frame = &mr->frames[i];
+    void *mapped = NULL;
+    if (!createMappedBuffer(mr, sizeof(Mesh_Camera_Data), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                            &frame->camera, &mapped)) {
+      return false;
+    }
+    frame->mappedCamera = mapped;
+    if (!createMappedBuffer(mr, sizeof(Mesh_Occlusion_Counters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            &frame->counters, &mapped)) {
+      return false;
+    }
+    frame->mappedCounters = mapped;
+    memset(frame->mappedCounters, 0, sizeof(Mesh_Occlusion_Counters));
+    if (!growFrameInstances(mr, frame, MESH_INITIAL_INSTANCES)) return false;
+    if (!mr->useMeshShader && !growFrameDraws(mr, frame, MESH_INITIAL_INSTANCES)) return false;
+  }
+
+  printf(GREEN "[OK] " RESET "Mesh Renderer (%s)\n",
+         mr->useMeshShader ? "task + mesh shaders" : mr->maxDrawIndirectCount > 1
+             ? "compute cull + multi-draw indirect" : "compute cull + indirect");
+  return true;
+}
+
+void mesh_renderer_destroy(Mesh_Renderer *mr) {
+  if (!mr || !mr->vk) return;
+  VkDevice device = mr->vk->device;
+
+  if (mr->gpuStat.count > 0) profiler_stat_print("mesh gpu", &mr->gpuStat);
+
+  for (uint32_t i = 0; i < mr->frameCount; i++) {
+    Mesh_Frame *frame = &mr->frames[i];
+    destroyFrameInstances(mr, frame);
+    if (frame->mappedCamera) vkUnmapMemory(device, frame->camera.memory);
+    destroyBuffer(mr, &frame->camera);
+    destroyBuffer(mr, &frame->draws);
+    if (frame->mappedCounters) vkUnmapMemory(device, frame->counters.memory);
+    destroyBuffer(mr, &frame->counters);
+  }
+  destroyDepthPyramid(mr);
+  destroyBuffer(mr, &mr->vertices);
+  destroyBuffer(mr, &mr->indices);
+  destroyBuffer(mr, &mr->meshlets);
+  destroyBuffer(mr, &mr->meshletVertices);
+  destroyBuffer(mr, &mr->meshletTriangles);
+
+  destroyPipelines(mr);
+  if (mr->cullPipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, mr->cullPipeline, NULL);
+  if (mr->instanceCullPipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, mr->instanceCullPipeline, NULL);
+  if (mr->hizPipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, mr->hizPipeline, NULL);
+  if (mr->hizPipelineLayout != VK_NULL_HANDLE) vkDestroyPipelineLayout(device, mr->hizPipelineLayout, NULL);
+  if (mr->hizDescriptorPool != VK_NULL_HANDLE) vkDestroyDescriptorPool(device, mr->hizDescriptorPool, NULL);
+  if (mr->hizSetLayout != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(device, mr->hizSetLayout, NULL);
+  if (mr->hizSampler != VK_NULL_HANDLE) vkDestroySampler(device, mr->hizSampler, NULL);
+  if (mr->instanceCullShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, mr->instanceCullShaderModule, NULL);
+  if (mr->hizShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, mr->hizShaderModule, NULL);
+  if (mr->pipelineLayout != VK_NULL_HANDLE) vkDestroyPipelineLayout(device, mr->pipelineLayout, NULL);
+  if (mr->cullShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, mr->cullShaderModule, NULL);
+  if (mr->vertShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, mr->vertShaderModule, NULL);
+  if (mr->taskShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, mr->taskShaderModule, NULL);
+  if (mr->meshShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, mr->meshShaderModule, NULL);
+  if (mr->fragShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, mr->fragShaderModule, NULL);
+  if (mr->descriptorPool != VK_NULL_HANDLE) vkDestroyDescriptorPool(device, mr->descriptorPool, NULL);
+  if (mr->descriptorSetLayout != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(device, mr->descriptorSetLayout, NULL);
+  if (mr->queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, mr->queryPool, NULL);
+
+  free(mr->pending);
+  memset(mr, 0, sizeof(*mr));
+}
+
+// ========== GEOMETRY ==========
+
+bool mesh_renderer_upload(Mesh_Renderer *mr, const Mesh_Meshlets *meshes, uint32_t count) {
+  if (!mr || !mr->vk || !meshes || count == 0) return false;
+  if (count > MESH_MAX_MESHES) {
+    printf(RED "[ERROR] " RESET "too many meshes (%u, max %d)\n", count, MESH_MAX_MESHES);
+    return false;
+  }
+
+  size_t vertexCount = 0, meshletCount = 0, meshletVertexCount = 0, triangleCount = 0, indexCount = 0;
+  for (uint32_t m = 0; m < count; m++) {
+    vertexCount += meshes[m].vertexCount;
+    meshletCount += meshes[m].meshletCount;
+    meshletVertexCount += meshes[m].meshletVertexCount;
+    triangleCount += meshes[m].meshletTriangleCount;
+    indexCount += meshes[m].indexCount;
+  }
+
+  Mesh_Vertex *vertices = malloc(vertexCount * sizeof(Mesh_Vertex));
+  Meshlet *meshlets = malloc(meshletCount * sizeof(Meshlet));
+  uint32_t *meshletVertices = malloc(meshletVertexCount * sizeof(uint32_t));
+  uint32_t *triangles = malloc(triangleCount * sizeof(uint32_t));
+  uint32_t *indices = malloc(indexCount * sizeof(uint32_t));
+  bool ok = vertices && meshlets && meshletVertices && triangles && indices;
+
+  // Concatenate, rebasing every offset and vertex id onto the shared arrays
+  size_t vertexBase = 0, meshletBase = 0, meshletVertexBase = 0, triangleBase = 0, indexBase = 0;
+  for (uint32_t m = 0; ok && m < count; m++) {
+    const Mesh_Meshlets *src = &meshes[m];
+    memcpy(vertices + vertexBase, src->vertices, src->vertexCount * sizeof(Mesh_Vertex));
+    for (uint32_t i = 0; i < src->meshletCount; i++) {
+      Meshlet meshlet = src->meshlets[i];
+      meshlet.vertexOffset += (uint32_t)meshletVertexBase;
+      meshlet.triangleOffset += (uint32_t)triangleBase;
+      meshlet.firstIndex += (uint32_t)indexBase;
+      meshlets[meshletBase + i] = meshlet;
+    }
+    for (uint32_t i = 0; i < src->meshletVertexCount; i++) {
+      meshletVertices[meshletVertexBase + i] = src->meshletVertices[i] + (uint32_t)vertexBase;
+    }
+    memcpy(triangles + triangleBase, src->meshletTriangles, src->meshletTriangleCount * sizeof(uint32_t));
+    for (uint32_t i = 0; i < src->indexCount; i++) {
+      indices[indexBase + i] = src->indices[i] + (uint32_t)vertexBase;
+    }
+
+    Mesh_Info *info = &mr->meshes[m];
+    memcpy(info->lods, src->lods, sizeof(info->lods));
+    info->lodCount = src->lodCount;
+    for (uint32_t l = 0; l < info->lodCount; l++) info->lods[l].firstMeshlet += (uint32_t)meshletBase;
+    memcpy(info->center, src->center, sizeof(info->center));
+    info->radius = src->radius;
+
+    vertexBase += src->vertexCount;
+    meshletBase += src->meshletCount;
+    meshletVertexBase += src->meshletVertexCount;
+    triangleBase += src->meshletTriangleCount;
+    indexBase += src->indexCount;
+  }
+
+  // Nothing may still be reading the old buffers
+  vkDeviceWaitIdle(mr->vk->device);
+  destroyBuffer(mr, &mr->vertices);
+  destroyBuffer(mr, &mr->indices);
+  destroyBuffer(mr, &mr->meshlets);
+  destroyBuffer(mr, &mr->meshletVertices);
+  destroyBuffer(mr, &mr->meshletTriangles);
+  mr->meshCount = 0;
+
+  ok = ok &&
+       uploadBuffer(mr, vertices, vertexCount * sizeof(Mesh_Vertex),
+                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &mr->vertices) &&
+       uploadBuffer(mr, indices, indexCount * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &mr->indices) &&
+       uploadBuffer(mr, meshlets, meshletCount * sizeof(Meshlet), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &mr->meshlets) &&
+       uploadBuffer(mr, meshletVertices, meshletVertexCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    &mr->meshletVertices) &&
+       uploadBuffer(mr, triangles, triangleCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    &mr->meshletTriangles);
+
+  free(vertices);
+  free(meshlets);
+  free(meshletVertices);
+  free(triangles);
+  free(indices);
+  if (!ok) {
+    printf(RED "[ERROR] " RESET "failed to upload meshes\n");
+    return false;
+  }
+
+  mr->meshCount = count;
+  for (uint32_t i = 0; i < mr->frameCount; i++) mr->frames[i].descriptorsDirty = true;
+  printf(GREEN "[OK] " RESET "Meshes (%u, %zu meshlets, %.1f MB)\n", count, meshletCount,
+         (double)(vertexCount * sizeof(Mesh_Vertex) + (indexCount + meshletVertexCount + triangleCount) * 4 +
+                  meshletCount * sizeof(Meshlet)) / (1024.0 * 1024.0));
+  return true;
+}
+
+// ========== PER FRAME ==========
+
+void mesh_renderer_set_camera(Mesh_Renderer *mr, const float eye[3], const float target[3],
+                              float fovY, float zNear, float zFar) {
+  if (!mr) return;
+  memcpy(mr->eye, eye, sizeof(mr->eye));
+  memcpy(mr->target, target, sizeof(mr->target));
+  mr->fovY = fovY;
+  mr->zNear = zNear;
+  mr->zFar = zFar;
+}
+
+void mesh_renderer_push(Mesh_Renderer *mr, const Mesh_Instance *instance) {
+  if (!mr || !mr->pending || instance->mesh >= mr->meshCount) return;
+  if (mr->pendingCount == mr->pendingCapacity) {
+    Mesh_Instance *pending = realloc(mr->pending, 2 * (size_t)mr->pendingCapacity * sizeof(Mesh_Instance));
+    arena_note_heap_allocation();
+    if (!pending) return;
+    mr->pending = pending;
+    mr->pendingCapacity *= 2;
+  }
+  mr->pending[mr->pendingCount++] = *instance;
+}
+
+// Coarsest level whose simplification error projects to at most the threshold
+static uint32_t selectLod(const Mesh_Renderer *mr, const Mesh_Info *info, float scale, float distance,
+                          float projScale) {
+  if (mr->forceLod >= 0) {
+    return (uint32_t)mr->forceLod < info->lodCount ? (uint32_t)mr->forceLod : info->lodCount - 1;
+  }
+  if (distance < mr->zNear) distance = mr->zNear;
+  uint32_t lod = 0;
+  for (uint32_t l = 1; l < info->lodCount; l++) {
+    if (info->lods[l].error * scale * projScale / distance > mr->lodThreshold) break;
+    lod = l;
+  }
+  return lod;
+}
+
+void mesh_renderer_flush(Mesh_Renderer *mr, uint32_t frameIndex, VkExtent2D extent) {
+  if (!mr || !mr->vk || frameIndex >= mr->frameCount) return;
+  Mesh_Frame *frame = &mr->frames[frameIndex];
+
+  // Fence already waited: results are available, never block on them
+  if (frame->timed) {
+    uint64_t ticks[2];
+    if (vkGetQueryPoolResults(mr->vk->device, mr->queryPool, frameIndex * 2, 2, sizeof(ticks), ticks,
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+      profiler_stat_add(&mr->gpuStat, (double)(ticks[1] - ticks[0]) * mr->timestampPeriod / 1000000.0);
+    }
+    frame->timed = false;
+  }
+  if (frame->counted) {
+    Mesh_Occlusion_Counters *counters = frame->mappedCounters;
+    mr->lastTested = counters->tested;
+    mr->lastOccluded = counters->tested - counters->visibleEarly - counters->visibleLate;
+    mr->lastDisoccluded = counters->visibleLate;
+    memset(counters, 0, sizeof(*counters));
+    frame->counted = false;
+  }
+
+  uint32_t count = mr->pendingCount;
+  mr->pendingCount = 0;
+  frame->instanceCount = 0;
+  frame->slotCount = 0;
+  mr->lastInstances = 0;
+  mr->lastMeshlets = 0;
+  mr->lastTriangles = 0;
+  if (count == 0 || mr->meshCount == 0 || extent.width == 0 || extent.height == 0) return;
+
+  double start = profiler_now_ms();
+
+  if (count > frame->instanceCapacity) {
+    uint32_t capacity = frame->instanceCapacity ? frame->instanceCapacity : MESH_INITIAL_INSTANCES;
+    while (capacity < count) capacity *= 2;
+    if (!growFrameInstances(mr, frame, capacity)) return;
+  }
+
+  float view[16], proj[16];
+  Mesh_Camera_Data *camera = frame->mappedCamera;
+  lookAt(mr->eye, mr->target, view);
+  perspective(mr->fovY, (float)extent.width / (float)extent.height, mr->zNear, mr->zFar, proj);
+  multiply(proj, view, camera->viewProj);
+  extractPlanes(camera->viewProj, camera->planes);
+  memcpy(camera->position, mr->eye, sizeof(mr->eye));
+  camera->position[3] = 1.0f;
+  float projScale = (float)extent.height / (2.0f * tanf(mr->fovY * 0.5f));
+
+  // Whole instances outside the frustum never reach the GPU; the rest get
+  // one slot per meshlet of their LOD
+  Mesh_Gpu_Instance *dst = frame->mappedInstances;
+  uint32_t written = 0, slots = 0;
+  uint64_t triangles = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const Mesh_Instance *src = &mr->pending[i];
+    const Mesh_Info *info = &mr->meshes[src->mesh];
+    float c = cosf(src->rotation), s = sinf(src->rotation);
+    float center[3] = {
+      (c * info->center[0] + s * info->center[2]) * src->scale + src->position[0],
+      info->center[1] * src->scale + src->position[1],
+      (-s * info->center[0] + c * info->center[2]) * src->scale + src->position[2],
+    };
+    float radius = info->radius * src->scale;
+
+    bool visible = true;
+    for (int p = 0; p < 6 && visible; p++) {
+      visible = dot3(camera->planes[p], center) + camera->planes[p][3] >= -radius;
+    }
+    if (!visible) continue;
+
+    float offset[3] = {center[0] - mr->eye[0], center[1] - mr->eye[1], center[2] - mr->eye[2]};
+    float distance = sqrtf(dot3(offset, offset)) - radius;
+    const Mesh_Lod *lod = &info->lods[selectLod(mr, info, src->scale, distance, projScale)];
+
+    Mesh_Gpu_Instance *gpu = &dst[written++];
+    memcpy(gpu->positionScale, src->position, sizeof(src->position));
+    gpu->positionScale[3] = src->scale;
+    memcpy(gpu->sphere, center, sizeof(center));
+    gpu->sphere[3] = radius;
+    gpu->cosYaw = c;
+    gpu->sinYaw = s;
+    gpu->color = src->color;
+    gpu->firstMeshlet = lod->firstMeshlet;
+    gpu->meshletCount = lod->meshletCount;
+    gpu->drawOffset = slots;
+    slots += lod->meshletCount;
+    triangles += lod->triangleCount;
+  }
+
+  if (!mr->useMeshShader && slots > frame->drawCapacity) {
+    uint32_t capacity = frame->drawCapacity ? frame->drawCapacity : MESH_INITIAL_INSTANCES;
+    while (capacity < slots) capacity *= 2;
+    if (!growFrameDraws(mr, frame, capacity)) return;
+  }
+  if (frame->descriptorsDirty) writeDescriptors(mr, frame);
+
+  camera->slotCount = slots;
+  camera->instanceCount = written;
+  camera->occlusionTest = mr->occlusion && mr->hizValid;
+  frame->instanceCount = written;
+  frame->slotCount = slots;
+  mr->lastInstances = written;
+  mr->lastMeshlets = slots;
+  mr->lastTriangles = triangles;
+  profiler_stat_add(&mr->flushStat, profiler_now_ms() - start);
+}
+
+VkBuffer mesh_renderer_draw_buffer(Mesh_Renderer *mr, uint32_t frameIndex) {
+  if (!mr || frameIndex >= mr->frameCount) return VK_NULL_HANDLE;
+  return mr->frames[frameIndex].draws.buffer;
+}
+
+VkBuffer mesh_renderer_visibility_buffer(Mesh_Renderer *mr, uint32_t frameIndex) {
+  if (!mr || frameIndex >= mr->frameCount) return VK_NULL_HANDLE;
+  return mr->frames[frameIndex].visibility.buffer;
+}
+
+VkImage mesh_renderer_hiz_image(Mesh_Renderer *mr) {
+  return mr ? mr->hiz : VK_NULL_HANDLE;
+}
+
+// Group counts above the per-dimension limit spill into y
+static void splitGroups(uint32_t groups, uint32_t *x, uint32_t *y) {
+  *x = groups < 65535 ? groups : 65535;
+  *y = (groups + *x - 1) / *x;
+}
+
+static void beginTiming(Mesh_Renderer *mr, VkCommandBuffer cmd, uint32_t frameIndex) {
+  if (mr->queryPool == VK_NULL_HANDLE) return;
+  mr->vk->dispatch.vkCmdResetQueryPool(cmd, mr->queryPool, frameIndex * 2, 2);
+  mr->vk->dispatch.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, mr->queryPool, frameIndex * 2);
+  mr->frames[frameIndex].timed = true;
+}
+
+void mesh_renderer_record_cull(Mesh_Renderer *mr, VkCommandBuffer cmd, uint32_t frameIndex, uint32_t phase) {
+  if (!mr || !mr->vk || frameIndex >= mr->frameCount) return;
+  Mesh_Frame *frame = &mr->frames[frameIndex];
+  if (frame->slotCount == 0) return;
+  const Vulkan_Dispatch *vkd = &mr->vk->dispatch;
+
+  if (phase == MESH_PHASE_EARLY) {
+    beginTiming(mr, cmd, frameIndex);
+    frame->counted = true;
+  }
+  uint32_t x, y;
+  splitGroups((frame->instanceCount + MESH_CULL_GROUP_SIZE - 1) / MESH_CULL_GROUP_SIZE, &x, &y);
+  vkd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mr->instanceCullPipeline);
+  vkd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mr->pipelineLayout, 0, 1, &frame->set, 0, NULL);
+  vkd->vkCmdPushConstants(cmd, mr->pipelineLayout, phaseStages(mr), 0, sizeof(phase), &phase);
+  vkd->vkCmdDispatch(cmd, x, y, 1);
+  if (mr->useMeshShader) return;
+
+  // The meshlet pass reads the phases just written
+  VkMemoryBarrier barrier = {0};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                            1, &barrier, 0, NULL, 0, NULL);
+  splitGroups((frame->slotCount + MESH_CULL_GROUP_SIZE - 1) / MESH_CULL_GROUP_SIZE, &x, &y);
+  vkd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mr->cullPipeline);
+  vkd->vkCmdDispatch(cmd, x, y, 1);
+}
+
+void mesh_renderer_record_hiz(Mesh_Renderer *mr, VkCommandBuffer cmd) {
+  if (!mr || !mr->vk || mr->hiz == VK_NULL_HANDLE) return;
+  const Vulkan_Dispatch *vkd = &mr->vk->dispatch;
+
+  vkd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mr->hizPipeline);
+  uint32_t srcWidth = mr->depthExtent.width, srcHeight = mr->depthExtent.height;
+  for (uint32_t level = 0; level < mr->hizLevels; level++) {
+    uint32_t width = mr->hizExtent.width >> level, height = mr->hizExtent.height >> level;
+    if (width == 0) width = 1;
+    if (height == 0) height = 1;
+    if (level > 0) {
+      VkMemoryBarrier barrier = {0};
+      barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      vkd->vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                1, &barrier, 0, NULL, 0, NULL);
+    }
+    uint32_t push[5] = {srcWidth, srcHeight, width, height, level == 0};
+    vkd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, mr->hizPipelineLayout, 0, 1,
+                                 &mr->hizSets[level], 0, NULL);
+    vkd->vkCmdPushConstants(cmd, mr->hizPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), push);
+    vkd->vkCmdDispatch(cmd, (width + 7) / 8, (height + 7) / 8, 1);
+    srcWidth = width;
+    srcHeight = height;
+  }
+  mr->hizValid = true;
+}
+
+void mesh_renderer_record_draw(Mesh_Renderer *mr, VkCommandBuffer cmd, uint32_t frameIndex, uint32_t phase,
+                               uint32_t imageIndex, VkImageView colorView, VkImageView depthView, VkExtent2D extent) {
+  if (!mr || !mr->vk || frameIndex >= mr->frameCount) return;
+  Mesh_Frame *frame = &mr->frames[frameIndex];
+  const Vulkan_Dispatch *vkd = &mr->vk->dispatch;
+  // Nothing to add to what the early draw cleared
+  if (phase == MESH_PHASE_LATE && frame->slotCount == 0) return;
+  VkAttachmentLoadOp loadOp = phase == MESH_PHASE_EARLY ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+
+  VkClearValue clearValues[2] = {{{{0.0f, 0.0f, 0.0f, 1.0f}}}, {{{0.0f}}}};
+  clearValues[1].depthStencil.depth = 1.0f;
+
+  if (mr->dynamicRendering) {
+    VkRenderingAttachmentInfo colorAttachment = {0};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = colorView;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = loadOp;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearValues[0];
+
+    VkRenderingAttachmentInfo depthAttachment = {0};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.imageView = depthView;
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = loadOp;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.clearValue = clearValues[1];
+
+    VkRenderingInfo renderingInfo = {0};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.renderArea.extent = extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+    mr->vk->cmdBeginRendering(cmd, &renderingInfo);
+  } else {
+    if (imageIndex >= mr->framebufferCount) return;
+    VkRenderPassBeginInfo renderPassInfo = {0};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = phase == MESH_PHASE_EARLY ? mr->renderPass : mr->loadRenderPass;
+    renderPassInfo.framebuffer = mr->framebuffers[imageIndex];
+    renderPassInfo.renderArea.extent = extent;
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
+    vkd->vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  }
+
+  if (frame->slotCount > 0) {
+    VkViewport viewport = {0};
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
+    viewport.maxDepth = 1.0f;
+    vkd->vkCmdSetViewport(cmd, 0, 1, &viewport);
+    VkRect2D scissor = {{0, 0}, extent};
+    vkd->vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+    vkd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mr->drawPipeline);
+    vkd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mr->pipelineLayout, 0, 1, &frame->set, 0, NULL);
+
+    if (mr->useMeshShader) {
+      vkd->vkCmdPushConstants(cmd, mr->pipelineLayout, phaseStages(mr), 0, sizeof(phase), &phase);
+      uint32_t x, y;
+      splitGroups((frame->slotCount + MESH_TASK_GROUP_SIZE - 1) / MESH_TASK_GROUP_SIZE, &x, &y);
+      mr->vk->cmdDrawMeshTasks(cmd, x, y, 1);
+    } else {
+      VkDeviceSize offset = 0;
+      vkd->vkCmdBindVertexBuffers(cmd, 0, 1, &mr->vertices.buffer, &offset);
+      vkd->vkCmdBindIndexBuffer(cmd, mr->indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+      // One command per meshlet slot; culled ones draw zero instances
+      uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+      for (uint32_t first = 0; first < frame->slotCount;) {
+        uint32_t batch = frame->slotCount - first;
+        if (batch > mr->maxDrawIndirectCount) batch = mr->maxDrawIndirectCount;
+        vkd->vkCmdDrawIndexedIndirect(cmd, frame->draws.buffer, (VkDeviceSize)first * stride, batch, stride);
+        first += batch;
+      }
+    }
+  }
+
+  if (mr->dynamicRendering) {
+    mr->vk->cmdEndRendering(cmd);
+  } else {
+    vkd->vkCmdEndRenderPass(cmd);
+  }
+
+  if (phase == MESH_PHASE_LATE && frame->timed) {
+    vkd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mr->queryPool, frameIndex * 2 + 1);
+  }
+}
@@ -0,0 +1,224 @@
+#ifndef MESH_RENDERER_H
+#define MESH_RENDERER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "vulkan_init.h"
+#include "profiler.h"
+#include "mesh.h"
+
+#define MESH_MAX_MESHES 32
+#define MESH_MAX_FRAMES 3
+#define MESH_INITIAL_INSTANCES 1024
+#define MESH_DEPTH_FORMAT VK_FORMAT_D32_SFLOAT
+#define MESH_TASK_GROUP_SIZE 32  // meshlets tested per task shader workgroup
+#define MESH_CULL_GROUP_SIZE 64  // meshlets tested per compute workgroup
+#define MESH_HIZ_FORMAT VK_FORMAT_R32_SFLOAT
+#define MESH_HIZ_MAX_LEVELS 16
+
+// Occlusion phases: instances visible in the previous frame's depth pyramid
+// are drawn early, the ones the rebuilt pyramid disoccludes late
+#define MESH_PHASE_EARLY 1
+#define MESH_PHASE_LATE 2
+
+// What gets submitted each frame
+typedef struct {
+  uint32_t mesh;
+  float position[3];
+  float scale;
+  float rotation;  // radians around +Y
+  uint32_t color;  // packed RGBA8 (0xAABBGGRR)
+} Mesh_Instance;
+
+// GPU layouts, mirrored in the meshlet shaders. An instance owns the
+// contiguous meshlet slots [drawOffset, drawOffset + meshletCount) of its
+// selected LOD; instances are written in drawOffset order.
+typedef struct {
+  float positionScale[4];
+  float sphere[4];  // world-space bounds
+  float cosYaw;
+  float sinYaw;
+  uint32_t color;
+  uint32_t firstMeshlet;
+  uint32_t meshletCount;
+  uint32_t drawOffset;
+  uint32_t pad[2];
+} Mesh_Gpu_Instance;
+
+typedef struct {
+  float viewProj[16];  // column-major, Vulkan clip space (y down, depth 0..1)
+  float planes[6][4];  // world-space frustum planes, normals pointing inwards
+  float position[4];
+  uint32_t slotCount;
+  uint32_t instanceCount;
+  uint32_t occlusionTest;  // 0 when the depth pyramid holds nothing usable
+  uint32_t pad;
+} Mesh_Camera_Data;
+
+// Written by the instance cull pass, read back once the frame is fenced
+typedef struct {
+  uint32_t tested;
+  uint32_t visibleEarly;
+  uint32_t visibleLate;
+  uint32_t pad;
+} Mesh_Occlusion_Counters;
+
+typedef struct {
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+} Mesh_Buffer;
+
+typedef struct {
+  Mesh_Buffer instances;
+  Mesh_Gpu_Instance *mappedInstances;
+  uint32_t instanceCapacity;
+  Mesh_Buffer camera;
+  Mesh_Camera_Data *mappedCamera;
+  Mesh_Buffer draws;  // VkDrawIndexedIndirectCommand per slot, written by the cull pass
+  uint32_t drawCapacity;
+  Mesh_Buffer visibility;  // occlusion phase per instance, instanceCapacity entries
+  Mesh_Buffer counters;
+  Mesh_Occlusion_Counters *mappedCounters;
+
+  VkDescriptorSet set;
+  bool descriptorsDirty;
+  uint32_t instanceCount;
+  uint32_t slotCount;
+  bool timed;    // timestamps were written for this slot
+  bool counted;  // the instance cull pass ran for this slot
+} Mesh_Frame;
+
+typedef struct {
+  Mesh_Lod lods[MESH_MAX_LODS];
+  uint32_t lodCount;
+  float center[3];
+  float radius;
+} Mesh_Info;
+
+// Meshlet renderer. LODs are picked per instance on the CPU from the
+// projected geometric error; meshlets are then frustum and normal-cone
+// culled on the GPU, either in a task shader feeding mesh shaders
+// (VK_EXT_mesh_shader) or in a compute pass writing indexed-indirect draws.
+// Whole instances are occlusion culled in two phases against a depth pyramid
+// (Hi-Z) it owns and rebuilds every frame between the phases. The early draw
+// clears the color target, the late one loads it.
+typedef struct Mesh_Renderer Mesh_Renderer;
+struct Mesh_Renderer {
+  Vulkan_Context *vk;
+  VkCommandPool commandPool;
+  bool useMeshShader;
+  bool dynamicRendering;
+
+  // Static geometry of every uploaded mesh, concatenated
+  Mesh_Buffer vertices;
+  Mesh_Buffer indices;
+  Mesh_Buffer meshlets;
+  Mesh_Buffer meshletVertices;
+  Mesh_Buffer meshletTriangles;
+  Mesh_Info meshes[MESH_MAX_MESHES];
+  uint32_t meshCount;
+
+  VkDescriptorSetLayout descriptorSetLayout;
+  VkDescriptorPool descriptorPool;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline cullPipeline;
+  VkPipeline drawPipeline;
+  VkShaderModule cullShaderModule;
+  VkShaderModule vertShaderModule;
+  VkShaderModule taskShaderModule;
+  VkShaderModule meshShaderModule;
+  VkShaderModule fragShaderModule;
+  VkPipeline instanceCullPipeline;
+  VkShaderModule instanceCullShaderModule;
+
+  // Depth pyramid, kept in VK_IMAGE_LAYOUT_GENERAL; one set per level build
+  VkImage hiz;
+  VkDeviceMemory hizMemory;
+  VkImageView hizView;
+  VkImageView hizLevelViews[MESH_HIZ_MAX_LEVELS];
+  uint32_t hizLevels;
+  VkExtent2D hizExtent;
+  VkExtent2D depthExtent;
+  bool hizValid;  // built at least once since it was (re)created
+  VkSampler hizSampler;
+  VkDescriptorSetLayout hizSetLayout;
+  VkDescriptorPool hizDescriptorPool;
+  VkDescriptorSet hizSets[MESH_HIZ_MAX_LEVELS];
+  VkPipelineLayout hizPipelineLayout;
+  VkPipeline hizPipeline;
+  VkShaderModule hizShaderModule;
+
+  // Render pass path only; the late draw loads what the early one cleared
+  VkRenderPass renderPass;
+  VkRenderPass loadRenderPass;
+  VkFramebuffer *framebuffers;
+  uint32_t framebufferCount;
+
+  float eye[3];
+  float target[3];
+  float fovY;
+  float zNear;
+  float zFar;
+  float lodThreshold;  // pixels of projected error a LOD may introduce
+  int32_t forceLod;    // < 0 selects by screen size
+  bool occlusion;      // false draws every instance in the early phase
+
+  // CPU side of the current frame
+  Mesh_Instance *pending;
+  uint32_t pendingCount;
+  uint32_t pendingCapacity;
+
+  Mesh_Frame frames[MESH_MAX_FRAMES];
+  uint32_t frameCount;
+
+  VkQueryPool queryPool;
+  float timestampPeriod;  // ns per tick, 0 when timestamps are unsupported
+  uint32_t maxDrawIndirectCount;
+
+  Profiler_Stat flushStat;  // LOD selection and upload
+  Profiler_Stat gpuStat;    // cull + draw, measured with timestamps
+  uint32_t lastInstances;
+  uint32_t lastMeshlets;
+  uint64_t lastTriangles;
+  // Occlusion counters of the most recently fenced frame
+  uint32_t lastTested;
+  uint32_t lastOccluded;
+  uint32_t lastDisoccluded;
+};
+
+// useMeshShader requires vk->meshShader; otherwise the indirect path is used
+bool mesh_renderer_create(Mesh_Renderer *mr, Vulkan_Context *vk, VkCommandPool commandPool, uint32_t framesInFlight,
+                          bool dynamicRendering, bool useMeshShader, VkFormat colorFormat);
+bool mesh_renderer_rebuild_pipelines(Mesh_Renderer *mr, VkFormat colorFormat);
+// Recreates the depth pyramid for depthView (sampled by the pyramid build);
+// render pass path: one framebuffer per color view, sharing depthView
+bool mesh_renderer_set_targets(Mesh_Renderer *mr, const VkImageView *colorViews, uint32_t count,
+                               VkImageView depthView, VkExtent2D extent);
+void mesh_renderer_destroy(Mesh_Renderer *mr);
+
+// Replaces all geometry; mesh ids are indices into meshes. Waits for the device.
+bool mesh_renderer_upload(Mesh_Renderer *mr, const Mesh_Meshlets *meshes, uint32_t count);
+
+void mesh_renderer_set_camera(Mesh_Renderer *mr, const float eye[3], const float target[3],
+                              float fovY, float zNear, float zFar);
+void mesh_renderer_push(Mesh_Renderer *mr, const Mesh_Instance *instance);
+
+// Selects LODs and writes the pending instances into the frame's slot. The
+// frame's fence must have been waited on.
+void mesh_renderer_flush(Mesh_Renderer *mr, uint32_t frame, VkExtent2D extent);
+
+// Compute pass marking the instances of a phase in the visibility buffer
+// (reads the depth pyramid); the indirect path also writes the draw buffer
+void mesh_renderer_record_cull(Mesh_Renderer *mr, VkCommandBuffer cmd, uint32_t frame, uint32_t phase);
+VkBuffer mesh_renderer_draw_buffer(Mesh_Renderer *mr, uint32_t frame);
+VkBuffer mesh_renderer_visibility_buffer(Mesh_Renderer *mr, uint32_t frame);
+// Begins and ends its own rendering scope on colorView + depthView; the
+// early phase clears both
+void mesh_renderer_record_draw(Mesh_Renderer *mr, VkCommandBuffer cmd, uint32_t frame, uint32_t phase,
+                               uint32_t imageIndex, VkImageView colorView, VkImageView depthView, VkExtent2D extent);
+// Compute pass rebuilding the depth pyramid from the sampled depth target
+void mesh_renderer_record_hiz(Mesh_Renderer *mr, VkCommandBuffer cmd);
+VkImage mesh_renderer_hiz_image(Mesh_Renderer *mr);
+
+#endif
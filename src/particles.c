@@ -0,0 +1,531 @@
+#include "particles.h"
+#include "color.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *kickoff_comp_path = "external/shaders/particle_kickoff.comp.spv";
+static const char *emit_comp_path = "external/shaders/particle_emit.comp.spv";
+static const char *simulate_comp_path = "external/shaders/particle_simulate.comp.spv";
+static const char *particle_vert_path = "external/shaders/particle.vert.spv";
+static const char *particle_frag_path = "external/shaders/particle.frag.spv";
+
+#define PARTICLE_BINDING_COUNT 4  // particles, indices, counters, stats
+#define PARTICLE_MAX_DT 0.1f      // a stall shouldn't fling everything off screen
+
+_Static_assert(sizeof(Particle_Gpu) == 24, "Particle_Gpu must match the std430 struct");
+_Static_assert(sizeof(Particle_Counters) == 64, "Particle_Counters must match the shaders");
+_Static_assert(sizeof(Particle_Params) == 80, "Particle_Params must match the push constant block");
+
+static const VkShaderStageFlags paramStages = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+
+// ========== RESOURCES ==========
+
+static void destroyBuffer(Particle_System *ps, Particle_Buffer *buffer) {
+  if (buffer->buffer != VK_NULL_HANDLE) vkDestroyBuffer(ps->vk->device, buffer->buffer, NULL);
+  if (buffer->memory != VK_NULL_HANDLE) vulkan_free_memory(ps->vk, buffer->memory);
+  buffer->buffer = VK_NULL_HANDLE;
+  buffer->memory = VK_NULL_HANDLE;
+}
+
+// Every slot starts on the dead list and both alive lists start empty
+static bool createState(Particle_System *ps) {
+  Vulkan_Context *vk = ps->vk;
+  VkDeviceSize particleSize = (VkDeviceSize)ps->capacity * sizeof(Particle_Gpu);
+  VkDeviceSize listSize = (VkDeviceSize)ps->capacity * sizeof(uint32_t);
+  if (!vulkan_create_buffer(vk, particleSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &ps->particles.buffer, &ps->particles.memory) ||
+      !vulkan_create_buffer(vk, 3 * listSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &ps->indices.buffer, &ps->indices.memory) ||
+      !vulkan_create_buffer(vk, sizeof(Particle_Counters),
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &ps->counters.buffer, &ps->counters.memory)) {
+    return false;
+  }
+
+  // The dead list and the counters, through one staging buffer
+  VkDeviceSize stagingSize = listSize + sizeof(Particle_Counters);
+  Particle_Buffer staging = {0};
+  void *mapped = NULL;
+  if (!vulkan_create_buffer(vk, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &staging.buffer, &staging.memory)) {
+    return false;
+  }
+  if (vkMapMemory(vk->device, staging.memory, 0, stagingSize, 0, &mapped) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to map particle staging buffer\n");
+    destroyBuffer(ps, &staging);
+    return false;
+  }
+  uint32_t *dead = mapped;
+  for (uint32_t i = 0; i < ps->capacity; i++) dead[i] = ps->capacity - 1 - i;  // popped from the end, so 0 first
+  Particle_Counters counters = {0};
+  counters.draws[0].instanceCount = 1;
+  counters.draws[1].instanceCount = 1;
+  counters.deadCount = ps->capacity;
+  memcpy((uint8_t *)mapped + listSize, &counters, sizeof(counters));
+  vkUnmapMemory(vk->device, staging.memory);
+
+  VkCommandBuffer cmd = vulkan_begin_one_time_commands(vk, ps->commandPool);
+  bool ok = cmd != VK_NULL_HANDLE;
+  if (ok) {
+    VkBufferCopy regions[2] = {{0}};
+    regions[0].size = listSize;
+    regions[1].srcOffset = listSize;
+    regions[1].size = sizeof(Particle_Counters);
+    vk->dispatch.vkCmdCopyBuffer(cmd, staging.buffer, ps->indices.buffer, 1, &regions[0]);
+    vk->dispatch.vkCmdCopyBuffer(cmd, staging.buffer, ps->counters.buffer, 1, &regions[1]);
+    ok = vulkan_end_one_time_commands(vk, ps->commandPool, cmd);
+  }
+  destroyBuffer(ps, &staging);
+  return ok;
+}
+
+static bool createDescriptors(Particle_System *ps) {
+  VkDevice device = ps->vk->device;
+  VkDescriptorSetLayoutBinding bindings[PARTICLE_BINDING_COUNT] = {{0}};
+  for (uint32_t i = 0; i < PARTICLE_BINDING_COUNT; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    // The point draw reads the particles through the alive list
+    bindings[i].stageFlags = i < 2 ? paramStages : VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = PARTICLE_BINDING_COUNT;
+  layoutInfo.pBindings = bindings;
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, NULL, &ps->descriptorSetLayout) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create particle descriptor set layout\n");
+    return false;
+  }
+
+  VkDescriptorPoolSize poolSize = {0};
+  poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  poolSize.descriptorCount = PARTICLE_BINDING_COUNT * PARTICLE_MAX_FRAMES;
+
+  VkDescriptorPoolCreateInfo poolInfo = {0};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+  poolInfo.maxSets = PARTICLE_MAX_FRAMES;
+  if (vkCreateDescriptorPool(device, &poolInfo, NULL, &ps->descriptorPool) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create particle descriptor pool\n");
+    return false;
+  }
+
+  // One set per slot for its stats; the state is shared
+  for (uint32_t i = 0; i < ps->frameCount; i++) {
+    Particle_Frame *frame = &ps->frames[i];
+    VkDescriptorSetAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = ps->descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &ps->descriptorSetLayout;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &frame->set) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to allocate particle descriptor set\n");
+      return false;
+    }
+
+    VkBuffer buffers[PARTICLE_BINDING_COUNT] = {
+      ps->particles.buffer, ps->indices.buffer, ps->counters.buffer, frame->stats.buffer,
+    };
+    VkDescriptorBufferInfo infos[PARTICLE_BINDING_COUNT] = {{0}};
+    VkWriteDescriptorSet writes[PARTICLE_BINDING_COUNT] = {{0}};
+    for (uint32_t b = 0; b < PARTICLE_BINDING_COUNT; b++) {
+      infos[b].buffer = buffers[b];
+      infos[b].range = VK_WHOLE_SIZE;
+      writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[b].dstSet = frame->set;
+      writes[b].dstBinding = b;
+      writes[b].descriptorCount = 1;
+      writes[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      writes[b].pBufferInfo = &infos[b];
+    }
+    vkUpdateDescriptorSets(device, PARTICLE_BINDING_COUNT, writes, 0, NULL);
+  }
+
+  VkPushConstantRange pushRange = {0};
+  pushRange.stageFlags = paramStages;
+  pushRange.size = sizeof(Particle_Params);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &ps->descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &ps->pipelineLayout) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create particle pipeline layout\n");
+    return false;
+  }
+  return true;
+}
+
+static VkShaderModule loadShader(Particle_System *ps, const char *path) {
+  size_t size;
+  char *code = readFile(path, &size);
+  if (!code) return VK_NULL_HANDLE;
+  VkShaderModule module = createShaderModule(code, size, ps->vk);
+  free(code);
+  return module;
+}
+
+// ========== PIPELINES ==========
+
+static bool createComputePipeline(Particle_System *ps, VkShaderModule module, const char *name, VkPipeline *pipeline) {
+  VkComputePipelineCreateInfo pipelineInfo = {0};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = module;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = ps->pipelineLayout;
+  pipelineInfo.basePipelineIndex = -1;
+
+  if (vkCreateComputePipelines(ps->vk->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, pipeline) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create %s pipeline\n", name);
+    return false;
+  }
+  return true;
+}
+
+bool particle_system_rebuild_pipeline(Particle_System *ps, VkRenderPass renderPass, VkFormat colorFormat) {
+  if (!ps || !ps->vk) return false;
+  if (ps->drawPipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(ps->vk->device, ps->drawPipeline, NULL);
+    ps->drawPipeline = VK_NULL_HANDLE;
+  }
+
+  VkPipelineShaderStageCreateInfo shaderStages[2] = {{0}, {0}};
+  shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  shaderStages[0].module = ps->vertShaderModule;
+  shaderStages[0].pName = "main";
+  shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  shaderStages[1].module = ps->fragShaderModule;
+  shaderStages[1].pName = "main";
+
+  // Positions come from the storage buffers
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo = {0};
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly = {0};
+  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+
+  VkPipelineViewportStateCreateInfo viewportState = {0};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer = {0};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.cullMode = VK_CULL_MODE_NONE;
+  rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling = {0};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.minSampleShading = 1.0f;
+
+  // Additive color, destination alpha untouched
+  VkPipelineColorBlendAttachmentState colorBlendAttachment = {0};
+  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.blendEnable = VK_TRUE;
+  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  VkPipelineColorBlendStateCreateInfo colorBlending = {0};
+  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.attachmentCount = 1;
+  colorBlending.pAttachments = &colorBlendAttachment;
+
+  VkDynamicState dynamicStates[] = {
+    VK_DYNAMIC_STATE_VIEWPORT,
+    VK_DYNAMIC_STATE_SCISSOR
+  };
+  VkPipelineDynamicStateCreateInfo dynamicState = {0};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
+
+  VkPipelineRenderingCreateInfo renderingInfo = {0};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachmentFormats = &colorFormat;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo = {0};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = renderPass == VK_NULL_HANDLE ? &renderingInfo : NULL;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = ps->pipelineLayout;
+  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.basePipelineIndex = -1;
+
+  if (vkCreateGraphicsPipelines(ps->vk->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &ps->drawPipeline) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create particle pipeline\n");
+    return false;
+  }
+  return true;
+}
+
+// ========== LIFETIME ==========
+
+bool particle_system_create(Particle_System *ps, Vulkan_Context *vk, VkCommandPool commandPool,
+                            uint32_t framesInFlight, uint32_t capacity, VkRenderPass renderPass,
+                            VkFormat colorFormat) {
+  if (!ps || !vk || framesInFlight == 0 || framesInFlight > PARTICLE_MAX_FRAMES || capacity == 0) return false;
+
+  memset(ps, 0, sizeof(*ps));
+  ps->vk = vk;
+  ps->commandPool = commandPool;
+  ps->frameCount = framesInFlight;
+  if (capacity > PARTICLE_MAX_CAPACITY) {
+    printf(YELLOW "[WARNING] " RESET "particle capacity clamped to %u\n", PARTICLE_MAX_CAPACITY);
+    capacity = PARTICLE_MAX_CAPACITY;
+  }
+  ps->capacity = capacity;
+
+  // A fountain that about fills the capacity at its average lifetime
+  Particle_Emitter *emitter = &ps->emitter;
+  emitter->direction = -1.5707963f;
+  emitter->spread = 0.6f;
+  emitter->speed[0] = 200.0f;
+  emitter->speed[1] = 500.0f;
+  emitter->lifetime[0] = 1.0f;
+  emitter->lifetime[1] = 3.0f;
+  emitter->gravity[1] = 300.0f;
+  emitter->drag = 0.1f;
+  emitter->rate = (float)capacity * 0.45f;
+  emitter->colorStart = 0xFF40C0FF;
+  emitter->colorEnd = 0x00FF2010;
+  ps->params.seed = 0x9E3779B9u;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(vk->physicalDevice, &properties);
+  if (properties.limits.timestampComputeAndGraphics) {
+    VkQueryPoolCreateInfo queryInfo = {0};
+    queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = 2 * PARTICLE_MAX_FRAMES;
+    if (vkCreateQueryPool(vk->device, &queryInfo, NULL, &ps->queryPool) == VK_SUCCESS) {
+      ps->timestampPeriod = properties.limits.timestampPeriod;
+    }
+  }
+
+  if (!createState(ps)) return false;
+  for (uint32_t i = 0; i < ps->frameCount; i++) {
+    Particle_Frame *frame = &ps->frames[i];
+    void *mapped = NULL;
+    if (!vulkan_create_buffer(vk, sizeof(Particle_Stats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &frame->stats.buffer, &frame->stats.memory)) {
+      return false;
+    }
+    if (vkMapMemory(vk->device, frame->stats.memory, 0, sizeof(Particle_Stats), 0, &mapped) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to map particle stats buffer\n");
+      return false;
+    }
+    frame->mappedStats = mapped;
+    memset(frame->mappedStats, 0, sizeof(Particle_Stats));
+  }
+  if (!createDescriptors(ps)) return false;
+
+  ps->kickoffShaderModule = loadShader(ps, kickoff_comp_path);
+  ps->emitShaderModule = loadShader(ps, emit_comp_path);
+  ps->simulateShaderModule = loadShader(ps, simulate_comp_path);
+  ps->vertShaderModule = loadShader(ps, particle_vert_path);
+  ps->fragShaderModule = loadShader(ps, particle_frag_path);
+  if (!ps->kickoffShaderModule || !ps->emitShaderModule || !ps->simulateShaderModule ||
+      !ps->vertShaderModule || !ps->fragShaderModule) {
+    return false;
+  }
+  if (!createComputePipeline(ps, ps->kickoffShaderModule, "particle kickoff", &ps->kickoffPipeline) ||
+      !createComputePipeline(ps, ps->emitShaderModule, "particle emit", &ps->emitPipeline) ||
+      !createComputePipeline(ps, ps->simulateShaderModule, "particle simulate", &ps->simulatePipeline) ||
+      !particle_system_rebuild_pipeline(ps, renderPass, colorFormat)) {
+    return false;
+  }
+
+  printf(GREEN "[OK] " RESET "Particle System (%u particles, %.1f MB)\n", ps->capacity,
+         (double)ps->capacity * (sizeof(Particle_Gpu) + 3 * sizeof(uint32_t)) / (1024.0 * 1024.0));
+  return true;
+}
+
+void particle_system_destroy(Particle_System *ps) {
+  if (!ps || !ps->vk) return;
+  VkDevice device = ps->vk->device;
+
+  particle_system_print_stats(ps);
+
+  for (uint32_t i = 0; i < ps->frameCount; i++) {
+    Particle_Frame *frame = &ps->frames[i];
+    if (frame->mappedStats) vkUnmapMemory(device, frame->stats.memory);
+    destroyBuffer(ps, &frame->stats);
+  }
+  destroyBuffer(ps, &ps->particles);
+  destroyBuffer(ps, &ps->indices);
+  destroyBuffer(ps, &ps->counters);
+
+  if (ps->drawPipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, ps->drawPipeline, NULL);
+  if (ps->kickoffPipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, ps->kickoffPipeline, NULL);
+  if (ps->emitPipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, ps->emitPipeline, NULL);
+  if (ps->simulatePipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, ps->simulatePipeline, NULL);
+  if (ps->kickoffShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, ps->kickoffShaderModule, NULL);
+  if (ps->emitShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, ps->emitShaderModule, NULL);
+  if (ps->simulateShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, ps->simulateShaderModule, NULL);
+  if (ps->vertShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, ps->vertShaderModule, NULL);
+  if (ps->fragShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, ps->fragShaderModule, NULL);
+  if (ps->pipelineLayout != VK_NULL_HANDLE) vkDestroyPipelineLayout(device, ps->pipelineLayout, NULL);
+  if (ps->descriptorPool != VK_NULL_HANDLE) vkDestroyDescriptorPool(device, ps->descriptorPool, NULL);
+  if (ps->descriptorSetLayout != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(device, ps->descriptorSetLayout, NULL);
+  if (ps->queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, ps->queryPool, NULL);
+
+  memset(ps, 0, sizeof(*ps));
+}
+
+// ========== FRAME ==========
+
+void particle_system_flush(Particle_System *ps, uint32_t frameIndex, VkExtent2D extent) {
+  if (!ps || !ps->vk || frameIndex >= ps->frameCount) return;
+  Particle_Frame *frame = &ps->frames[frameIndex];
+
+  // Fence already waited: results are available, never block on them
+  if (frame->simulated) {
+    const Particle_Stats *stats = frame->mappedStats;
+    ps->lastAlive = stats->alive;
+    ps->lastEmitted = stats->emitted;
+    if (frame->timed) {
+      uint64_t ticks[2];
+      if (vkGetQueryPoolResults(ps->vk->device, ps->queryPool, frameIndex * 2, 2, sizeof(ticks), ticks,
+                                sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+        profiler_stat_add(&ps->gpuStat, (double)(ticks[1] - ticks[0]) * ps->timestampPeriod / 1000000.0);
+        ps->simulated += (uint64_t)stats->alive + stats->emitted;
+      }
+    }
+    frame->simulated = false;
+    frame->timed = false;
+  }
+
+  double now = profiler_now_ms();
+  float dt = ps->lastFlushMs > 0.0 ? (float)((now - ps->lastFlushMs) / 1000.0) : 1.0f / 60.0f;
+  ps->lastFlushMs = now;
+  if (ps->fixedDt > 0.0f) dt = ps->fixedDt;
+  if (dt > PARTICLE_MAX_DT) dt = PARTICLE_MAX_DT;
+
+  // Whole particles only; the remainder is owed to the next frame
+  const Particle_Emitter *emitter = &ps->emitter;
+  ps->emitCarry += (double)emitter->rate * dt;
+  uint32_t emit = ps->emitCarry < (double)ps->capacity ? (uint32_t)ps->emitCarry : ps->capacity;
+  ps->emitCarry = emit == ps->capacity ? 0.0 : ps->emitCarry - emit;
+
+  Particle_Params *params = &ps->params;
+  if (ps->swapLists) {
+    params->current = 1 - params->current;
+    ps->swapLists = false;
+  }
+  memcpy(params->emitter, emitter->position, sizeof(params->emitter));
+  memcpy(params->gravity, emitter->gravity, sizeof(params->gravity));
+  memcpy(params->speed, emitter->speed, sizeof(params->speed));
+  memcpy(params->lifetime, emitter->lifetime, sizeof(params->lifetime));
+  params->extent[0] = (float)(extent.width ? extent.width : 1);
+  params->extent[1] = (float)(extent.height ? extent.height : 1);
+  params->direction = emitter->direction;
+  params->spread = emitter->spread;
+  params->drag = emitter->drag;
+  params->dt = dt;
+  params->emitCount = emit;
+  params->capacity = ps->capacity;
+  params->seed = params->seed * 1664525u + 1013904223u;
+  params->colorStart = emitter->colorStart;
+  params->colorEnd = emitter->colorEnd;
+}
+
+static void stateBarrier(const Vulkan_Dispatch *vkd, VkCommandBuffer cmd, VkPipelineStageFlags srcStages) {
+  VkMemoryBarrier barrier = {0};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkd->vkCmdPipelineBarrier(cmd, srcStages, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                            0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+void particle_system_record_simulate(Particle_System *ps, VkCommandBuffer cmd, uint32_t frameIndex) {
+  if (!ps || !ps->vk || frameIndex >= ps->frameCount) return;
+  Particle_Frame *frame = &ps->frames[frameIndex];
+  const Vulkan_Dispatch *vkd = &ps->vk->dispatch;
+
+  if (ps->queryPool != VK_NULL_HANDLE) {
+    vkd->vkCmdResetQueryPool(cmd, ps->queryPool, frameIndex * 2, 2);
+    vkd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, ps->queryPool, frameIndex * 2);
+    frame->timed = true;
+  }
+
+  // The state persists: the previous frame's simulation and draw touched it last
+  stateBarrier(vkd, cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+
+  vkd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, ps->pipelineLayout, 0, 1, &frame->set, 0, NULL);
+  vkd->vkCmdPushConstants(cmd, ps->pipelineLayout, paramStages, 0, sizeof(Particle_Params), &ps->params);
+  vkd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, ps->kickoffPipeline);
+  vkd->vkCmdDispatch(cmd, 1, 1, 1);
+
+  // Sized by the kickoff, so the CPU never needs the counts
+  stateBarrier(vkd, cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+  vkd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, ps->emitPipeline);
+  vkd->vkCmdDispatchIndirect(cmd, ps->counters.buffer, offsetof(Particle_Counters, emitDispatch));
+
+  stateBarrier(vkd, cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+  vkd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, ps->simulatePipeline);
+  vkd->vkCmdDispatchIndirect(cmd, ps->counters.buffer, offsetof(Particle_Counters, simulateDispatch));
+
+  if (frame->timed) {
+    vkd->vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, ps->queryPool, frameIndex * 2 + 1);
+  }
+  frame->simulated = true;
+  ps->swapLists = true;
+}
+
+void particle_system_record_draw(Particle_System *ps, VkCommandBuffer cmd, uint32_t frameIndex) {
+  if (!ps || !ps->vk || frameIndex >= ps->frameCount || !ps->frames[frameIndex].simulated) return;
+  const Vulkan_Dispatch *vkd = &ps->vk->dispatch;
+
+  // The list the simulation just compacted into; its length is the vertex count
+  uint32_t next = 1 - ps->params.current;
+  vkd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ps->drawPipeline);
+  vkd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ps->pipelineLayout, 0, 1,
+                               &ps->frames[frameIndex].set, 0, NULL);
+  vkd->vkCmdPushConstants(cmd, ps->pipelineLayout, paramStages, 0, sizeof(Particle_Params), &ps->params);
+  vkd->vkCmdDrawIndirect(cmd, ps->counters.buffer,
+                         offsetof(Particle_Counters, draws) + next * sizeof(VkDrawIndirectCommand), 1,
+                         sizeof(VkDrawIndirectCommand));
+}
+
+void particle_system_print_stats(const Particle_System *ps) {
+  if (!ps || !ps->vk || ps->gpuStat.count == 0) return;
+  double gpuMs = ps->gpuStat.total;
+  printf(CYAN "[PROFILE] " RESET "particles: %u alive of %u, %llu simulated in %.2f ms of GPU time (%.0f per ms)\n",
+         ps->lastAlive, ps->capacity, (unsigned long long)ps->simulated, gpuMs,
+         gpuMs > 0.0 ? (double)ps->simulated / gpuMs : 0.0);
+  profiler_stat_print("particle gpu", &ps->gpuStat);
+}
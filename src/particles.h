@@ -0,0 +1,151 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "vulkan_init.h"
+#include "profiler.h"
+
+#define PARTICLE_MAX_FRAMES 3
+#define PARTICLE_GROUP_SIZE 256  // invocations per emit and simulate workgroup, as in the shaders
+#define PARTICLE_MAX_CAPACITY (65535u * PARTICLE_GROUP_SIZE)  // one dispatch dimension's worth of groups
+
+// GPU layouts, mirrored in the particle shaders
+typedef struct {
+  float position[2];  // pixels, y down
+  float velocity[2];  // pixels per second
+  float life;         // seconds left
+  float lifetime;
+} Particle_Gpu;
+
+// Everything the GPU decides for itself. draws[i].vertexCount is the length
+// of alive list i; the kickoff pass fills the dispatches.
+typedef struct {
+  VkDrawIndirectCommand draws[2];
+  VkDispatchIndirectCommand emitDispatch;
+  VkDispatchIndirectCommand simulateDispatch;
+  uint32_t deadCount;
+  uint32_t emitCount;  // requested emission clamped to the free slots
+} Particle_Counters;
+
+// Written by the kickoff pass, read back once the frame is fenced
+typedef struct {
+  uint32_t alive;    // before this frame's simulation
+  uint32_t emitted;
+  uint32_t dead;
+  uint32_t pad;
+} Particle_Stats;
+
+// Push constants shared by every particle stage
+typedef struct {
+  float emitter[2];
+  float gravity[2];
+  float speed[2];     // min, max
+  float lifetime[2];  // min, max
+  float extent[2];    // pixels the positions map onto
+  float direction;    // radians, 0 along +x
+  float spread;       // radians around direction
+  float drag;         // share of velocity lost per second
+  float dt;
+  uint32_t emitCount;
+  uint32_t capacity;
+  uint32_t current;  // alive list being simulated; the other is drawn
+  uint32_t seed;
+  uint32_t colorStart;  // packed RGBA8 (0xAABBGGRR), blended additively
+  uint32_t colorEnd;
+} Particle_Params;
+
+typedef struct {
+  float position[2];
+  float direction;
+  float spread;
+  float speed[2];
+  float lifetime[2];
+  float gravity[2];
+  float drag;
+  float rate;  // particles per second
+  uint32_t colorStart;
+  uint32_t colorEnd;
+} Particle_Emitter;
+
+typedef struct {
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+} Particle_Buffer;
+
+typedef struct {
+  Particle_Buffer stats;
+  Particle_Stats *mappedStats;
+  VkDescriptorSet set;
+  bool timed;      // timestamps were written for this slot
+  bool simulated;  // the kickoff wrote stats for this slot
+} Particle_Frame;
+
+// Emission, simulation and compaction run entirely in compute. A particle
+// slot is either on the dead list or on one of two alive lists; each frame
+// a kickoff invocation sizes the indirect dispatches, emission pops dead
+// slots onto the current alive list, and simulation either returns a slot to
+// the dead list or compacts it into the other alive list, whose length is
+// the vertex count of the indirect point draw. The CPU only pushes the
+// emitter parameters and an emission count.
+typedef struct {
+  Vulkan_Context *vk;
+  VkCommandPool commandPool;
+  uint32_t capacity;
+
+  Particle_Emitter emitter;
+  float fixedDt;  // > 0 replaces the measured frame time (benchmarks)
+
+  Particle_Buffer particles;  // capacity Particle_Gpu
+  Particle_Buffer indices;    // dead list, alive list 0, alive list 1; capacity each
+  Particle_Buffer counters;   // Particle_Counters, also the indirect arguments
+
+  VkDescriptorSetLayout descriptorSetLayout;
+  VkDescriptorPool descriptorPool;
+  VkPipelineLayout pipelineLayout;
+  VkShaderModule kickoffShaderModule;
+  VkShaderModule emitShaderModule;
+  VkShaderModule simulateShaderModule;
+  VkShaderModule vertShaderModule;
+  VkShaderModule fragShaderModule;
+  VkPipeline kickoffPipeline;
+  VkPipeline emitPipeline;
+  VkPipeline simulatePipeline;
+  VkPipeline drawPipeline;
+
+  Particle_Params params;  // for the frame being recorded
+  bool swapLists;          // a simulation was recorded; the next frame simulates what it drew
+  double emitCarry;        // fractional particles owed to the next frame
+  double lastFlushMs;
+
+  Particle_Frame frames[PARTICLE_MAX_FRAMES];
+  uint32_t frameCount;
+
+  VkQueryPool queryPool;
+  float timestampPeriod;  // ns per tick, 0 when timestamps are unsupported
+
+  Profiler_Stat gpuStat;  // kickoff + emit + simulate, measured with timestamps
+  uint64_t simulated;     // particles the timed frames simulated
+  uint32_t lastAlive;
+  uint32_t lastEmitted;
+} Particle_System;
+
+// renderPass is the pass the points are drawn in, VK_NULL_HANDLE for dynamic
+// rendering. capacity is clamped to PARTICLE_MAX_CAPACITY.
+bool particle_system_create(Particle_System *ps, Vulkan_Context *vk, VkCommandPool commandPool,
+                            uint32_t framesInFlight, uint32_t capacity, VkRenderPass renderPass,
+                            VkFormat colorFormat);
+bool particle_system_rebuild_pipeline(Particle_System *ps, VkRenderPass renderPass, VkFormat colorFormat);
+void particle_system_destroy(Particle_System *ps);
+
+// Once the slot's fence is waited on: reads its stats and timing and turns
+// the emitter into this frame's parameters. extent is what positions map onto.
+void particle_system_flush(Particle_System *ps, uint32_t frameIndex, VkExtent2D extent);
+// Kickoff, emission and simulation; outside of any render pass
+void particle_system_record_simulate(Particle_System *ps, VkCommandBuffer cmd, uint32_t frameIndex);
+// Inside a color pass over the target, after record_simulate
+void particle_system_record_draw(Particle_System *ps, VkCommandBuffer cmd, uint32_t frameIndex);
+void particle_system_print_stats(const Particle_System *ps);
+
+#endif
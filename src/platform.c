@@ -3,9 +3,43 @@
 #include <GLFW/glfw3.h>
 #include <stdio.h>
 
+// GLFW is initialized with the first window and terminated with the last
+static uint32_t windowCount;
+
+static void framebufferResizeCallback(GLFWwindow *window, int width, int height) {
+  Platform_Context *ctx = glfwGetWindowUserPointer(window);
+  if (!ctx) return;
+  ctx->width = (uint32_t)width;
+  ctx->height = (uint32_t)height;
+  ctx->framebufferResized = true;
+  atomic_store(&ctx->redrawRequested, true);
+}
+
+static void windowRefreshCallback(GLFWwindow *window) {
+  Platform_Context *ctx = glfwGetWindowUserPointer(window);
+  if (!ctx) return;
+  atomic_store(&ctx->redrawRequested, true);
+}
+
+static void cursorPosCallback(GLFWwindow *window, double x, double y) {
+  Platform_Context *ctx = glfwGetWindowUserPointer(window);
+  if (!ctx) return;
+  ctx->cursorX = (float)x;
+  ctx->cursorY = (float)y;
+  atomic_store(&ctx->redrawRequested, true);
+}
+
+static void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods) {
+  (void)mods;
+  Platform_Context *ctx = glfwGetWindowUserPointer(window);
+  if (!ctx || button != GLFW_MOUSE_BUTTON_LEFT) return;
+  ctx->mouseDown = action == GLFW_PRESS;
+  atomic_store(&ctx->redrawRequested, true);
+}
+
 bool platform_create(Platform_Context *ctx, uint32_t w, uint32_t h, const char *t) {
   if (!ctx) return false;
-  if (!glfwInit()) {
+  if (windowCount == 0 && !glfwInit()) {
     printf(RED "[ERROR] " RESET "failed to initialize glfw\n");
     return false;
   }
@@ -20,6 +54,14 @@ bool platform_create(Platform_Context *ctx, uint32_t w, uint32_t h, const char *
   ctx->width = w;
   ctx->height = h;
   ctx->title = t;
+  ctx->framebufferResized = false;
+  atomic_store(&ctx->redrawRequested, true);
+  glfwSetWindowUserPointer(ctx->window, ctx);
+  glfwSetFramebufferSizeCallback(ctx->window, framebufferResizeCallback);
+  glfwSetCursorPosCallback(ctx->window, cursorPosCallback);
+  glfwSetMouseButtonCallback(ctx->window, mouseButtonCallback);
+  glfwSetWindowRefreshCallback(ctx->window, windowRefreshCallback);
+  windowCount++;
   printf(GREEN "[OK] " RESET "window\n");
   return true;
 }
@@ -33,8 +75,44 @@ void platform_events(void) {
   glfwPollEvents();
 }
 
-void platform_destroy(Platform_Context *ctx) {
+void platform_wait_events(void) {
+  glfwWaitEvents();
+}
+
+void platform_wait_events_timeout(double seconds) {
+  glfwWaitEventsTimeout(seconds);
+}
+
+void platform_request_redraw(Platform_Context *ctx) {
+  if (!ctx) return;
+  atomic_store(&ctx->redrawRequested, true);
+  glfwPostEmptyEvent();
+}
+
+bool platform_take_redraw(Platform_Context *ctx) {
+  if (!ctx) return false;
+  return atomic_exchange(&ctx->redrawRequested, false);
+}
+
+void platform_framebuffer_size(Platform_Context *ctx, uint32_t *w, uint32_t *h) {
   if (!ctx) return;
+  int width = 0, height = 0;
+  glfwGetFramebufferSize(ctx->window, &width, &height);
+  *w = (uint32_t)width;
+  *h = (uint32_t)height;
+}
+
+// Asks the window system for a new size; the framebuffer follows once the
+// resulting events have been processed.
+void platform_set_size(Platform_Context *ctx, uint32_t w, uint32_t h) {
+  if (!ctx) return;
+  glfwSetWindowSize(ctx->window, (int)w, (int)h);
+  glfwPollEvents();
+}
+
+void platform_destroy(Platform_Context *ctx) {
+  if (!ctx || !ctx->window) return;
   glfwDestroyWindow(ctx->window);
-  glfwTerminate();
+  ctx->window = NULL;
+  if (--windowCount == 0) glfwTerminate();
 }
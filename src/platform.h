@@ -3,6 +3,7 @@
 
 #define GLFW_INCLUDE_VULKAN
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <GLFW/glfw3.h>
@@ -15,11 +16,28 @@ struct Platform_Context {
   const char *title;
 
   GLFWwindow *window;
+  bool framebufferResized;
+
+  // Updated by platform_events(); window coordinates
+  float cursorX;
+  float cursorY;
+  bool mouseDown;
+
+  // Set by input, resize and expose events, or platform_request_redraw()
+  atomic_bool redrawRequested;
 };
 
 bool platform_create(Platform_Context *ctx, uint32_t w, uint32_t h, const char * title);
 bool platform_should_close(Platform_Context *ctx);
 void platform_events(void);
+void platform_wait_events(void);
+void platform_wait_events_timeout(double seconds);
+// Thread safe; wakes a thread blocked in platform_wait_events*()
+void platform_request_redraw(Platform_Context *ctx);
+// Returns whether a redraw was requested since the last call
+bool platform_take_redraw(Platform_Context *ctx);
+void platform_framebuffer_size(Platform_Context *ctx, uint32_t *w, uint32_t *h);
+void platform_set_size(Platform_Context *ctx, uint32_t w, uint32_t h);
 void platform_destroy(Platform_Context *ctx);
 
 #endif
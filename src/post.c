@@ -0,0 +1,419 @@
+#include "post.h"
+#include "color.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *shader_paths[POST_PASS_BLIT] = {
+  "external/shaders/post_bloom_down.comp.spv",
+  "external/shaders/post_bloom_blur.comp.spv",
+  "external/shaders/post_bloom_blur.comp.spv",
+  "external/shaders/post_composite.comp.spv",
+};
+
+static const char *op_names[] = {NULL, "exposure", "bloom", "tonemap", "grade", "vignette"};
+static const char *pass_names[POST_PASS_COUNT] = {"bloom down", "bloom blur x", "bloom blur y", "composite", "blit"};
+
+#define POST_BINDING_COUNT 3  // source, bloom (both sampled), destination (storage)
+#define POST_SET_COUNT (3 + POST_MAX_TARGETS)
+
+// Mirrored in the post shaders; the bloom passes only use the first fields
+typedef struct {
+  int32_t size[2];      // destination extent
+  float texel[2];       // 1 / source extent
+  float sceneScale[2];  // share of the HDR target holding the scene, per axis
+  float direction[2];   // blur axis in source texels
+  float threshold;
+  uint32_t ops;         // composite: Post_Op per nibble, first op lowest
+  uint32_t opCount;
+  uint32_t encodeSrgb;
+  float exposure;
+  float bloomStrength;
+  float contrast;
+  float saturation;
+  float vignette;
+} Post_Push_Constants;
+
+_Static_assert(sizeof(Post_Push_Constants) <= 128, "post push constants exceed the guaranteed minimum");
+
+// ========== CHAIN ==========
+
+static bool parseChain(Post_Context *post, const char *chain) {
+  const char *p = chain;
+  while (*p) {
+    const char *end = strchr(p, ',');
+    size_t len = end ? (size_t)(end - p) : strlen(p);
+    Post_Op op = 0;
+    for (uint32_t i = POST_OP_EXPOSURE; i <= POST_OP_VIGNETTE; i++) {
+      if (strlen(op_names[i]) == len && strncmp(op_names[i], p, len) == 0) op = (Post_Op)i;
+    }
+    if (op == 0) {
+      printf(RED "[ERROR] " RESET "unknown post effect '%.*s'\n", (int)len, p);
+      return false;
+    }
+    for (uint32_t i = 0; i < post->opCount; i++) {
+      if (post->ops[i] == op) {
+        printf(RED "[ERROR] " RESET "post effect '%s' listed twice\n", op_names[op]);
+        return false;
+      }
+    }
+    post->ops[post->opCount++] = op;
+    if (op == POST_OP_BLOOM) post->bloom = true;
+    if (!end) break;
+    p = end + 1;
+  }
+  if (post->opCount == 0) {
+    printf(RED "[ERROR] " RESET "empty post chain\n");
+    return false;
+  }
+  return true;
+}
+
+const char *post_pass_name(Post_Pass pass) {
+  return pass < POST_PASS_COUNT ? pass_names[pass] : "?";
+}
+
+bool post_storage_format(Vulkan_Context *vk, VkFormat format) {
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(vk->physicalDevice, format, &properties);
+  return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+}
+
+// ========== DESCRIPTORS ==========
+
+static bool createDescriptors(Post_Context *post) {
+  VkDevice device = post->vk->device;
+
+  VkSamplerCreateInfo samplerInfo = {0};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  if (vkCreateSampler(device, &samplerInfo, NULL, &post->sampler) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create post sampler\n");
+    return false;
+  }
+
+  VkDescriptorSetLayoutBinding bindings[POST_BINDING_COUNT] = {{0}};
+  for (uint32_t i = 0; i < POST_BINDING_COUNT; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = i < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = POST_BINDING_COUNT;
+  layoutInfo.pBindings = bindings;
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, NULL, &post->setLayout) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create post set layout\n");
+    return false;
+  }
+
+  VkDescriptorPoolSize poolSizes[2] = {{0}};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = 2 * POST_SET_COUNT;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  poolSizes[1].descriptorCount = POST_SET_COUNT;
+  VkDescriptorPoolCreateInfo poolInfo = {0};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = 2;
+  poolInfo.pPoolSizes = poolSizes;
+  poolInfo.maxSets = POST_SET_COUNT;
+  if (vkCreateDescriptorPool(device, &poolInfo, NULL, &post->descriptorPool) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create post descriptor pool\n");
+    return false;
+  }
+
+  // Allocated once; post_set_targets only rewrites them
+  VkDescriptorSetLayout layouts[POST_SET_COUNT];
+  VkDescriptorSet sets[POST_SET_COUNT];
+  for (uint32_t i = 0; i < POST_SET_COUNT; i++) layouts[i] = post->setLayout;
+  VkDescriptorSetAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = post->descriptorPool;
+  allocInfo.descriptorSetCount = POST_SET_COUNT;
+  allocInfo.pSetLayouts = layouts;
+  if (vkAllocateDescriptorSets(device, &allocInfo, sets) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to allocate post descriptor sets\n");
+    return false;
+  }
+  memcpy(post->bloomSets, sets, sizeof(post->bloomSets));
+  memcpy(post->compositeSets, sets + 3, sizeof(post->compositeSets));
+
+  VkPushConstantRange pushRange = {0};
+  pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushRange.size = sizeof(Post_Push_Constants);
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &post->setLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &post->pipelineLayout) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create post pipeline layout\n");
+    return false;
+  }
+  return true;
+}
+
+static void writeSet(Post_Context *post, VkDescriptorSet set, VkImageView src, VkImageView bloom, VkImageView dst) {
+  VkDescriptorImageInfo images[POST_BINDING_COUNT] = {
+    {post->sampler, src, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+    {post->sampler, bloom, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+    {VK_NULL_HANDLE, dst, VK_IMAGE_LAYOUT_GENERAL},
+  };
+  VkWriteDescriptorSet writes[POST_BINDING_COUNT] = {{0}};
+  for (uint32_t b = 0; b < POST_BINDING_COUNT; b++) {
+    writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[b].dstSet = set;
+    writes[b].dstBinding = b;
+    writes[b].descriptorCount = 1;
+    writes[b].descriptorType = b < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[b].pImageInfo = &images[b];
+  }
+  vkUpdateDescriptorSets(post->vk->device, POST_BINDING_COUNT, writes, 0, NULL);
+}
+
+// ========== LIFECYCLE ==========
+
+bool post_create(Post_Context *post, Vulkan_Context *vk, uint32_t framesInFlight, const char *chain) {
+  if (!post || !vk || !chain || framesInFlight == 0 || framesInFlight > POST_MAX_FRAMES) return false;
+
+  memset(post, 0, sizeof(*post));
+  post->vk = vk;
+  post->frameCount = framesInFlight;
+  post->settings.exposure = 1.0f;
+  post->settings.bloomThreshold = 1.0f;
+  post->settings.bloomStrength = 0.6f;
+  post->settings.contrast = 1.1f;
+  post->settings.saturation = 1.15f;
+  post->settings.vignette = 0.35f;
+  if (!parseChain(post, chain)) {
+    memset(post, 0, sizeof(*post));
+    return false;
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(vk->physicalDevice, &properties);
+  if (properties.limits.timestampComputeAndGraphics) {
+    VkQueryPoolCreateInfo queryInfo = {0};
+    queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = 2 * POST_PASS_COUNT * POST_MAX_FRAMES;
+    if (vkCreateQueryPool(vk->device, &queryInfo, NULL, &post->queryPool) == VK_SUCCESS) {
+      post->timestampPeriod = properties.limits.timestampPeriod;
+    }
+  }
+
+  if (!createDescriptors(post)) return false;
+
+  for (uint32_t i = 0; i < POST_PASS_BLIT; i++) {
+    if (!post->bloom && i != POST_PASS_COMPOSITE) continue;
+    if (i == POST_PASS_BLOOM_BLUR_Y) {
+      // Same shader as blur x, the direction is a push constant
+      post->pipelines[i] = post->pipelines[POST_PASS_BLOOM_BLUR_X];
+      continue;
+    }
+    size_t size;
+    char *code = readFile(shader_paths[i], &size);
+    if (!code) return false;
+    post->shaderModules[i] = createShaderModule(code, size, vk);
+    free(code);
+    if (post->shaderModules[i] == VK_NULL_HANDLE) return false;
+
+    VkComputePipelineCreateInfo pipelineInfo = {0};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = post->shaderModules[i];
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = post->pipelineLayout;
+    pipelineInfo.basePipelineIndex = -1;
+    if (vkCreateComputePipelines(vk->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &post->pipelines[i]) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to create post %s pipeline\n", pass_names[i]);
+      return false;
+    }
+  }
+
+  // What actually runs: neighbourhood effects need their own passes, the
+  // per-pixel ones collapse into the composite
+  char merged[128] = {0};
+  for (uint32_t i = 0; i < post->opCount; i++) {
+    if (i > 0) strncat(merged, "+", sizeof(merged) - strlen(merged) - 1);
+    strncat(merged, op_names[post->ops[i]], sizeof(merged) - strlen(merged) - 1);
+  }
+  printf(GREEN "[OK] " RESET "Post Chain (%s%s)\n", post->bloom ? "bloom down, blur x, blur y, " : "", merged);
+  return true;
+}
+
+void post_destroy(Post_Context *post) {
+  if (!post || !post->vk) return;
+  VkDevice device = post->vk->device;
+
+  for (uint32_t i = 0; i < POST_PASS_COUNT; i++) {
+    if (post->passStats[i].count == 0) continue;
+    char name[32];
+    snprintf(name, sizeof(name), "post %s", pass_names[i]);
+    profiler_stat_print(name, &post->passStats[i]);
+  }
+
+  for (uint32_t i = 0; i < POST_PASS_BLIT; i++) {
+    if (post->pipelines[i] != VK_NULL_HANDLE && i != POST_PASS_BLOOM_BLUR_Y) {
+      vkDestroyPipeline(device, post->pipelines[i], NULL);
+    }
+    if (post->shaderModules[i] != VK_NULL_HANDLE) vkDestroyShaderModule(device, post->shaderModules[i], NULL);
+  }
+  if (post->pipelineLayout != VK_NULL_HANDLE) vkDestroyPipelineLayout(device, post->pipelineLayout, NULL);
+  if (post->descriptorPool != VK_NULL_HANDLE) vkDestroyDescriptorPool(device, post->descriptorPool, NULL);
+  if (post->setLayout != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(device, post->setLayout, NULL);
+  if (post->sampler != VK_NULL_HANDLE) vkDestroySampler(device, post->sampler, NULL);
+  if (post->queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(device, post->queryPool, NULL);
+  memset(post, 0, sizeof(*post));
+}
+
+static bool isSrgb(VkFormat format) {
+  return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+bool post_set_targets(Post_Context *post, VkImageView hdrView, const VkImageView bloomViews[2],
+                      const VkImageView *dstViews, uint32_t dstCount, VkFormat dstFormat, bool direct,
+                      VkExtent2D extent) {
+  if (!post || !post->vk || dstCount == 0 || dstCount > POST_MAX_TARGETS) return false;
+
+  post->direct = direct;
+  // A blit into an sRGB image encodes on its own; a storage write never does
+  post->encodeSrgb = !isSrgb(dstFormat);
+  post->extent = extent;
+  post->sceneExtent = extent;
+  post->bloomExtent.width = extent.width > 1 ? extent.width / 2 : 1;
+  post->bloomExtent.height = extent.height > 1 ? extent.height / 2 : 1;
+
+  // Unused sampled bindings still need a valid view
+  VkImageView bloom = post->bloom ? bloomViews[0] : hdrView;
+  if (post->bloom) {
+    writeSet(post, post->bloomSets[0], hdrView, hdrView, bloomViews[0]);
+    writeSet(post, post->bloomSets[1], bloomViews[0], hdrView, bloomViews[1]);
+    writeSet(post, post->bloomSets[2], bloomViews[1], hdrView, bloomViews[0]);
+  }
+  for (uint32_t i = 0; i < dstCount; i++) {
+    writeSet(post, post->compositeSets[i], hdrView, bloom, dstViews[i]);
+  }
+  post->compositeSetCount = dstCount;
+  return true;
+}
+
+void post_set_scene_extent(Post_Context *post, VkExtent2D extent) {
+  if (!post || extent.width == 0 || extent.height == 0) return;
+  if (extent.width > post->extent.width) extent.width = post->extent.width;
+  if (extent.height > post->extent.height) extent.height = post->extent.height;
+  post->sceneExtent = extent;
+}
+
+static void setSceneScale(const Post_Context *post, Post_Push_Constants *push) {
+  push->sceneScale[0] = (float)post->sceneExtent.width / (float)post->extent.width;
+  push->sceneScale[1] = (float)post->sceneExtent.height / (float)post->extent.height;
+}
+
+// ========== FRAME ==========
+
+void post_flush(Post_Context *post, uint32_t frameIndex) {
+  if (!post || !post->vk || frameIndex >= post->frameCount) return;
+
+  // Fence already waited: results are available, never block on them
+  uint32_t timed = post->timed[frameIndex];
+  for (uint32_t pass = 0; pass < POST_PASS_COUNT; pass++) {
+    if (!(timed & (1u << pass))) continue;
+    uint64_t ticks[2];
+    uint32_t query = (frameIndex * POST_PASS_COUNT + pass) * 2;
+    if (vkGetQueryPoolResults(post->vk->device, post->queryPool, query, 2, sizeof(ticks), ticks,
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+      profiler_stat_add(&post->passStats[pass], (double)(ticks[1] - ticks[0]) * post->timestampPeriod / 1000000.0);
+    }
+  }
+  post->timed[frameIndex] = 0;
+}
+
+static void beginTiming(Post_Context *post, VkCommandBuffer cmd, uint32_t frameIndex, Post_Pass pass) {
+  if (post->queryPool == VK_NULL_HANDLE) return;
+  uint32_t query = (frameIndex * POST_PASS_COUNT + pass) * 2;
+  post->vk->dispatch.vkCmdResetQueryPool(cmd, post->queryPool, query, 2);
+  post->vk->dispatch.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, post->queryPool, query);
+  post->timed[frameIndex] |= 1u << pass;
+}
+
+static void endTiming(Post_Context *post, VkCommandBuffer cmd, uint32_t frameIndex, Post_Pass pass) {
+  if (post->queryPool == VK_NULL_HANDLE) return;
+  uint32_t query = (frameIndex * POST_PASS_COUNT + pass) * 2 + 1;
+  post->vk->dispatch.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, post->queryPool, query);
+}
+
+static void dispatchPass(Post_Context *post, VkCommandBuffer cmd, uint32_t frameIndex, Post_Pass pass,
+                         VkDescriptorSet set, const Post_Push_Constants *push) {
+  const Vulkan_Dispatch *vkd = &post->vk->dispatch;
+  beginTiming(post, cmd, frameIndex, pass);
+  vkd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, post->pipelines[pass]);
+  vkd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, post->pipelineLayout, 0, 1, &set, 0, NULL);
+  vkd->vkCmdPushConstants(cmd, post->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(*push), push);
+  vkd->vkCmdDispatch(cmd, ((uint32_t)push->size[0] + POST_GROUP_SIZE - 1) / POST_GROUP_SIZE,
+                     ((uint32_t)push->size[1] + POST_GROUP_SIZE - 1) / POST_GROUP_SIZE, 1);
+  endTiming(post, cmd, frameIndex, pass);
+}
+
+void post_record_bloom(Post_Context *post, VkCommandBuffer cmd, uint32_t frameIndex, Post_Pass pass) {
+  if (!post || !post->vk || !post->bloom || frameIndex >= post->frameCount || pass > POST_PASS_BLOOM_BLUR_Y) return;
+
+  // The down pass reads the full-size scene, the blurs the half-size targets
+  VkExtent2D src = pass == POST_PASS_BLOOM_DOWN ? post->extent : post->bloomExtent;
+  Post_Push_Constants push = {0};
+  push.size[0] = (int32_t)post->bloomExtent.width;
+  push.size[1] = (int32_t)post->bloomExtent.height;
+  push.texel[0] = 1.0f / (float)src.width;
+  push.texel[1] = 1.0f / (float)src.height;
+  push.direction[0] = pass == POST_PASS_BLOOM_BLUR_X ? 1.0f : 0.0f;
+  push.direction[1] = pass == POST_PASS_BLOOM_BLUR_Y ? 1.0f : 0.0f;
+  push.threshold = post->settings.bloomThreshold;
+  setSceneScale(post, &push);
+  dispatchPass(post, cmd, frameIndex, pass, post->bloomSets[pass], &push);
+}
+
+void post_record_composite(Post_Context *post, VkCommandBuffer cmd, uint32_t frameIndex, uint32_t dstIndex) {
+  if (!post || !post->vk || frameIndex >= post->frameCount || dstIndex >= post->compositeSetCount) return;
+
+  Post_Push_Constants push = {0};
+  push.size[0] = (int32_t)post->extent.width;
+  push.size[1] = (int32_t)post->extent.height;
+  push.texel[0] = 1.0f / (float)post->extent.width;
+  push.texel[1] = 1.0f / (float)post->extent.height;
+  setSceneScale(post, &push);
+  for (uint32_t i = 0; i < post->opCount; i++) push.ops |= (uint32_t)post->ops[i] << (4 * i);
+  push.opCount = post->opCount;
+  push.encodeSrgb = post->encodeSrgb;
+  push.exposure = post->settings.exposure;
+  push.bloomStrength = post->settings.bloomStrength;
+  push.contrast = post->settings.contrast;
+  push.saturation = post->settings.saturation;
+  push.vignette = post->settings.vignette;
+  dispatchPass(post, cmd, frameIndex, POST_PASS_COMPOSITE, post->compositeSets[dstIndex], &push);
+}
+
+void post_record_blit(Post_Context *post, VkCommandBuffer cmd, uint32_t frameIndex, VkImage src, VkImage dst) {
+  if (!post || !post->vk || frameIndex >= post->frameCount) return;
+
+  VkImageBlit region = {0};
+  region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.srcSubresource.layerCount = 1;
+  region.srcOffsets[1].x = (int32_t)post->extent.width;
+  region.srcOffsets[1].y = (int32_t)post->extent.height;
+  region.srcOffsets[1].z = 1;
+  region.dstSubresource = region.srcSubresource;
+  region.dstOffsets[1] = region.srcOffsets[1];
+  beginTiming(post, cmd, frameIndex, POST_PASS_BLIT);
+  post->vk->dispatch.vkCmdBlitImage(cmd, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+  endTiming(post, cmd, frameIndex, POST_PASS_BLIT);
+}
@@ -0,0 +1,107 @@
+#ifndef POST_H
+#define POST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "vulkan_init.h"
+#include "profiler.h"
+
+#define POST_HDR_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+#define POST_MAX_FRAMES 3
+#define POST_MAX_OPS 7        // 4 bits each in one push constant word
+#define POST_MAX_TARGETS 8    // composite destinations (swapchain images)
+#define POST_GROUP_SIZE 8     // 8x8 threads per workgroup in every post shader
+
+// Per-pixel effects, applied by the composite pass in the configured order.
+// Values are what the composite shader switches on.
+typedef enum {
+  POST_OP_EXPOSURE = 1,
+  POST_OP_BLOOM = 2,     // adds the blurred bright pass; also schedules the bloom passes
+  POST_OP_TONEMAP = 3,   // ACES fit, HDR -> [0, 1]
+  POST_OP_GRADE = 4,     // contrast and saturation
+  POST_OP_VIGNETTE = 5,
+} Post_Op;
+
+// GPU passes as they are recorded; each gets its own timing
+typedef enum {
+  POST_PASS_BLOOM_DOWN,
+  POST_PASS_BLOOM_BLUR_X,
+  POST_PASS_BLOOM_BLUR_Y,
+  POST_PASS_COMPOSITE,
+  POST_PASS_BLIT,
+  POST_PASS_COUNT,
+} Post_Pass;
+
+typedef struct {
+  float exposure;  // linear multiplier
+  float bloomThreshold;
+  float bloomStrength;
+  float contrast;
+  float saturation;
+  float vignette;  // darkening at the corners, 0 disables
+} Post_Settings;
+
+typedef struct {
+  Vulkan_Context *vk;
+  uint32_t frameCount;
+
+  Post_Op ops[POST_MAX_OPS];
+  uint32_t opCount;
+  bool bloom;
+  Post_Settings settings;
+
+  // Set by post_set_targets
+  bool direct;      // composite stores straight into the presentable image
+  bool encodeSrgb;  // destination is UNORM; the composite applies the sRGB curve
+  VkExtent2D extent;
+  VkExtent2D bloomExtent;
+  VkExtent2D sceneExtent;  // rendered corner of the HDR target, upscaled to extent
+
+  VkSampler sampler;
+  VkDescriptorSetLayout setLayout;
+  VkDescriptorPool descriptorPool;
+  VkDescriptorSet bloomSets[3];  // down, blur x, blur y
+  VkDescriptorSet compositeSets[POST_MAX_TARGETS];
+  uint32_t compositeSetCount;
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipelines[POST_PASS_BLIT];  // one per compute pass
+  VkShaderModule shaderModules[POST_PASS_BLIT];
+
+  // Two timestamps per pass per frame slot, read once the slot is fenced
+  VkQueryPool queryPool;
+  float timestampPeriod;
+  uint32_t timed[POST_MAX_FRAMES];  // bit per Post_Pass written this frame
+  Profiler_Stat passStats[POST_PASS_COUNT];
+} Post_Context;
+
+// chain is a comma separated list of exposure, bloom, tonemap, grade and
+// vignette; per-pixel effects are merged into a single composite dispatch.
+bool post_create(Post_Context *post, Vulkan_Context *vk, uint32_t framesInFlight, const char *chain);
+void post_destroy(Post_Context *post);
+
+// Called whenever the graph is recompiled. bloomViews are the two half-size
+// ping-pong targets (ignored without bloom); dstViews are written as storage
+// images, one composite set each, and dstFormat decides the sRGB encode.
+bool post_set_targets(Post_Context *post, VkImageView hdrView, const VkImageView bloomViews[2],
+                      const VkImageView *dstViews, uint32_t dstCount, VkFormat dstFormat, bool direct,
+                      VkExtent2D extent);
+
+// Dynamic resolution: the scene covers only this top-left part of the HDR
+// target; bloom and the composite sample it stretched over the full extent.
+// post_set_targets resets it to the full extent.
+void post_set_scene_extent(Post_Context *post, VkExtent2D extent);
+
+// Collects the timings of the frame slot last recorded; call once its fence is waited on
+void post_flush(Post_Context *post, uint32_t frameIndex);
+
+void post_record_bloom(Post_Context *post, VkCommandBuffer cmd, uint32_t frameIndex, Post_Pass pass);
+void post_record_composite(Post_Context *post, VkCommandBuffer cmd, uint32_t frameIndex, uint32_t dstIndex);
+// Blit path: src in TRANSFER_SRC_OPTIMAL, dst in TRANSFER_DST_OPTIMAL
+void post_record_blit(Post_Context *post, VkCommandBuffer cmd, uint32_t frameIndex, VkImage src, VkImage dst);
+
+// Whether a format can be the composite's storage destination
+bool post_storage_format(Vulkan_Context *vk, VkFormat format);
+const char *post_pass_name(Post_Pass pass);
+
+#endif
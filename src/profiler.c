@@ -0,0 +1,35 @@
+#include "profiler.h"
+#include "color.h"
+#include <stdio.h>
+#include <time.h>
+
+double profiler_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+double profiler_cpu_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+void profiler_stat_add(Profiler_Stat *stat, double ms) {
+  if (!stat) return;
+  if (stat->count == 0 || ms < stat->min) stat->min = ms;
+  if (stat->count == 0 || ms > stat->max) stat->max = ms;
+  stat->total += ms;
+  stat->count++;
+}
+
+double profiler_stat_avg(const Profiler_Stat *stat) {
+  if (!stat || stat->count == 0) return 0.0;
+  return stat->total / (double)stat->count;
+}
+
+void profiler_stat_print(const char *name, const Profiler_Stat *stat) {
+  if (!stat || stat->count == 0) return;
+  printf(CYAN "[PROFILE] " RESET "%s: avg %.3f ms, min %.3f ms, max %.3f ms (%llu samples)\n",
+         name, profiler_stat_avg(stat), stat->min, stat->max, (unsigned long long)stat->count);
+}
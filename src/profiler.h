@@ -0,0 +1,22 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+typedef struct {
+  uint64_t count;
+  double total;
+  double min;
+  double max;
+} Profiler_Stat;
+
+// Monotonic wall clock in milliseconds
+double profiler_now_ms(void);
+// CPU time consumed by the whole process (all threads) in milliseconds
+double profiler_cpu_ms(void);
+
+void profiler_stat_add(Profiler_Stat *stat, double ms);
+double profiler_stat_avg(const Profiler_Stat *stat);
+void profiler_stat_print(const char *name, const Profiler_Stat *stat);
+
+#endif
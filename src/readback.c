@@ -0,0 +1,636 @@
+#include "readback.h"
+#include "color.h"
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ========== ENCODERS ==========
+
+static uint32_t crcTable[256];
+static pthread_once_t crcOnce = PTHREAD_ONCE_INIT;
+
+static void initCrcTable(void) {
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    }
+    crcTable[n] = c;
+  }
+}
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+static void putBE32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static void writeChunk(FILE *file, const char *type, const uint8_t *data, uint32_t size) {
+  uint8_t header[8];
+  putBE32(header, size);
+  memcpy(header + 4, type, 4);
+  fwrite(header, 1, 8, file);
+  if (size) fwrite(data, 1, size, file);
+
+  uint32_t crc = crc32Update(0xFFFFFFFFu, (const uint8_t *)type, 4);
+  crc = crc32Update(crc, data, size) ^ 0xFFFFFFFFu;
+  uint8_t trailer[4];
+  putBE32(trailer, crc);
+  fwrite(trailer, 1, 4, file);
+}
+
+static bool reserveScratch(Readback_Context *rb, size_t size) {
+  if (rb->scratchSize >= size) return true;
+  uint8_t *scratch = realloc(rb->scratch, size);
+  if (!scratch) return false;
+  arena_note_heap_allocation();
+  rb->scratch = scratch;
+  rb->scratchSize = size;
+  return true;
+}
+
+// RGB rows, each prefixed with PNG filter type 0, into scratch. For PNG the
+// rows start after the zlib header so the IDAT can be built in place.
+static uint8_t *convertRows(Readback_Context *rb, const Readback_Slot *slot, size_t offset,
+                            bool filterByte, uint32_t channels) {
+  size_t rowSize = (size_t)slot->width * channels + (filterByte ? 1 : 0);
+  const uint8_t *src = slot->mapped;
+  uint8_t *dst = rb->scratch + offset;
+  uint32_t r = slot->bgra ? 2 : 0, b = slot->bgra ? 0 : 2;
+
+  for (uint32_t y = 0; y < slot->height; y++) {
+    uint8_t *row = dst + y * rowSize;
+    if (filterByte) *row++ = 0;
+    const uint8_t *in = src + (size_t)y * slot->width * 4;
+    for (uint32_t x = 0; x < slot->width; x++, in += 4) {
+      *row++ = in[r];
+      *row++ = in[1];
+      *row++ = in[b];
+      if (channels == 4) *row++ = in[3];
+    }
+  }
+  return dst;
+}
+
+static bool writePng(Readback_Context *rb, FILE *file, const Readback_Slot *slot) {
+  size_t rowSize = (size_t)slot->width * 3 + 1;
+  size_t raw = rowSize * slot->height;
+  size_t blocks = (raw + 65534) / 65535;
+  size_t zlibSize = 2 + blocks * 5 + raw + 4;
+  // Converted rows at the tail, stored blocks assembled at the front
+  if (!reserveScratch(rb, zlibSize + raw)) return false;
+  const uint8_t *rows = convertRows(rb, slot, zlibSize, true, 3);
+
+  uint8_t *z = rb->scratch;
+  *z++ = 0x78;
+  *z++ = 0x01;
+  uint32_t a = 1, b = 0;
+  for (size_t done = 0; done < raw;) {
+    size_t len = raw - done > 65535 ? 65535 : raw - done;
+    *z++ = done + len == raw ? 1 : 0;
+    *z++ = (uint8_t)len;
+    *z++ = (uint8_t)(len >> 8);
+    *z++ = (uint8_t)~len;
+    *z++ = (uint8_t)(~len >> 8);
+    memmove(z, rows + done, len);
+    for (size_t i = 0; i < len; i++) {
+      a = (a + z[i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    z += len;
+    done += len;
+  }
+  putBE32(z, (b << 16) | a);
+
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  fwrite(signature, 1, 8, file);
+  uint8_t ihdr[13] = {0};
+  putBE32(ihdr, slot->width);
+  putBE32(ihdr + 4, slot->height);
+  ihdr[8] = 8;  // bit depth
+  ihdr[9] = 2;  // RGB
+  writeChunk(file, "IHDR", ihdr, sizeof(ihdr));
+  writeChunk(file, "IDAT", rb->scratch, (uint32_t)zlibSize);
+  writeChunk(file, "IEND", NULL, 0);
+  return true;
+}
+
+static bool writeFrame(Readback_Context *rb, FILE *file, const Readback_Slot *slot) {
+  size_t pixels = (size_t)slot->width * slot->height;
+  switch (rb->config.format) {
+    case READBACK_FORMAT_RAW:
+      if (!reserveScratch(rb, pixels * 4)) return false;
+      fwrite(convertRows(rb, slot, 0, false, 4), 1, pixels * 4, file);
+      return true;
+    case READBACK_FORMAT_PPM:
+      if (!reserveScratch(rb, pixels * 3)) return false;
+      fprintf(file, "P6\n%u %u\n255\n", slot->width, slot->height);
+      fwrite(convertRows(rb, slot, 0, false, 3), 1, pixels * 3, file);
+      return true;
+    case READBACK_FORMAT_PNG:
+      return writePng(rb, file, slot);
+  }
+  return false;
+}
+
+// ========== WRITER THREAD ==========
+
+bool readback_parse_pattern(const char *path, Readback_Pattern *pattern) {
+  memset(pattern, 0, sizeof(*pattern));
+  char *out = pattern->prefix;
+  size_t length = 0;
+  bool found = false;
+  for (const char *c = path; *c; c++) {
+    if (*c == '%' && c[1] == '%') {
+      c++;
+    } else if (*c == '%') {
+      if (found) return false;
+      c++;
+      if (*c == '0') {
+        pattern->zeroPad = true;
+        c++;
+      }
+      while (*c >= '0' && *c <= '9') {
+        pattern->width = pattern->width * 10 + (*c - '0');
+        if (pattern->width > 64) return false;
+        c++;
+      }
+      if (*c != 'u' && *c != 'd' && *c != 'i') return false;
+      found = true;
+      out = pattern->suffix;
+      length = 0;
+      continue;
+    }
+    if (length + 1 >= READBACK_MAX_PATH) return false;
+    out[length++] = *c;
+  }
+  return found;
+}
+
+static void *writerMain(void *arg) {
+  Readback_Context *rb = arg;
+  char path[2 * READBACK_MAX_PATH + 32];
+
+  pthread_mutex_lock(&rb->mutex);
+  for (;;) {
+    while (rb->queueCount == 0 && !rb->quit) {
+      pthread_cond_wait(&rb->cond, &rb->mutex);
+    }
+    if (rb->queueCount == 0 && rb->quit) break;
+
+    uint32_t index = rb->queue[rb->queueHead];
+    rb->queueHead = (rb->queueHead + 1) % READBACK_SLOTS;
+    rb->queueCount--;
+    pthread_mutex_unlock(&rb->mutex);
+
+    // The slot is ours until it goes back to FREE, no lock needed
+    Readback_Slot *slot = &rb->slots[index];
+    double start = profiler_now_ms();
+    FILE *file = rb->stream;
+    if (rb->perFrameFiles) {
+      const Readback_Pattern *pattern = &rb->pattern;
+      snprintf(path, sizeof(path), pattern->zeroPad ? "%s%0*llu%s" : "%s%*llu%s", pattern->prefix, pattern->width,
+               (unsigned long long)slot->frameNumber, pattern->suffix);
+      file = fopen(path, "wb");
+      if (!file) printf(RED "[ERROR] " RESET "readback: failed to open %s\n", path);
+    }
+    if (file) {
+      if (!writeFrame(rb, file, slot)) printf(RED "[ERROR] " RESET "readback: failed to encode frame\n");
+      if (rb->perFrameFiles) fclose(file);
+      else fflush(file);
+    }
+    double elapsed = profiler_now_ms() - start;
+
+    pthread_mutex_lock(&rb->mutex);
+    profiler_stat_add(&rb->writeStat, elapsed);
+    rb->framesWritten++;
+    slot->state = READBACK_SLOT_FREE;
+    pthread_cond_broadcast(&rb->cond);
+  }
+  pthread_mutex_unlock(&rb->mutex);
+
+  return NULL;
+}
+
+// ========== SLOTS ==========
+
+static void destroySlot(Readback_Context *rb, Readback_Slot *slot) {
+  if (slot->memory != VK_NULL_HANDLE) {
+    vkUnmapMemory(rb->vk->device, slot->memory);
+    vulkan_free_memory(rb->vk, slot->memory);
+  }
+  if (slot->buffer != VK_NULL_HANDLE) vkDestroyBuffer(rb->vk->device, slot->buffer, NULL);
+  slot->buffer = VK_NULL_HANDLE;
+  slot->memory = VK_NULL_HANDLE;
+  slot->mapped = NULL;
+  slot->size = 0;
+  slot->imported = false;
+}
+
+// Binds the slot's buffer to its part of config.hostSlots, so the copy
+// writes straight into it
+static bool importSlot(Readback_Context *rb, Readback_Slot *slot) {
+  Vulkan_Context *vk = rb->vk;
+  VkDeviceSize size = rb->config.hostSlotStride;
+
+  VkExternalMemoryBufferCreateInfo externalInfo = {0};
+  externalInfo.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+  externalInfo.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+  VkBufferCreateInfo bufferInfo = {0};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.pNext = &externalInfo;
+  bufferInfo.size = size;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(vk->device, &bufferInfo, NULL, &slot->buffer) != VK_SUCCESS) return false;
+
+  VkMemoryHostPointerPropertiesEXT pointerProperties = {0};
+  pointerProperties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(vk->device, slot->buffer, &requirements);
+  if (vk->getMemoryHostPointerProperties(vk->device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+                                         slot->host, &pointerProperties) != VK_SUCCESS) {
+    return false;
+  }
+  uint32_t typeBits = requirements.memoryTypeBits & pointerProperties.memoryTypeBits;
+  VkMemoryPropertyFlags coherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  uint32_t type = findMemoryType(vk->physicalDevice, typeBits, coherent);
+  slot->coherent = type != UINT32_MAX;
+  if (type == UINT32_MAX) type = findMemoryType(vk->physicalDevice, typeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+  if (type == UINT32_MAX || requirements.size > size) return false;
+
+  VkImportMemoryHostPointerInfoEXT importInfo = {0};
+  importInfo.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+  importInfo.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+  importInfo.pHostPointer = slot->host;
+  VkMemoryAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.pNext = &importInfo;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = type;
+  if (vulkan_allocate_memory(vk, &allocInfo, &slot->memory) != VK_SUCCESS) return false;
+  vkBindBufferMemory(vk->device, slot->buffer, slot->memory, 0);
+
+  // Mapped only so non-coherent types can be invalidated; it aliases host
+  if (vkMapMemory(vk->device, slot->memory, 0, VK_WHOLE_SIZE, 0, &slot->mapped) != VK_SUCCESS) return false;
+  slot->size = size;
+  slot->imported = true;
+  return true;
+}
+
+static bool allocateSlot(Readback_Context *rb, Readback_Slot *slot, VkDeviceSize size) {
+  destroySlot(rb, slot);
+
+  if (slot->host && size > rb->config.hostSlotStride) {
+    printf(RED "[ERROR] " RESET "readback: %llu byte frame doesn't fit a %zu byte host slot\n",
+           (unsigned long long)size, rb->config.hostSlotStride);
+    return false;
+  }
+  if (rb->hostImport) {
+    if (importSlot(rb, slot)) return true;
+    printf(YELLOW "[WARNING] " RESET "readback: host memory import failed, copying instead\n");
+    destroySlot(rb, slot);
+    rb->hostImport = false;
+  }
+
+  // Cached memory makes the writer's reads fast; it is usually not coherent
+  VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+  VkMemoryPropertyFlags coherent = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  bool haveCached = findMemoryType(rb->vk->physicalDevice, UINT32_MAX, cached) != UINT32_MAX;
+
+  if (!vulkan_create_buffer(rb->vk, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, haveCached ? cached : coherent,
+                            &slot->buffer, &slot->memory)) {
+    return false;
+  }
+  slot->coherent = !haveCached;
+  if (vkMapMemory(rb->vk->device, slot->memory, 0, VK_WHOLE_SIZE, 0, &slot->mapped) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "readback: failed to map slot\n");
+    destroySlot(rb, slot);
+    return false;
+  }
+  slot->size = size;
+  return true;
+}
+
+static bool formatSupported(VkFormat format, bool *bgra) {
+  switch (format) {
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+      *bgra = true;
+      return true;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+      *bgra = false;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// ========== PUBLIC API ==========
+
+bool readback_create(Readback_Context *rb, Vulkan_Context *vk, const Readback_Config *config) {
+  if (!rb || !vk || !config || (!config->path && !config->sink)) return false;
+  memset(rb, 0, sizeof(*rb));
+  rb->vk = vk;
+  rb->config = *config;
+  for (uint32_t i = 0; i < READBACK_MAX_FRAMES; i++) rb->frameSlots[i] = -1;
+  // Several contexts may capture at once (batch mode)
+  pthread_once(&crcOnce, initCrcTable);
+
+  if (config->hostSlots) {
+    for (uint32_t i = 0; i < READBACK_SLOTS; i++) {
+      rb->slots[i].host = (uint8_t *)config->hostSlots + (size_t)i * config->hostSlotStride;
+    }
+    VkDeviceSize align = vk->hostPointerAlignment;
+    rb->hostImport = vk->externalMemoryHost && (uintptr_t)config->hostSlots % align == 0 &&
+                     config->hostSlotStride % align == 0;
+  }
+
+  if (config->sink) {
+    // Nothing to open; frames go to the sink
+  } else if (strcmp(config->path, "-") == 0) {
+    // Frames own stdout; everything the app prints goes to stderr instead
+    int fd = dup(STDOUT_FILENO);
+    if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+      printf(RED "[ERROR] " RESET "readback: failed to redirect stdout\n");
+      return false;
+    }
+    rb->stream = fdopen(fd, "wb");
+  } else if (strchr(config->path, '%')) {
+    if (!readback_parse_pattern(config->path, &rb->pattern)) {
+      printf(RED "[ERROR] " RESET "readback: %s needs exactly one frame number conversion such as %%u or %%05u "
+             "(%%%% for a literal percent)\n", config->path);
+      return false;
+    }
+    rb->perFrameFiles = true;
+  } else {
+    rb->stream = fopen(config->path, "wb");
+  }
+  if (!config->sink && !rb->perFrameFiles && !rb->stream) {
+    printf(RED "[ERROR] " RESET "readback: failed to open %s\n", config->path);
+    return false;
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(vk->physicalDevice, &properties);
+  if (properties.limits.timestampComputeAndGraphics) {
+    VkQueryPoolCreateInfo queryInfo = {0};
+    queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = 2 * READBACK_MAX_FRAMES;
+    if (vkCreateQueryPool(vk->device, &queryInfo, NULL, &rb->queryPool) == VK_SUCCESS) {
+      rb->timestampPeriod = properties.limits.timestampPeriod;
+    }
+  }
+
+  pthread_mutex_init(&rb->mutex, NULL);
+  pthread_cond_init(&rb->cond, NULL);
+  if (config->sink) {
+    printf(GREEN "[OK] " RESET "Readback (sink, %d slots%s)\n", READBACK_SLOTS,
+           !config->hostSlots ? "" : rb->hostImport ? ", imported host memory" : ", copied to host memory");
+    return true;
+  }
+  if (pthread_create(&rb->writer, NULL, writerMain, rb) != 0) {
+    printf(RED "[ERROR] " RESET "readback: failed to start writer thread\n");
+    return false;
+  }
+  rb->writerStarted = true;
+
+  static const char *formatNames[] = {"raw rgba", "ppm", "png"};
+  printf(GREEN "[OK] " RESET "Readback (%s -> %s, %d slots)\n",
+         formatNames[config->format], config->path, READBACK_SLOTS);
+  return true;
+}
+
+void readback_destroy(Readback_Context *rb) {
+  if (!rb || !rb->vk) return;
+
+  // The device is idle here, so every recorded copy has landed. A sink
+  // isn't handed frames while its owner tears down.
+  for (uint32_t f = 0; f < READBACK_MAX_FRAMES && !rb->config.sink; f++) {
+    readback_collect(rb, f);
+  }
+
+  if (rb->writerStarted) {
+    pthread_mutex_lock(&rb->mutex);
+    rb->quit = true;
+    pthread_cond_broadcast(&rb->cond);
+    pthread_mutex_unlock(&rb->mutex);
+    pthread_join(rb->writer, NULL);
+  }
+  if (rb->writerStarted || rb->config.sink) {
+    if (rb->framesQueued > 0) readback_print_stats(rb);
+    pthread_mutex_destroy(&rb->mutex);
+    pthread_cond_destroy(&rb->cond);
+  }
+
+  if (rb->stream) fclose(rb->stream);
+  for (uint32_t i = 0; i < READBACK_SLOTS; i++) destroySlot(rb, &rb->slots[i]);
+  if (rb->queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(rb->vk->device, rb->queryPool, NULL);
+  free(rb->scratch);
+  memset(rb, 0, sizeof(*rb));
+}
+
+int32_t readback_begin(Readback_Context *rb, uint32_t frameSlot, uint64_t frameNumber,
+                       VkExtent2D extent, VkFormat format) {
+  if (!rb || !rb->vk || frameSlot >= READBACK_MAX_FRAMES) return -1;
+  rb->frameSlots[frameSlot] = -1;
+
+  bool bgra = false;
+  if (!formatSupported(format, &bgra)) {
+    static bool warned = false;
+    if (!warned) printf(YELLOW "[WARNING] " RESET "readback: unsupported swapchain format %d\n", format);
+    warned = true;
+    return -1;
+  }
+
+  double start = profiler_now_ms();
+  pthread_mutex_lock(&rb->mutex);
+  int32_t index = -1;
+  for (;;) {
+    for (uint32_t i = 0; i < READBACK_SLOTS; i++) {
+      if (rb->slots[i].state == READBACK_SLOT_FREE) {
+        index = (int32_t)i;
+        break;
+      }
+    }
+    if (index >= 0) break;
+    if (rb->config.sink) {
+      // Slots come back through readback_release on this thread; waiting would never end
+      rb->skipped++;
+      pthread_mutex_unlock(&rb->mutex);
+      return -1;
+    }
+    // Every slot is with the writer: the encoder can't keep up
+    double stallStart = profiler_now_ms();
+    pthread_cond_wait(&rb->cond, &rb->mutex);
+    rb->stalls++;
+    profiler_stat_add(&rb->stallStat, profiler_now_ms() - stallStart);
+  }
+  Readback_Slot *slot = &rb->slots[index];
+  slot->state = READBACK_SLOT_GPU;
+  pthread_mutex_unlock(&rb->mutex);
+
+  VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 4;
+  if (slot->size < size && !allocateSlot(rb, slot, size)) {
+    slot->state = READBACK_SLOT_FREE;
+    return -1;
+  }
+  slot->frameSlot = frameSlot;
+  slot->frameNumber = frameNumber;
+  slot->width = extent.width;
+  slot->height = extent.height;
+  slot->bgra = bgra;
+  rb->frameSlots[frameSlot] = index;
+
+  slot->cpuMs = profiler_now_ms() - start;
+  return index;
+}
+
+VkBuffer readback_buffer(Readback_Context *rb, int32_t slot) {
+  if (!rb || slot < 0 || slot >= READBACK_SLOTS) return VK_NULL_HANDLE;
+  return rb->slots[slot].buffer;
+}
+
+void readback_record_copy(Readback_Context *rb, VkCommandBuffer cmd, uint32_t frameSlot, int32_t index, VkImage image) {
+  if (!rb || index < 0 || frameSlot >= READBACK_MAX_FRAMES) return;
+  Readback_Slot *slot = &rb->slots[index];
+
+  if (rb->queryPool != VK_NULL_HANDLE) {
+    rb->vk->dispatch.vkCmdResetQueryPool(cmd, rb->queryPool, frameSlot * 2, 2);
+    rb->vk->dispatch.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, rb->queryPool, frameSlot * 2);
+  }
+
+  VkBufferImageCopy region = {0};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent.width = slot->width;
+  region.imageExtent.height = slot->height;
+  region.imageExtent.depth = 1;
+  rb->vk->dispatch.vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+  VkBufferMemoryBarrier barrier = {0};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = slot->buffer;
+  barrier.offset = 0;
+  barrier.size = VK_WHOLE_SIZE;
+  rb->vk->dispatch.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                       0, 0, NULL, 1, &barrier, 0, NULL);
+
+  if (rb->queryPool != VK_NULL_HANDLE) {
+    rb->vk->dispatch.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, rb->queryPool, frameSlot * 2 + 1);
+  }
+}
+
+void readback_collect(Readback_Context *rb, uint32_t frameSlot) {
+  if (!rb || !rb->vk || frameSlot >= READBACK_MAX_FRAMES) return;
+  int32_t index = rb->frameSlots[frameSlot];
+  if (index < 0) return;
+  rb->frameSlots[frameSlot] = -1;
+
+  double start = profiler_now_ms();
+  Readback_Slot *slot = &rb->slots[index];
+
+  // Fence already waited: results are available, never block on them
+  if (rb->queryPool != VK_NULL_HANDLE) {
+    uint64_t ticks[2];
+    if (vkGetQueryPoolResults(rb->vk->device, rb->queryPool, frameSlot * 2, 2, sizeof(ticks), ticks,
+                              sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+      profiler_stat_add(&rb->gpuStat, (double)(ticks[1] - ticks[0]) * rb->timestampPeriod / 1000000.0);
+    }
+  }
+
+  if (!slot->coherent) {
+    VkMappedMemoryRange range = {0};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = slot->memory;
+    range.offset = 0;
+    range.size = VK_WHOLE_SIZE;
+    rb->vk->dispatch.vkInvalidateMappedMemoryRanges(rb->vk->device, 1, &range);
+  }
+
+  if (slot->host && !slot->imported) {
+    double copyStart = profiler_now_ms();
+    memcpy(slot->host, slot->mapped, (size_t)slot->width * slot->height * 4);
+    profiler_stat_add(&rb->copyStat, profiler_now_ms() - copyStart);
+  }
+
+  double cpuMs = slot->cpuMs + profiler_now_ms() - start;
+
+  if (rb->config.sink) {
+    pthread_mutex_lock(&rb->mutex);
+    profiler_stat_add(&rb->cpuStat, cpuMs);
+    slot->state = READBACK_SLOT_SINK;
+    rb->framesQueued++;
+    pthread_mutex_unlock(&rb->mutex);
+    rb->config.sink(rb, index, rb->config.sinkData);
+    return;
+  }
+
+  pthread_mutex_lock(&rb->mutex);
+  profiler_stat_add(&rb->cpuStat, cpuMs);
+  slot->state = READBACK_SLOT_QUEUED;
+  rb->queue[(rb->queueHead + rb->queueCount) % READBACK_SLOTS] = (uint32_t)index;
+  rb->queueCount++;
+  rb->framesQueued++;
+  pthread_cond_broadcast(&rb->cond);
+  pthread_mutex_unlock(&rb->mutex);
+}
+
+void readback_release(Readback_Context *rb, int32_t index) {
+  if (!rb || !rb->vk || index < 0 || index >= READBACK_SLOTS) return;
+  pthread_mutex_lock(&rb->mutex);
+  if (rb->slots[index].state == READBACK_SLOT_SINK) {
+    rb->slots[index].state = READBACK_SLOT_FREE;
+    rb->framesWritten++;
+  }
+  pthread_mutex_unlock(&rb->mutex);
+}
+
+uint32_t readback_free_slots(Readback_Context *rb) {
+  if (!rb || !rb->vk) return 0;
+  uint32_t count = 0;
+  pthread_mutex_lock(&rb->mutex);
+  for (uint32_t i = 0; i < READBACK_SLOTS; i++) {
+    if (rb->slots[i].state == READBACK_SLOT_FREE) count++;
+  }
+  pthread_mutex_unlock(&rb->mutex);
+  return count;
+}
+
+void readback_print_stats(Readback_Context *rb) {
+  if (!rb || !rb->vk) return;
+  pthread_mutex_lock(&rb->mutex);
+  if (rb->config.sink) {
+    printf(CYAN "[PROFILE] " RESET "readback: %llu frames handed over, %llu released, %llu skipped (no free slot)\n",
+           (unsigned long long)rb->framesQueued, (unsigned long long)rb->framesWritten,
+           (unsigned long long)rb->skipped);
+  } else {
+    printf(CYAN "[PROFILE] " RESET "readback: %llu frames queued, %llu written, %llu writer stalls\n",
+           (unsigned long long)rb->framesQueued, (unsigned long long)rb->framesWritten,
+           (unsigned long long)rb->stalls);
+  }
+  profiler_stat_print("readback render-thread cost", &rb->cpuStat);
+  profiler_stat_print("readback stall", &rb->stallStat);
+  profiler_stat_print("readback GPU copy", &rb->gpuStat);
+  profiler_stat_print("readback copy to host slots", &rb->copyStat);
+  profiler_stat_print("readback encode+write", &rb->writeStat);
+  pthread_mutex_unlock(&rb->mutex);
+}
@@ -0,0 +1,150 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include "vulkan_init.h"
+#include "profiler.h"
+
+#define READBACK_SLOTS 4
+#define READBACK_MAX_FRAMES 3
+#define READBACK_MAX_PATH 512
+
+typedef enum {
+  READBACK_FORMAT_RAW,  // tightly packed RGBA8, frames back to back
+  READBACK_FORMAT_PPM,
+  READBACK_FORMAT_PNG,  // stored (uncompressed) deflate, no zlib dependency
+} Readback_Format;
+
+typedef struct Readback_Context Readback_Context;
+
+// Called on the render thread with each collected slot; the slot stays out
+// of rotation until readback_release
+typedef void (*Readback_Sink_Fn)(Readback_Context *rb, int32_t slot, void *userData);
+
+typedef struct {
+  // "-" streams to stdout; a pattern containing a %u/%05u etc. writes one
+  // file per frame (see readback_parse_pattern); anything else is one file
+  // holding the whole sequence.
+  const char *path;
+  Readback_Format format;
+
+  // Hands frames to sink instead of a file; path is ignored and no writer
+  // thread is started
+  Readback_Sink_Fn sink;
+  void *sinkData;
+  // Optional memory the frames end up in, READBACK_SLOTS slots of
+  // hostSlotStride bytes (e.g. a shared-memory ring). With
+  // VK_EXT_external_memory_host and aligned slots the copy lands there
+  // directly; otherwise it is memcpy'd over when collected.
+  void *hostSlots;
+  size_t hostSlotStride;
+} Readback_Config;
+
+// A per-frame file name split around its frame number, so the user's path
+// never reaches printf as a format
+typedef struct {
+  char prefix[READBACK_MAX_PATH];
+  char suffix[READBACK_MAX_PATH];
+  int width;
+  bool zeroPad;
+} Readback_Pattern;
+
+typedef enum {
+  READBACK_SLOT_FREE,
+  READBACK_SLOT_GPU,     // copy recorded, frame fence not yet waited on
+  READBACK_SLOT_QUEUED,  // owned by the writer thread
+  READBACK_SLOT_SINK,    // handed to the sink, until readback_release
+} Readback_Slot_State;
+
+typedef struct {
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  void *mapped;
+  VkDeviceSize size;
+  bool coherent;
+  void *host;     // this slot's part of config.hostSlots, NULL without
+  bool imported;  // the buffer is bound to host directly
+
+  Readback_Slot_State state;
+  uint32_t frameSlot;
+  uint64_t frameNumber;
+  uint32_t width;
+  uint32_t height;
+  bool bgra;
+  double cpuMs;  // render-thread time spent on this frame so far
+} Readback_Slot;
+
+// Asynchronous frame capture. The frame's command buffer copies the swapchain
+// image into a host-visible slot; once that frame's fence is waited on (i.e.
+// MAX_FRAMES_IN_FLIGHT frames later) the slot is handed to a writer thread
+// without mapping or waiting. The render loop only blocks when every slot is
+// still owned by the writer, which is counted as a stall. With a sink
+// there is no writer: a frame is skipped when no slot is free.
+struct Readback_Context {
+  Vulkan_Context *vk;
+  Readback_Config config;
+
+  Readback_Slot slots[READBACK_SLOTS];
+  int32_t frameSlots[READBACK_MAX_FRAMES];  // slot copied by each frame in flight, -1 if none
+
+  VkQueryPool queryPool;
+  float timestampPeriod;  // ns per tick, 0 when timestamps are unsupported
+
+  pthread_t writer;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  uint32_t queue[READBACK_SLOTS];
+  uint32_t queueHead;
+  uint32_t queueCount;
+  bool quit;
+  bool writerStarted;
+  bool hostImport;  // slots are imported from config.hostSlots
+
+  FILE *stream;  // sequence output, NULL when writing one file per frame
+  bool perFrameFiles;
+  Readback_Pattern pattern;  // when perFrameFiles
+  uint8_t *scratch;
+  size_t scratchSize;
+
+  uint64_t framesQueued;
+  uint64_t framesWritten;
+  uint64_t stalls;
+  uint64_t skipped;          // sink mode, no slot free
+  Profiler_Stat cpuStat;     // render-thread cost per captured frame
+  Profiler_Stat stallStat;   // waiting for the writer to free a slot
+  Profiler_Stat gpuStat;     // copy duration measured with timestamps
+  Profiler_Stat writeStat;   // writer thread, per frame
+  Profiler_Stat copyStat;    // into config.hostSlots, when not imported
+};
+
+// Accepts exactly one %u, %d or %i, with an optional 0 flag and width, and
+// %% for a literal percent; false for any other conversion or none
+bool readback_parse_pattern(const char *path, Readback_Pattern *pattern);
+
+bool readback_create(Readback_Context *rb, Vulkan_Context *vk, const Readback_Config *config);
+void readback_destroy(Readback_Context *rb);
+
+// Picks a slot for the frame being recorded and sizes it for the image.
+// Returns the slot index, or -1 if capture is skipped this frame.
+int32_t readback_begin(Readback_Context *rb, uint32_t frameSlot, uint64_t frameNumber,
+                       VkExtent2D extent, VkFormat format);
+VkBuffer readback_buffer(Readback_Context *rb, int32_t slot);
+
+// The image must already be in TRANSFER_SRC_OPTIMAL (the render graph pass
+// declares that); the host-read barrier is recorded here.
+void readback_record_copy(Readback_Context *rb, VkCommandBuffer cmd, uint32_t frameSlot, int32_t slot, VkImage image);
+
+// Call right after the frame's fence has been waited on
+void readback_collect(Readback_Context *rb, uint32_t frameSlot);
+// Sink mode: the consumer is done with a slot it was handed
+void readback_release(Readback_Context *rb, int32_t slot);
+uint32_t readback_free_slots(Readback_Context *rb);
+
+void readback_print_stats(Readback_Context *rb);
+
+#endif
@@ -0,0 +1,744 @@
+#include "render_graph.h"
+#include "vulkan_init.h"
+#include "color.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vulkan/vulkan.h>
+
+#define RG_WRITE_ACCESS_MASK (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | \
+                              VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | \
+                              VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+typedef struct {
+  VkPipelineStageFlags stage;
+  VkAccessFlags access;
+  VkImageLayout layout;
+  VkImageUsageFlags usage;
+} RG_Use_Info;
+
+typedef struct {
+  VkImageLayout layout;
+  VkPipelineStageFlags writeStage;
+  VkAccessFlags writeAccess;
+  VkPipelineStageFlags readStages;
+  VkPipelineStageFlags visibleStages;
+  VkAccessFlags visibleAccess;
+  bool touched;
+} RG_State;
+
+static bool isDepthFormat(VkFormat format) {
+  return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 ||
+         format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D24_UNORM_S8_UINT ||
+         format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+static VkImageAspectFlags aspectForFormat(VkFormat format) {
+  return isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
+static VkPipelineStageFlags shaderStages(const Render_Graph *graph, RG_Pass_Type type) {
+  switch (type) {
+    case RG_PASS_COMPUTE: return VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    case RG_PASS_TRANSFER: return VK_PIPELINE_STAGE_TRANSFER_BIT;
+    case RG_PASS_GRAPHICS:
+    default: return graph->graphicsStages;
+  }
+}
+
+static RG_Use_Info useInfo(const Render_Graph *graph, RG_Pass_Type type, RG_Use use, bool write) {
+  RG_Use_Info info = {0};
+  switch (use) {
+    case RG_USE_COLOR_ATTACHMENT:
+      info.stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      info.access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0);
+      info.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+      break;
+    case RG_USE_DEPTH_ATTACHMENT:
+      info.stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+      info.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0);
+      info.layout = write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+      info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+      break;
+    case RG_USE_SAMPLED:
+      info.stage = shaderStages(graph, type);
+      info.access = VK_ACCESS_SHADER_READ_BIT;
+      info.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      info.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+      break;
+    case RG_USE_STORAGE:
+      info.stage = shaderStages(graph, type);
+      info.access = write ? VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+      info.layout = VK_IMAGE_LAYOUT_GENERAL;
+      info.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+      break;
+    case RG_USE_TRANSFER:
+      info.stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      info.access = write ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_TRANSFER_READ_BIT;
+      info.layout = write ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      info.usage = write ? VK_IMAGE_USAGE_TRANSFER_DST_BIT : VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+      break;
+    case RG_USE_VERTEX:
+      info.stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+      info.access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+      break;
+    case RG_USE_INDEX:
+      info.stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+      info.access = VK_ACCESS_INDEX_READ_BIT;
+      break;
+    case RG_USE_INDIRECT:
+      info.stage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+      info.access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+      break;
+    case RG_USE_UNIFORM:
+      info.stage = shaderStages(graph, type);
+      info.access = VK_ACCESS_UNIFORM_READ_BIT;
+      break;
+  }
+  return info;
+}
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static uint64_t topologyHash(const Render_Graph *graph) {
+  uint64_t hash = 14695981039346656037ULL;
+  hash = hashBytes(hash, &graph->resourceCount, sizeof(graph->resourceCount));
+  for (uint32_t i = 0; i < graph->resourceCount; i++) {
+    const RG_Resource *res = &graph->resources[i];
+    hash = hashBytes(hash, &res->kind, sizeof(res->kind));
+    hash = hashBytes(hash, &res->imported, sizeof(res->imported));
+    hash = hashBytes(hash, &res->desc, sizeof(res->desc));
+    hash = hashBytes(hash, &res->initialLayout, sizeof(res->initialLayout));
+    hash = hashBytes(hash, &res->initialStage, sizeof(res->initialStage));
+    hash = hashBytes(hash, &res->initialAccess, sizeof(res->initialAccess));
+    hash = hashBytes(hash, &res->finalLayout, sizeof(res->finalLayout));
+  }
+  hash = hashBytes(hash, &graph->graphicsStages, sizeof(graph->graphicsStages));
+  hash = hashBytes(hash, &graph->passCount, sizeof(graph->passCount));
+  for (uint32_t i = 0; i < graph->passCount; i++) {
+    const RG_Pass *pass = &graph->passes[i];
+    hash = hashBytes(hash, &pass->type, sizeof(pass->type));
+    hash = hashBytes(hash, &pass->accessCount, sizeof(pass->accessCount));
+    hash = hashBytes(hash, pass->accesses, pass->accessCount * sizeof(RG_Access));
+  }
+  return hash;
+}
+
+bool render_graph_create(Render_Graph *graph, VkPhysicalDevice physicalDevice, VkDevice device,
+                         const Vulkan_Dispatch *dispatch) {
+  if (!graph || !dispatch) return false;
+  memset(graph, 0, sizeof(*graph));
+  graph->physicalDevice = physicalDevice;
+  graph->device = device;
+  graph->dispatch = dispatch;
+  graph->graphicsStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  return true;
+}
+
+static void releaseTransients(Render_Graph *graph) {
+  for (uint32_t i = 0; i < RG_MAX_RESOURCES; i++) {
+    if (graph->transientViews[i] != VK_NULL_HANDLE) {
+      if (graph->deletion) {
+        deletion_queue_push(graph->deletion, DELETION_IMAGE_VIEW, (uint64_t)graph->transientViews[i]);
+      } else {
+        vkDestroyImageView(graph->device, graph->transientViews[i], NULL);
+      }
+      graph->transientViews[i] = VK_NULL_HANDLE;
+    }
+    if (graph->transientImages[i] != VK_NULL_HANDLE) {
+      if (graph->deletion) {
+        deletion_queue_push(graph->deletion, DELETION_IMAGE, (uint64_t)graph->transientImages[i]);
+      } else {
+        vkDestroyImage(graph->device, graph->transientImages[i], NULL);
+      }
+      graph->transientImages[i] = VK_NULL_HANDLE;
+    }
+    if (!graph->resources[i].imported) {
+      graph->resources[i].image = VK_NULL_HANDLE;
+      graph->resources[i].view = VK_NULL_HANDLE;
+    }
+  }
+  if (graph->transientMemory != VK_NULL_HANDLE) {
+    if (graph->deletion) {
+      deletion_queue_push(graph->deletion, DELETION_MEMORY, (uint64_t)graph->transientMemory);
+    } else {
+      memory_budget_untrack(graph->budget, graph->transientMemory);
+      vkFreeMemory(graph->device, graph->transientMemory, NULL);
+    }
+    graph->transientMemory = VK_NULL_HANDLE;
+  }
+  graph->transientSize = 0;
+  graph->transientUnaliasedSize = 0;
+}
+
+// Point the (possibly re-declared) transient resources at the images owned by
+// the compiled state.
+static void attachTransients(Render_Graph *graph) {
+  for (uint32_t i = 0; i < graph->resourceCount; i++) {
+    RG_Resource *res = &graph->resources[i];
+    if (res->imported || res->kind != RG_RESOURCE_IMAGE) continue;
+    res->image = graph->transientImages[i];
+    res->view = graph->transientViews[i];
+  }
+}
+
+void render_graph_destroy(Render_Graph *graph) {
+  if (!graph) return;
+  releaseTransients(graph);
+  graph->compiled = false;
+}
+
+void render_graph_reset(Render_Graph *graph) {
+  if (!graph) return;
+  graph->resourceCount = 0;
+  graph->passCount = 0;
+}
+
+static RG_Handle addResource(Render_Graph *graph, const char *name, RG_Resource_Kind kind, bool imported) {
+  if (graph->resourceCount >= RG_MAX_RESOURCES) {
+    printf(RED "[ERROR] " RESET "render graph: too many resources (%s)\n", name);
+    return RG_INVALID;
+  }
+  RG_Handle handle = graph->resourceCount++;
+  RG_Resource *res = &graph->resources[handle];
+  memset(res, 0, sizeof(*res));
+  res->name = name;
+  res->kind = kind;
+  res->imported = imported;
+  return handle;
+}
+
+RG_Handle render_graph_import_image(Render_Graph *graph, const char *name, const RG_Image_Desc *desc,
+                                    VkImageLayout initialLayout, VkPipelineStageFlags initialStage,
+                                    VkImageLayout finalLayout) {
+  if (!graph || !desc) return RG_INVALID;
+  RG_Handle handle = addResource(graph, name, RG_RESOURCE_IMAGE, true);
+  if (handle == RG_INVALID) return handle;
+  RG_Resource *res = &graph->resources[handle];
+  res->desc = *desc;
+  res->initialLayout = initialLayout;
+  res->initialStage = initialStage;
+  res->finalLayout = finalLayout;
+  return handle;
+}
+
+RG_Handle render_graph_import_buffer(Render_Graph *graph, const char *name, VkBuffer buffer, VkDeviceSize size) {
+  if (!graph) return RG_INVALID;
+  RG_Handle handle = addResource(graph, name, RG_RESOURCE_BUFFER, true);
+  if (handle == RG_INVALID) return handle;
+  graph->resources[handle].buffer = buffer;
+  graph->resources[handle].bufferSize = size;
+  graph->resources[handle].initialStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  return handle;
+}
+
+RG_Handle render_graph_create_image(Render_Graph *graph, const char *name, const RG_Image_Desc *desc) {
+  if (!graph || !desc) return RG_INVALID;
+  RG_Handle handle = addResource(graph, name, RG_RESOURCE_IMAGE, false);
+  if (handle == RG_INVALID) return handle;
+  RG_Resource *res = &graph->resources[handle];
+  res->desc = *desc;
+  if (res->desc.samples == 0) res->desc.samples = VK_SAMPLE_COUNT_1_BIT;
+  res->initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  return handle;
+}
+
+RG_Handle render_graph_add_pass(Render_Graph *graph, const char *name, RG_Pass_Type type,
+                                RG_Execute_Fn execute, void *userData) {
+  if (!graph) return RG_INVALID;
+  if (graph->passCount >= RG_MAX_PASSES) {
+    printf(RED "[ERROR] " RESET "render graph: too many passes (%s)\n", name);
+    return RG_INVALID;
+  }
+  RG_Handle handle = graph->passCount++;
+  RG_Pass *pass = &graph->passes[handle];
+  memset(pass, 0, sizeof(*pass));
+  pass->name = name;
+  pass->type = type;
+  pass->execute = execute;
+  pass->userData = userData;
+  return handle;
+}
+
+static void addAccess(Render_Graph *graph, RG_Handle pass, RG_Handle resource, RG_Use use, bool write) {
+  if (!graph || pass >= graph->passCount || resource >= graph->resourceCount) return;
+  RG_Pass *p = &graph->passes[pass];
+  if (p->accessCount >= RG_MAX_PASS_ACCESSES) {
+    printf(RED "[ERROR] " RESET "render graph: too many accesses in pass %s\n", p->name);
+    return;
+  }
+  RG_Access *access = &p->accesses[p->accessCount++];
+  memset(access, 0, sizeof(*access));
+  access->resource = resource;
+  access->use = use;
+  access->write = write;
+}
+
+void render_graph_read(Render_Graph *graph, RG_Handle pass, RG_Handle resource, RG_Use use) {
+  addAccess(graph, pass, resource, use, false);
+}
+
+void render_graph_write(Render_Graph *graph, RG_Handle pass, RG_Handle resource, RG_Use use) {
+  addAccess(graph, pass, resource, use, true);
+}
+
+void render_graph_set_image(Render_Graph *graph, RG_Handle resource, VkImage image, VkImageView view) {
+  if (!graph || resource >= graph->resourceCount || !graph->resources[resource].imported) return;
+  graph->resources[resource].image = image;
+  graph->resources[resource].view = view;
+}
+
+void render_graph_set_history(Render_Graph *graph, RG_Handle resource, VkAccessFlags access) {
+  if (!graph || resource >= graph->resourceCount || !graph->resources[resource].imported) return;
+  graph->resources[resource].initialAccess = access;
+}
+
+void render_graph_set_buffer(Render_Graph *graph, RG_Handle resource, VkBuffer buffer) {
+  if (!graph || resource >= graph->resourceCount || !graph->resources[resource].imported) return;
+  graph->resources[resource].buffer = buffer;
+}
+
+VkImage render_graph_get_image(Render_Graph *graph, RG_Handle resource) {
+  if (!graph || resource >= graph->resourceCount) return VK_NULL_HANDLE;
+  return graph->resources[resource].image;
+}
+
+VkImageView render_graph_get_view(Render_Graph *graph, RG_Handle resource) {
+  if (!graph || resource >= graph->resourceCount) return VK_NULL_HANDLE;
+  return graph->resources[resource].view;
+}
+
+// Walk backwards from the imported resources (the only things visible outside
+// the graph) and keep the passes that contribute to them.
+static uint32_t cullPasses(Render_Graph *graph) {
+  bool needed[RG_MAX_RESOURCES] = {0};
+  for (uint32_t i = 0; i < graph->resourceCount; i++) {
+    needed[i] = graph->resources[i].imported;
+  }
+
+  uint32_t culled = 0;
+  for (uint32_t p = graph->passCount; p-- > 0;) {
+    RG_Pass *pass = &graph->passes[p];
+    RG_Pass_Compiled *compiled = &graph->compiledPasses[p];
+    bool alive = false;
+    for (uint32_t a = 0; a < pass->accessCount; a++) {
+      if (pass->accesses[a].write && needed[pass->accesses[a].resource]) {
+        alive = true;
+        break;
+      }
+    }
+    compiled->culled = !alive;
+    if (!alive) {
+      culled++;
+      continue;
+    }
+    for (uint32_t a = 0; a < pass->accessCount; a++) {
+      if (!pass->accesses[a].write) {
+        needed[pass->accesses[a].resource] = true;
+      }
+    }
+  }
+  return culled;
+}
+
+static bool rangesOverlap(VkDeviceSize aOffset, VkDeviceSize aSize, VkDeviceSize bOffset, VkDeviceSize bSize) {
+  return aOffset < bOffset + bSize && bOffset < aOffset + aSize;
+}
+
+static bool lifetimesOverlap(const RG_Resource *a, const RG_Resource *b) {
+  return a->firstPass <= b->lastPass && b->firstPass <= a->lastPass;
+}
+
+// Create the transient images, then place them in a single allocation.
+// Resources whose pass ranges don't overlap may share bytes; placement is
+// greedy largest-first, lowest offset that clears every live neighbour.
+static bool allocateTransients(Render_Graph *graph) {
+  uint32_t order[RG_MAX_RESOURCES];
+  uint32_t orderCount = 0;
+  uint32_t memoryTypeBits = UINT32_MAX;
+  VkDeviceSize alignments[RG_MAX_RESOURCES] = {0};
+
+  for (uint32_t i = 0; i < graph->resourceCount; i++) {
+    RG_Resource *res = &graph->resources[i];
+    if (res->imported || res->kind != RG_RESOURCE_IMAGE || res->firstPass == RG_INVALID) continue;
+
+    VkImageCreateInfo imageInfo = {0};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.flags = VK_IMAGE_CREATE_ALIAS_BIT;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = res->desc.format;
+    imageInfo.extent.width = res->desc.extent.width;
+    imageInfo.extent.height = res->desc.extent.height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = res->desc.samples;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = res->usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(graph->device, &imageInfo, NULL, &graph->transientImages[i]) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "render graph: failed to create transient image %s\n", res->name);
+      return false;
+    }
+
+    res->image = graph->transientImages[i];
+
+    VkMemoryRequirements memReq;
+    vkGetImageMemoryRequirements(graph->device, res->image, &memReq);
+    res->memorySize = memReq.size;
+    alignments[i] = memReq.alignment;
+    memoryTypeBits &= memReq.memoryTypeBits;
+    graph->transientUnaliasedSize += memReq.size;
+
+    // insertion sort, largest first
+    uint32_t pos = orderCount++;
+    while (pos > 0 && graph->resources[order[pos - 1]].memorySize < res->memorySize) {
+      order[pos] = order[pos - 1];
+      pos--;
+    }
+    order[pos] = i;
+  }
+
+  if (orderCount == 0) return true;
+
+  for (uint32_t n = 0; n < orderCount; n++) {
+    RG_Resource *res = &graph->resources[order[n]];
+    VkDeviceSize alignment = alignments[order[n]];
+    VkDeviceSize offset = 0;
+    bool moved = true;
+    while (moved) {
+      moved = false;
+      for (uint32_t m = 0; m < n; m++) {
+        RG_Resource *placed = &graph->resources[order[m]];
+        if (!lifetimesOverlap(res, placed)) continue;
+        if (rangesOverlap(offset, res->memorySize, placed->memoryOffset, placed->memorySize)) {
+          offset = placed->memoryOffset + placed->memorySize;
+          offset = (offset + alignment - 1) / alignment * alignment;
+          moved = true;
+        }
+      }
+    }
+    res->memoryOffset = offset;
+    if (offset + res->memorySize > graph->transientSize) {
+      graph->transientSize = offset + res->memorySize;
+    }
+  }
+
+  if (memoryTypeBits == 0) {
+    printf(RED "[ERROR] " RESET "render graph: transient images have no common memory type\n");
+    return false;
+  }
+
+  VkMemoryAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = graph->transientSize;
+  allocInfo.memoryTypeIndex = findMemoryType(graph->physicalDevice, memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (allocInfo.memoryTypeIndex == UINT32_MAX) {
+    printf(RED "[ERROR] " RESET "render graph: no device local memory for transient images\n");
+    return false;
+  }
+  if (vkAllocateMemory(graph->device, &allocInfo, NULL, &graph->transientMemory) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "render graph: failed to allocate transient memory\n");
+    return false;
+  }
+  memory_budget_track(graph->budget, graph->transientMemory, allocInfo.allocationSize, allocInfo.memoryTypeIndex);
+
+  for (uint32_t n = 0; n < orderCount; n++) {
+    RG_Resource *res = &graph->resources[order[n]];
+    if (vkBindImageMemory(graph->device, res->image, graph->transientMemory, res->memoryOffset) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "render graph: failed to bind transient image %s\n", res->name);
+      return false;
+    }
+
+    VkImageViewCreateInfo viewInfo = {0};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = res->image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = res->desc.format;
+    viewInfo.subresourceRange.aspectMask = aspectForFormat(res->desc.format);
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(graph->device, &viewInfo, NULL, &graph->transientViews[order[n]]) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "render graph: failed to create transient view %s\n", res->name);
+      return false;
+    }
+    res->view = graph->transientViews[order[n]];
+  }
+  return true;
+}
+
+static void pushBarrier(Render_Graph *graph, RG_Handle resource, VkImageLayout oldLayout, VkImageLayout newLayout,
+                        VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+  RG_Barrier *barrier = &graph->barriers[graph->barrierCount++];
+  barrier->resource = resource;
+  barrier->oldLayout = oldLayout;
+  barrier->newLayout = newLayout;
+  barrier->srcAccess = srcAccess;
+  barrier->dstAccess = dstAccess;
+}
+
+// Transient images that share bytes with this one (including itself from the
+// previous frame) must be done before the first use overwrites them.
+static VkPipelineStageFlags aliasWaitStages(Render_Graph *graph, RG_Handle resource) {
+  RG_Resource *res = &graph->resources[resource];
+  VkPipelineStageFlags stages = 0;
+  for (uint32_t i = 0; i < graph->resourceCount; i++) {
+    RG_Resource *other = &graph->resources[i];
+    if (other->imported || other->kind != RG_RESOURCE_IMAGE || other->firstPass == RG_INVALID) continue;
+    if (rangesOverlap(res->memoryOffset, res->memorySize, other->memoryOffset, other->memorySize)) {
+      stages |= other->allStages;
+    }
+  }
+  return stages;
+}
+
+static bool buildBarriers(Render_Graph *graph) {
+  RG_State states[RG_MAX_RESOURCES];
+  memset(states, 0, sizeof(states));
+  for (uint32_t i = 0; i < graph->resourceCount; i++) {
+    states[i].layout = graph->resources[i].imported ? graph->resources[i].initialLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+    states[i].writeStage = graph->resources[i].imported ? graph->resources[i].initialStage : 0;
+    states[i].writeAccess = graph->resources[i].imported ? graph->resources[i].initialAccess : 0;
+  }
+  graph->barrierCount = 0;
+
+  for (uint32_t p = 0; p < graph->passCount; p++) {
+    RG_Pass *pass = &graph->passes[p];
+    RG_Pass_Compiled *compiled = &graph->compiledPasses[p];
+    compiled->barrierOffset = graph->barrierCount;
+    compiled->barrierCount = 0;
+    compiled->srcStage = 0;
+    compiled->dstStage = 0;
+    if (compiled->culled) continue;
+
+    // Merge repeated accesses to one resource within the pass
+    bool done[RG_MAX_PASS_ACCESSES] = {0};
+    for (uint32_t a = 0; a < pass->accessCount; a++) {
+      if (done[a]) continue;
+      RG_Handle resource = pass->accesses[a].resource;
+      RG_Resource *res = &graph->resources[resource];
+      RG_Use_Info info = useInfo(graph, pass->type, pass->accesses[a].use, pass->accesses[a].write);
+      bool write = pass->accesses[a].write;
+      for (uint32_t b = a + 1; b < pass->accessCount; b++) {
+        if (pass->accesses[b].resource != resource) continue;
+        RG_Use_Info other = useInfo(graph, pass->type, pass->accesses[b].use, pass->accesses[b].write);
+        if (res->kind == RG_RESOURCE_IMAGE && other.layout != info.layout) {
+          printf(RED "[ERROR] " RESET "render graph: pass %s uses %s in two layouts\n", pass->name, res->name);
+          return false;
+        }
+        info.stage |= other.stage;
+        info.access |= other.access;
+        write = write || pass->accesses[b].write;
+        done[b] = true;
+      }
+
+      RG_State *st = &states[resource];
+      bool isImage = res->kind == RG_RESOURCE_IMAGE;
+      bool layoutChange = isImage && st->layout != info.layout;
+      VkPipelineStageFlags srcStage = 0;
+      VkAccessFlags srcAccess = 0;
+      bool needBarrier = false;
+
+      if (!st->touched && !res->imported && isImage) {
+        srcStage = aliasWaitStages(graph, resource);
+        needBarrier = true;
+      }
+
+      if (write) {
+        if (layoutChange || st->writeStage || st->readStages) {
+          srcStage |= st->writeStage | st->readStages;
+          srcAccess |= st->writeAccess;
+          needBarrier = true;
+        }
+      } else {
+        bool stale = st->writeAccess &&
+                     ((info.stage & ~st->visibleStages) || (info.access & ~st->visibleAccess));
+        if (layoutChange || stale) {
+          srcStage |= st->writeStage | (layoutChange ? st->readStages : 0);
+          srcAccess |= st->writeAccess;
+          needBarrier = true;
+        }
+      }
+
+      if (needBarrier) {
+        VkImageLayout oldLayout = st->touched || res->imported ? st->layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        pushBarrier(graph, resource, oldLayout, isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED,
+                    srcAccess, info.access);
+        compiled->barrierCount++;
+        compiled->srcStage |= srcStage;
+        compiled->dstStage |= info.stage;
+      }
+
+      if (write) {
+        st->writeStage = info.stage;
+        st->writeAccess = info.access & RG_WRITE_ACCESS_MASK;
+        st->readStages = 0;
+        st->visibleStages = 0;
+        st->visibleAccess = 0;
+      } else {
+        if (layoutChange) {
+          // The transition is itself a write that happened in this scope
+          st->writeStage |= info.stage;
+          st->visibleStages = 0;
+          st->visibleAccess = 0;
+          st->readStages = 0;
+        }
+        st->readStages |= info.stage;
+        st->visibleStages |= info.stage;
+        st->visibleAccess |= info.access;
+      }
+      if (isImage) st->layout = info.layout;
+      st->touched = true;
+    }
+    if (compiled->barrierCount > 0 && compiled->srcStage == 0) {
+      compiled->srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+  }
+
+  // Hand imported images back in the layout the caller asked for
+  graph->finalBarrierOffset = graph->barrierCount;
+  graph->finalBarrierCount = 0;
+  graph->finalSrcStage = 0;
+  for (uint32_t i = 0; i < graph->resourceCount; i++) {
+    RG_Resource *res = &graph->resources[i];
+    RG_State *st = &states[i];
+    if (!res->imported || res->kind != RG_RESOURCE_IMAGE) continue;
+    if (res->finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || res->finalLayout == st->layout) continue;
+    pushBarrier(graph, i, st->layout, res->finalLayout, st->writeAccess, 0);
+    graph->finalBarrierCount++;
+    graph->finalSrcStage |= st->writeStage | st->readStages;
+  }
+  if (graph->finalBarrierCount > 0 && graph->finalSrcStage == 0) {
+    graph->finalSrcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  }
+  return true;
+}
+
+bool render_graph_compile(Render_Graph *graph) {
+  if (!graph) return false;
+
+  uint64_t hash = topologyHash(graph);
+  if (graph->compiled && hash == graph->compiledHash) {
+    attachTransients(graph);
+    return true;
+  }
+
+  releaseTransients(graph);
+  graph->compiled = false;
+
+  uint32_t culled = cullPasses(graph);
+
+  for (uint32_t i = 0; i < graph->resourceCount; i++) {
+    RG_Resource *res = &graph->resources[i];
+    res->usage = 0;
+    res->allStages = 0;
+    res->firstPass = RG_INVALID;
+    res->lastPass = RG_INVALID;
+    res->memoryOffset = 0;
+    res->memorySize = 0;
+  }
+  for (uint32_t p = 0; p < graph->passCount; p++) {
+    RG_Pass *pass = &graph->passes[p];
+    if (graph->compiledPasses[p].culled) continue;
+    for (uint32_t a = 0; a < pass->accessCount; a++) {
+      RG_Resource *res = &graph->resources[pass->accesses[a].resource];
+      RG_Use_Info info = useInfo(graph, pass->type, pass->accesses[a].use, pass->accesses[a].write);
+      res->usage |= info.usage;
+      res->allStages |= info.stage;
+      if (res->firstPass == RG_INVALID) res->firstPass = p;
+      res->lastPass = p;
+    }
+  }
+
+  if (!allocateTransients(graph)) {
+    releaseTransients(graph);
+    return false;
+  }
+  if (!buildBarriers(graph)) {
+    releaseTransients(graph);
+    return false;
+  }
+
+  graph->compiledHash = hash;
+  graph->compiled = true;
+  printf(GREEN "[OK] " RESET "Render Graph (%u passes, %u culled, %u barriers, transient %llu KiB / %llu KiB unaliased)\n",
+         graph->passCount, culled, graph->barrierCount,
+         (unsigned long long)(graph->transientSize / 1024),
+         (unsigned long long)(graph->transientUnaliasedSize / 1024));
+  return true;
+}
+
+static void emitBarriers(Render_Graph *graph, VkCommandBuffer cmd, uint32_t offset, uint32_t count,
+                         VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+  VkImageMemoryBarrier imageBarriers[RG_MAX_RESOURCES];
+  VkBufferMemoryBarrier bufferBarriers[RG_MAX_RESOURCES];
+  uint32_t imageCount = 0;
+  uint32_t bufferCount = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    const RG_Barrier *barrier = &graph->barriers[offset + i];
+    const RG_Resource *res = &graph->resources[barrier->resource];
+    if (res->kind == RG_RESOURCE_IMAGE) {
+      VkImageMemoryBarrier *ib = &imageBarriers[imageCount++];
+      memset(ib, 0, sizeof(*ib));
+      ib->sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      ib->srcAccessMask = barrier->srcAccess;
+      ib->dstAccessMask = barrier->dstAccess;
+      ib->oldLayout = barrier->oldLayout;
+      ib->newLayout = barrier->newLayout;
+      ib->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      ib->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      ib->image = res->image;
+      ib->subresourceRange.aspectMask = aspectForFormat(res->desc.format);
+      ib->subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+      ib->subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    } else {
+      // Imported buffers may be left unbound on frames that don't use them
+      if (res->buffer == VK_NULL_HANDLE) continue;
+      VkBufferMemoryBarrier *bb = &bufferBarriers[bufferCount++];
+      memset(bb, 0, sizeof(*bb));
+      bb->sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      bb->srcAccessMask = barrier->srcAccess;
+      bb->dstAccessMask = barrier->dstAccess;
+      bb->srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      bb->dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      bb->buffer = res->buffer;
+      bb->offset = 0;
+      bb->size = VK_WHOLE_SIZE;
+    }
+  }
+
+  graph->dispatch->vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, NULL, bufferCount, bufferBarriers, imageCount, imageBarriers);
+}
+
+void render_graph_execute(Render_Graph *graph, VkCommandBuffer cmd) {
+  if (!graph || !graph->compiled) return;
+
+  for (uint32_t p = 0; p < graph->passCount; p++) {
+    RG_Pass *pass = &graph->passes[p];
+    RG_Pass_Compiled *compiled = &graph->compiledPasses[p];
+    if (compiled->culled) continue;
+    if (compiled->barrierCount > 0) {
+      emitBarriers(graph, cmd, compiled->barrierOffset, compiled->barrierCount, compiled->srcStage, compiled->dstStage);
+    }
+    if (pass->execute) {
+      pass->execute(cmd, pass->userData);
+    }
+  }
+
+  if (graph->finalBarrierCount > 0) {
+    emitBarriers(graph, cmd, graph->finalBarrierOffset, graph->finalBarrierCount,
+                 graph->finalSrcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+  }
+}
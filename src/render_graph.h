@@ -0,0 +1,187 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "vulkan_dispatch.h"
+#include "deletion.h"
+#include "memory_budget.h"
+
+#define RG_MAX_RESOURCES 32
+#define RG_MAX_PASSES 32
+#define RG_MAX_PASS_ACCESSES 8
+#define RG_MAX_BARRIERS (RG_MAX_PASSES * RG_MAX_PASS_ACCESSES + RG_MAX_RESOURCES)
+#define RG_INVALID UINT32_MAX
+
+typedef uint32_t RG_Handle;
+
+typedef void (*RG_Execute_Fn)(VkCommandBuffer cmd, void *userData);
+
+typedef enum {
+  RG_PASS_GRAPHICS,
+  RG_PASS_COMPUTE,
+  RG_PASS_TRANSFER,
+} RG_Pass_Type;
+
+// How a pass touches a resource. Whether it is a read or a write comes from
+// render_graph_read / render_graph_write.
+typedef enum {
+  RG_USE_COLOR_ATTACHMENT,
+  RG_USE_DEPTH_ATTACHMENT,
+  RG_USE_SAMPLED,
+  RG_USE_STORAGE,
+  RG_USE_TRANSFER,
+  RG_USE_VERTEX,
+  RG_USE_INDEX,
+  RG_USE_INDIRECT,
+  RG_USE_UNIFORM,
+} RG_Use;
+
+typedef enum {
+  RG_RESOURCE_IMAGE,
+  RG_RESOURCE_BUFFER,
+} RG_Resource_Kind;
+
+typedef struct {
+  VkFormat format;
+  VkExtent2D extent;
+  VkSampleCountFlagBits samples;
+} RG_Image_Desc;
+
+typedef struct {
+  RG_Handle resource;
+  RG_Use use;
+  bool write;
+} RG_Access;
+
+typedef struct {
+  RG_Handle resource;
+  VkImageLayout oldLayout;
+  VkImageLayout newLayout;
+  VkAccessFlags srcAccess;
+  VkAccessFlags dstAccess;
+} RG_Barrier;
+
+typedef struct {
+  const char *name;
+  RG_Resource_Kind kind;
+  bool imported;
+  RG_Image_Desc desc;
+
+  // Imported resources: state at the start of the frame and the layout the
+  // caller expects once the graph has run (UNDEFINED = leave as is).
+  VkImageLayout initialLayout;
+  VkPipelineStageFlags initialStage;
+  VkAccessFlags initialAccess;  // see render_graph_set_history
+  VkImageLayout finalLayout;
+
+  VkImage image;
+  VkImageView view;
+  VkBuffer buffer;
+  VkDeviceSize bufferSize;
+
+  // Filled by render_graph_compile
+  VkImageUsageFlags usage;
+  VkPipelineStageFlags allStages;
+  uint32_t firstPass;
+  uint32_t lastPass;
+  VkDeviceSize memoryOffset;
+  VkDeviceSize memorySize;
+} RG_Resource;
+
+typedef struct {
+  const char *name;
+  RG_Pass_Type type;
+  RG_Execute_Fn execute;
+  void *userData;
+  RG_Access accesses[RG_MAX_PASS_ACCESSES];
+  uint32_t accessCount;
+} RG_Pass;
+
+// Compiled per-pass state, kept apart from the declaration so a graph can be
+// re-declared every frame without losing it.
+typedef struct {
+  bool culled;
+  uint32_t barrierOffset;
+  uint32_t barrierCount;
+  VkPipelineStageFlags srcStage;
+  VkPipelineStageFlags dstStage;
+} RG_Pass_Compiled;
+
+// Frame render graph. Passes declare what they read and write, compile
+// derives barriers/layout transitions, culls passes that feed nothing and
+// packs transient images into one aliased allocation. Compilation is cached
+// on a hash of the declared topology, so re-declaring an identical graph is
+// cheap and execution only replays the precomputed barriers.
+typedef struct Render_Graph Render_Graph;
+struct Render_Graph {
+  VkDevice device;
+  const Vulkan_Dispatch *dispatch;
+  VkPhysicalDevice physicalDevice;
+  // Shader stages of graphics passes; add task/mesh stages when those run
+  VkPipelineStageFlags graphicsStages;
+  // Where replaced transients go when set; otherwise they are destroyed at once
+  Deletion_Queue *deletion;
+  // Counts the transient allocation when set
+  Memory_Budget *budget;
+
+  RG_Resource resources[RG_MAX_RESOURCES];
+  uint32_t resourceCount;
+  RG_Pass passes[RG_MAX_PASSES];
+  uint32_t passCount;
+
+  RG_Pass_Compiled compiledPasses[RG_MAX_PASSES];
+  RG_Barrier barriers[RG_MAX_BARRIERS];
+  uint32_t barrierCount;
+  uint32_t finalBarrierOffset;
+  uint32_t finalBarrierCount;
+  VkPipelineStageFlags finalSrcStage;
+
+  VkImage transientImages[RG_MAX_RESOURCES];
+  VkImageView transientViews[RG_MAX_RESOURCES];
+  VkDeviceMemory transientMemory;
+  VkDeviceSize transientSize;
+  VkDeviceSize transientUnaliasedSize;
+
+  uint64_t compiledHash;
+  bool compiled;
+};
+
+bool render_graph_create(Render_Graph *graph, VkPhysicalDevice physicalDevice, VkDevice device,
+                         const Vulkan_Dispatch *dispatch);
+void render_graph_destroy(Render_Graph *graph);
+
+// Drops all declarations. The compiled state stays cached until the next
+// render_graph_compile sees a different topology.
+void render_graph_reset(Render_Graph *graph);
+
+RG_Handle render_graph_import_image(Render_Graph *graph, const char *name, const RG_Image_Desc *desc,
+                                    VkImageLayout initialLayout, VkPipelineStageFlags initialStage,
+                                    VkImageLayout finalLayout);
+RG_Handle render_graph_import_buffer(Render_Graph *graph, const char *name, VkBuffer buffer, VkDeviceSize size);
+RG_Handle render_graph_create_image(Render_Graph *graph, const char *name, const RG_Image_Desc *desc);
+
+RG_Handle render_graph_add_pass(Render_Graph *graph, const char *name, RG_Pass_Type type,
+                                RG_Execute_Fn execute, void *userData);
+void render_graph_read(Render_Graph *graph, RG_Handle pass, RG_Handle resource, RG_Use use);
+void render_graph_write(Render_Graph *graph, RG_Handle pass, RG_Handle resource, RG_Use use);
+
+// Imported handles may change every frame (e.g. the acquired swapchain image)
+// without invalidating the compiled graph.
+void render_graph_set_image(Render_Graph *graph, RG_Handle resource, VkImage image, VkImageView view);
+void render_graph_set_buffer(Render_Graph *graph, RG_Handle resource, VkBuffer buffer);
+// The imported resource carries a write from an earlier frame (made at its
+// initialStage) that this frame's first access must wait on and see, e.g.
+// a depth pyramid read before it is rebuilt.
+void render_graph_set_history(Render_Graph *graph, RG_Handle resource, VkAccessFlags access);
+
+VkImage render_graph_get_image(Render_Graph *graph, RG_Handle resource);
+VkImageView render_graph_get_view(Render_Graph *graph, RG_Handle resource);
+
+// When the topology has changed, the previous compilation's transient images
+// are released; without a deletion queue they must not be in use by the GPU.
+bool render_graph_compile(Render_Graph *graph);
+void render_graph_execute(Render_Graph *graph, VkCommandBuffer cmd);
+
+#endif
@@ -2,6 +2,8 @@
 #include "platform.h"
 #include "vulkan_init.h"
 #include "color.h"
+#include "profiler.h"
+#include "arena.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -10,6 +12,10 @@
 #include <stdint.h>
 #include <vulkan/vulkan_core.h>
 
+_Static_assert(MAX_FRAMES_IN_FLIGHT <= SPRITE_MAX_FRAMES, "sprite ring too small");
+_Static_assert(MAX_FRAMES_IN_FLIGHT <= READBACK_MAX_FRAMES, "readback ring too small");
+_Static_assert(MAX_FRAMES_IN_FLIGHT <= POST_MAX_FRAMES, "post timing ring too small");
+
 static const char *vert_path = "external/shaders/shader.vert.spv";
 static const char *frag_path = "external/shaders/shader.frag.spv";
 
@@ -21,117 +27,597 @@ typedef struct {
   uint32_t presentModeCount;
 } SwapChainSupportDetails;
 
-static void recordCommandBuffer(Rendering_Context *ctx, VkCommandBuffer commandBuffer, uint32_t imageIndex) {
-    // BEGIN COMMAND BUFFER (THIS WAS MISSING!)
-    VkCommandBufferBeginInfo beginInfo = {0};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0;
-    beginInfo.pInheritanceInfo = NULL;
+// Opens a pass over one color attachment the graph has already put in
+// COLOR_ATTACHMENT_OPTIMAL. A VkRenderPass has its load op baked in. With a
+// resolveView, view is multisampled and is resolved into it at the end.
+static void beginColorPass(Rendering_Context *ctx, VkCommandBuffer commandBuffer, VkImageView view,
+                           VkImageView resolveView, VkRenderPass renderPass, VkFramebuffer framebuffer,
+                           VkExtent2D extent, bool clear) {
+    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
 
-    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-        printf(RED "[ERROR] " RESET "failed to begin recording command buffer!\n");
-        return;
-    }
+    if (ctx->dynamicRendering) {
+        VkRenderingAttachmentInfo colorAttachment = {0};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = view;
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue = clearColor;
+        if (resolveView != VK_NULL_HANDLE) {
+            // Only the resolved samples outlive the pass
+            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+            colorAttachment.resolveImageView = resolveView;
+            colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
 
-    VkRenderPassBeginInfo renderPassInfo = {0};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = ctx->renderPass;
-    renderPassInfo.framebuffer = ctx->swapChainFramebuffers[imageIndex];
-    renderPassInfo.renderArea.offset.x = 0;
-    renderPassInfo.renderArea.offset.y = 0;
-    renderPassInfo.renderArea.extent = ctx->swapChainExtent;
-    
-    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+        VkRenderingInfo renderingInfo = {0};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.offset.x = 0;
+        renderingInfo.renderArea.offset.y = 0;
+        renderingInfo.renderArea.extent = extent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+
+        ctx->vulkan_context.cmdBeginRendering(commandBuffer, &renderingInfo);
+    } else {
+        VkRenderPassBeginInfo renderPassInfo = {0};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea.offset.x = 0;
+        renderPassInfo.renderArea.offset.y = 0;
+        renderPassInfo.renderArea.extent = extent;
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+
+        ctx->vulkan_context.dispatch.vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->graphicsPipeline);
-    
     VkViewport viewport = {0};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = (float)ctx->swapChainExtent.width;
-    viewport.height = (float)ctx->swapChainExtent.height;
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    ctx->vulkan_context.dispatch.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
     VkRect2D scissor = {0};
     scissor.offset.x = 0;
     scissor.offset.y = 0;
-    scissor.extent = ctx->swapChainExtent;
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-    
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
-    vkCmdEndRenderPass(commandBuffer);
+    scissor.extent = extent;
+    ctx->vulkan_context.dispatch.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+static void endColorPass(Rendering_Context *ctx, VkCommandBuffer commandBuffer) {
+    if (ctx->dynamicRendering) {
+        ctx->vulkan_context.cmdEndRendering(commandBuffer);
+    } else {
+        ctx->vulkan_context.dispatch.vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+// The render pass path's framebuffer for the acquired image; dynamic
+// rendering has none
+static VkFramebuffer swapChainFramebuffer(Rendering_Context *ctx) {
+    return ctx->swapChainFramebuffers ? ctx->swapChainFramebuffers[ctx->imageIndex] : VK_NULL_HANDLE;
+}
+
+static void trianglePass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+
+    // The mesh pass has already cleared and drawn into the scene target
+    bool clear = !ctx->config.meshes;
+    if (ctx->postEnabled) {
+        beginColorPass(ctx, commandBuffer, render_graph_get_view(&ctx->graph, ctx->hdrTarget), VK_NULL_HANDLE,
+                       ctx->sceneRenderPass, ctx->sceneFramebuffer, ctx->renderExtent, clear);
+    } else if (ctx->samples > VK_SAMPLE_COUNT_1_BIT) {
+        beginColorPass(ctx, commandBuffer, render_graph_get_view(&ctx->graph, ctx->msaaTarget),
+                       ctx->swapChainImageViews[ctx->imageIndex], ctx->renderPass, swapChainFramebuffer(ctx),
+                       ctx->swapChainExtent, clear);
+    } else {
+        beginColorPass(ctx, commandBuffer, ctx->swapChainImageViews[ctx->imageIndex], VK_NULL_HANDLE,
+                       ctx->renderPass, swapChainFramebuffer(ctx), ctx->swapChainExtent, clear);
+    }
+    ctx->vulkan_context.dispatch.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->graphicsPipeline);
+    ctx->vulkan_context.dispatch.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    if (ctx->config.particles) {
+        particle_system_record_draw(&ctx->particles, commandBuffer, ctx->currentFrame);
+    }
+
+    // With post processing the UI goes on top of the result instead
+    if (!ctx->postEnabled) {
+        sprite_batch_draw(&ctx->sprites, commandBuffer, ctx->currentFrame, ctx->swapChainExtent);
+    }
+    endColorPass(ctx, commandBuffer);
+}
+
+static void uiPass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    beginColorPass(ctx, commandBuffer, ctx->swapChainImageViews[ctx->imageIndex], VK_NULL_HANDLE,
+                   ctx->renderPass, swapChainFramebuffer(ctx), ctx->swapChainExtent, false);
+    sprite_batch_draw(&ctx->sprites, commandBuffer, ctx->currentFrame, ctx->swapChainExtent);
+    endColorPass(ctx, commandBuffer);
+}
+
+// The same triangle and sprites, in another window
+static void viewPass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_View *view = userData;
+    Rendering_Context *ctx = view->owner;
+    beginColorPass(ctx, commandBuffer, view->imageViews[view->imageIndex], VK_NULL_HANDLE,
+                   ctx->viewRenderPass, view->framebuffers ? view->framebuffers[view->imageIndex] : VK_NULL_HANDLE,
+                   view->extent, true);
+    ctx->vulkan_context.dispatch.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ctx->graphicsPipeline);
+    ctx->vulkan_context.dispatch.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    sprite_batch_draw(&ctx->sprites, commandBuffer, ctx->currentFrame, view->extent);
+    endColorPass(ctx, commandBuffer);
+}
+
+static void bloomDownPass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    post_record_bloom(&ctx->post, commandBuffer, ctx->currentFrame, POST_PASS_BLOOM_DOWN);
+}
+
+static void bloomBlurXPass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    post_record_bloom(&ctx->post, commandBuffer, ctx->currentFrame, POST_PASS_BLOOM_BLUR_X);
+}
+
+static void bloomBlurYPass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    post_record_bloom(&ctx->post, commandBuffer, ctx->currentFrame, POST_PASS_BLOOM_BLUR_Y);
+}
+
+static void postCompositePass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    post_record_composite(&ctx->post, commandBuffer, ctx->currentFrame, ctx->post.direct ? ctx->imageIndex : 0);
+}
+
+static void presentBlitPass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    post_record_blit(&ctx->post, commandBuffer, ctx->currentFrame, render_graph_get_image(&ctx->graph, ctx->ldrTarget),
+                     ctx->swapChainImages[ctx->imageIndex]);
+}
+
+static void recordMeshDraw(Rendering_Context *ctx, VkCommandBuffer commandBuffer, uint32_t phase) {
+    // Post processing: a single HDR target instead of one per swapchain image
+    VkImageView colorView = ctx->postEnabled ? render_graph_get_view(&ctx->graph, ctx->hdrTarget)
+                                             : ctx->swapChainImageViews[ctx->imageIndex];
+    mesh_renderer_record_draw(&ctx->meshes, commandBuffer, ctx->currentFrame, phase,
+                              ctx->postEnabled ? 0 : ctx->imageIndex, colorView,
+                              render_graph_get_view(&ctx->graph, ctx->depthTarget), ctx->swapChainExtent);
+}
+
+static void meshEarlyCullPass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    mesh_renderer_record_cull(&ctx->meshes, commandBuffer, ctx->currentFrame, MESH_PHASE_EARLY);
+}
+
+static void meshEarlyDrawPass(VkCommandBuffer commandBuffer, void *userData) {
+    recordMeshDraw(userData, commandBuffer, MESH_PHASE_EARLY);
+}
+
+static void meshPyramidPass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    mesh_renderer_record_hiz(&ctx->meshes, commandBuffer);
+}
+
+static void meshLateCullPass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    mesh_renderer_record_cull(&ctx->meshes, commandBuffer, ctx->currentFrame, MESH_PHASE_LATE);
+}
+
+static void meshLateDrawPass(VkCommandBuffer commandBuffer, void *userData) {
+    recordMeshDraw(userData, commandBuffer, MESH_PHASE_LATE);
+}
+
+static void particlePass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    particle_system_record_simulate(&ctx->particles, commandBuffer, ctx->currentFrame);
+}
+
+static void readbackPass(VkCommandBuffer commandBuffer, void *userData) {
+    Rendering_Context *ctx = userData;
+    readback_record_copy(&ctx->readback, commandBuffer, ctx->currentFrame, ctx->readbackSlot,
+                         ctx->swapChainImages[ctx->imageIndex]);
+}
+
+// Everything else in the frame is static, so what changed since the last
+// present is where sprites were plus where they are now.
+static void computeDamage(Rendering_Context *ctx, VkRectLayerKHR *rect) {
+    const float *now = ctx->sprites.bounds;
+    float *prev = ctx->damageBounds;
+    float width = (float)ctx->swapChainExtent.width;
+    float height = (float)ctx->swapChainExtent.height;
+
+    float x0 = now[0] < prev[0] ? now[0] : prev[0];
+    float y0 = now[1] < prev[1] ? now[1] : prev[1];
+    float x1 = now[2] > prev[2] ? now[2] : prev[2];
+    float y1 = now[3] > prev[3] ? now[3] : prev[3];
+    if (x0 < 0.0f) x0 = 0.0f;
+    if (y0 < 0.0f) y0 = 0.0f;
+    if (x1 > width) x1 = width;
+    if (y1 > height) y1 = height;
+    memcpy(prev, now, sizeof(ctx->damageBounds));
+
+    rect->layer = 0;
+    if (ctx->fullDamage || x0 >= x1 || y0 >= y1) {
+        // Nothing to narrow it down with; zero rectangles would mean the same
+        rect->offset.x = 0;
+        rect->offset.y = 0;
+        rect->extent = ctx->swapChainExtent;
+    } else {
+        rect->offset.x = (int32_t)x0;
+        rect->offset.y = (int32_t)y0;
+        rect->extent.width = (uint32_t)(x1 + 1.0f) - (uint32_t)x0;
+        rect->extent.height = (uint32_t)(y1 + 1.0f) - (uint32_t)y0;
+        if ((uint32_t)x0 + rect->extent.width > ctx->swapChainExtent.width) {
+            rect->extent.width = ctx->swapChainExtent.width - (uint32_t)x0;
+        }
+        if ((uint32_t)y0 + rect->extent.height > ctx->swapChainExtent.height) {
+            rect->extent.height = ctx->swapChainExtent.height - (uint32_t)y0;
+        }
+    }
+    ctx->fullDamage = false;
+}
 
-    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+static void recordCommandBuffer(Rendering_Context *ctx, VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    // BEGIN COMMAND BUFFER (THIS WAS MISSING!)
+    VkCommandBufferBeginInfo beginInfo = {0};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = 0;
+    beginInfo.pInheritanceInfo = NULL;
+
+    if (ctx->vulkan_context.dispatch.vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        printf(RED "[ERROR] " RESET "failed to begin recording command buffer!\n");
+        return;
+    }
+
+    if (ctx->resolutionEnabled) resolution_begin(&ctx->resolution, commandBuffer, ctx->currentFrame);
+
+    // New glyphs must land in the atlas before any pass samples it
+    text_record_uploads(&ctx->text, commandBuffer);
+
+    // Barriers and layout transitions come from the compiled graph
+    ctx->imageIndex = imageIndex;
+    render_graph_set_image(&ctx->graph, ctx->swapChainTarget,
+                           ctx->swapChainImages[imageIndex], ctx->swapChainImageViews[imageIndex]);
+    if (ctx->captureEnabled) {
+        ctx->readbackSlot = -1;
+        if (!ctx->config.captureOnRequest || ctx->captureRequested) {
+            ctx->readbackSlot = readback_begin(&ctx->readback, ctx->currentFrame, ctx->frameNumber,
+                                               ctx->swapChainExtent, ctx->swapChainImageFormat);
+            ctx->captureRequested = false;
+        }
+        render_graph_set_buffer(&ctx->graph, ctx->readbackTarget, readback_buffer(&ctx->readback, ctx->readbackSlot));
+    }
+    if (ctx->config.meshes) {
+        render_graph_set_image(&ctx->graph, ctx->hizTarget, mesh_renderer_hiz_image(&ctx->meshes), ctx->meshes.hizView);
+        render_graph_set_buffer(&ctx->graph, ctx->meshVisibilityTarget,
+                                mesh_renderer_visibility_buffer(&ctx->meshes, ctx->currentFrame));
+        if (!ctx->meshes.useMeshShader) {
+            render_graph_set_buffer(&ctx->graph, ctx->meshDrawTarget, mesh_renderer_draw_buffer(&ctx->meshes, ctx->currentFrame));
+        }
+    }
+    render_graph_execute(&ctx->graph, commandBuffer);
+
+    // Other windows go in the same command buffer and submit
+    for (uint32_t i = 0; i < RENDERING_MAX_VIEWS; i++) {
+        Rendering_View *view = &ctx->views[i];
+        if (!view->acquired) continue;
+        render_graph_set_image(&view->graph, view->target, view->images[view->imageIndex],
+                               view->imageViews[view->imageIndex]);
+        render_graph_execute(&view->graph, commandBuffer);
+    }
+
+    if (ctx->resolutionEnabled) resolution_end(&ctx->resolution, commandBuffer, ctx->currentFrame);
+    if (ctx->vulkan_context.dispatch.vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
         printf(RED "[ERROR] " RESET "failed to record command buffer!\n");
     }
 }
 
-char* readFile(const char *path, size_t *outSize)
-{
-  FILE *file = fopen(path, "rb");
-  if (!file) {
-    printf(RED "[ERROR] " RESET "failed to open file: %s\n", path);
-    return NULL;
+// ========== COMMAND CACHE ==========
+
+// The recordings may still be executing, so the deletion queue frees them
+static void freeCachedCommands(Rendering_Context *ctx) {
+    if (ctx->cachedCommands && ctx->commandPool != VK_NULL_HANDLE) {
+        deletion_queue_push_commands(&ctx->deletion, ctx->commandPool, ctx->cachedCommands,
+                                     ctx->swapChainImageCount * MAX_FRAMES_IN_FLIGHT);
+    } else {
+        free(ctx->cachedCommands);
+    }
+    free(ctx->cachedKeys);
+    ctx->cachedCommands = NULL;
+    ctx->cachedKeys = NULL;
+}
+
+// Allocated on first use and dropped with the swapchain, whose image count
+// and framebuffers the recordings depend on
+static bool ensureCachedCommands(Rendering_Context *ctx) {
+    if (ctx->cachedCommands) return true;
+    uint32_t count = ctx->swapChainImageCount * MAX_FRAMES_IN_FLIGHT;
+    ctx->cachedCommands = calloc(count, sizeof(VkCommandBuffer));
+    ctx->cachedKeys = calloc(count, sizeof(uint64_t));
+    if (!ctx->cachedCommands || !ctx->cachedKeys) {
+        freeCachedCommands(ctx);
+        return false;
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = ctx->commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = count;
+    if (vkAllocateCommandBuffers(ctx->vulkan_context.device, &allocInfo, ctx->cachedCommands) != VK_SUCCESS) {
+        printf(RED "[ERROR] " RESET "failed to allocate cached command buffers!\n");
+        free(ctx->cachedCommands);
+        ctx->cachedCommands = NULL;
+        freeCachedCommands(ctx);
+        return false;
+    }
+    return true;
+}
+
+// What a recording for this frame depends on, or 0 when the frame must be
+// recorded fresh. Captures, post pass timings, mesh culling and particle
+// parameters change every frame. Pending glyph uploads must run exactly
+// once, and other windows bring their own swapchain images.
+static uint64_t commandsKey(Rendering_Context *ctx, uint32_t frame) {
+    if (!ctx->config.cacheCommands || ctx->config.offscreen) return 0;
+    if (ctx->captureEnabled || ctx->config.meshes || ctx->config.particles || ctx->postEnabled ||
+        ctx->text.font.dirty) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < RENDERING_MAX_VIEWS; i++) {
+        if (ctx->views[i].acquired) return 0;
+    }
+    if (!ensureCachedCommands(ctx)) return 0;
+    uint64_t key = sprite_batch_signature(&ctx->sprites, frame);
+    key ^= (ctx->commandsGeneration + 1) * 0x9E3779B97F4A7C15ULL;
+    return key | 1;
+}
+
+void rendering_invalidate_commands(Rendering_Context *ctx) {
+    if (ctx) ctx->commandsGeneration++;
+}
+
+// What the particle points are drawn in: the triangle pass's render pass
+static VkRenderPass particleRenderPass(Rendering_Context *ctx) {
+  if (ctx->dynamicRendering) return VK_NULL_HANDLE;
+  return ctx->postEnabled ? ctx->sceneRenderPass : ctx->renderPass;
+}
+
+// The scene's part of the swapchain extent. Viewport and scissor are dynamic
+// state and the HDR target keeps its full size, so a new scale rebuilds
+// nothing.
+static void updateRenderExtent(Rendering_Context *ctx) {
+  ctx->renderExtent = ctx->resolutionEnabled ? resolution_extent(&ctx->resolution, ctx->swapChainExtent)
+                                             : ctx->swapChainExtent;
+  if (ctx->postEnabled) post_set_scene_extent(&ctx->post, ctx->renderExtent);
+}
+
+// Render pass path with post processing: the triangle draws into the HDR
+// transient, whose view changes with every recompile
+static bool createSceneFramebuffer(Rendering_Context *ctx, VkImageView hdrView) {
+  if (ctx->sceneFramebuffer != VK_NULL_HANDLE) {
+    vkDestroyFramebuffer(ctx->vulkan_context.device, ctx->sceneFramebuffer, NULL);
+    ctx->sceneFramebuffer = VK_NULL_HANDLE;
   }
 
-  fseek(file, 0, SEEK_END);
-  long fileSize = ftell(file);
-  fseek(file, 0, SEEK_SET);
+  VkFramebufferCreateInfo framebufferInfo = {0};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = ctx->sceneRenderPass;
+  framebufferInfo.attachmentCount = 1;
+  framebufferInfo.pAttachments = &hdrView;
+  framebufferInfo.width = ctx->swapChainExtent.width;
+  framebufferInfo.height = ctx->swapChainExtent.height;
+  framebufferInfo.layers = 1;
+  if (vkCreateFramebuffer(ctx->vulkan_context.device, &framebufferInfo, NULL, &ctx->sceneFramebuffer) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create scene framebuffer\n");
+    return false;
+  }
+  return true;
+}
 
-  if (fileSize < 0) {
-    printf(RED "[ERROR] " RESET "failed to determine file size: %s\n", path);
-    fclose(file);
-    return NULL;
+static bool createFramebuffers(Rendering_Context *ctx);
+
+// Declare the frame's passes. Compilation is cached, so this only does real
+// work when the topology (or the swapchain format/extent) changes.
+static bool buildRenderGraph(Rendering_Context *ctx) {
+  render_graph_reset(&ctx->graph);
+
+  RG_Image_Desc swapChainDesc = {0};
+  swapChainDesc.format = ctx->swapChainImageFormat;
+  swapChainDesc.extent = ctx->swapChainExtent;
+  swapChainDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+
+  // The acquire semaphore is waited on at COLOR_ATTACHMENT_OUTPUT, so that is
+  // where the first transition has to start from. Offscreen targets are never
+  // presented; they are left ready for a copy.
+  ctx->swapChainTarget = render_graph_import_image(&ctx->graph, "swapchain", &swapChainDesc,
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      ctx->config.offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+  // With post processing the scene renders into HDR and only the chain's
+  // output and the UI touch the swapchain image
+  RG_Handle sceneTarget = ctx->swapChainTarget;
+  RG_Image_Desc hdrDesc = swapChainDesc;
+  hdrDesc.format = POST_HDR_FORMAT;
+  if (ctx->postEnabled) {
+    ctx->hdrTarget = render_graph_create_image(&ctx->graph, "hdr", &hdrDesc);
+    sceneTarget = ctx->hdrTarget;
   }
 
-  char *buffer = malloc(fileSize);
-  if (!buffer) {
-    printf(RED "[ERROR] " RESET "failed to allocate memory for file: %s\n", path);
-    fclose(file);
-    return NULL;
+  // MSAA: the scene pass draws into a multisampled transient and resolves
+  // it into the target as the pass ends
+  if (ctx->samples > VK_SAMPLE_COUNT_1_BIT) {
+    RG_Image_Desc msaaDesc = swapChainDesc;
+    msaaDesc.samples = ctx->samples;
+    ctx->msaaTarget = render_graph_create_image(&ctx->graph, "msaa", &msaaDesc);
   }
 
-  size_t bytesRead = fread(buffer, 1, fileSize, file);
-  if (bytesRead != (size_t)fileSize) {
-    printf(RED "[ERROR] " RESET "failed to read file: %s\n", path);
-    free(buffer);
-    fclose(file);
-    return NULL;
+  if (ctx->config.meshes) {
+    RG_Image_Desc depthDesc = swapChainDesc;
+    depthDesc.format = MESH_DEPTH_FORMAT;
+    ctx->depthTarget = render_graph_create_image(&ctx->graph, "depth", &depthDesc);
+
+    // The pyramid persists across frames: the previous frame's build is the
+    // first thing this one reads. The cull passes sample it in GENERAL.
+    RG_Image_Desc hizDesc = swapChainDesc;
+    hizDesc.format = MESH_HIZ_FORMAT;
+    ctx->hizTarget = render_graph_import_image(&ctx->graph, "hi-z", &hizDesc, VK_IMAGE_LAYOUT_GENERAL,
+                                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+    render_graph_set_history(&ctx->graph, ctx->hizTarget, VK_ACCESS_SHADER_WRITE_BIT);
+    // Swapped in per frame like the swapchain image
+    ctx->meshVisibilityTarget = render_graph_import_buffer(&ctx->graph, "mesh visibility", VK_NULL_HANDLE, 0);
+    if (!ctx->meshes.useMeshShader) {
+      ctx->meshDrawTarget = render_graph_import_buffer(&ctx->graph, "mesh draws", VK_NULL_HANDLE, 0);
+    }
+
+    // Early: what the previous frame's pyramid shows, then a pyramid of
+    // that; late: whatever the new pyramid disoccludes
+    for (uint32_t phase = MESH_PHASE_EARLY; phase <= MESH_PHASE_LATE; phase++) {
+      bool early = phase == MESH_PHASE_EARLY;
+      RG_Handle cull = render_graph_add_pass(&ctx->graph, early ? "mesh cull" : "mesh cull late", RG_PASS_COMPUTE,
+                                             early ? meshEarlyCullPass : meshLateCullPass, ctx);
+      render_graph_read(&ctx->graph, cull, ctx->hizTarget, RG_USE_STORAGE);
+      render_graph_write(&ctx->graph, cull, ctx->meshVisibilityTarget, RG_USE_STORAGE);
+
+      RG_Handle draw = render_graph_add_pass(&ctx->graph, early ? "meshes" : "meshes late", RG_PASS_GRAPHICS,
+                                             early ? meshEarlyDrawPass : meshLateDrawPass, ctx);
+      if (ctx->meshes.useMeshShader) {
+        render_graph_read(&ctx->graph, draw, ctx->meshVisibilityTarget, RG_USE_STORAGE);
+      } else {
+        render_graph_write(&ctx->graph, cull, ctx->meshDrawTarget, RG_USE_STORAGE);
+        render_graph_read(&ctx->graph, draw, ctx->meshDrawTarget, RG_USE_INDIRECT);
+      }
+      render_graph_write(&ctx->graph, draw, ctx->depthTarget, RG_USE_DEPTH_ATTACHMENT);
+      render_graph_write(&ctx->graph, draw, sceneTarget, RG_USE_COLOR_ATTACHMENT);
+
+      if (early) {
+        RG_Handle pyramid = render_graph_add_pass(&ctx->graph, "hi-z", RG_PASS_COMPUTE, meshPyramidPass, ctx);
+        render_graph_read(&ctx->graph, pyramid, ctx->depthTarget, RG_USE_SAMPLED);
+        render_graph_write(&ctx->graph, pyramid, ctx->hizTarget, RG_USE_STORAGE);
+      }
+    }
   }
 
-  fclose(file);
+  if (ctx->config.particles) {
+    // Persistent; the simulation orders itself after the previous frame's draw
+    Particle_System *ps = &ctx->particles;
+    ctx->particleStateTarget = render_graph_import_buffer(&ctx->graph, "particles", ps->particles.buffer,
+                                                          (VkDeviceSize)ps->capacity * sizeof(Particle_Gpu));
+    ctx->particleListTarget = render_graph_import_buffer(&ctx->graph, "particle lists", ps->indices.buffer,
+                                                         3 * (VkDeviceSize)ps->capacity * sizeof(uint32_t));
+    ctx->particleCountersTarget = render_graph_import_buffer(&ctx->graph, "particle counters", ps->counters.buffer,
+                                                             sizeof(Particle_Counters));
+    RG_Handle simulate = render_graph_add_pass(&ctx->graph, "particles", RG_PASS_COMPUTE, particlePass, ctx);
+    render_graph_write(&ctx->graph, simulate, ctx->particleStateTarget, RG_USE_STORAGE);
+    render_graph_write(&ctx->graph, simulate, ctx->particleListTarget, RG_USE_STORAGE);
+    render_graph_write(&ctx->graph, simulate, ctx->particleCountersTarget, RG_USE_STORAGE);
+  }
 
-  if (outSize) {
-    *outSize = fileSize;
+  RG_Handle triangle = render_graph_add_pass(&ctx->graph, "triangle", RG_PASS_GRAPHICS, trianglePass, ctx);
+  render_graph_write(&ctx->graph, triangle, sceneTarget, RG_USE_COLOR_ATTACHMENT);
+  if (ctx->samples > VK_SAMPLE_COUNT_1_BIT) {
+    render_graph_write(&ctx->graph, triangle, ctx->msaaTarget, RG_USE_COLOR_ATTACHMENT);
+  }
+  if (ctx->config.particles) {
+    // The points' vertex shader reads the particles through the alive list;
+    // the counters are the draw's arguments
+    render_graph_read(&ctx->graph, triangle, ctx->particleStateTarget, RG_USE_STORAGE);
+    render_graph_read(&ctx->graph, triangle, ctx->particleListTarget, RG_USE_STORAGE);
+    render_graph_read(&ctx->graph, triangle, ctx->particleCountersTarget, RG_USE_INDIRECT);
   }
 
-  return buffer;
-}
+  if (ctx->postEnabled) {
+    if (ctx->post.bloom) {
+      // Half-size ping-pong pair; the result ends up back in the first one
+      RG_Image_Desc bloomDesc = hdrDesc;
+      bloomDesc.extent.width = swapChainDesc.extent.width > 1 ? swapChainDesc.extent.width / 2 : 1;
+      bloomDesc.extent.height = swapChainDesc.extent.height > 1 ? swapChainDesc.extent.height / 2 : 1;
+      ctx->bloomTargets[0] = render_graph_create_image(&ctx->graph, "bloom a", &bloomDesc);
+      ctx->bloomTargets[1] = render_graph_create_image(&ctx->graph, "bloom b", &bloomDesc);
+
+      RG_Handle down = render_graph_add_pass(&ctx->graph, "bloom down", RG_PASS_COMPUTE, bloomDownPass, ctx);
+      render_graph_read(&ctx->graph, down, ctx->hdrTarget, RG_USE_SAMPLED);
+      render_graph_write(&ctx->graph, down, ctx->bloomTargets[0], RG_USE_STORAGE);
+      RG_Handle blurX = render_graph_add_pass(&ctx->graph, "bloom blur x", RG_PASS_COMPUTE, bloomBlurXPass, ctx);
+      render_graph_read(&ctx->graph, blurX, ctx->bloomTargets[0], RG_USE_SAMPLED);
+      render_graph_write(&ctx->graph, blurX, ctx->bloomTargets[1], RG_USE_STORAGE);
+      RG_Handle blurY = render_graph_add_pass(&ctx->graph, "bloom blur y", RG_PASS_COMPUTE, bloomBlurYPass, ctx);
+      render_graph_read(&ctx->graph, blurY, ctx->bloomTargets[1], RG_USE_SAMPLED);
+      render_graph_write(&ctx->graph, blurY, ctx->bloomTargets[0], RG_USE_STORAGE);
+    }
+
+    // Every per-pixel effect is one dispatch, stored straight into the
+    // swapchain image when it allows storage, else blitted across
+    RG_Handle composite = render_graph_add_pass(&ctx->graph, "post", RG_PASS_COMPUTE, postCompositePass, ctx);
+    render_graph_read(&ctx->graph, composite, ctx->hdrTarget, RG_USE_SAMPLED);
+    if (ctx->post.bloom) render_graph_read(&ctx->graph, composite, ctx->bloomTargets[0], RG_USE_SAMPLED);
+    if (ctx->postDirect) {
+      render_graph_write(&ctx->graph, composite, ctx->swapChainTarget, RG_USE_STORAGE);
+    } else {
+      ctx->ldrTarget = render_graph_create_image(&ctx->graph, "ldr", &hdrDesc);
+      render_graph_write(&ctx->graph, composite, ctx->ldrTarget, RG_USE_STORAGE);
+      RG_Handle blit = render_graph_add_pass(&ctx->graph, "present blit", RG_PASS_TRANSFER, presentBlitPass, ctx);
+      render_graph_read(&ctx->graph, blit, ctx->ldrTarget, RG_USE_TRANSFER);
+      render_graph_write(&ctx->graph, blit, ctx->swapChainTarget, RG_USE_TRANSFER);
+    }
+
+    RG_Handle ui = render_graph_add_pass(&ctx->graph, "ui", RG_PASS_GRAPHICS, uiPass, ctx);
+    render_graph_write(&ctx->graph, ui, ctx->swapChainTarget, RG_USE_COLOR_ATTACHMENT);
+  }
+
+  if (ctx->captureEnabled) {
+    // Writing the imported buffer keeps the copy alive through culling
+    ctx->readbackTarget = render_graph_import_buffer(&ctx->graph, "readback", VK_NULL_HANDLE, 0);
+    RG_Handle readback = render_graph_add_pass(&ctx->graph, "readback", RG_PASS_TRANSFER, readbackPass, ctx);
+    render_graph_read(&ctx->graph, readback, ctx->swapChainTarget, RG_USE_TRANSFER);
+    render_graph_write(&ctx->graph, readback, ctx->readbackTarget, RG_USE_TRANSFER);
+  }
+
+  if (!render_graph_compile(&ctx->graph)) return false;
 
-void freeSwapChainSupportDetails(SwapChainSupportDetails *details) {
-  if (details->formats) {
-    free(details->formats);
-    details->formats = NULL;
+  // Descriptors and framebuffers follow the transient views
+  if (ctx->samples > VK_SAMPLE_COUNT_1_BIT && !ctx->dynamicRendering && !createFramebuffers(ctx)) return false;
+  VkImageView hdrView = VK_NULL_HANDLE;
+  if (ctx->postEnabled) {
+    hdrView = render_graph_get_view(&ctx->graph, ctx->hdrTarget);
+    if (!ctx->dynamicRendering && !createSceneFramebuffer(ctx, hdrView)) return false;
+
+    VkImageView bloomViews[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+    if (ctx->post.bloom) {
+      bloomViews[0] = render_graph_get_view(&ctx->graph, ctx->bloomTargets[0]);
+      bloomViews[1] = render_graph_get_view(&ctx->graph, ctx->bloomTargets[1]);
+    }
+    VkImageView ldrView = ctx->postDirect ? VK_NULL_HANDLE : render_graph_get_view(&ctx->graph, ctx->ldrTarget);
+    if (!post_set_targets(&ctx->post, hdrView, bloomViews, ctx->postDirect ? ctx->swapChainImageViews : &ldrView,
+                          ctx->postDirect ? ctx->swapChainImageCount : 1, ctx->swapChainImageFormat,
+                          ctx->postDirect, ctx->swapChainExtent)) {
+      return false;
+    }
   }
-  if (details->presentModes) {
-    free(details->presentModes);
-    details->presentModes = NULL;
+  updateRenderExtent(ctx);
+  if (ctx->config.meshes) {
+    return mesh_renderer_set_targets(&ctx->meshes, ctx->postEnabled ? &hdrView : ctx->swapChainImageViews,
+                                     ctx->postEnabled ? 1 : ctx->swapChainImageCount,
+                                     render_graph_get_view(&ctx->graph, ctx->depthTarget), ctx->swapChainExtent);
   }
+  return true;
 }
 
-SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
+// Arrays come from the scratch arena; the caller resets it
+SwapChainSupportDetails querySwapChainSupport(Arena *scratch, VkPhysicalDevice device, VkSurfaceKHR surface) {
   SwapChainSupportDetails details = {0};
 
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
 
   vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &details.formatCount, NULL);
   if (details.formatCount != 0) {
-    details.formats = malloc(details.formatCount * sizeof(VkSurfaceFormatKHR));
+    details.formats = ARENA_ALLOC(scratch, VkSurfaceFormatKHR, details.formatCount);
     if (details.formats) {
       vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &details.formatCount, details.formats);
     }
@@ -139,7 +625,7 @@ SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurface
 
   vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &details.presentModeCount, NULL);
   if (details.presentModeCount != 0) {
-    details.presentModes = malloc(details.presentModeCount * sizeof(VkPresentModeKHR));
+    details.presentModes = ARENA_ALLOC(scratch, VkPresentModeKHR, details.presentModeCount);
     if (details.presentModes) {
       vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &details.presentModeCount, details.presentModes);
     }
@@ -158,6 +644,22 @@ VkSurfaceFormatKHR chooseSwapSurfaceFormat(VkSurfaceFormatKHR *availableFormats,
   return availableFormats[0];
 }
 
+// The post chain can store straight into a UNORM image (applying the sRGB
+// curve itself); sRGB formats are practically never storage capable
+static bool chooseStorageSurfaceFormat(Vulkan_Context *vk, const SwapChainSupportDetails *support,
+                                       VkSurfaceFormatKHR *format) {
+  if (!(support->capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT)) return false;
+  for (uint32_t i = 0; i < support->formatCount; i++) {
+    VkSurfaceFormatKHR candidate = support->formats[i];
+    if ((candidate.format == VK_FORMAT_B8G8R8A8_UNORM || candidate.format == VK_FORMAT_R8G8B8A8_UNORM) &&
+        candidate.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR && post_storage_format(vk, candidate.format)) {
+      *format = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
 VkPresentModeKHR chooseSwapPresentMode(VkPresentModeKHR *availablePresentModes, uint32_t presentModeCount) {
   for (uint32_t i = 0; i < presentModeCount; i++) {
     if (availablePresentModes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
@@ -189,35 +691,26 @@ VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR *capabilities, uint32
   }
 }
 
-VkShaderModule createShaderModule(const char *code, size_t codeSize, Vulkan_Context *vk_ctx) {
-  VkShaderModuleCreateInfo createInfo = {0};
-  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = codeSize;
-  createInfo.pCode = (const uint32_t*)code;
-  VkShaderModule shaderModule;
-  if (vkCreateShaderModule(vk_ctx->device, &createInfo, NULL, &shaderModule) != VK_SUCCESS) {
-    printf(RED "[ERROR] " RESET "failed to create shader module\n");
+static bool createSwapChain(Rendering_Context *ctx, VkSwapchainKHR oldSwapChain) {
+  Arena *scratch = arena_scratch();
+  size_t mark = arena_mark(scratch);
+  SwapChainSupportDetails swapChainSupport = querySwapChainSupport(scratch, ctx->vulkan_context.physicalDevice,
+                                                                   ctx->vulkan_context.surface);
+
+  VkSurfaceFormatKHR surfaceFormat;
+  ctx->postDirect = ctx->postEnabled &&
+                    chooseStorageSurfaceFormat(&ctx->vulkan_context, &swapChainSupport, &surfaceFormat);
+  if (!ctx->postDirect) {
+    surfaceFormat = chooseSwapSurfaceFormat(
+        swapChainSupport.formats, 
+        swapChainSupport.formatCount
+        );
   }
-  return shaderModule;
-}
-
-bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Platform_Context *platform) {
-  if (!ctx || !vulkan_context) return false;
-
-  ctx->vulkan_context = *vulkan_context;
-  ctx->currentFrame = 0;  // INITIALIZE currentFrame
-  
-  SwapChainSupportDetails swapChainSupport = querySwapChainSupport(ctx->vulkan_context.physicalDevice, ctx->vulkan_context.surface);
-
-  VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(
-      swapChainSupport.formats, 
-      swapChainSupport.formatCount
-      );
   VkPresentModeKHR presentMode = chooseSwapPresentMode(
       swapChainSupport.presentModes, 
       swapChainSupport.presentModeCount
       );
-  VkExtent2D extent = chooseSwapExtent(&swapChainSupport.capabilities, platform->width, platform->height);
+  VkExtent2D extent = chooseSwapExtent(&swapChainSupport.capabilities, ctx->platform->width, ctx->platform->height);
 
   uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
   if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
@@ -233,6 +726,24 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
   createInfo.imageExtent = extent;
   createInfo.imageArrayLayers = 1;
   createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  if (ctx->captureEnabled) {
+    if (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+      createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    } else {
+      printf(YELLOW "[WARNING] " RESET "swapchain can't be a transfer source, capture disabled\n");
+      ctx->captureEnabled = false;
+    }
+  }
+  if (ctx->postDirect) {
+    createInfo.imageUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+  } else if (ctx->postEnabled) {
+    if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+      printf(RED "[ERROR] " RESET "swapchain can take neither storage writes nor blits from the post chain\n");
+      arena_reset_to(scratch, mark);
+      return false;
+    }
+    createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  }
 
   QueueFamilyIndices indices = findQueueFamilies(ctx->vulkan_context.physicalDevice, ctx->vulkan_context.surface);
   uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
@@ -250,11 +761,11 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  createInfo.oldSwapchain = oldSwapChain;
 
   if (vkCreateSwapchainKHR(ctx->vulkan_context.device, &createInfo, NULL, &ctx->swapChain) != VK_SUCCESS) {
     printf(RED "[ERROR] " RESET "failed to create swap chain!\n");
-    freeSwapChainSupportDetails(&swapChainSupport);
+    arena_reset_to(scratch, mark);
     return false;
   }
 
@@ -263,7 +774,7 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
   ctx->swapChainImages = malloc(imageCount * sizeof(VkImage));
   if (!ctx->swapChainImages) {
     printf(RED "[ERROR] " RESET "failed to allocate memory for swapChainImages\n");
-    freeSwapChainSupportDetails(&swapChainSupport);
+    arena_reset_to(scratch, mark);
     return false;
   }
   vkGetSwapchainImagesKHR(ctx->vulkan_context.device, ctx->swapChain, &imageCount, ctx->swapChainImages);
@@ -271,11 +782,48 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
   ctx->swapChainImageFormat = surfaceFormat.format;
   ctx->swapChainExtent = extent;
 
-  // FREE THE SWAP CHAIN SUPPORT DETAILS (MEMORY LEAK FIX)
-  freeSwapChainSupportDetails(&swapChainSupport);
+  arena_reset_to(scratch, mark);
 
   printf(GREEN "[OK] " RESET "Swapchain\n");
+  return true;
+}
+
+// Headless stand-in for the swapchain: one image per frame in flight, so the
+// frame fence is all the synchronization an image needs.
+static bool createOffscreenTargets(Rendering_Context *ctx) {
+  ctx->swapChainImageCount = MAX_FRAMES_IN_FLIGHT;
+  ctx->swapChainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  ctx->postDirect = ctx->postEnabled && post_storage_format(&ctx->vulkan_context, VK_FORMAT_R8G8B8A8_UNORM);
+  if (ctx->postDirect) {
+    // Same bytes as the sRGB target; the post chain encodes
+    ctx->swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+  } else if (ctx->postEnabled) {
+    usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  }
+  ctx->swapChainExtent = ctx->config.offscreenExtent;
+  ctx->swapChainImages = calloc(ctx->swapChainImageCount, sizeof(VkImage));
+  ctx->offscreenMemory = calloc(ctx->swapChainImageCount, sizeof(VkDeviceMemory));
+  if (!ctx->swapChainImages || !ctx->offscreenMemory) {
+    printf(RED "[ERROR] " RESET "failed to allocate memory for offscreen targets\n");
+    return false;
+  }
+
+  for (uint32_t i = 0; i < ctx->swapChainImageCount; i++) {
+    if (!vulkan_create_image(&ctx->vulkan_context, ctx->swapChainExtent.width, ctx->swapChainExtent.height, 1,
+                             ctx->swapChainImageFormat, usage,
+                             &ctx->swapChainImages[i], &ctx->offscreenMemory[i])) {
+      printf(RED "[ERROR] " RESET "failed to create offscreen target\n");
+      return false;
+    }
+  }
 
+  printf(GREEN "[OK] " RESET "Offscreen Targets (%ux%u)\n", ctx->swapChainExtent.width, ctx->swapChainExtent.height);
+  return true;
+}
+
+static bool createImageViews(Rendering_Context *ctx) {
   ctx->swapChainImageViews = malloc(ctx->swapChainImageCount * sizeof(VkImageView));
   if (ctx->swapChainImageViews == NULL) {
     printf(RED "[ERROR] " RESET "failed to allocate memory for swapChainImageViews\n");
@@ -299,10 +847,67 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
     viewCreateInfo.subresourceRange.layerCount = 1;
     if (vkCreateImageView(ctx->vulkan_context.device, &viewCreateInfo, NULL, &ctx->swapChainImageViews[i]) != VK_SUCCESS) {
       printf(RED "[ERROR] " RESET "failed to create image views\n");
+      return false;
     }
   }
   printf(GREEN "[OK] " RESET "Image Views\n");
+  return true;
+}
+
+// clear: whether this is the first pass drawing into the image. Above one
+// sample, attachment 0 is multisampled and resolves into attachment 1.
+static bool createRenderPass(Rendering_Context *ctx, VkFormat format, VkSampleCountFlagBits samples, bool clear,
+                             VkRenderPass *renderPass) {
+  bool multisampled = samples > VK_SAMPLE_COUNT_1_BIT;
+  VkAttachmentDescription attachments[2] = {{0}};
+  VkAttachmentDescription *colorAttachment = &attachments[0];
+  colorAttachment->format = format;
+  colorAttachment->samples = samples;
+  colorAttachment->loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+  colorAttachment->storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment->stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment->stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  // The render graph owns layout transitions and synchronization
+  colorAttachment->initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachment->finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentDescription *resolveAttachment = &attachments[1];
+  *resolveAttachment = *colorAttachment;
+  resolveAttachment->samples = VK_SAMPLE_COUNT_1_BIT;
+  resolveAttachment->loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  resolveAttachment->storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+  VkAttachmentReference colorAttachmentRef = {0};
+  colorAttachmentRef.attachment = 0;
+  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  VkAttachmentReference resolveAttachmentRef = {0};
+  resolveAttachmentRef.attachment = 1;
+  resolveAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass = {0};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorAttachmentRef;
+  subpass.pResolveAttachments = multisampled ? &resolveAttachmentRef : NULL;
+
+  VkRenderPassCreateInfo renderPassInfo = {0};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = multisampled ? 2 : 1;
+  renderPassInfo.pAttachments = attachments;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = 0;
+  renderPassInfo.pDependencies = NULL;
+
+  if (vkCreateRenderPass(ctx->vulkan_context.device, &renderPassInfo, NULL, renderPass) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create render pass\n");
+    return false;
+  }
+  printf(GREEN "[OK] " RESET "Render Pass\n");
+  return true;
+}
 
+static bool createGraphicsPipeline(Rendering_Context *ctx) {
   printf("fetching shaders ...\n");
 
   size_t vertSize, fragSize;
@@ -394,7 +999,7 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
   VkPipelineMultisampleStateCreateInfo multisampling = {0};
   multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
   multisampling.sampleShadingEnable = VK_FALSE;
-  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.rasterizationSamples = ctx->samples;
   multisampling.minSampleShading = 1.0f;
   multisampling.pSampleMask = NULL;
   multisampling.alphaToCoverageEnable = VK_FALSE;
@@ -434,50 +1039,17 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
   }
   printf(GREEN "[OK] " RESET "Pipeline Layout\n");
 
-  VkAttachmentDescription colorAttachment = {0};
-  colorAttachment.format = ctx->swapChainImageFormat;
-  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-  VkAttachmentReference colorAttachmentRef = {0};
-  colorAttachmentRef.attachment = 0;
-  colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-  VkSubpassDescription subpass = {0};
-  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorAttachmentRef;
-
-  VkSubpassDependency dependency = {0};
-  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-  dependency.dstSubpass = 0;
-  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.srcAccessMask = 0;
-  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-  VkRenderPassCreateInfo renderPassInfo = {0};
-  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-  renderPassInfo.attachmentCount = 1;
-  renderPassInfo.pAttachments = &colorAttachment;
-  renderPassInfo.subpassCount = 1;
-  renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
-
-  if (vkCreateRenderPass(ctx->vulkan_context.device, &renderPassInfo, NULL, &ctx->renderPass) != VK_SUCCESS) {
-    printf(RED "[ERROR] " RESET "failed to create render pass\n");
-    return false;
-  }
-  printf(GREEN "[OK] " RESET "Render Pass\n");
+  // Dynamic rendering only needs the attachment formats, not a render pass
+  VkPipelineRenderingCreateInfo renderingInfo = {0};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachmentFormats = &ctx->sceneFormat;
+  renderingInfo.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+  renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
 
   VkGraphicsPipelineCreateInfo pipelineInfo = {0};
   pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = ctx->dynamicRendering ? &renderingInfo : NULL;
   pipelineInfo.stageCount = 2;
   pipelineInfo.pStages = shaderStages;
   pipelineInfo.pVertexInputState = &vertexInputInfo;
@@ -489,7 +1061,8 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
   pipelineInfo.pColorBlendState = &colorBlending;
   pipelineInfo.pDynamicState = &dynamicState;
   pipelineInfo.layout = ctx->pipelineLayout;
-  pipelineInfo.renderPass = ctx->renderPass;
+  pipelineInfo.renderPass = ctx->dynamicRendering ? VK_NULL_HANDLE
+                          : ctx->postEnabled ? ctx->sceneRenderPass : ctx->renderPass;
   pipelineInfo.subpass = 0;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
   pipelineInfo.basePipelineIndex = -1;
@@ -499,20 +1072,30 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
     return false;
   }
   printf(GREEN "[OK] " RESET "Graphics Pipeline\n");
+  return true;
+}
 
+// With MSAA each framebuffer pairs the graph's multisampled transient with
+// the image it resolves into, so it is built once the graph has compiled
+static bool createFramebuffers(Rendering_Context *ctx) {
   ctx->swapChainFramebuffers = malloc(ctx->swapChainImageCount * sizeof(VkFramebuffer));
   if (!ctx->swapChainFramebuffers) {
     printf(RED "[ERROR] " RESET "failed to allocate memory for swapChainFramebuffers\n");
     return false;
   }
 
+  bool multisampled = ctx->samples > VK_SAMPLE_COUNT_1_BIT;
   for (uint32_t i = 0; i < ctx->swapChainImageCount; i++) {
-    VkImageView attachments[] = {ctx->swapChainImageViews[i]};
+    VkImageView attachments[2] = {ctx->swapChainImageViews[i], VK_NULL_HANDLE};
+    if (multisampled) {
+      attachments[0] = render_graph_get_view(&ctx->graph, ctx->msaaTarget);
+      attachments[1] = ctx->swapChainImageViews[i];
+    }
 
     VkFramebufferCreateInfo framebufferInfo = {0};
     framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     framebufferInfo.renderPass = ctx->renderPass;
-    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.attachmentCount = multisampled ? 2 : 1;
     framebufferInfo.pAttachments = attachments;
     framebufferInfo.width = ctx->swapChainExtent.width;
     framebufferInfo.height = ctx->swapChainExtent.height;
@@ -524,50 +1107,23 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
     }
   }
   printf(GREEN "[OK] " RESET "Framebuffers\n");
+  return true;
+}
 
-  // ========== CREATE COMMAND POOL ==========
-  QueueFamilyIndices cmdPoolIndices = findQueueFamilies(ctx->vulkan_context.physicalDevice, ctx->vulkan_context.surface);
-  
-  VkCommandPoolCreateInfo poolInfo = {0};
-  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-  poolInfo.queueFamilyIndex = cmdPoolIndices.graphicsFamily;
-
-  if (vkCreateCommandPool(ctx->vulkan_context.device, &poolInfo, NULL, &ctx->commandPool) != VK_SUCCESS) {
-    printf(RED "[ERROR] " RESET "failed to create command pool!\n");
-    return false;
-  }
-  printf(GREEN "[OK] " RESET "Command Pool\n");
-
-  // ========== ALLOCATE COMMAND BUFFERS ==========
-  VkCommandBufferAllocateInfo allocInfo = {0};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool = ctx->commandPool;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
-
-  if (vkAllocateCommandBuffers(ctx->vulkan_context.device, &allocInfo, ctx->commandBuffers) != VK_SUCCESS) {
-    printf(RED "[ERROR] " RESET "failed to allocate command buffers!\n");
-    return false;
-  }
-  printf(GREEN "[OK] " RESET "Command Buffers\n");
-
-  // ========== CREATE SYNCHRONIZATION OBJECTS ==========
+static bool createPerImageSync(Rendering_Context *ctx) {
   VkSemaphoreCreateInfo semaphoreInfo = {0};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  VkFenceCreateInfo fenceInfo = {0};
-  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Start signaled
-
   // Allocate per-image semaphores and fence tracking
-  ctx->renderFinishedSemaphores = malloc(ctx->swapChainImageCount * sizeof(VkSemaphore));
+  ctx->renderFinishedSemaphores = calloc(ctx->swapChainImageCount, sizeof(VkSemaphore));
   ctx->imagesInFlight = malloc(ctx->swapChainImageCount * sizeof(VkFence));
   
   if (!ctx->renderFinishedSemaphores || !ctx->imagesInFlight) {
     printf(RED "[ERROR] " RESET "failed to allocate per-image sync objects!\n");
     free(ctx->renderFinishedSemaphores);
     free(ctx->imagesInFlight);
+    ctx->renderFinishedSemaphores = NULL;
+    ctx->imagesInFlight = NULL;
     return false;
   }
   
@@ -576,15 +1132,6 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
     ctx->imagesInFlight[i] = VK_NULL_HANDLE;
   }
 
-  // Create per-frame semaphores and fences
-  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    if (vkCreateSemaphore(ctx->vulkan_context.device, &semaphoreInfo, NULL, &ctx->imageAvailableSemaphores[i]) != VK_SUCCESS ||
-        vkCreateFence(ctx->vulkan_context.device, &fenceInfo, NULL, &ctx->inFlightFences[i]) != VK_SUCCESS) {
-      printf(RED "[ERROR] " RESET "failed to create per-frame synchronization objects!\n");
-      return false;
-    }
-  }
-  
   // Create per-image semaphores
   for (uint32_t i = 0; i < ctx->swapChainImageCount; i++) {
     if (vkCreateSemaphore(ctx->vulkan_context.device, &semaphoreInfo, NULL, &ctx->renderFinishedSemaphores[i]) != VK_SUCCESS) {
@@ -592,36 +1139,641 @@ bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Pl
       return false;
     }
   }
-
-  printf(GREEN "[OK] " RESET "Synchronization Objects (%d frames, %d images)\n", 
-         MAX_FRAMES_IN_FLIGHT, ctx->swapChainImageCount);
-
-  printf(GREEN "[OK] " RESET "Rendering Init Complete\n");
   return true;
 }
 
-// ========== RENDERING DRAW FUNCTION (FIXED SEMAPHORE USAGE!) ==========
-void rendering_draw(Rendering_Context *ctx) {
-    if (!ctx) return;
-
-    uint32_t currentFrame = ctx->currentFrame;
+// Everything whose size or count follows the swapchain. Frames still in
+// flight may use it, so it goes through the deletion queue.
+static void cleanupSwapChain(Rendering_Context *ctx) {
+    Deletion_Queue *deletion = &ctx->deletion;
+    freeCachedCommands(ctx);
+
+    if (ctx->renderFinishedSemaphores) {
+        for (uint32_t i = 0; i < ctx->swapChainImageCount; i++) {
+            deletion_queue_push(deletion, DELETION_SEMAPHORE, (uint64_t)ctx->renderFinishedSemaphores[i]);
+        }
+        free(ctx->renderFinishedSemaphores);
+        ctx->renderFinishedSemaphores = NULL;
+    }
+    
+    if (ctx->imagesInFlight) {
+        free(ctx->imagesInFlight);
+        ctx->imagesInFlight = NULL;
+    }
+
+    if (ctx->swapChainFramebuffers) {
+        for (uint32_t i = 0; i < ctx->swapChainImageCount; i++) {
+            deletion_queue_push(deletion, DELETION_FRAMEBUFFER, (uint64_t)ctx->swapChainFramebuffers[i]);
+        }
+        free(ctx->swapChainFramebuffers);
+        ctx->swapChainFramebuffers = NULL;
+    }
+
+    deletion_queue_push(deletion, DELETION_FRAMEBUFFER, (uint64_t)ctx->sceneFramebuffer);
+    ctx->sceneFramebuffer = VK_NULL_HANDLE;
+
+    if (ctx->swapChainImageViews) {
+        for (uint32_t i = 0; i < ctx->swapChainImageCount; i++) {
+            deletion_queue_push(deletion, DELETION_IMAGE_VIEW, (uint64_t)ctx->swapChainImageViews[i]);
+        }
+        free(ctx->swapChainImageViews);
+        ctx->swapChainImageViews = NULL;
+    }
+
+    if (ctx->offscreenMemory) {
+        for (uint32_t i = 0; i < ctx->swapChainImageCount; i++) {
+            deletion_queue_push(deletion, DELETION_IMAGE, (uint64_t)ctx->swapChainImages[i]);
+            deletion_queue_push(deletion, DELETION_MEMORY, (uint64_t)ctx->offscreenMemory[i]);
+        }
+        free(ctx->offscreenMemory);
+        ctx->offscreenMemory = NULL;
+    }
+    
+    if (ctx->swapChainImages) {
+        free(ctx->swapChainImages);
+        ctx->swapChainImages = NULL;
+    }
+}
+
+bool rendering_recreate_swapchain(Rendering_Context *ctx) {
+  // Offscreen targets have a fixed size
+  if (!ctx || ctx->config.offscreen) return false;
+
+  // A minimized window has a 0x0 framebuffer; nothing to present until it's back
+  uint32_t width = 0, height = 0;
+  platform_framebuffer_size(ctx->platform, &width, &height);
+  while (width == 0 || height == 0) {
+    platform_wait_events();
+    platform_framebuffer_size(ctx->platform, &width, &height);
+  }
+  ctx->platform->width = width;
+  ctx->platform->height = height;
+  ctx->platform->framebufferResized = false;
+
+  double start = profiler_now_ms();
+  // The swapchain's own objects are retired below. The post and mesh
+  // descriptor sets, though, are rewritten in place for the new targets
+  // while frames in flight may still read them.
+  if (ctx->postEnabled || ctx->config.meshes) vkDeviceWaitIdle(ctx->vulkan_context.device);
+
+  VkFormat oldFormat = ctx->swapChainImageFormat;
+  VkSwapchainKHR oldSwapChain = ctx->swapChain;
+  cleanupSwapChain(ctx);
+
+  bool ok = createSwapChain(ctx, oldSwapChain);
+  deletion_queue_push(&ctx->deletion, DELETION_SWAPCHAIN, (uint64_t)oldSwapChain);
+  if (!ok) return false;
+  if (!createImageViews(ctx)) return false;
+
+  // A format change (e.g. moving to an HDR display) rebuilds pipelines, which
+  // the renderers destroy directly; rare enough to wait for
+  if (ctx->swapChainImageFormat != oldFormat) vkDeviceWaitIdle(ctx->vulkan_context.device);
+
+  // The HDR target keeps its format when post processing is on
+  VkFormat oldSceneFormat = ctx->sceneFormat;
+  if (!ctx->postEnabled) ctx->sceneFormat = ctx->swapChainImageFormat;
+  bool sceneChanged = ctx->sceneFormat != oldSceneFormat;
+  if (sceneChanged) {
+    vkDestroyPipeline(ctx->vulkan_context.device, ctx->graphicsPipeline, NULL);
+    vkDestroyPipelineLayout(ctx->vulkan_context.device, ctx->pipelineLayout, NULL);
+    vkDestroyShaderModule(ctx->vulkan_context.device, ctx->fragShaderModule, NULL);
+    vkDestroyShaderModule(ctx->vulkan_context.device, ctx->vertShaderModule, NULL);
+  }
+  if (!ctx->dynamicRendering) {
+    // Framebuffers are tied to the render pass, which is tied to the format
+    if (ctx->swapChainImageFormat != oldFormat) {
+      vkDestroyRenderPass(ctx->vulkan_context.device, ctx->renderPass, NULL);
+      if (!createRenderPass(ctx, ctx->swapChainImageFormat, ctx->samples, !ctx->config.meshes && !ctx->postEnabled,
+                            &ctx->renderPass)) {
+        return false;
+      }
+    }
+    if (ctx->samples == VK_SAMPLE_COUNT_1_BIT && !createFramebuffers(ctx)) return false;
+  }
+  if (sceneChanged && !createGraphicsPipeline(ctx)) return false;
+
+  if (ctx->swapChainImageFormat != oldFormat &&
+      !sprite_batch_rebuild_pipelines(&ctx->sprites, ctx->dynamicRendering ? VK_NULL_HANDLE : ctx->renderPass,
+                                      ctx->swapChainImageFormat)) {
+    return false;
+  }
+  if (ctx->config.meshes && sceneChanged && !mesh_renderer_rebuild_pipelines(&ctx->meshes, ctx->sceneFormat)) {
+    return false;
+  }
+  if (ctx->config.particles && sceneChanged &&
+      !particle_system_rebuild_pipeline(&ctx->particles, particleRenderPass(ctx), ctx->sceneFormat)) {
+    return false;
+  }
+
+  if (!createPerImageSync(ctx)) return false;
+  if (!buildRenderGraph(ctx)) return false;
+
+  ctx->fullDamage = true;
+  profiler_stat_add(&ctx->resizeStat, profiler_now_ms() - start);
+  return true;
+}
+
+// ========== EXTRA WINDOWS ==========
+
+// Retired rather than destroyed: the frames in flight may still use them
+static void destroyViewImages(Rendering_Context *ctx, Rendering_View *view) {
+  for (uint32_t i = 0; i < view->imageCount; i++) {
+    if (view->renderFinishedSemaphores) {
+      deletion_queue_push(&ctx->deletion, DELETION_SEMAPHORE, (uint64_t)view->renderFinishedSemaphores[i]);
+    }
+    if (view->framebuffers) {
+      deletion_queue_push(&ctx->deletion, DELETION_FRAMEBUFFER, (uint64_t)view->framebuffers[i]);
+    }
+    if (view->imageViews) {
+      deletion_queue_push(&ctx->deletion, DELETION_IMAGE_VIEW, (uint64_t)view->imageViews[i]);
+    }
+  }
+  free(view->renderFinishedSemaphores);
+  free(view->imagesInFlight);
+  free(view->framebuffers);
+  free(view->imageViews);
+  free(view->images);
+  view->renderFinishedSemaphores = NULL;
+  view->imagesInFlight = NULL;
+  view->framebuffers = NULL;
+  view->imageViews = NULL;
+  view->images = NULL;
+  view->imageCount = 0;
+}
+
+// Replaces the view's swapchain (if any) and everything sized by it
+static bool createViewSwapChain(Rendering_Context *ctx, Rendering_View *view) {
+  VkDevice device = ctx->vulkan_context.device;
+  destroyViewImages(ctx, view);
+
+  Arena *scratch = arena_scratch();
+  size_t mark = arena_mark(scratch);
+  SwapChainSupportDetails support = querySwapChainSupport(scratch, ctx->vulkan_context.physicalDevice, view->surface);
+
+  // The pipelines are shared, so the format has to be the main window's
+  VkSurfaceFormatKHR surfaceFormat = {VK_FORMAT_UNDEFINED, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+  for (uint32_t i = 0; i < support.formatCount; i++) {
+    if (support.formats[i].format == ctx->swapChainImageFormat) {
+      surfaceFormat = support.formats[i];
+      break;
+    }
+  }
+  if (surfaceFormat.format == VK_FORMAT_UNDEFINED) {
+    printf(RED "[ERROR] " RESET "window doesn't offer the main swapchain's format %d\n", ctx->swapChainImageFormat);
+    arena_reset_to(scratch, mark);
+    return false;
+  }
+
+  uint32_t imageCount = support.capabilities.minImageCount + 1;
+  if (support.capabilities.maxImageCount > 0 && imageCount > support.capabilities.maxImageCount) {
+    imageCount = support.capabilities.maxImageCount;
+  }
+  view->extent = chooseSwapExtent(&support.capabilities, view->platform->width, view->platform->height);
+
+  VkSwapchainCreateInfoKHR createInfo = {0};
+  createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+  createInfo.surface = view->surface;
+  createInfo.minImageCount = imageCount;
+  createInfo.imageFormat = surfaceFormat.format;
+  createInfo.imageColorSpace = surfaceFormat.colorSpace;
+  createInfo.imageExtent = view->extent;
+  createInfo.imageArrayLayers = 1;
+  createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  QueueFamilyIndices indices = findQueueFamilies(ctx->vulkan_context.physicalDevice, view->surface);
+  uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
+  if (indices.graphicsFamily != indices.presentFamily) {
+    createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+    createInfo.queueFamilyIndexCount = 2;
+    createInfo.pQueueFamilyIndices = queueFamilyIndices;
+  } else {
+    createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  }
+  createInfo.preTransform = support.capabilities.currentTransform;
+  createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+  createInfo.presentMode = chooseSwapPresentMode(support.presentModes, support.presentModeCount);
+  createInfo.clipped = VK_TRUE;
+  createInfo.oldSwapchain = view->swapChain;
+  arena_reset_to(scratch, mark);
+
+  VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+  VkResult result = vkCreateSwapchainKHR(device, &createInfo, NULL, &swapChain);
+  deletion_queue_push(&ctx->deletion, DELETION_SWAPCHAIN, (uint64_t)view->swapChain);
+  view->swapChain = swapChain;
+  if (result != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create window swap chain!\n");
+    return false;
+  }
+
+  vkGetSwapchainImagesKHR(device, view->swapChain, &imageCount, NULL);
+  view->images = calloc(imageCount, sizeof(VkImage));
+  view->imageViews = calloc(imageCount, sizeof(VkImageView));
+  view->framebuffers = ctx->dynamicRendering ? NULL : calloc(imageCount, sizeof(VkFramebuffer));
+  view->renderFinishedSemaphores = calloc(imageCount, sizeof(VkSemaphore));
+  view->imagesInFlight = calloc(imageCount, sizeof(VkFence));
+  if (!view->images || !view->imageViews || (!ctx->dynamicRendering && !view->framebuffers) ||
+      !view->renderFinishedSemaphores || !view->imagesInFlight) {
+    printf(RED "[ERROR] " RESET "failed to allocate window swapchain arrays\n");
+    return false;
+  }
+  view->imageCount = imageCount;
+  vkGetSwapchainImagesKHR(device, view->swapChain, &imageCount, view->images);
+
+  VkSemaphoreCreateInfo semaphoreInfo = {0};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  for (uint32_t i = 0; i < imageCount; i++) {
+    view->imageViews[i] = vulkan_create_image_view(&ctx->vulkan_context, view->images[i], surfaceFormat.format,
+                                                   VK_IMAGE_ASPECT_COLOR_BIT, 1);
+    if (view->imageViews[i] == VK_NULL_HANDLE) return false;
+    if (vkCreateSemaphore(device, &semaphoreInfo, NULL, &view->renderFinishedSemaphores[i]) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to create per-image semaphore!\n");
+      return false;
+    }
+    if (ctx->dynamicRendering) continue;
+
+    VkFramebufferCreateInfo framebufferInfo = {0};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = ctx->viewRenderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &view->imageViews[i];
+    framebufferInfo.width = view->extent.width;
+    framebufferInfo.height = view->extent.height;
+    framebufferInfo.layers = 1;
+    if (vkCreateFramebuffer(device, &framebufferInfo, NULL, &view->framebuffers[i]) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to create framebuffer\n");
+      return false;
+    }
+  }
+
+  RG_Image_Desc desc = {0};
+  desc.format = surfaceFormat.format;
+  desc.extent = view->extent;
+  desc.samples = VK_SAMPLE_COUNT_1_BIT;
+  render_graph_reset(&view->graph);
+  view->target = render_graph_import_image(&view->graph, "swapchain", &desc, VK_IMAGE_LAYOUT_UNDEFINED,
+                                           VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                           VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+  RG_Handle pass = render_graph_add_pass(&view->graph, "view", RG_PASS_GRAPHICS, viewPass, view);
+  render_graph_write(&view->graph, pass, view->target, RG_USE_COLOR_ATTACHMENT);
+  return render_graph_compile(&view->graph);
+}
+
+// The surface is queued after its swapchain, so it goes after it too
+static void destroyView(Rendering_Context *ctx, Rendering_View *view) {
+  destroyViewImages(ctx, view);
+  render_graph_destroy(&view->graph);
+  deletion_queue_push(&ctx->deletion, DELETION_SWAPCHAIN, (uint64_t)view->swapChain);
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    deletion_queue_push(&ctx->deletion, DELETION_SEMAPHORE, (uint64_t)view->imageAvailableSemaphores[i]);
+  }
+  deletion_queue_push(&ctx->deletion, DELETION_SURFACE, (uint64_t)view->surface);
+  memset(view, 0, sizeof(*view));
+}
+
+// Resized or out of date; a minimized window just sits out until it's back
+static bool recreateView(Rendering_Context *ctx, Rendering_View *view) {
+  uint32_t width = 0, height = 0;
+  platform_framebuffer_size(view->platform, &width, &height);
+  if (width == 0 || height == 0) return false;
+  view->platform->width = width;
+  view->platform->height = height;
+  view->platform->framebufferResized = false;
+
+  double start = profiler_now_ms();
+  if (!createViewSwapChain(ctx, view)) {
+    printf(RED "[ERROR] " RESET "failed to recreate window swapchain, closing it\n");
+    destroyView(ctx, view);
+    return false;
+  }
+  profiler_stat_add(&ctx->resizeStat, profiler_now_ms() - start);
+  return true;
+}
+
+bool rendering_add_window(Rendering_Context *ctx, Platform_Context *platform) {
+  if (!ctx || !platform) return false;
+  if (ctx->config.offscreen || ctx->postEnabled || ctx->samples > VK_SAMPLE_COUNT_1_BIT) {
+    printf(YELLOW "[WARNING] " RESET "extra windows need a swapchain, no post processing and no MSAA\n");
+    return false;
+  }
+
+  Rendering_View *view = NULL;
+  for (uint32_t i = 0; i < RENDERING_MAX_VIEWS && !view; i++) {
+    if (!ctx->views[i].platform) view = &ctx->views[i];
+  }
+  if (!view) {
+    printf(YELLOW "[WARNING] " RESET "at most %d extra windows\n", RENDERING_MAX_VIEWS);
+    return false;
+  }
+  memset(view, 0, sizeof(*view));
+  view->owner = ctx;
+  view->platform = platform;
+
+  // The main render pass may load what the mesh pass drew; a view starts clean
+  if (!ctx->dynamicRendering && ctx->viewRenderPass == VK_NULL_HANDLE &&
+      !createRenderPass(ctx, ctx->swapChainImageFormat, VK_SAMPLE_COUNT_1_BIT, true, &ctx->viewRenderPass)) {
+    memset(view, 0, sizeof(*view));
+    return false;
+  }
+  if (!vulkan_create_surface(&ctx->vulkan_context, platform, &view->surface)) {
+    memset(view, 0, sizeof(*view));
+    return false;
+  }
+  render_graph_create(&view->graph, ctx->vulkan_context.physicalDevice, ctx->vulkan_context.device,
+                      &ctx->vulkan_context.dispatch);
+
+  VkSemaphoreCreateInfo semaphoreInfo = {0};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    if (vkCreateSemaphore(ctx->vulkan_context.device, &semaphoreInfo, NULL, &view->imageAvailableSemaphores[i]) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to create per-frame semaphore!\n");
+      destroyView(ctx, view);
+      return false;
+    }
+  }
+  if (!createViewSwapChain(ctx, view)) {
+    destroyView(ctx, view);
+    return false;
+  }
+  printf(GREEN "[OK] " RESET "Window %u (%ux%u, %u images)\n", rendering_window_count(ctx),
+         view->extent.width, view->extent.height, view->imageCount);
+  return true;
+}
+
+void rendering_remove_window(Rendering_Context *ctx, Platform_Context *platform) {
+  if (!ctx || !platform) return;
+  for (uint32_t i = 0; i < RENDERING_MAX_VIEWS; i++) {
+    if (ctx->views[i].platform != platform) continue;
+    // The native window goes away right after, and its surface can't outlive
+    // it, so this one can't wait for the fences
+    vkDeviceWaitIdle(ctx->vulkan_context.device);
+    destroyView(ctx, &ctx->views[i]);
+    deletion_queue_flush(&ctx->deletion);
+  }
+}
+
+uint32_t rendering_window_count(const Rendering_Context *ctx) {
+  if (!ctx || ctx->config.offscreen) return 0;
+  uint32_t count = 1;
+  for (uint32_t i = 0; i < RENDERING_MAX_VIEWS; i++) {
+    if (ctx->views[i].platform) count++;
+  }
+  return count;
+}
+
+// Gets an image from every other window for this frame. One that can't
+// provide one right now is left out of the submit and the present.
+static void acquireViews(Rendering_Context *ctx, uint32_t currentFrame) {
+    for (uint32_t i = 0; i < RENDERING_MAX_VIEWS; i++) {
+        Rendering_View *view = &ctx->views[i];
+        view->acquired = false;
+        if (!view->platform) continue;
+        if (view->platform->framebufferResized && !recreateView(ctx, view)) continue;
+
+        VkResult result = ctx->vulkan_context.dispatch.vkAcquireNextImageKHR(
+            ctx->vulkan_context.device, view->swapChain, UINT64_MAX,
+            view->imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &view->imageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateView(ctx, view);
+            continue;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            printf(RED "[ERROR] " RESET "failed to acquire window image!\n");
+            continue;
+        }
+
+        if (view->imagesInFlight[view->imageIndex] != VK_NULL_HANDLE) {
+            ctx->vulkan_context.dispatch.vkWaitForFences(ctx->vulkan_context.device, 1,
+                                                         &view->imagesInFlight[view->imageIndex], VK_TRUE, UINT64_MAX);
+        }
+        view->imagesInFlight[view->imageIndex] = ctx->inFlightFences[currentFrame];
+        view->acquired = true;
+    }
+}
+
+bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Platform_Context *platform) {
+  if (!ctx || !vulkan_context || (!platform && !ctx->config.offscreen)) return false;
+
+  double start = profiler_now_ms();
+  ctx->vulkan_context = *vulkan_context;
+  ctx->platform = platform;
+  ctx->currentFrame = 0;  // INITIALIZE currentFrame
+  ctx->dynamicRendering = vulkan_context->dynamicRendering && !ctx->config.forceRenderPass;
+  printf("Rendering path: %s\n", ctx->dynamicRendering ? "dynamic rendering" : "render pass");
+  ctx->captureEnabled = ctx->config.capture.path != NULL;
+  ctx->readbackSlot = -1;
+  if (!deletion_queue_create(&ctx->deletion, vulkan_context->instance, vulkan_context->device)) return false;
+  ctx->deletion.budget = vulkan_context->budget;
+
+  // Dynamic resolution scales the HDR scene target; without a chain of its
+  // own, exposure at 1 turns the composite into a plain upscale. The meshlet
+  // pass's depth pyramid assumes the full extent, so it is left out there.
+  bool dynamicResolution = ctx->config.resolutionTargetMs > 0.0f;
+  if (dynamicResolution && ctx->config.meshes) {
+    printf(YELLOW "[WARNING] " RESET "dynamic resolution doesn't support the mesh pass, disabled\n");
+    dynamicResolution = false;
+  }
+  if (dynamicResolution && !ctx->config.post) ctx->config.post = "exposure";
+
+  // Decided before the swapchain, whose format and usage depend on it
+  if (ctx->config.post) {
+    if (!vulkan_context->storageWriteWithoutFormat) {
+      printf(YELLOW "[WARNING] " RESET "post processing needs shaderStorageImageWriteWithoutFormat, disabled\n");
+    } else if (!post_create(&ctx->post, &ctx->vulkan_context, MAX_FRAMES_IN_FLIGHT, ctx->config.post)) {
+      printf(RED "[ERROR] " RESET "failed to create post chain!\n");
+      return false;
+    } else {
+      ctx->postEnabled = true;
+    }
+  }
+  if (dynamicResolution) {
+    float minScale = ctx->config.resolutionMin > 0.0f ? ctx->config.resolutionMin : 0.5f;
+    float maxScale = ctx->config.resolutionMax > 0.0f ? ctx->config.resolutionMax : 1.0f;
+    if (!ctx->postEnabled) {
+      printf(YELLOW "[WARNING] " RESET "dynamic resolution needs the HDR scene target, disabled\n");
+    } else if (!resolution_create(&ctx->resolution, &ctx->vulkan_context, MAX_FRAMES_IN_FLIGHT, minScale, maxScale,
+                                  ctx->config.resolutionTargetMs)) {
+      printf(RED "[ERROR] " RESET "failed to create dynamic resolution!\n");
+      return false;
+    } else {
+      ctx->resolutionEnabled = true;
+    }
+  }
+
+  // MSAA covers the direct scene pass only: the mesh pass, the particles and
+  // the post chain's HDR target all stay single-sampled
+  ctx->samples = VK_SAMPLE_COUNT_1_BIT;
+  if (ctx->config.samples > VK_SAMPLE_COUNT_1_BIT) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(ctx->vulkan_context.physicalDevice, &properties);
+    if (ctx->config.meshes || ctx->config.particles || ctx->postEnabled) {
+      printf(YELLOW "[WARNING] " RESET "MSAA doesn't support meshes, particles or post processing, disabled\n");
+    } else if (!(properties.limits.framebufferColorSampleCounts & ctx->config.samples)) {
+      printf(YELLOW "[WARNING] " RESET "%ux MSAA not supported, disabled\n", (unsigned)ctx->config.samples);
+    } else {
+      ctx->samples = ctx->config.samples;
+      printf("MSAA: %ux\n", (unsigned)ctx->samples);
+    }
+  }
+
+  if (ctx->config.offscreen) {
+    if (!createOffscreenTargets(ctx)) return false;
+  } else if (!createSwapChain(ctx, VK_NULL_HANDLE)) {
+    return false;
+  }
+  if (!createImageViews(ctx)) return false;
+  ctx->sceneFormat = ctx->postEnabled ? POST_HDR_FORMAT : ctx->swapChainImageFormat;
+  if (ctx->postEnabled) {
+    printf("Post output: %s\n", ctx->postDirect ? "storage writes to the swapchain image" : "HDR target + blit");
+  }
+  if (!ctx->dynamicRendering) {
+    if (!createRenderPass(ctx, ctx->swapChainImageFormat, ctx->samples, !ctx->config.meshes && !ctx->postEnabled,
+                          &ctx->renderPass)) {
+      return false;
+    }
+    if (ctx->postEnabled &&
+        !createRenderPass(ctx, ctx->sceneFormat, VK_SAMPLE_COUNT_1_BIT, !ctx->config.meshes, &ctx->sceneRenderPass)) {
+      return false;
+    }
+  }
+  if (!createGraphicsPipeline(ctx)) return false;
+  // Multisampled framebuffers wait for the graph's transient
+  if (!ctx->dynamicRendering && ctx->samples == VK_SAMPLE_COUNT_1_BIT && !createFramebuffers(ctx)) return false;
+
+  // ========== CREATE COMMAND POOL ==========
+  QueueFamilyIndices cmdPoolIndices = findQueueFamilies(ctx->vulkan_context.physicalDevice, ctx->vulkan_context.surface);
+  
+  VkCommandPoolCreateInfo poolInfo = {0};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = cmdPoolIndices.graphicsFamily;
+
+  if (vkCreateCommandPool(ctx->vulkan_context.device, &poolInfo, NULL, &ctx->commandPool) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create command pool!\n");
+    return false;
+  }
+  printf(GREEN "[OK] " RESET "Command Pool\n");
+
+  // ========== ALLOCATE COMMAND BUFFERS ==========
+  VkCommandBufferAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = ctx->commandPool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+
+  if (vkAllocateCommandBuffers(ctx->vulkan_context.device, &allocInfo, ctx->commandBuffers) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to allocate command buffers!\n");
+    return false;
+  }
+  printf(GREEN "[OK] " RESET "Command Buffers\n");
+
+  if (!arena_create(&ctx->frameArena, "frame", FRAME_ARENA_SIZE)) return false;
+  if (!sprite_batch_create(&ctx->sprites, &ctx->vulkan_context, ctx->commandPool, MAX_FRAMES_IN_FLIGHT,
+                           ctx->dynamicRendering ? VK_NULL_HANDLE : ctx->renderPass, ctx->swapChainImageFormat,
+                           ctx->samples)) {
+    printf(RED "[ERROR] " RESET "failed to create sprite batch!\n");
+    return false;
+  }
+  ctx->sprites.frameArena = &ctx->frameArena;
+  if (!text_create(&ctx->text, &ctx->vulkan_context, ctx->commandPool, &ctx->sprites)) return false;
+  if (ctx->config.tracePath) {
+    if (!trace_writer_open(&ctx->trace, ctx->config.tracePath, ctx->swapChainExtent)) return false;
+    ctx->sprites.trace = &ctx->trace;
+  }
+  if (ctx->captureEnabled && !readback_create(&ctx->readback, &ctx->vulkan_context, &ctx->config.capture)) return false;
+  if (ctx->config.meshes &&
+      !mesh_renderer_create(&ctx->meshes, &ctx->vulkan_context, ctx->commandPool, MAX_FRAMES_IN_FLIGHT,
+                            ctx->dynamicRendering, !ctx->config.meshFallback, ctx->sceneFormat)) {
+    printf(RED "[ERROR] " RESET "failed to create mesh renderer!\n");
+    return false;
+  }
+  if (ctx->config.particles) {
+    if (!particle_system_create(&ctx->particles, &ctx->vulkan_context, ctx->commandPool, MAX_FRAMES_IN_FLIGHT,
+                                ctx->config.particles, particleRenderPass(ctx), ctx->sceneFormat)) {
+      printf(RED "[ERROR] " RESET "failed to create particle system!\n");
+      return false;
+    }
+    ctx->particles.emitter.position[0] = (float)ctx->swapChainExtent.width * 0.5f;
+    ctx->particles.emitter.position[1] = (float)ctx->swapChainExtent.height * 0.75f;
+  }
+
+  // The graph's passes reference the renderers above
+  render_graph_create(&ctx->graph, ctx->vulkan_context.physicalDevice, ctx->vulkan_context.device,
+                      &ctx->vulkan_context.dispatch);
+  ctx->graph.deletion = &ctx->deletion;
+  ctx->graph.budget = ctx->vulkan_context.budget;
+  if (ctx->config.meshes && ctx->meshes.useMeshShader) {
+    // The task shader reads the visibility the cull passes write
+    ctx->graph.graphicsStages |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+  }
+  if (!buildRenderGraph(ctx)) {
+    printf(RED "[ERROR] " RESET "failed to compile render graph\n");
+    return false;
+  }
+
+  // ========== CREATE SYNCHRONIZATION OBJECTS ==========
+  VkSemaphoreCreateInfo semaphoreInfo = {0};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  VkFenceCreateInfo fenceInfo = {0};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Start signaled
+
+  // Create per-frame semaphores and fences
+  for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    if (vkCreateSemaphore(ctx->vulkan_context.device, &semaphoreInfo, NULL, &ctx->imageAvailableSemaphores[i]) != VK_SUCCESS ||
+        vkCreateFence(ctx->vulkan_context.device, &fenceInfo, NULL, &ctx->inFlightFences[i]) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to create per-frame synchronization objects!\n");
+      return false;
+    }
+  }
+  
+  if (!createPerImageSync(ctx)) return false;
+
+  printf(GREEN "[OK] " RESET "Synchronization Objects (%d frames, %d images)\n", 
+         MAX_FRAMES_IN_FLIGHT, ctx->swapChainImageCount);
+
+  ctx->fullDamage = true;
+  ctx->createTimeMs = profiler_now_ms() - start;
+  printf(GREEN "[OK] " RESET "Rendering Init Complete (%.3f ms)\n", ctx->createTimeMs);
+  return true;
+}
+
+// ========== RENDERING DRAW FUNCTION (FIXED SEMAPHORE USAGE!) ==========
+void rendering_draw(Rendering_Context *ctx) {
+    if (!ctx) return;
+
+    uint32_t currentFrame = ctx->currentFrame;
 
     // Wait for the previous frame to finish
-    vkWaitForFences(ctx->vulkan_context.device, 1, &ctx->inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-
-    // Acquire an image from the swap chain
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(
-        ctx->vulkan_context.device,
-        ctx->swapChain,
-        UINT64_MAX,
-        ctx->imageAvailableSemaphores[currentFrame],  // Per-frame semaphore
-        VK_NULL_HANDLE,
-        &imageIndex
-    );
+    double fenceStart = profiler_now_ms();
+    ctx->vulkan_context.dispatch.vkWaitForFences(ctx->vulkan_context.device, 1, &ctx->inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    profiler_stat_add(&ctx->fenceStat, profiler_now_ms() - fenceStart);
+    arena_reset(&ctx->frameArena);
+
+    // Every submission up to the one this fence covered is done; fences are
+    // waited in submission order, so nothing retired before it is in use
+    deletion_queue_collect(&ctx->deletion, ctx->fenceSubmissions[currentFrame]);
+    memory_budget_update(ctx->vulkan_context.budget);
+
+    // The copy recorded MAX_FRAMES_IN_FLIGHT frames ago has landed
+    if (ctx->captureEnabled) {
+        readback_collect(&ctx->readback, currentFrame);
+    }
+
+    // Acquire an image from the swap chain; offscreen targets map 1:1 to frames
+    uint32_t imageIndex = currentFrame;
+    VkResult result = VK_SUCCESS;
+    if (!ctx->config.offscreen) {
+        result = ctx->vulkan_context.dispatch.vkAcquireNextImageKHR(
+            ctx->vulkan_context.device,
+            ctx->swapChain,
+            UINT64_MAX,
+            ctx->imageAvailableSemaphores[currentFrame],  // Per-frame semaphore
+            VK_NULL_HANDLE,
+            &imageIndex
+        );
+    }
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        printf(YELLOW "[WARNING] " RESET "Swap chain out of date\n");
+        rendering_recreate_swapchain(ctx);
         return;
     } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
         printf(RED "[ERROR] " RESET "failed to acquire swap chain image!\n");
@@ -630,69 +1782,190 @@ void rendering_draw(Rendering_Context *ctx) {
 
     // Check if a previous frame is using this image (wait for it)
     if (ctx->imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-        vkWaitForFences(ctx->vulkan_context.device, 1, &ctx->imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+        ctx->vulkan_context.dispatch.vkWaitForFences(ctx->vulkan_context.device, 1, &ctx->imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
     }
     // Mark the image as now being in use by this frame
     ctx->imagesInFlight[imageIndex] = ctx->inFlightFences[currentFrame];
+    acquireViews(ctx, currentFrame);
 
     // Reset the fence only after we're sure we're submitting work
-    vkResetFences(ctx->vulkan_context.device, 1, &ctx->inFlightFences[currentFrame]);
+    ctx->vulkan_context.dispatch.vkResetFences(ctx->vulkan_context.device, 1, &ctx->inFlightFences[currentFrame]);
+
+    // Sort this frame's sprites into its (now idle) ring slot
+    sprite_batch_flush(&ctx->sprites, currentFrame);
+    if (ctx->sprites.trace) trace_write_frame(ctx->sprites.trace);
+    if (ctx->config.meshes) {
+        mesh_renderer_flush(&ctx->meshes, currentFrame, ctx->swapChainExtent);
+        // The mesh pass clears and redraws the whole image
+        ctx->fullDamage = true;
+    }
+    if (ctx->config.particles) {
+        particle_system_flush(&ctx->particles, currentFrame, ctx->swapChainExtent);
+        ctx->fullDamage = true;
+    }
+    if (ctx->postEnabled) {
+        post_flush(&ctx->post, currentFrame);
+        // So does the post chain
+        ctx->fullDamage = true;
+    }
+    // Steered by the frame this slot last ran; a new scale applies from this one on
+    if (ctx->resolutionEnabled && resolution_update(&ctx->resolution, currentFrame)) {
+        updateRenderExtent(ctx);
+    }
 
-    // Reset and record command buffer
-    vkResetCommandBuffer(ctx->commandBuffers[currentFrame], 0);
-    recordCommandBuffer(ctx, ctx->commandBuffers[currentFrame], imageIndex);
+    // Record the frame, or replay this image's recording if nothing it captured changed
+    double recordStart = profiler_now_ms();
+    VkCommandBuffer commandBuffer = ctx->commandBuffers[currentFrame];
+    uint64_t key = commandsKey(ctx, currentFrame);
+    if (key != 0) {
+        uint32_t slot = imageIndex * MAX_FRAMES_IN_FLIGHT + currentFrame;
+        commandBuffer = ctx->cachedCommands[slot];
+        if (ctx->cachedKeys[slot] == key) {
+            ctx->imageIndex = imageIndex;
+            ctx->cacheHits++;
+        } else {
+            // Only this frame slot submits it, and its fence has been waited on
+            ctx->vulkan_context.dispatch.vkResetCommandBuffer(commandBuffer, 0);
+            recordCommandBuffer(ctx, commandBuffer, imageIndex);
+            ctx->cachedKeys[slot] = key;
+            ctx->cacheMisses++;
+        }
+    } else {
+        ctx->vulkan_context.dispatch.vkResetCommandBuffer(commandBuffer, 0);
+        recordCommandBuffer(ctx, commandBuffer, imageIndex);
+    }
+    profiler_stat_add(&ctx->recordStat, profiler_now_ms() - recordStart);
 
     // Submit command buffer
     VkSubmitInfo submitInfo = {0};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {ctx->imageAvailableSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
+    // One entry per window with an image this frame, the main one first
+    VkSemaphore waitSemaphores[1 + RENDERING_MAX_VIEWS];
+    VkPipelineStageFlags waitStages[1 + RENDERING_MAX_VIEWS];
+    // Signal per-image semaphore (indexed by imageIndex, not currentFrame!)
+    VkSemaphore signalSemaphores[1 + RENDERING_MAX_VIEWS];
+    VkSwapchainKHR swapChains[1 + RENDERING_MAX_VIEWS];
+    uint32_t imageIndices[1 + RENDERING_MAX_VIEWS];
+    Rendering_View *presented[1 + RENDERING_MAX_VIEWS] = {NULL};
+    uint32_t windowCount = 0;
+    if (!ctx->config.offscreen) {
+        waitSemaphores[0] = ctx->imageAvailableSemaphores[currentFrame];
+        signalSemaphores[0] = ctx->renderFinishedSemaphores[imageIndex];
+        swapChains[0] = ctx->swapChain;
+        imageIndices[0] = imageIndex;
+        windowCount = 1;
+        for (uint32_t i = 0; i < RENDERING_MAX_VIEWS; i++) {
+            Rendering_View *view = &ctx->views[i];
+            if (!view->acquired) continue;
+            waitSemaphores[windowCount] = view->imageAvailableSemaphores[currentFrame];
+            signalSemaphores[windowCount] = view->renderFinishedSemaphores[view->imageIndex];
+            swapChains[windowCount] = view->swapChain;
+            imageIndices[windowCount] = view->imageIndex;
+            presented[windowCount] = view;
+            windowCount++;
+        }
+    }
+    for (uint32_t i = 0; i < windowCount; i++) waitStages[i] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    submitInfo.waitSemaphoreCount = windowCount;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &ctx->commandBuffers[currentFrame];
-
-    // Signal per-image semaphore (indexed by imageIndex, not currentFrame!)
-    VkSemaphore signalSemaphores[] = {ctx->renderFinishedSemaphores[imageIndex]};
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = windowCount;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    if (vkQueueSubmit(ctx->vulkan_context.queue, 1, &submitInfo, ctx->inFlightFences[currentFrame]) != VK_SUCCESS) {
+    if (ctx->vulkan_context.dispatch.vkQueueSubmit(ctx->vulkan_context.queue, 1, &submitInfo, ctx->inFlightFences[currentFrame]) != VK_SUCCESS) {
         printf(RED "[ERROR] " RESET "failed to submit draw command buffer!\n");
         return;
     }
+    ctx->fenceSubmissions[currentFrame] = deletion_queue_submit(&ctx->deletion);
+
+    if (ctx->config.offscreen) {
+        ctx->currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        ctx->frameNumber++;
+        return;
+    }
 
-    // Present the image
+    // Every window in one present, so its cost doesn't scale with the count
     VkPresentInfoKHR presentInfo = {0};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.waitSemaphoreCount = windowCount;
     presentInfo.pWaitSemaphores = signalSemaphores;
 
-    VkSwapchainKHR swapChains[] = {ctx->swapChain};
-    presentInfo.swapchainCount = 1;
+    VkResult results[1 + RENDERING_MAX_VIEWS];
+    presentInfo.swapchainCount = windowCount;
     presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
-    presentInfo.pResults = NULL;
+    presentInfo.pImageIndices = imageIndices;
+    presentInfo.pResults = results;
+
+    // Damage is only tracked for the main window; zero rectangles mean all of it
+    VkRectLayerKHR damage;
+    VkPresentRegionKHR region[1 + RENDERING_MAX_VIEWS] = {{0}};
+    VkPresentRegionsKHR regions = {0};
+    if (ctx->vulkan_context.incrementalPresent) {
+        computeDamage(ctx, &damage);
+        region[0].rectangleCount = 1;
+        region[0].pRectangles = &damage;
+        regions.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR;
+        regions.swapchainCount = windowCount;
+        regions.pRegions = region;
+        presentInfo.pNext = &regions;
+    }
 
-    result = vkQueuePresentKHR(ctx->vulkan_context.presentQueue, &presentInfo);
+    double presentStart = profiler_now_ms();
+    result = ctx->vulkan_context.dispatch.vkQueuePresentKHR(ctx->vulkan_context.presentQueue, &presentInfo);
+    profiler_stat_add(&ctx->presentStat, profiler_now_ms() - presentStart);
+    for (uint32_t i = 1; i < windowCount; i++) {
+        // Recreated before its next acquire
+        if (results[i] == VK_ERROR_OUT_OF_DATE_KHR || results[i] == VK_SUBOPTIMAL_KHR) {
+            presented[i]->platform->framebufferResized = true;
+        }
+    }
+    // The overall result may come from another window
+    if (windowCount > 1 && result != VK_ERROR_DEVICE_LOST) result = results[0];
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-        printf(YELLOW "[WARNING] " RESET "Swap chain suboptimal or out of date\n");
+    // Move to next frame
+    ctx->currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    ctx->frameNumber++;
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || ctx->platform->framebufferResized) {
+        rendering_recreate_swapchain(ctx);
     } else if (result != VK_SUCCESS) {
         printf(RED "[ERROR] " RESET "failed to present swap chain image!\n");
     }
+}
 
-    // Move to next frame
-    ctx->currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+void rendering_collect_captures(Rendering_Context *ctx) {
+    if (!ctx || !ctx->captureEnabled) return;
+    // The slot about to be reused holds the oldest submission
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        uint32_t frame = (ctx->currentFrame + i) % MAX_FRAMES_IN_FLIGHT;
+        if (ctx->readback.frameSlots[frame] < 0) continue;
+        ctx->vulkan_context.dispatch.vkWaitForFences(ctx->vulkan_context.device, 1, &ctx->inFlightFences[frame],
+                                                     VK_TRUE, UINT64_MAX);
+        readback_collect(&ctx->readback, frame);
+    }
 }
 
 void rendering_destroy(Rendering_Context *ctx) {
-    if (!ctx) return;
-    
+    // rendering_create copies the device before creating anything, so
+    // without one there is nothing to tear down
+    if (!ctx || ctx->vulkan_context.device == VK_NULL_HANDLE) return;
+
     vkDeviceWaitIdle(ctx->vulkan_context.device);
 
+    // Flushes the copies still in flight and joins the writer
+    readback_destroy(&ctx->readback);
+
+    for (uint32_t i = 0; i < RENDERING_MAX_VIEWS; i++) {
+        if (ctx->views[i].platform) destroyView(ctx, &ctx->views[i]);
+    }
+    if (ctx->viewRenderPass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(ctx->vulkan_context.device, ctx->viewRenderPass, NULL);
+        ctx->viewRenderPass = VK_NULL_HANDLE;
+    }
+
     // Destroy per-frame synchronization objects
     for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         if (ctx->imageAvailableSemaphores[i] != VK_NULL_HANDLE) {
@@ -702,37 +1975,33 @@ void rendering_destroy(Rendering_Context *ctx) {
             vkDestroyFence(ctx->vulkan_context.device, ctx->inFlightFences[i], NULL);
         }
     }
-    
-    // Destroy per-image semaphores
-    if (ctx->renderFinishedSemaphores) {
-        for (uint32_t i = 0; i < ctx->swapChainImageCount; i++) {
-            if (ctx->renderFinishedSemaphores[i] != VK_NULL_HANDLE) {
-                vkDestroySemaphore(ctx->vulkan_context.device, ctx->renderFinishedSemaphores[i], NULL);
-            }
-        }
-        free(ctx->renderFinishedSemaphores);
-        ctx->renderFinishedSemaphores = NULL;
-    }
-    
-    if (ctx->imagesInFlight) {
-        free(ctx->imagesInFlight);
-        ctx->imagesInFlight = NULL;
-    }
 
+    render_graph_destroy(&ctx->graph);
+    mesh_renderer_destroy(&ctx->meshes);
+    particle_system_destroy(&ctx->particles);
+    post_destroy(&ctx->post);
+    resolution_print_stats(&ctx->resolution);
+    resolution_destroy(&ctx->resolution);
+    trace_writer_close(&ctx->trace);
+    text_destroy(&ctx->text);
+    sprite_batch_destroy(&ctx->sprites);
+    if (ctx->frameArena.base) arena_print_stats(&ctx->frameArena);
+    arena_destroy(&ctx->frameArena);
+
+    if (ctx->cachedCommands) {
+        printf(CYAN "[PROFILE] " RESET "command cache: %llu replayed, %llu recorded\n",
+               (unsigned long long)ctx->cacheHits, (unsigned long long)ctx->cacheMisses);
+    }
+    // Per-image semaphores, framebuffers, image views and cached recordings
+    // join whatever was retired earlier; the device is idle, so all of it
+    // goes now, before the pool the recordings came from
+    cleanupSwapChain(ctx);
+    deletion_queue_print_stats(&ctx->deletion);
+    deletion_queue_destroy(&ctx->deletion);
     if (ctx->commandPool != VK_NULL_HANDLE) {
         vkDestroyCommandPool(ctx->vulkan_context.device, ctx->commandPool, NULL);
     }
     
-    if (ctx->swapChainFramebuffers) {
-        for (uint32_t i = 0; i < ctx->swapChainImageCount; i++) {
-            if (ctx->swapChainFramebuffers[i] != VK_NULL_HANDLE) {
-                vkDestroyFramebuffer(ctx->vulkan_context.device, ctx->swapChainFramebuffers[i], NULL);
-            }
-        }
-        free(ctx->swapChainFramebuffers);
-        ctx->swapChainFramebuffers = NULL;
-    }
-    
     if (ctx->graphicsPipeline != VK_NULL_HANDLE) {
         vkDestroyPipeline(ctx->vulkan_context.device, ctx->graphicsPipeline, NULL);
         ctx->graphicsPipeline = VK_NULL_HANDLE;
@@ -747,6 +2016,11 @@ void rendering_destroy(Rendering_Context *ctx) {
         vkDestroyRenderPass(ctx->vulkan_context.device, ctx->renderPass, NULL);
         ctx->renderPass = VK_NULL_HANDLE;
     }
+
+    if (ctx->sceneRenderPass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(ctx->vulkan_context.device, ctx->sceneRenderPass, NULL);
+        ctx->sceneRenderPass = VK_NULL_HANDLE;
+    }
     
     if (ctx->fragShaderModule != VK_NULL_HANDLE) {
         vkDestroyShaderModule(ctx->vulkan_context.device, ctx->fragShaderModule, NULL);
@@ -757,21 +2031,6 @@ void rendering_destroy(Rendering_Context *ctx) {
         ctx->vertShaderModule = VK_NULL_HANDLE;
     }
     
-    if (ctx->swapChainImageViews) {
-        for (uint32_t i = 0; i < ctx->swapChainImageCount; i++) {
-            if (ctx->swapChainImageViews[i] != VK_NULL_HANDLE) {
-                vkDestroyImageView(ctx->vulkan_context.device, ctx->swapChainImageViews[i], NULL);
-            }
-        }
-        free(ctx->swapChainImageViews);
-        ctx->swapChainImageViews = NULL;
-    }
-    
-    if (ctx->swapChainImages) {
-        free(ctx->swapChainImages);
-        ctx->swapChainImages = NULL;
-    }
-    
     if (ctx->swapChain != VK_NULL_HANDLE) {
         vkDestroySwapchainKHR(ctx->vulkan_context.device, ctx->swapChain, NULL);
         ctx->swapChain = VK_NULL_HANDLE;
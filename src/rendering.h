@@ -5,41 +5,202 @@
 #include <stdbool.h>
 #include <vulkan/vulkan.h>
 #include "platform.h"
+#include "render_graph.h"
+#include "profiler.h"
+#include "sprite_batch.h"
+#include "text.h"
+#include "readback.h"
+#include "trace.h"
+#include "arena.h"
+#include "mesh_renderer.h"
+#include "post.h"
+#include "deletion.h"
+#include "resolution.h"
+#include "particles.h"
 
 #define MAX_FRAMES_IN_FLIGHT 2
+#define FRAME_ARENA_SIZE (512 * 1024)  // grows past its high-water mark on overflow
+#define RENDERING_MAX_VIEWS 8  // windows besides the main one
+
+// Set on Rendering_Context.config before rendering_create
+typedef struct {
+  bool forceRenderPass;  // use VkRenderPass/VkFramebuffer even if dynamic rendering is available
+  Readback_Config capture;  // capture.path == NULL disables frame capture
+  bool captureOnRequest;    // only capture frames with captureRequested set
+  bool offscreen;           // render into plain images, no surface/swapchain/present
+  VkExtent2D offscreenExtent;
+  const char *tracePath;    // record sprite and text API calls for replay, NULL to disable
+  bool meshes;              // depth-tested meshlet pass under the triangle and sprites
+  bool meshFallback;        // use compute cull + indirect draws even with mesh shaders
+  const char *post;         // post chain over an HDR scene target (see post_create), NULL to disable
+  bool cacheCommands;       // replay a recording per swapchain image until something invalidates it
+  float resolutionTargetMs; // GPU frame time dynamic resolution steers the scene scale to, 0 disables
+  float resolutionMin;      // scale bounds per axis; 0 means 0.5 and 1
+  float resolutionMax;
+  uint32_t particles;       // GPU particle capacity, simulated in compute and drawn over the triangle; 0 disables
+  VkSampleCountFlagBits samples;  // MSAA for the triangle and sprites, resolved as their pass ends; 0 or 1 disables
+} Rendering_Config;
 
 typedef struct Rendering_Context Rendering_Context;
+
+// A further window onto the scene (triangle and sprites). It shares the
+// device, pipelines, sprite batch, command buffer and frame fence with the
+// main window; the swapchain, its sync objects and a one-pass graph are its
+// own. All windows are submitted and presented together.
+typedef struct {
+  Rendering_Context *owner;
+  Platform_Context *platform;  // NULL for a free slot
+  VkSurfaceKHR surface;
+  VkSwapchainKHR swapChain;
+  VkImage *images;
+  VkImageView *imageViews;
+  VkFramebuffer *framebuffers;
+  uint32_t imageCount;
+  VkExtent2D extent;
+
+  VkSemaphore imageAvailableSemaphores[MAX_FRAMES_IN_FLIGHT];
+  VkSemaphore *renderFinishedSemaphores;  // per image
+  VkFence *imagesInFlight;                // per image
+
+  Render_Graph graph;
+  RG_Handle target;
+  uint32_t imageIndex;
+  bool acquired;  // holds an image for the frame being recorded
+} Rendering_View;
+
 struct Rendering_Context {
+  Rendering_Config config;
   Vulkan_Context vulkan_context;
+  Platform_Context *platform;
+  bool dynamicRendering;
   VkSwapchainKHR swapChain;
   VkImage *swapChainImages;
   VkFormat swapChainImageFormat;
   VkExtent2D swapChainExtent;
   VkImageView *swapChainImageViews;
   uint32_t swapChainImageCount;
+  VkDeviceMemory *offscreenMemory;  // backs swapChainImages in offscreen mode
 
   VkShaderModule vertShaderModule;
   VkShaderModule fragShaderModule;
 
   VkPipelineLayout pipelineLayout;
-  VkRenderPass renderPass;
+  VkRenderPass renderPass;  // swapchain image; the scene and UI, or only the UI with post processing
   VkPipeline graphicsPipeline;
+  VkFormat sceneFormat;     // what the triangle and meshes render into
+  VkSampleCountFlagBits samples;  // of the scene pass; above 1 it draws into msaaTarget and resolves
+  RG_Handle msaaTarget;
 
   VkFramebuffer *swapChainFramebuffers;
+
+  // Further windows; slots with a NULL platform are free
+  Rendering_View views[RENDERING_MAX_VIEWS];
+  VkRenderPass viewRenderPass;  // render pass path: clears, compatible with renderPass
+
+  // Frame graph; the swapchain image is imported and swapped in per frame
+  Render_Graph graph;
+  RG_Handle swapChainTarget;
+  uint32_t imageIndex;
+
   VkCommandPool commandPool;
+
+  // Immediate-mode 2D sprites, drawn on top of the scene each frame
+  Sprite_Batch sprites;
+  Text_Context text;
+  Trace_Writer trace;
+
+  // 3D meshlets, drawn first into the swapchain image and a transient depth target
+  Mesh_Renderer meshes;
+  RG_Handle depthTarget;
+  RG_Handle hizTarget;
+  RG_Handle meshVisibilityTarget;
+  RG_Handle meshDrawTarget;
+
+  // Compute particles: simulated before the scene pass, which draws them
+  // with an indirect draw the simulation sized
+  Particle_System particles;
+  RG_Handle particleStateTarget;
+  RG_Handle particleListTarget;
+  RG_Handle particleCountersTarget;
+
+  // Post processing: the scene renders into an HDR transient that a compute
+  // chain resolves into the swapchain image, then the UI is drawn on top
+  Post_Context post;
+  bool postEnabled;
+  bool postDirect;  // the chain stores into the swapchain image, else into ldrTarget + blit
+  RG_Handle hdrTarget;
+  RG_Handle bloomTargets[2];
+  RG_Handle ldrTarget;
+  VkRenderPass sceneRenderPass;  // render pass path only
+  VkFramebuffer sceneFramebuffer;
+
+  // Dynamic resolution: the scene renders into the top-left renderExtent of
+  // the full-size HDR target and the composite upscales it, so a new scale
+  // only changes the viewport and a push constant
+  Resolution_Controller resolution;
+  bool resolutionEnabled;
+  VkExtent2D renderExtent;  // swapChainExtent without dynamic resolution
+
+  // Frame capture; the copy is a graph pass writing the imported slot buffer
+  bool captureEnabled;
+  Readback_Context readback;
+  RG_Handle readbackTarget;
+  int32_t readbackSlot;
+  bool captureRequested;  // with config.captureOnRequest; cleared once recorded
   VkCommandBuffer commandBuffers[MAX_FRAMES_IN_FLIGHT];
 
+  // With config.cacheCommands: one recording per swapchain image and frame
+  // slot, replayed while its key matches. Sprite instance data lives in the
+  // ring buffers, so only the draw list and the generation are in the key.
+  VkCommandBuffer *cachedCommands;  // [image * MAX_FRAMES_IN_FLIGHT + frame]
+  uint64_t *cachedKeys;             // 0 = not recorded
+  uint64_t commandsGeneration;      // bumped by rendering_invalidate_commands
+  uint64_t cacheHits;
+  uint64_t cacheMisses;
+
   // Synchronization objects
   VkSemaphore imageAvailableSemaphores[MAX_FRAMES_IN_FLIGHT];  // Per-frame
   VkSemaphore *renderFinishedSemaphores;  // Per-swapchain image (dynamic array)
   VkFence inFlightFences[MAX_FRAMES_IN_FLIGHT];  // Per-frame
   VkFence *imagesInFlight;  // Tracks which fence is using each image (dynamic array)
+  uint64_t fenceSubmissions[MAX_FRAMES_IN_FLIGHT];  // deletion queue value each fence signals
+
+  // Objects replaced while running (swapchain, framebuffers, graph transients),
+  // destroyed once the frames that may use them have finished
+  Deletion_Queue deletion;
 
   uint32_t currentFrame;
+  uint64_t frameNumber;
+
+  // Transient CPU data for the frame being recorded; reset every frame
+  Arena frameArena;
+
+  // Incremental present: sprite bounds of the last presented frame
+  float damageBounds[4];
+  bool fullDamage;  // next present reports the whole image (first frame, resize)
+
+  double createTimeMs;
+  Profiler_Stat resizeStat;
+  Profiler_Stat fenceStat;  // CPU blocked on the frame fence
+  Profiler_Stat presentStat;  // the one vkQueuePresentKHR covering every window
+  Profiler_Stat recordStat;   // recording the frame's commands, or picking the cached ones
 };
 
+// platform may be NULL when config.offscreen is set
 bool rendering_create(Rendering_Context *ctx, Vulkan_Context *vulkan_context, Platform_Context *platform);
 void rendering_draw(Rendering_Context *ctx);
+bool rendering_recreate_swapchain(Rendering_Context *ctx);
+// Adds a window drawn and presented along with the main one. It needs the
+// main swapchain's format and the direct scene path (no post processing).
+bool rendering_add_window(Rendering_Context *ctx, Platform_Context *platform);
+void rendering_remove_window(Rendering_Context *ctx, Platform_Context *platform);
+uint32_t rendering_window_count(const Rendering_Context *ctx);
+// Drops every cached recording; call when something they captured changes
+// outside of what the renderer tracks (resizes and pipeline swaps are tracked)
+void rendering_invalidate_commands(Rendering_Context *ctx);
+// Waits for every frame in flight and collects its capture, oldest first,
+// instead of leaving that to the draw that reuses the frame slot
+void rendering_collect_captures(Rendering_Context *ctx);
 void rendering_destroy(Rendering_Context *ctx);
 
 #endif
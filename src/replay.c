@@ -0,0 +1,140 @@
+#include "rendering.h"
+#include "vulkan_init.h"
+#include "profiler.h"
+#include "trace.h"
+#include "color.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Trace replay: feeds recorded sprite and text calls through an offscreen
+// renderer as fast as it will go. No window, no input, no frame pacing, so runs are
+// comparable across builds.
+
+struct Replay {
+  Vulkan_Context vulkan;
+  Rendering_Context rendering;
+  Trace trace;
+
+  const char *path;
+  uint32_t loops;
+};
+struct Replay replay;
+
+static bool parseArgs(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+      replay.loops = (uint32_t)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      unsigned width = 0, height = 0;
+      if (sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+        printf(RED "[ERROR] " RESET "--size expects WIDTHxHEIGHT\n");
+        return false;
+      }
+      replay.rendering.config.offscreenExtent.width = width;
+      replay.rendering.config.offscreenExtent.height = height;
+    } else if (strcmp(argv[i], "--render-pass") == 0) {
+      replay.rendering.config.forceRenderPass = true;
+    } else if (argv[i][0] != '-' && !replay.path) {
+      replay.path = argv[i];
+    } else {
+      printf(RED "[ERROR] " RESET "unknown argument: %s\n", argv[i]);
+      return false;
+    }
+  }
+  if (!replay.path) {
+    printf("usage: %s TRACE [--loops N] [--size WxH] [--render-pass]\n", argv[0]);
+    return false;
+  }
+  return true;
+}
+
+// Plays the trace once. Texture records were resolved up front and are skipped.
+static void playTrace(Profiler_Stat *frameStat) {
+  Rendering_Context *r = &replay.rendering;
+  size_t cursor = 0;
+  Trace_Record record;
+  double frameStart = profiler_now_ms();
+
+  while (trace_next(&replay.trace, &cursor, &record)) {
+    switch (record.type) {
+      case TRACE_RECORD_SPRITE:
+        sprite_batch_push(&r->sprites, &record.sprite);
+        break;
+      case TRACE_RECORD_TEXT:
+        text_draw(&r->text, record.x, record.y, record.size, record.color, record.text);
+        break;
+      case TRACE_RECORD_FRAME: {
+        rendering_draw(r);
+        double now = profiler_now_ms();
+        if (frameStat) profiler_stat_add(frameStat, now - frameStart);
+        frameStart = now;
+        break;
+      }
+      case TRACE_RECORD_TEXTURE:
+        break;
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  replay.loops = 3;
+  if (!parseArgs(argc, argv)) return 1;
+  if (!trace_load(replay.path, &replay.trace)) return 1;
+  printf(GREEN "[OK] " RESET "Trace %s: %llu frames, %llu records, %ux%u\n", replay.path,
+         (unsigned long long)replay.trace.frames, (unsigned long long)replay.trace.records,
+         replay.trace.extent.width, replay.trace.extent.height);
+
+  Rendering_Config *config = &replay.rendering.config;
+  config->offscreen = true;
+  if (config->offscreenExtent.width == 0) config->offscreenExtent = replay.trace.extent;
+
+  bool vulkanOk = vulkan_create(&replay.vulkan, NULL);
+  if (!vulkanOk || !rendering_create(&replay.rendering, &replay.vulkan, NULL)) {
+    // Rendering only has something to undo once it had a device
+    if (vulkanOk) rendering_destroy(&replay.rendering);
+    vulkan_destroy(&replay.vulkan);
+    trace_free(&replay.trace);
+    return 1;
+  }
+
+  // The recorded images aren't in the trace; ids registered by the
+  // application get a white stand-in so draw keys and batching match.
+  Sprite_Batch *batch = &replay.rendering.sprites;
+  size_t cursor = 0;
+  Trace_Record record;
+  while (trace_next(&replay.trace, &cursor, &record)) {
+    if (record.type != TRACE_RECORD_TEXTURE) continue;
+    while (batch->textureCount <= record.texture) {
+      if (sprite_batch_add_texture(batch, batch->whiteView, VK_NULL_HANDLE) == SPRITE_WHITE_TEXTURE) break;
+    }
+  }
+
+  // First pass rasterizes glyphs and grows buffers; it isn't measured
+  playTrace(NULL);
+  vkDeviceWaitIdle(replay.rendering.vulkan_context.device);
+
+  Profiler_Stat frameStat = {0};
+  memset(&batch->flushStat, 0, sizeof(batch->flushStat));
+  double start = profiler_now_ms();
+  for (uint32_t i = 0; i < replay.loops; i++) {
+    playTrace(&frameStat);
+  }
+  vkDeviceWaitIdle(replay.rendering.vulkan_context.device);
+  double totalMs = profiler_now_ms() - start;
+
+  profiler_stat_print("replay frame (CPU)", &frameStat);
+  profiler_stat_print("sprite sort+upload", &batch->flushStat);
+  printf(CYAN "[PROFILE] " RESET "replay: %llu frames in %.3f ms, %.3f ms/frame, %.1f frames/s\n",
+         (unsigned long long)frameStat.count, totalMs,
+         frameStat.count ? totalMs / (double)frameStat.count : 0.0,
+         totalMs > 0.0 ? 1000.0 * (double)frameStat.count / totalMs : 0.0);
+
+  rendering_destroy(&replay.rendering);
+  vulkan_destroy(&replay.vulkan);
+  trace_free(&replay.trace);
+  arena_scratch_release();
+  return 0;
+}
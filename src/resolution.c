@@ -0,0 +1,139 @@
+#include "resolution.h"
+#include "color.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static float clampScale(const Resolution_Controller *rc, float scale) {
+  if (scale < rc->minScale) return rc->minScale;
+  if (scale > rc->maxScale) return rc->maxScale;
+  return scale;
+}
+
+bool resolution_create(Resolution_Controller *rc, Vulkan_Context *vk, uint32_t framesInFlight, float minScale,
+                       float maxScale, float targetMs) {
+  if (!rc || !vk || framesInFlight == 0 || framesInFlight > RESOLUTION_MAX_FRAMES || targetMs <= 0.0f) return false;
+
+  memset(rc, 0, sizeof(*rc));
+  rc->vk = vk;
+  rc->frameCount = framesInFlight;
+  rc->targetMs = targetMs;
+  rc->maxScale = 1.0f;
+  resolution_set_range(rc, minScale, maxScale);
+  rc->scale = rc->maxScale;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(vk->physicalDevice, &properties);
+  if (properties.limits.timestampComputeAndGraphics) {
+    VkQueryPoolCreateInfo queryInfo = {0};
+    queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = 2 * RESOLUTION_MAX_FRAMES;
+    if (vkCreateQueryPool(vk->device, &queryInfo, NULL, &rc->queryPool) == VK_SUCCESS) {
+      rc->timestampPeriod = properties.limits.timestampPeriod;
+    }
+  }
+  if (rc->queryPool == VK_NULL_HANDLE) {
+    printf(YELLOW "[WARNING] " RESET "no GPU timestamps, dynamic resolution stays at %.2f\n", rc->scale);
+  }
+  printf(GREEN "[OK] " RESET "Dynamic Resolution (%.2f-%.2f, %.2f ms target)\n", rc->minScale, rc->maxScale,
+         rc->targetMs);
+  return true;
+}
+
+void resolution_destroy(Resolution_Controller *rc) {
+  if (!rc || !rc->vk) return;
+  if (rc->queryPool != VK_NULL_HANDLE) vkDestroyQueryPool(rc->vk->device, rc->queryPool, NULL);
+  memset(rc, 0, sizeof(*rc));
+}
+
+void resolution_set_range(Resolution_Controller *rc, float minScale, float maxScale) {
+  if (!rc) return;
+  // The scene target is allocated at the full extent, so there is nothing above 1
+  if (maxScale > 1.0f || maxScale <= 0.0f) maxScale = 1.0f;
+  if (minScale < RESOLUTION_STEP) minScale = RESOLUTION_STEP;
+  if (minScale > maxScale) minScale = maxScale;
+  rc->minScale = minScale;
+  rc->maxScale = maxScale;
+  rc->scale = clampScale(rc, rc->scale);
+}
+
+// ========== FRAME ==========
+
+void resolution_begin(Resolution_Controller *rc, VkCommandBuffer cmd, uint32_t frameIndex) {
+  if (!rc || rc->queryPool == VK_NULL_HANDLE || frameIndex >= rc->frameCount) return;
+  uint32_t query = frameIndex * 2;
+  rc->vk->dispatch.vkCmdResetQueryPool(cmd, rc->queryPool, query, 2);
+  rc->vk->dispatch.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, rc->queryPool, query);
+}
+
+void resolution_end(Resolution_Controller *rc, VkCommandBuffer cmd, uint32_t frameIndex) {
+  if (!rc || rc->queryPool == VK_NULL_HANDLE || frameIndex >= rc->frameCount) return;
+  rc->vk->dispatch.vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, rc->queryPool, frameIndex * 2 + 1);
+  rc->timed[frameIndex] = true;
+}
+
+bool resolution_update(Resolution_Controller *rc, uint32_t frameIndex) {
+  if (!rc || !rc->vk || frameIndex >= rc->frameCount) return false;
+  rc->frame++;
+  if (!rc->timed[frameIndex]) return false;
+  rc->timed[frameIndex] = false;
+  double start = profiler_now_ms();
+
+  // Fence already waited: results are available, never block on them
+  uint64_t ticks[2];
+  if (vkGetQueryPoolResults(rc->vk->device, rc->queryPool, frameIndex * 2, 2, sizeof(ticks), ticks,
+                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+    return false;
+  }
+  double ms = (double)(ticks[1] - ticks[0]) * rc->timestampPeriod / 1000000.0;
+  profiler_stat_add(&rc->gpuStat, ms);
+  rc->scaleSum += rc->scale;
+  rc->filteredMs = rc->filteredMs == 0.0 ? ms : rc->filteredMs + (ms - rc->filteredMs) * RESOLUTION_SMOOTHING;
+
+  float scale = rc->scale;
+  if (rc->frame >= rc->settleUntil) {
+    if (rc->filteredMs > rc->targetMs) {
+      float fit = rc->scale * (float)sqrt(rc->targetMs / rc->filteredMs);
+      scale = floorf(fit / RESOLUTION_STEP + 1e-3f) * RESOLUTION_STEP;
+      if (scale > rc->scale - RESOLUTION_STEP) scale = rc->scale - RESOLUTION_STEP;
+    } else if (rc->filteredMs < rc->targetMs * RESOLUTION_HEADROOM) {
+      scale = rc->scale + RESOLUTION_STEP;
+    }
+    scale = clampScale(rc, scale);
+  }
+
+  bool changed = fabsf(scale - rc->scale) > 1e-4f;
+  if (changed) {
+    if (scale > rc->scale) rc->increases++;
+    else rc->decreases++;
+    // Expect the cost to follow the pixel count until samples at the new scale arrive
+    rc->filteredMs *= (double)(scale * scale) / (double)(rc->scale * rc->scale);
+    rc->scale = scale;
+    rc->settleUntil = rc->frame + RESOLUTION_SETTLE;
+  }
+  profiler_stat_add(&rc->updateStat, profiler_now_ms() - start);
+  return changed;
+}
+
+VkExtent2D resolution_extent(const Resolution_Controller *rc, VkExtent2D full) {
+  float scale = rc ? rc->scale : 1.0f;
+  VkExtent2D extent;
+  extent.width = (uint32_t)((float)full.width * scale + 0.5f);
+  extent.height = (uint32_t)((float)full.height * scale + 0.5f);
+  if (extent.width == 0) extent.width = 1;
+  if (extent.height == 0) extent.height = 1;
+  if (extent.width > full.width) extent.width = full.width;
+  if (extent.height > full.height) extent.height = full.height;
+  return extent;
+}
+
+void resolution_print_stats(const Resolution_Controller *rc) {
+  if (!rc || !rc->vk || rc->gpuStat.count == 0) return;
+  printf(CYAN "[PROFILE] " RESET "dynamic resolution: scale %.2f, average %.2f (%.2f-%.2f), "
+         "%u increases, %u decreases, %.2f ms target\n",
+         rc->scale, rc->scaleSum / (double)rc->gpuStat.count, rc->minScale, rc->maxScale,
+         rc->increases, rc->decreases, rc->targetMs);
+  profiler_stat_print("GPU frame", &rc->gpuStat);
+  profiler_stat_print("resolution update", &rc->updateStat);
+}
@@ -0,0 +1,64 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "vulkan_init.h"
+#include "profiler.h"
+
+#define RESOLUTION_MAX_FRAMES 3
+#define RESOLUTION_STEP 0.05f       // scales are multiples of this, so noise can't nudge it every frame
+#define RESOLUTION_HEADROOM 0.85    // grows only while GPU time is under this share of the target
+#define RESOLUTION_SMOOTHING 0.2    // weight of each new sample in the filtered GPU time
+#define RESOLUTION_SETTLE 8         // frames after a change before the next; samples lag by the frames in flight
+
+// Picks the scene's render scale from the GPU time of whole frames. Each
+// frame slot brackets its command buffer with two timestamps, read once the
+// slot is fenced. Above the target the scale drops at once by the square
+// root of the overshoot (cost follows the pixel count); under the headroom
+// it grows one step at a time, so it doesn't oscillate around the target.
+// Without timestamp support the scale stays at its maximum.
+typedef struct {
+  Vulkan_Context *vk;
+  uint32_t frameCount;
+
+  float minScale;  // per axis, of the full extent
+  float maxScale;
+  float targetMs;
+  float scale;
+
+  double filteredMs;  // 0 until the first sample
+  uint64_t frame;
+  uint64_t settleUntil;
+
+  VkQueryPool queryPool;
+  float timestampPeriod;
+  bool timed[RESOLUTION_MAX_FRAMES];
+
+  uint32_t increases;
+  uint32_t decreases;
+  double scaleSum;  // over every update, for the average
+  Profiler_Stat gpuStat;
+  Profiler_Stat updateStat;
+} Resolution_Controller;
+
+bool resolution_create(Resolution_Controller *rc, Vulkan_Context *vk, uint32_t framesInFlight, float minScale,
+                       float maxScale, float targetMs);
+void resolution_destroy(Resolution_Controller *rc);
+
+// Bounds may change at any time; the scale is clamped into them
+void resolution_set_range(Resolution_Controller *rc, float minScale, float maxScale);
+
+// Around everything the frame records
+void resolution_begin(Resolution_Controller *rc, VkCommandBuffer cmd, uint32_t frameIndex);
+void resolution_end(Resolution_Controller *rc, VkCommandBuffer cmd, uint32_t frameIndex);
+// Reads the slot's timing once its fence is waited on and steers the scale.
+// Returns true when the scale changed.
+bool resolution_update(Resolution_Controller *rc, uint32_t frameIndex);
+
+// The scaled extent, at least 1x1
+VkExtent2D resolution_extent(const Resolution_Controller *rc, VkExtent2D full);
+void resolution_print_stats(const Resolution_Controller *rc);
+
+#endif
@@ -0,0 +1,577 @@
+#include "scene.h"
+#include "color.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#if defined(__SSE2__)
+#define SCENE_HAVE_SSE 1
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+// Built for AVX whatever the compiler flags, and only called after a CPU check
+#define SCENE_HAVE_AVX 1
+#define SCENE_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+#define SCENE_FLOAT_ARRAYS 34  // position 3, rotation 4, scale 3, local box 6, world 12, world box 6
+
+Scene_Kernel scene_best_kernel(void) {
+#if SCENE_HAVE_AVX
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx")) return SCENE_KERNEL_AVX;
+#endif
+#if SCENE_HAVE_SSE
+  return SCENE_KERNEL_SSE;
+#else
+  return SCENE_KERNEL_SCALAR;
+#endif
+}
+
+const char *scene_kernel_name(Scene_Kernel kernel) {
+  switch (kernel) {
+    case SCENE_KERNEL_SCALAR: return "scalar";
+    case SCENE_KERNEL_SSE: return "SSE";
+    case SCENE_KERNEL_AVX: return "AVX";
+  }
+  return "unknown";
+}
+
+// Every float array in the store, in a fixed order
+static void floatArrays(Scene_Store *store, float ***arrays) {
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < 3; i++) arrays[n++] = &store->position[i];
+  for (uint32_t i = 0; i < 4; i++) arrays[n++] = &store->rotation[i];
+  for (uint32_t i = 0; i < 3; i++) arrays[n++] = &store->scale[i];
+  for (uint32_t i = 0; i < 3; i++) arrays[n++] = &store->localCenter[i];
+  for (uint32_t i = 0; i < 3; i++) arrays[n++] = &store->localExtent[i];
+  for (uint32_t i = 0; i < 12; i++) arrays[n++] = &store->world[i];
+  for (uint32_t i = 0; i < 3; i++) arrays[n++] = &store->boundsMin[i];
+  for (uint32_t i = 0; i < 3; i++) arrays[n++] = &store->boundsMax[i];
+}
+
+// ========== KERNELS ==========
+
+// Local 3x4 from position, rotation and scale: [R * diag(s) | t]
+static void localMatrix(const Scene_Store *store, uint32_t i, float *l) {
+  float x = store->rotation[0][i], y = store->rotation[1][i], z = store->rotation[2][i], w = store->rotation[3][i];
+  float sx = store->scale[0][i], sy = store->scale[1][i], sz = store->scale[2][i];
+  l[0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+  l[1] = 2.0f * (x * y - w * z) * sy;
+  l[2] = 2.0f * (x * z + w * y) * sz;
+  l[3] = store->position[0][i];
+  l[4] = 2.0f * (x * y + w * z) * sx;
+  l[5] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+  l[6] = 2.0f * (y * z - w * x) * sz;
+  l[7] = store->position[1][i];
+  l[8] = 2.0f * (x * z - w * y) * sx;
+  l[9] = 2.0f * (y * z + w * x) * sy;
+  l[10] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+  l[11] = store->position[2][i];
+}
+
+static void updateScalar(Scene_Store *store, uint32_t begin, uint32_t end, bool roots) {
+  for (uint32_t i = begin; i < end; i++) {
+    float l[12], w[12];
+    localMatrix(store, i, l);
+    if (roots) {
+      memcpy(w, l, sizeof(w));
+    } else {
+      uint32_t p = store->parent[i];
+      for (uint32_t r = 0; r < 3; r++) {
+        float p0 = store->world[r * 4][p], p1 = store->world[r * 4 + 1][p];
+        float p2 = store->world[r * 4 + 2][p], p3 = store->world[r * 4 + 3][p];
+        for (uint32_t c = 0; c < 4; c++) {
+          w[r * 4 + c] = p0 * l[c] + p1 * l[4 + c] + p2 * l[8 + c] + (c == 3 ? p3 : 0.0f);
+        }
+      }
+    }
+    for (uint32_t e = 0; e < 12; e++) store->world[e][i] = w[e];
+
+    // Box transformed by the matrix, extents by its absolute value
+    float cx = store->localCenter[0][i], cy = store->localCenter[1][i], cz = store->localCenter[2][i];
+    float ex = store->localExtent[0][i], ey = store->localExtent[1][i], ez = store->localExtent[2][i];
+    for (uint32_t r = 0; r < 3; r++) {
+      const float *row = &w[r * 4];
+      float center = row[0] * cx + row[1] * cy + row[2] * cz + row[3];
+      float extent = fabsf(row[0]) * ex + fabsf(row[1]) * ey + fabsf(row[2]) * ez;
+      store->boundsMin[r][i] = center - extent;
+      store->boundsMax[r][i] = center + extent;
+    }
+  }
+}
+
+#if SCENE_HAVE_SSE
+static inline __m128 gatherSse(const float *array, const uint32_t *index) {
+  return _mm_set_ps(array[index[3]], array[index[2]], array[index[1]], array[index[0]]);
+}
+
+// Same math as updateScalar, four objects per iteration. Returns where it stopped.
+static uint32_t updateSse(Scene_Store *store, uint32_t begin, uint32_t end, bool roots) {
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  uint32_t i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 x = _mm_loadu_ps(store->rotation[0] + i), y = _mm_loadu_ps(store->rotation[1] + i);
+    __m128 z = _mm_loadu_ps(store->rotation[2] + i), w = _mm_loadu_ps(store->rotation[3] + i);
+    __m128 sx = _mm_loadu_ps(store->scale[0] + i), sy = _mm_loadu_ps(store->scale[1] + i);
+    __m128 sz = _mm_loadu_ps(store->scale[2] + i);
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+    __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+    __m128 l[12];
+    l[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+    l[1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+    l[2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+    l[3] = _mm_loadu_ps(store->position[0] + i);
+    l[4] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+    l[5] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+    l[6] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+    l[7] = _mm_loadu_ps(store->position[1] + i);
+    l[8] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+    l[9] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+    l[10] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+    l[11] = _mm_loadu_ps(store->position[2] + i);
+
+    __m128 m[12];
+    if (roots) {
+      memcpy(m, l, sizeof(m));
+    } else {
+      // Siblings are adjacent, so the gathers mostly hit the same parent
+      const uint32_t *parent = store->parent + i;
+      for (uint32_t r = 0; r < 3; r++) {
+        __m128 p0 = gatherSse(store->world[r * 4], parent), p1 = gatherSse(store->world[r * 4 + 1], parent);
+        __m128 p2 = gatherSse(store->world[r * 4 + 2], parent), p3 = gatherSse(store->world[r * 4 + 3], parent);
+        for (uint32_t c = 0; c < 4; c++) {
+          __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, l[c]), _mm_mul_ps(p1, l[4 + c])), _mm_mul_ps(p2, l[8 + c]));
+          m[r * 4 + c] = c == 3 ? _mm_add_ps(v, p3) : v;
+        }
+      }
+    }
+    for (uint32_t e = 0; e < 12; e++) _mm_storeu_ps(store->world[e] + i, m[e]);
+
+    __m128 cx = _mm_loadu_ps(store->localCenter[0] + i), cy = _mm_loadu_ps(store->localCenter[1] + i);
+    __m128 cz = _mm_loadu_ps(store->localCenter[2] + i);
+    __m128 ex = _mm_loadu_ps(store->localExtent[0] + i), ey = _mm_loadu_ps(store->localExtent[1] + i);
+    __m128 ez = _mm_loadu_ps(store->localExtent[2] + i);
+    for (uint32_t r = 0; r < 3; r++) {
+      const __m128 *row = &m[r * 4];
+      __m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(row[0], cx), _mm_mul_ps(row[1], cy)),
+                                 _mm_add_ps(_mm_mul_ps(row[2], cz), row[3]));
+      __m128 extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign, row[0]), ex),
+                                            _mm_mul_ps(_mm_andnot_ps(sign, row[1]), ey)),
+                                 _mm_mul_ps(_mm_andnot_ps(sign, row[2]), ez));
+      _mm_storeu_ps(store->boundsMin[r] + i, _mm_sub_ps(center, extent));
+      _mm_storeu_ps(store->boundsMax[r] + i, _mm_add_ps(center, extent));
+    }
+  }
+  return i;
+}
+#endif
+
+#if SCENE_HAVE_AVX
+SCENE_AVX static inline __m256 gatherAvx(const float *array, const uint32_t *index) {
+  return _mm256_set_ps(array[index[7]], array[index[6]], array[index[5]], array[index[4]],
+                       array[index[3]], array[index[2]], array[index[1]], array[index[0]]);
+}
+
+// updateSse at eight objects per iteration
+SCENE_AVX static uint32_t updateAvx(Scene_Store *store, uint32_t begin, uint32_t end, bool roots) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  uint32_t i = begin;
+  for (; i + 8 <= end; i += 8) {
+    __m256 x = _mm256_loadu_ps(store->rotation[0] + i), y = _mm256_loadu_ps(store->rotation[1] + i);
+    __m256 z = _mm256_loadu_ps(store->rotation[2] + i), w = _mm256_loadu_ps(store->rotation[3] + i);
+    __m256 sx = _mm256_loadu_ps(store->scale[0] + i), sy = _mm256_loadu_ps(store->scale[1] + i);
+    __m256 sz = _mm256_loadu_ps(store->scale[2] + i);
+    __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+    __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+    __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+    __m256 l[12];
+    l[0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))), sx);
+    l[1] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy);
+    l[2] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz);
+    l[3] = _mm256_loadu_ps(store->position[0] + i);
+    l[4] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx);
+    l[5] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))), sy);
+    l[6] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz);
+    l[7] = _mm256_loadu_ps(store->position[1] + i);
+    l[8] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx);
+    l[9] = _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy);
+    l[10] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))), sz);
+    l[11] = _mm256_loadu_ps(store->position[2] + i);
+
+    __m256 m[12];
+    if (roots) {
+      memcpy(m, l, sizeof(m));
+    } else {
+      const uint32_t *parent = store->parent + i;
+      for (uint32_t r = 0; r < 3; r++) {
+        __m256 p0 = gatherAvx(store->world[r * 4], parent), p1 = gatherAvx(store->world[r * 4 + 1], parent);
+        __m256 p2 = gatherAvx(store->world[r * 4 + 2], parent), p3 = gatherAvx(store->world[r * 4 + 3], parent);
+        for (uint32_t c = 0; c < 4; c++) {
+          __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p0, l[c]), _mm256_mul_ps(p1, l[4 + c])),
+                                   _mm256_mul_ps(p2, l[8 + c]));
+          m[r * 4 + c] = c == 3 ? _mm256_add_ps(v, p3) : v;
+        }
+      }
+    }
+    for (uint32_t e = 0; e < 12; e++) _mm256_storeu_ps(store->world[e] + i, m[e]);
+
+    __m256 cx = _mm256_loadu_ps(store->localCenter[0] + i), cy = _mm256_loadu_ps(store->localCenter[1] + i);
+    __m256 cz = _mm256_loadu_ps(store->localCenter[2] + i);
+    __m256 ex = _mm256_loadu_ps(store->localExtent[0] + i), ey = _mm256_loadu_ps(store->localExtent[1] + i);
+    __m256 ez = _mm256_loadu_ps(store->localExtent[2] + i);
+    for (uint32_t r = 0; r < 3; r++) {
+      const __m256 *row = &m[r * 4];
+      __m256 center = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(row[0], cx), _mm256_mul_ps(row[1], cy)),
+                                    _mm256_add_ps(_mm256_mul_ps(row[2], cz), row[3]));
+      __m256 extent = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign, row[0]), ex),
+                                                  _mm256_mul_ps(_mm256_andnot_ps(sign, row[1]), ey)),
+                                    _mm256_mul_ps(_mm256_andnot_ps(sign, row[2]), ez));
+      _mm256_storeu_ps(store->boundsMin[r] + i, _mm256_sub_ps(center, extent));
+      _mm256_storeu_ps(store->boundsMax[r] + i, _mm256_add_ps(center, extent));
+    }
+  }
+  return i;
+}
+#endif
+
+// One depth's span; the vector kernels leave the tail to the scalar one
+static void updateSpan(Scene_Store *store, uint32_t begin, uint32_t end, bool roots) {
+  switch (store->kernel) {
+#if SCENE_HAVE_AVX
+    case SCENE_KERNEL_AVX:
+      begin = updateAvx(store, begin, end, roots);
+      break;
+#endif
+#if SCENE_HAVE_SSE
+    case SCENE_KERNEL_SSE:
+      begin = updateSse(store, begin, end, roots);
+      break;
+#endif
+    default:
+      break;
+  }
+  updateScalar(store, begin, end, roots);
+}
+
+// ========== HIERARCHY ==========
+
+// First index in [begin, end) whose parent is at least value; parents
+// ascend within a depth
+static uint32_t lowerBound(const uint32_t *parent, uint32_t begin, uint32_t end, uint32_t value) {
+  while (begin < end) {
+    uint32_t mid = begin + (end - begin) / 2;
+    if (parent[mid] < value) begin = mid + 1;
+    else end = mid;
+  }
+  return begin;
+}
+
+static void markDirty(Scene_Store *store, uint32_t index) {
+  if (!store->sorted) return;  // the sort recomputes everything anyway
+  store->changed[index] = 1;
+  Scene_Range *range = &store->dirty[store->depth[index]];
+  if (range->begin == range->end) {
+    range->begin = index;
+    range->end = index + 1;
+    return;
+  }
+  if (index < range->begin) range->begin = index;
+  if (index >= range->end) range->end = index + 1;
+}
+
+// Recomputes one run of changed blocks
+static void recomputeRun(Scene_Store *store, Scene_Range run, bool roots, Scene_Range *changedSpan) {
+  updateSpan(store, run.begin, run.end, roots);
+  store->updatedObjects += run.end - run.begin;
+  if (changedSpan->begin == changedSpan->end) changedSpan->begin = run.begin;
+  changedSpan->end = run.end;
+}
+
+// Reorders everything by depth, and within a depth by the parent's new
+// index, with one counting sort per depth. Arrays are permuted through the
+// spare one and swapped with it.
+static bool sortStore(Scene_Store *store) {
+  uint32_t n = store->count;
+  uint32_t *byDepth = malloc(sizeof(uint32_t) * n);
+  uint32_t *order = malloc(sizeof(uint32_t) * n);
+  uint32_t *newIndex = malloc(sizeof(uint32_t) * n);
+  uint32_t levelSize[SCENE_MAX_DEPTH] = {0};
+  uint32_t levelCount = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    levelSize[store->depth[i]]++;
+    if (store->depth[i] + 1u > levelCount) levelCount = store->depth[i] + 1u;
+  }
+  uint32_t widest = 0;
+  store->levelStart[0] = 0;
+  for (uint32_t d = 0; d < levelCount; d++) {
+    store->levelStart[d + 1] = store->levelStart[d] + levelSize[d];
+    if (levelSize[d] > widest) widest = levelSize[d];
+  }
+  store->levelCount = levelCount;
+  uint32_t *counts = malloc(sizeof(uint32_t) * (widest + 1));
+  if (!byDepth || !order || !newIndex || !counts) {
+    free(byDepth);
+    free(order);
+    free(newIndex);
+    free(counts);
+    return false;
+  }
+
+  uint32_t fill[SCENE_MAX_DEPTH];
+  memcpy(fill, store->levelStart, sizeof(uint32_t) * levelCount);
+  for (uint32_t i = 0; i < n; i++) byDepth[fill[store->depth[i]]++] = i;
+
+  // Roots keep their insertion order; each deeper level follows its parents
+  for (uint32_t k = 0; k < store->levelStart[1]; k++) {
+    order[k] = byDepth[k];
+    newIndex[byDepth[k]] = k;
+  }
+  for (uint32_t d = 1; d < levelCount; d++) {
+    uint32_t parentBase = store->levelStart[d - 1];
+    uint32_t parents = store->levelStart[d] - parentBase;
+    memset(counts, 0, sizeof(uint32_t) * (parents + 1));
+    for (uint32_t k = store->levelStart[d]; k < store->levelStart[d + 1]; k++) {
+      counts[newIndex[store->parent[byDepth[k]]] - parentBase + 1]++;
+    }
+    for (uint32_t p = 0; p < parents; p++) counts[p + 1] += counts[p];
+    for (uint32_t k = store->levelStart[d]; k < store->levelStart[d + 1]; k++) {
+      uint32_t old = byDepth[k];
+      uint32_t slot = store->levelStart[d] + counts[newIndex[store->parent[old]] - parentBase]++;
+      order[slot] = old;
+      newIndex[old] = slot;
+    }
+  }
+
+  float **arrays[SCENE_FLOAT_ARRAYS];
+  floatArrays(store, arrays);
+  for (uint32_t a = 0; a < SCENE_FLOAT_ARRAYS; a++) {
+    float *src = *arrays[a];
+    float *dst = (float *)store->spare;
+    for (uint32_t k = 0; k < n; k++) dst[k] = src[order[k]];
+    *arrays[a] = dst;
+    store->spare = (uint32_t *)src;
+  }
+
+  // byDepth is free from here on
+  uint32_t *scratch = byDepth;
+  for (uint32_t k = 0; k < n; k++) {
+    uint32_t parent = store->parent[order[k]];
+    scratch[k] = parent == SCENE_NONE ? SCENE_NONE : newIndex[parent];
+  }
+  memcpy(store->parent, scratch, sizeof(uint32_t) * n);
+  for (uint32_t k = 0; k < n; k++) scratch[k] = store->indexToHandle[order[k]];
+  memcpy(store->indexToHandle, scratch, sizeof(uint32_t) * n);
+  for (uint32_t k = 0; k < n; k++) store->handleToIndex[store->indexToHandle[k]] = k;
+  for (uint32_t d = 0; d < levelCount; d++) {
+    memset(store->depth + store->levelStart[d], (int)d, levelSize[d]);
+  }
+
+  free(byDepth);
+  free(order);
+  free(newIndex);
+  free(counts);
+  memset(store->changed, 0, n);
+  store->sorted = true;
+  // Indices moved, so everything is recomputed in its new place
+  scene_store_invalidate(store);
+  return true;
+}
+
+// ========== PUBLIC API ==========
+
+bool scene_store_create(Scene_Store *store, uint32_t capacity) {
+  if (!store || capacity == 0 || capacity > UINT32_MAX - 8) return false;
+  memset(store, 0, sizeof(*store));
+
+  // Whole AVX registers per array, so every array stays aligned
+  size_t stride = ((size_t)capacity + 7) & ~(size_t)7;
+  size_t byteStride = (stride + SCENE_ALIGN - 1) & ~(size_t)(SCENE_ALIGN - 1);
+  // + spare, parent and the two handle maps, then depth and changed
+  size_t size = (SCENE_FLOAT_ARRAYS + 4) * stride * sizeof(float) + 2 * byteStride;
+  store->block = aligned_alloc(SCENE_ALIGN, size);
+  if (!store->block) {
+    printf(RED "[ERROR] " RESET "scene: failed to allocate %u objects\n", capacity);
+    return false;
+  }
+  store->capacity = capacity;
+
+  float *next = store->block;
+  float **arrays[SCENE_FLOAT_ARRAYS];
+  floatArrays(store, arrays);
+  for (uint32_t a = 0; a < SCENE_FLOAT_ARRAYS; a++, next += stride) *arrays[a] = next;
+  store->spare = (uint32_t *)next;
+  next += stride;
+  store->parent = (uint32_t *)next;
+  next += stride;
+  store->handleToIndex = (uint32_t *)next;
+  next += stride;
+  store->indexToHandle = (uint32_t *)next;
+  next += stride;
+  store->depth = (uint8_t *)next;
+  store->changed = store->depth + byteStride;
+  memset(store->changed, 0, byteStride);
+
+  store->sorted = true;
+  store->kernel = scene_best_kernel();
+  printf(GREEN "[OK] " RESET "Scene Store (%u objects, %s kernel, %.1f MB)\n", capacity,
+         scene_kernel_name(store->kernel), (double)size / (1024.0 * 1024.0));
+  return true;
+}
+
+void scene_store_destroy(Scene_Store *store) {
+  if (!store) return;
+  free(store->block);
+  memset(store, 0, sizeof(*store));
+}
+
+uint32_t scene_store_add(Scene_Store *store, const Scene_Object *object) {
+  if (!store || !store->block || !object || store->count == store->capacity) return SCENE_NONE;
+  uint32_t parent = SCENE_NONE;
+  uint32_t depth = 0;
+  if (object->parent != SCENE_NONE) {
+    if (object->parent >= store->count) return SCENE_NONE;
+    parent = store->handleToIndex[object->parent];
+    depth = store->depth[parent] + 1u;
+    if (depth >= SCENE_MAX_DEPTH) return SCENE_NONE;
+  }
+
+  // Nothing is ever removed, so the next handle and the next index are both count
+  uint32_t i = store->count++;
+  store->handleToIndex[i] = i;
+  store->indexToHandle[i] = i;
+  store->parent[i] = parent;
+  store->depth[i] = (uint8_t)depth;
+  for (uint32_t c = 0; c < 3; c++) {
+    store->position[c][i] = object->position[c];
+    store->scale[c][i] = object->scale[c];
+    store->localCenter[c][i] = object->boundsCenter[c];
+    store->localExtent[c][i] = object->boundsExtent[c];
+  }
+  for (uint32_t c = 0; c < 4; c++) store->rotation[c][i] = object->rotation[c];
+  store->sorted = false;
+  return i;
+}
+
+uint32_t scene_store_index(const Scene_Store *store, uint32_t handle) {
+  if (!store || handle >= store->count) return SCENE_NONE;
+  return store->handleToIndex[handle];
+}
+
+void scene_store_set_position(Scene_Store *store, uint32_t handle, const float position[3]) {
+  uint32_t i = scene_store_index(store, handle);
+  if (i == SCENE_NONE) return;
+  for (uint32_t c = 0; c < 3; c++) store->position[c][i] = position[c];
+  markDirty(store, i);
+}
+
+void scene_store_set_rotation(Scene_Store *store, uint32_t handle, const float rotation[4]) {
+  uint32_t i = scene_store_index(store, handle);
+  if (i == SCENE_NONE) return;
+  for (uint32_t c = 0; c < 4; c++) store->rotation[c][i] = rotation[c];
+  markDirty(store, i);
+}
+
+void scene_store_set_scale(Scene_Store *store, uint32_t handle, const float scale[3]) {
+  uint32_t i = scene_store_index(store, handle);
+  if (i == SCENE_NONE) return;
+  for (uint32_t c = 0; c < 3; c++) store->scale[c][i] = scale[c];
+  markDirty(store, i);
+}
+
+void scene_store_invalidate(Scene_Store *store) {
+  if (!store || !store->sorted) return;
+  for (uint32_t d = 0; d < store->levelCount; d++) {
+    store->dirty[d].begin = store->levelStart[d];
+    store->dirty[d].end = store->levelStart[d + 1];
+  }
+  memset(store->changed, 1, store->count);
+}
+
+void scene_store_update(Scene_Store *store) {
+  if (!store || !store->block || store->count == 0) return;
+  if (!store->sorted) {
+    double sortStart = profiler_now_ms();
+    if (!sortStore(store)) {
+      printf(RED "[ERROR] " RESET "scene: out of memory sorting %u objects\n", store->count);
+      return;
+    }
+    profiler_stat_add(&store->sortStat, profiler_now_ms() - sortStart);
+  }
+
+  double start = profiler_now_ms();
+  store->updatedObjects = 0;
+  Scene_Range scanned[SCENE_MAX_DEPTH];
+  Scene_Range parents = {0, 0};  // where the previous depth changed
+  for (uint32_t d = 0; d < store->levelCount; d++) {
+    Scene_Range span = store->dirty[d];
+    store->dirty[d].begin = 0;
+    store->dirty[d].end = 0;
+    if (parents.begin < parents.end) {
+      // Children of a contiguous run of parents are contiguous
+      uint32_t levelEnd = store->levelStart[d + 1];
+      uint32_t first = lowerBound(store->parent, store->levelStart[d], levelEnd, parents.begin);
+      uint32_t last = lowerBound(store->parent, first, levelEnd, parents.end);
+      for (uint32_t i = first; i < last; i++) store->changed[i] |= store->changed[store->parent[i]];
+      if (span.begin == span.end) {
+        span.begin = first;
+        span.end = last;
+      } else if (first < last) {
+        if (first < span.begin) span.begin = first;
+        if (last > span.end) span.end = last;
+      }
+    }
+    scanned[d] = span;
+
+    parents.begin = 0;
+    parents.end = 0;
+    Scene_Range run = {SCENE_NONE, SCENE_NONE};
+    for (uint32_t block = span.begin; block < span.end; block += SCENE_BLOCK) {
+      uint32_t blockEnd = block + SCENE_BLOCK < span.end ? block + SCENE_BLOCK : span.end;
+      bool changed = false;
+      for (uint32_t i = block; i < blockEnd && !changed; i++) changed = store->changed[i] != 0;
+      if (changed && run.begin == SCENE_NONE) run.begin = block;
+      if (!changed && run.begin != SCENE_NONE) {
+        run.end = block;
+        recomputeRun(store, run, d == 0, &parents);
+        run.begin = SCENE_NONE;
+      }
+    }
+    if (run.begin != SCENE_NONE) {
+      run.end = span.end;
+      recomputeRun(store, run, d == 0, &parents);
+    }
+  }
+  // Only now, as each depth read its parents' flags
+  for (uint32_t d = 0; d < store->levelCount; d++) {
+    if (scanned[d].begin < scanned[d].end) {
+      memset(store->changed + scanned[d].begin, 0, scanned[d].end - scanned[d].begin);
+    }
+  }
+  profiler_stat_add(&store->updateStat, profiler_now_ms() - start);
+}
+
+bool scene_store_set_kernel(Scene_Store *store, Scene_Kernel kernel) {
+  // Each kernel's instructions are a subset of the next one's
+  if (!store || kernel > scene_best_kernel()) return false;
+  store->kernel = kernel;
+  return true;
+}
+
+void scene_store_print_stats(const Scene_Store *store) {
+  if (!store || !store->block) return;
+  printf(CYAN "[PROFILE] " RESET "scene: %u objects in %u levels, %s kernel\n", store->count, store->levelCount,
+         scene_kernel_name(store->kernel));
+  profiler_stat_print("scene sort", &store->sortStat);
+  profiler_stat_print("scene update", &store->updateStat);
+}
@@ -0,0 +1,110 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "profiler.h"
+
+#define SCENE_NONE UINT32_MAX
+#define SCENE_MAX_DEPTH 32
+#define SCENE_ALIGN 32              // every SoA array starts on an AVX register boundary
+#define SCENE_BLOCK 64              // objects recomputed together when any of them changed
+
+typedef enum {
+  SCENE_KERNEL_SCALAR,
+  SCENE_KERNEL_SSE,  // 4 objects per iteration
+  SCENE_KERNEL_AVX,  // 8 objects per iteration, picked at runtime
+} Scene_Kernel;
+
+// What gets added; transforms are relative to the parent
+typedef struct {
+  uint32_t parent;       // handle, SCENE_NONE for a root
+  float position[3];
+  float rotation[4];     // unit quaternion x, y, z, w
+  float scale[3];
+  float boundsCenter[3]; // local box the world bounds are built from
+  float boundsExtent[3]; // half size
+} Scene_Object;
+
+typedef struct {
+  uint32_t begin;
+  uint32_t end;
+} Scene_Range;
+
+// Data-oriented transform store. Every per-object field is its own aligned
+// array, so the update streams through memory instead of chasing node
+// pointers. Objects are kept sorted by depth, and within a depth by parent,
+// so one pass in index order updates every parent before its children and
+// the children of a contiguous run of parents are contiguous too. Edits set
+// a changed flag, which the update hands down one depth at a time; only the
+// blocks holding a changed object are recomputed, with SSE or AVX kernels
+// where the CPU has them.
+//
+// Handles are stable; indices change when an add re-sorts the store, which
+// recomputes everything.
+//
+// CPU only: nothing renders from the store, and --bench-scene is its only
+// caller.
+typedef struct {
+  uint32_t capacity;  // fixed at creation
+  uint32_t count;
+  void *block;        // every array below, in one allocation
+
+  // Local transform and bounds
+  float *position[3];
+  float *rotation[4];
+  float *scale[3];
+  float *localCenter[3];
+  float *localExtent[3];
+
+  // World transform, 3x4 row-major (element r * 4 + c), and world box
+  float *world[12];
+  float *boundsMin[3];
+  float *boundsMax[3];
+
+  uint32_t *parent;  // index, SCENE_NONE for roots
+  uint32_t *handleToIndex;
+  uint32_t *indexToHandle;
+  uint8_t *depth;
+  uint8_t *changed;  // edited, or under an edited parent, since the last update
+  uint32_t *spare;  // permutation target while sorting, swapped in
+
+  bool sorted;  // false after an add, until the next update
+  uint32_t levelCount;
+  uint32_t levelStart[SCENE_MAX_DEPTH + 1];
+  Scene_Range dirty[SCENE_MAX_DEPTH];  // bounds of the edits since the last update, per depth
+
+  Scene_Kernel kernel;
+  uint64_t updatedObjects;  // recomputed by the last update
+  Profiler_Stat sortStat;
+  Profiler_Stat updateStat;
+} Scene_Store;
+
+// The best kernel this CPU runs
+Scene_Kernel scene_best_kernel(void);
+const char *scene_kernel_name(Scene_Kernel kernel);
+
+bool scene_store_create(Scene_Store *store, uint32_t capacity);
+void scene_store_destroy(Scene_Store *store);
+
+// Returns the handle, or SCENE_NONE when full, the parent is unknown or
+// the hierarchy would be deeper than SCENE_MAX_DEPTH
+uint32_t scene_store_add(Scene_Store *store, const Scene_Object *object);
+// Current index of a handle; stable until the next add
+uint32_t scene_store_index(const Scene_Store *store, uint32_t handle);
+
+void scene_store_set_position(Scene_Store *store, uint32_t handle, const float position[3]);
+void scene_store_set_rotation(Scene_Store *store, uint32_t handle, const float rotation[4]);
+void scene_store_set_scale(Scene_Store *store, uint32_t handle, const float scale[3]);
+// Everything is recomputed by the next update
+void scene_store_invalidate(Scene_Store *store);
+
+// Sorts if needed and recomputes world matrices and bounds of the dirty
+// objects and their descendants
+void scene_store_update(Scene_Store *store);
+// Fails when the CPU can't run the kernel
+bool scene_store_set_kernel(Scene_Store *store, Scene_Kernel kernel);
+void scene_store_print_stats(const Scene_Store *store);
+
+#endif
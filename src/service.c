@@ -0,0 +1,420 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // memfd_create, accept4
+#endif
+#include "service.h"
+#include "color.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static size_t alignUp(size_t value, size_t align) {
+  return (value + align - 1) / align * align;
+}
+
+static bool socketAddress(const char *path, struct sockaddr_un *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr->sun_path)) {
+    printf(RED "[ERROR] " RESET "service: socket path too long: %s\n", path);
+    return false;
+  }
+  memcpy(addr->sun_path, path, strlen(path) + 1);
+  return true;
+}
+
+// ========== SERVICE ==========
+
+static bool sendReady(Render_Service *service, uint32_t id, int32_t slot, uint64_t frameNumber) {
+  Service_Frame_Ready ready = {0};
+  ready.id = id;
+  ready.slot = slot;
+  ready.frameNumber = frameNumber;
+  return send(service->clientFd, &ready, sizeof(ready), MSG_NOSIGNAL) == (ssize_t)sizeof(ready);
+}
+
+// Readback sink; runs inside rendering_draw or rendering_collect_captures
+static void frameReady(Readback_Context *rb, int32_t slot, void *userData) {
+  Render_Service *service = userData;
+  if (service->inFlight > 0) service->inFlight--;
+  if (service->clientFd < 0) {
+    readback_release(rb, slot);
+    return;
+  }
+  // A failed send means the client is gone; the next read notices
+  if (!sendReady(service, service->slotRequest[slot], slot, rb->slots[slot].frameNumber)) {
+    readback_release(rb, slot);
+    return;
+  }
+  service->slotHeld[slot] = true;
+  service->framesServed++;
+  profiler_stat_add(&service->latencyStat, profiler_now_ms() - service->slotStartMs[slot]);
+}
+
+static void releaseSlot(Render_Service *service, int32_t slot) {
+  if (slot < 0 || slot >= READBACK_SLOTS || !service->slotHeld[slot]) return;
+  service->slotHeld[slot] = false;
+  readback_release(&service->rendering->readback, slot);
+}
+
+static bool acceptClient(Render_Service *service) {
+  int fd = accept4(service->listenFd, NULL, NULL, SOCK_CLOEXEC);
+  if (fd < 0) {
+    if (errno == EINTR || errno == ECONNABORTED) return true;
+    printf(RED "[ERROR] " RESET "service: accept failed: %s\n", strerror(errno));
+    return false;
+  }
+
+  // The ring's fd goes along with the first message
+  uint32_t magic = SERVICE_MAGIC;
+  struct iovec iov = {&magic, sizeof(magic)};
+  union {
+    struct cmsghdr align;
+    char buffer[CMSG_SPACE(sizeof(int))];
+  } control;
+  memset(&control, 0, sizeof(control));
+  struct msghdr message = {0};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control.buffer;
+  message.msg_controllen = sizeof(control.buffer);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &service->memFd, sizeof(int));
+  if (sendmsg(fd, &message, MSG_NOSIGNAL) < 0) {
+    printf(YELLOW "[WARNING] " RESET "service: failed to hand the ring to a client\n");
+    close(fd);
+    return true;
+  }
+
+  service->clientFd = fd;
+  service->clients++;
+  printf(GREEN "[OK] " RESET "service: client connected\n");
+  return true;
+}
+
+static void dropClient(Render_Service *service) {
+  if (service->clientFd < 0) return;
+  close(service->clientFd);
+  service->clientFd = -1;
+
+  // Captures still in flight come back with nobody to hand them to
+  rendering_collect_captures(service->rendering);
+  for (int32_t i = 0; i < READBACK_SLOTS; i++) releaseSlot(service, i);
+  service->queueHead = 0;
+  service->queueCount = 0;
+  printf("service: client disconnected\n");
+}
+
+// Reads everything the client has sent; with wait, blocks for the first
+// packet. Returns false once the client is gone or broke the protocol.
+static bool readCommands(Render_Service *service, bool wait) {
+  if (wait) {
+    struct pollfd pfd = {service->clientFd, POLLIN, 0};
+    if (poll(&pfd, 1, -1) < 0 && errno != EINTR) return false;
+  }
+
+  while (!service->quit) {
+    Service_Command command;
+    ssize_t size = recv(service->clientFd, &command, sizeof(command), MSG_DONTWAIT);
+    if (size < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    if (size == 0) return false;
+    if ((size_t)size != sizeof(command)) {
+      printf(YELLOW "[WARNING] " RESET "service: dropped a %zd byte packet\n", size);
+      continue;
+    }
+
+    // Releases must get through while a frame waits for a slot
+    if (command.type == SERVICE_COMMAND_RELEASE) {
+      releaseSlot(service, command.slot);
+    } else if (command.type == SERVICE_COMMAND_QUIT) {
+      service->quit = true;
+    } else if (service->queueCount == SERVICE_MAX_QUEUED) {
+      printf(RED "[ERROR] " RESET "service: client has more than %d commands outstanding\n", SERVICE_MAX_QUEUED);
+      return false;
+    } else {
+      uint32_t index = (service->queueHead + service->queueCount) % SERVICE_MAX_QUEUED;
+      service->queue[index] = command;
+      service->queueTimeMs[index] = profiler_now_ms();
+      service->queueCount++;
+    }
+  }
+  return true;
+}
+
+// Applies queued commands up to the next frame request
+static void applyCommands(Render_Service *service) {
+  while (service->queueCount > 0) {
+    const Service_Command *command = &service->queue[service->queueHead];
+    if (command->type == SERVICE_COMMAND_FRAME) return;
+
+    Service_View *view = &service->view;
+    if (command->type == SERVICE_COMMAND_SCENE) {
+      memcpy(view->scene, command->scene, SERVICE_SCENE_NAME);
+      view->scene[SERVICE_SCENE_NAME - 1] = '\0';
+    } else if (command->type == SERVICE_COMMAND_CAMERA) {
+      memcpy(view->eye, command->camera.eye, sizeof(view->eye));
+      memcpy(view->target, command->camera.target, sizeof(view->target));
+      view->fovY = command->camera.fovY;
+      view->camera = true;
+    } else {
+      printf(YELLOW "[WARNING] " RESET "service: unknown command %u\n", command->type);
+    }
+    service->queueHead = (service->queueHead + 1) % SERVICE_MAX_QUEUED;
+    service->queueCount--;
+  }
+}
+
+static void renderFrame(Render_Service *service) {
+  uint32_t id = service->queue[service->queueHead].id;
+  double requestMs = service->queueTimeMs[service->queueHead];
+  service->queueHead = (service->queueHead + 1) % SERVICE_MAX_QUEUED;
+  service->queueCount--;
+
+  Rendering_Context *r = service->rendering;
+  double start = profiler_now_ms();
+  service->draw(r, &service->view, service->userData);
+  r->captureRequested = true;
+  r->readbackSlot = -1;
+  rendering_draw(r);
+  profiler_stat_add(&service->renderStat, profiler_now_ms() - start);
+
+  int32_t slot = r->readbackSlot;
+  if (slot < 0) {
+    service->framesFailed++;
+    sendReady(service, id, -1, r->frameNumber);
+    return;
+  }
+  service->slotRequest[slot] = id;
+  service->slotStartMs[slot] = requestMs;
+  service->inFlight++;
+}
+
+bool service_create(Render_Service *service, Vulkan_Context *vk, const char *socketPath, VkExtent2D extent,
+                    const char *scene, Readback_Config *capture) {
+  if (!service || !vk || !socketPath || !capture || extent.width == 0 || extent.height == 0) return false;
+  memset(service, 0, sizeof(*service));
+  service->vk = vk;
+  service->socketPath = socketPath;
+  service->listenFd = -1;
+  service->clientFd = -1;
+  service->memFd = -1;
+  snprintf(service->view.scene, SERVICE_SCENE_NAME, "%s", scene ? scene : "triangle");
+
+  // Slots start on a boundary both mmap and a host pointer import accept
+  size_t align = (size_t)sysconf(_SC_PAGESIZE);
+  if (vk->externalMemoryHost && vk->hostPointerAlignment > align) align = (size_t)vk->hostPointerAlignment;
+  size_t stride = alignUp((size_t)extent.width * extent.height * 4, align);
+  size_t offset = alignUp(sizeof(Service_Shared_Header), align);
+  service->sharedSize = offset + stride * READBACK_SLOTS;
+
+  // Sealed at its size, so neither side can shrink it under the other's
+  // mapping (a SIGBUS on the next access) or grow it
+  service->memFd = memfd_create("render-service", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (service->memFd < 0 || ftruncate(service->memFd, (off_t)service->sharedSize) != 0 ||
+      fcntl(service->memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+    printf(RED "[ERROR] " RESET "service: failed to create the shared ring: %s\n", strerror(errno));
+    return false;
+  }
+  service->shared = mmap(NULL, service->sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED, service->memFd, 0);
+  if (service->shared == MAP_FAILED) {
+    service->shared = NULL;
+    printf(RED "[ERROR] " RESET "service: failed to map the shared ring: %s\n", strerror(errno));
+    return false;
+  }
+  Service_Shared_Header *header = service->shared;
+  header->magic = SERVICE_MAGIC;
+  header->version = SERVICE_VERSION;
+  header->slotCount = READBACK_SLOTS;
+  header->width = extent.width;
+  header->height = extent.height;
+  header->slotOffset = offset;
+  header->slotStride = stride;
+  service->header = header;
+
+  capture->sink = frameReady;
+  capture->sinkData = service;
+  capture->hostSlots = (uint8_t *)service->shared + offset;
+  capture->hostSlotStride = stride;
+
+  struct sockaddr_un addr;
+  if (!socketAddress(socketPath, &addr)) return false;
+  // A socket left behind by an earlier run; never anything else
+  struct stat info;
+  if (lstat(socketPath, &info) == 0 && S_ISSOCK(info.st_mode)) unlink(socketPath);
+  service->listenFd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (service->listenFd < 0 || bind(service->listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    printf(RED "[ERROR] " RESET "service: failed to bind %s: %s\n", socketPath, strerror(errno));
+    if (service->listenFd >= 0) close(service->listenFd);
+    service->listenFd = -1;
+    return false;
+  }
+  if (listen(service->listenFd, 4) != 0) {
+    printf(RED "[ERROR] " RESET "service: failed to listen on %s: %s\n", socketPath, strerror(errno));
+    return false;
+  }
+
+  printf(GREEN "[OK] " RESET "Render Service (%s, %ux%u, %d slots of %zu bytes)\n", socketPath,
+         extent.width, extent.height, READBACK_SLOTS, stride);
+  return true;
+}
+
+bool service_run(Render_Service *service, Rendering_Context *rendering, Service_Draw_Fn draw, void *userData) {
+  if (!service || !rendering || !draw || service->listenFd < 0 || !rendering->captureEnabled) return false;
+  service->rendering = rendering;
+  service->draw = draw;
+  service->userData = userData;
+  service->header->format = (uint32_t)rendering->swapChainImageFormat;
+  if (rendering->readback.hostImport) service->header->flags |= SERVICE_FLAG_ZERO_COPY;
+  printf("service: listening on %s, frames %s\n", service->socketPath,
+         rendering->readback.hostImport ? "written to the ring by the GPU" : "copied into the ring");
+
+  Readback_Context *rb = &rendering->readback;
+  while (!service->quit) {
+    if (service->clientFd < 0) {
+      if (!acceptClient(service)) return false;
+      continue;
+    }
+
+    // Block only when nothing moves until the client sends something
+    bool wait = service->inFlight == 0 && (service->queueCount == 0 || readback_free_slots(rb) == 0);
+    if (!readCommands(service, wait)) {
+      dropClient(service);
+      continue;
+    }
+    applyCommands(service);
+
+    if (service->queueCount > 0 && readback_free_slots(rb) > 0) {
+      renderFrame(service);
+    } else if (service->inFlight > 0) {
+      // Nothing else to submit: finish what is in flight rather than
+      // leave it for a draw that isn't coming
+      rendering_collect_captures(rendering);
+    }
+  }
+  dropClient(service);
+  return true;
+}
+
+void service_destroy(Render_Service *service) {
+  if (!service || !service->vk) return;
+  if (service->clientFd >= 0) close(service->clientFd);
+  if (service->listenFd >= 0) {
+    close(service->listenFd);
+    unlink(service->socketPath);
+  }
+  if (service->shared) munmap(service->shared, service->sharedSize);
+  if (service->memFd >= 0) close(service->memFd);
+  if (service->clients > 0) service_print_stats(service);
+  memset(service, 0, sizeof(*service));
+}
+
+void service_print_stats(const Render_Service *service) {
+  if (!service || !service->vk) return;
+  printf(CYAN "[PROFILE] " RESET "service: %llu clients, %llu frames served, %llu failed\n",
+         (unsigned long long)service->clients, (unsigned long long)service->framesServed,
+         (unsigned long long)service->framesFailed);
+  profiler_stat_print("service request to ready", &service->latencyStat);
+  profiler_stat_print("service record+submit", &service->renderStat);
+}
+
+// ========== CLIENT ==========
+
+bool service_client_connect(Service_Client *client, const char *socketPath) {
+  if (!client || !socketPath) return false;
+  memset(client, 0, sizeof(*client));
+  client->fd = -1;
+
+  struct sockaddr_un addr;
+  if (!socketAddress(socketPath, &addr)) return false;
+  client->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (client->fd < 0 || connect(client->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    printf(RED "[ERROR] " RESET "service: failed to connect to %s: %s\n", socketPath, strerror(errno));
+    service_client_close(client);
+    return false;
+  }
+
+  uint32_t magic = 0;
+  struct iovec iov = {&magic, sizeof(magic)};
+  union {
+    struct cmsghdr align;
+    char buffer[CMSG_SPACE(sizeof(int))];
+  } control;
+  memset(&control, 0, sizeof(control));
+  struct msghdr message = {0};
+  message.msg_iov = &iov;
+  message.msg_iovlen = 1;
+  message.msg_control = control.buffer;
+  message.msg_controllen = sizeof(control.buffer);
+  int memFd = -1;
+  if (recvmsg(client->fd, &message, MSG_CMSG_CLOEXEC) == (ssize_t)sizeof(magic) && magic == SERVICE_MAGIC) {
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      memcpy(&memFd, CMSG_DATA(cmsg), sizeof(int));
+    }
+  }
+  // Only a ring sealed against shrinking is safe to keep mapped
+  int seals = memFd >= 0 ? fcntl(memFd, F_GET_SEALS) : -1;
+  struct stat info;
+  if (seals < 0 || !(seals & F_SEAL_SHRINK) || fstat(memFd, &info) != 0 ||
+      (size_t)info.st_size < sizeof(Service_Shared_Header)) {
+    printf(RED "[ERROR] " RESET "service: %s didn't hand over a frame ring\n", socketPath);
+    if (memFd >= 0) close(memFd);
+    service_client_close(client);
+    return false;
+  }
+
+  // The mapping outlives the fd
+  client->sharedSize = (size_t)info.st_size;
+  client->shared = mmap(NULL, client->sharedSize, PROT_READ, MAP_SHARED, memFd, 0);
+  close(memFd);
+  if (client->shared == MAP_FAILED) {
+    client->shared = NULL;
+    printf(RED "[ERROR] " RESET "service: failed to map the frame ring: %s\n", strerror(errno));
+    service_client_close(client);
+    return false;
+  }
+  client->header = client->shared;
+  if (client->header->magic != SERVICE_MAGIC || client->header->version != SERVICE_VERSION ||
+      client->header->slotOffset + client->header->slotStride * client->header->slotCount > client->sharedSize) {
+    printf(RED "[ERROR] " RESET "service: frame ring header doesn't match this build\n");
+    service_client_close(client);
+    return false;
+  }
+  return true;
+}
+
+bool service_client_send(Service_Client *client, const Service_Command *command) {
+  if (!client || client->fd < 0 || !command) return false;
+  return send(client->fd, command, sizeof(*command), MSG_NOSIGNAL) == (ssize_t)sizeof(*command);
+}
+
+bool service_client_wait(Service_Client *client, Service_Frame_Ready *ready) {
+  if (!client || client->fd < 0 || !ready) return false;
+  for (;;) {
+    ssize_t size = recv(client->fd, ready, sizeof(*ready), 0);
+    if (size < 0 && errno == EINTR) continue;
+    return size == (ssize_t)sizeof(*ready);
+  }
+}
+
+const uint8_t *service_client_pixels(const Service_Client *client, int32_t slot) {
+  if (!client || !client->header || slot < 0 || (uint32_t)slot >= client->header->slotCount) return NULL;
+  return (const uint8_t *)client->shared + client->header->slotOffset + (size_t)slot * client->header->slotStride;
+}
+
+void service_client_close(Service_Client *client) {
+  if (!client) return;
+  if (client->shared) munmap(client->shared, client->sharedSize);
+  if (client->fd >= 0) close(client->fd);
+  memset(client, 0, sizeof(*client));
+  client->fd = -1;
+}
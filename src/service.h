@@ -0,0 +1,144 @@
+#ifndef SERVICE_H
+#define SERVICE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "vulkan_init.h"
+#include "rendering.h"
+#include "profiler.h"
+
+#define SERVICE_MAGIC 0x56525352u  // "RSRV"
+#define SERVICE_VERSION 1
+#define SERVICE_SCENE_NAME 32
+#define SERVICE_MAX_QUEUED 64  // commands read ahead of the frame being waited on
+
+#define SERVICE_FLAG_ZERO_COPY 1u  // the GPU copies straight into the ring
+
+// Start of the shared mapping. Slot i holds width * height tightly packed
+// 4-byte pixels in format, at slotOffset + i * slotStride.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slotCount;
+  uint32_t width;
+  uint32_t height;
+  uint32_t format;  // VkFormat
+  uint32_t flags;
+  uint32_t pad;
+  uint64_t slotOffset;
+  uint64_t slotStride;
+} Service_Shared_Header;
+
+typedef enum {
+  SERVICE_COMMAND_SCENE,    // scene: drawn by every later frame
+  SERVICE_COMMAND_CAMERA,   // camera: likewise
+  SERVICE_COMMAND_FRAME,    // render one frame; answered with a Service_Frame_Ready
+  SERVICE_COMMAND_RELEASE,  // slot: the client is done reading it
+  SERVICE_COMMAND_QUIT,     // stop the service
+} Service_Command_Type;
+
+// Client to service, one per packet. Commands apply in order, except
+// RELEASE and QUIT, which apply as soon as they are read.
+typedef struct {
+  uint32_t type;  // Service_Command_Type
+  uint32_t id;    // echoed in the frame's reply
+  union {
+    char scene[SERVICE_SCENE_NAME];
+    struct {
+      float eye[3];
+      float target[3];
+      float fovY;  // radians
+    } camera;
+    int32_t slot;
+  };
+} Service_Command;
+
+// Service to client, one per FRAME command; match them up by id
+typedef struct {
+  uint32_t id;
+  int32_t slot;  // ring slot holding the frame, -1 if it couldn't be captured
+  uint64_t frameNumber;
+} Service_Frame_Ready;
+
+// What the draw callback renders; the camera only applies to 3D scenes
+typedef struct {
+  char scene[SERVICE_SCENE_NAME];
+  bool camera;  // set once a CAMERA command arrived
+  float eye[3];
+  float target[3];
+  float fovY;
+} Service_View;
+
+typedef void (*Service_Draw_Fn)(Rendering_Context *r, const Service_View *view, void *userData);
+
+// Local render service. Clients connect to a Unix domain (seqpacket)
+// socket, receive the fd of a sealed memfd holding a Service_Shared_Header
+// and READBACK_SLOTS frame slots, then send fixed-size commands. Frames are
+// rendered offscreen and captured into the ring, with the GPU writing into
+// it directly when VK_EXT_external_memory_host can import the mapping, so
+// only the ready slot index goes back over the socket. A slot stays the
+// client's until it releases it; a frame request waits for a free slot, so
+// clients keep at most READBACK_SLOTS frames outstanding. One client is
+// served at a time.
+typedef struct {
+  Vulkan_Context *vk;
+  Rendering_Context *rendering;
+  const char *socketPath;
+  int listenFd;
+  int clientFd;  // -1 without a client
+
+  int memFd;
+  void *shared;
+  size_t sharedSize;
+  Service_Shared_Header *header;
+
+  Service_Draw_Fn draw;
+  void *userData;
+  Service_View view;
+
+  Service_Command queue[SERVICE_MAX_QUEUED];
+  double queueTimeMs[SERVICE_MAX_QUEUED];  // when each command was read
+  uint32_t queueHead;
+  uint32_t queueCount;
+  uint32_t slotRequest[READBACK_SLOTS];  // FRAME id each slot is being captured for
+  double slotStartMs[READBACK_SLOTS];    // when that request was read
+  bool slotHeld[READBACK_SLOTS];         // handed to the client, not yet released
+  uint32_t inFlight;                     // captures recorded but not yet collected
+  bool quit;
+
+  uint64_t clients;
+  uint64_t framesServed;
+  uint64_t framesFailed;
+  Profiler_Stat latencyStat;  // FRAME read to ready sent
+  Profiler_Stat renderStat;   // recording and submitting one frame
+} Render_Service;
+
+// Before rendering_create: creates the ring for frames of extent and binds
+// the socket. capture is filled in; pass it as the rendering config's capture.
+bool service_create(Render_Service *service, Vulkan_Context *vk, const char *socketPath, VkExtent2D extent,
+                    const char *scene, Readback_Config *capture);
+// Serves clients until one sends QUIT. rendering must capture on request
+// into the config service_create filled in.
+bool service_run(Render_Service *service, Rendering_Context *rendering, Service_Draw_Fn draw, void *userData);
+void service_destroy(Render_Service *service);
+void service_print_stats(const Render_Service *service);
+
+// ========== CLIENT ==========
+
+typedef struct {
+  int fd;
+  void *shared;
+  size_t sharedSize;
+  const Service_Shared_Header *header;
+} Service_Client;
+
+bool service_client_connect(Service_Client *client, const char *socketPath);
+bool service_client_send(Service_Client *client, const Service_Command *command);
+// Blocks for the next frame reply
+bool service_client_wait(Service_Client *client, Service_Frame_Ready *ready);
+const uint8_t *service_client_pixels(const Service_Client *client, int32_t slot);
+void service_client_close(Service_Client *client);
+
+#endif
@@ -0,0 +1,187 @@
+#include "sim.h"
+#include "color.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static uint32_t floatBits(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static float bitsFloat(uint32_t bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static uint32_t xorshift(uint32_t *state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+static void sleepMs(double ms) {
+  struct timespec ts;
+  ts.tv_sec = (time_t)(ms / 1000.0);
+  ts.tv_nsec = (long)((ms - (double)ts.tv_sec * 1000.0) * 1000000.0);
+  nanosleep(&ts, NULL);
+}
+
+// ========== TRIPLE BUFFER ==========
+
+static void publish(Sim_Context *sim) {
+  Sim_Triple_Buffer *tb = &sim->buffer;
+  Sim_State *slot = &tb->slots[tb->back];
+  slot->tick = sim->work.tick;
+  slot->timeMs = sim->work.timeMs;
+  slot->bodyCount = sim->work.bodyCount;
+  memcpy(slot->bodies, sim->work.bodies, sim->work.bodyCount * sizeof(Sim_Body));
+
+  // Release the filled slot, take whichever one was shared
+  uint32_t previous = atomic_exchange_explicit(&tb->shared, tb->back | SIM_SLOT_FRESH, memory_order_acq_rel);
+  tb->back = previous & ~SIM_SLOT_FRESH;
+}
+
+const Sim_State *sim_acquire(Sim_Context *sim) {
+  Sim_Triple_Buffer *tb = &sim->buffer;
+  if (atomic_load_explicit(&tb->shared, memory_order_relaxed) & SIM_SLOT_FRESH) {
+    uint32_t previous = atomic_exchange_explicit(&tb->shared, tb->front, memory_order_acq_rel);
+    tb->front = previous & ~SIM_SLOT_FRESH;
+  }
+  return &tb->slots[tb->front];
+}
+
+// ========== SIMULATION ==========
+
+static void step(Sim_Context *sim) {
+  const float dt = (float)(sim->tickMs / 1000.0);
+  float width = bitsFloat(atomic_load_explicit(&sim->width, memory_order_relaxed));
+  float height = bitsFloat(atomic_load_explicit(&sim->height, memory_order_relaxed));
+  float cursorX = bitsFloat(atomic_load_explicit(&sim->cursorX, memory_order_relaxed));
+  float cursorY = bitsFloat(atomic_load_explicit(&sim->cursorY, memory_order_relaxed));
+  bool attract = atomic_load_explicit(&sim->mouseDown, memory_order_relaxed);
+
+  for (uint32_t i = 0; i < sim->work.bodyCount; i++) {
+    Sim_Body *body = &sim->work.bodies[i];
+    body->prevX = body->x;
+    body->prevY = body->y;
+
+    if (attract) {
+      body->vx += (cursorX - body->x) * 4.0f * dt;
+      body->vy += (cursorY - body->y) * 4.0f * dt;
+    }
+    body->x += body->vx * dt;
+    body->y += body->vy * dt;
+
+    // Bounce off the edges of the framebuffer
+    float maxX = width - body->size;
+    float maxY = height - body->size;
+    if (body->x < 0.0f) { body->x = 0.0f; body->vx = -body->vx; }
+    if (body->y < 0.0f) { body->y = 0.0f; body->vy = -body->vy; }
+    if (body->x > maxX) { body->x = maxX > 0.0f ? maxX : 0.0f; body->vx = -body->vx; }
+    if (body->y > maxY) { body->y = maxY > 0.0f ? maxY : 0.0f; body->vy = -body->vy; }
+  }
+  sim->work.tick++;
+}
+
+static void *simThread(void *arg) {
+  Sim_Context *sim = arg;
+  double next = profiler_now_ms() + sim->tickMs;
+
+  while (!atomic_load_explicit(&sim->quit, memory_order_relaxed)) {
+    double now = profiler_now_ms();
+    if (now < next) {
+      sleepMs(next - now);
+      continue;
+    }
+
+    uint32_t steps = 0;
+    while (next <= now && steps < SIM_MAX_CATCHUP) {
+      double start = profiler_now_ms();
+      step(sim);
+      profiler_stat_add(&sim->stepStat, profiler_now_ms() - start);
+      sim->work.timeMs = next;
+      next += sim->tickMs;
+      steps++;
+    }
+    // Too far behind to catch up; resume from now rather than spiral
+    if (next <= now) {
+      sim->droppedTicks += (uint64_t)((now - next) / sim->tickMs) + 1;
+      next = now + sim->tickMs;
+    }
+    publish(sim);
+  }
+  return NULL;
+}
+
+bool sim_create(Sim_Context *sim, uint32_t bodyCount, float width, float height) {
+  memset(sim, 0, sizeof(*sim));
+  if (bodyCount > SIM_MAX_BODIES) bodyCount = SIM_MAX_BODIES;
+  sim->tickMs = 1000.0 / SIM_TICK_HZ;
+  sim_set_bounds(sim, width, height);
+
+  uint32_t seed = 0x9E3779B9u;
+  sim->work.bodyCount = bodyCount;
+  for (uint32_t i = 0; i < bodyCount; i++) {
+    Sim_Body *body = &sim->work.bodies[i];
+    uint32_t r = xorshift(&seed);
+    body->size = 4.0f + (float)(r & 7);
+    body->x = (float)((r >> 3) % 1024) / 1024.0f * (width - body->size);
+    body->y = (float)((r >> 13) % 1024) / 1024.0f * (height - body->size);
+    body->prevX = body->x;
+    body->prevY = body->y;
+    r = xorshift(&seed);
+    body->vx = ((float)(r & 0xFF) - 127.5f);
+    body->vy = ((float)((r >> 8) & 0xFF) - 127.5f);
+    body->color = 0xFF000000u | (r >> 8);
+  }
+
+  // Slot 0 is the producer's, 2 the consumer's; the first state is already shared
+  sim->buffer.back = 0;
+  sim->buffer.front = 2;
+  atomic_store(&sim->buffer.shared, 1u);
+  sim->work.timeMs = profiler_now_ms();
+  publish(sim);
+
+  if (pthread_create(&sim->thread, NULL, simThread, sim) != 0) {
+    printf(RED "[ERROR] " RESET "failed to start simulation thread\n");
+    return false;
+  }
+  sim->started = true;
+  printf(GREEN "[OK] " RESET "Simulation (%u bodies, %d Hz)\n", bodyCount, SIM_TICK_HZ);
+  return true;
+}
+
+void sim_destroy(Sim_Context *sim) {
+  if (!sim || !sim->started) return;
+  atomic_store(&sim->quit, true);
+  pthread_join(sim->thread, NULL);
+  sim->started = false;
+
+  profiler_stat_print("sim step", &sim->stepStat);
+  printf(CYAN "[PROFILE] " RESET "sim: %llu ticks, %llu dropped\n",
+         (unsigned long long)sim->work.tick, (unsigned long long)sim->droppedTicks);
+}
+
+void sim_set_input(Sim_Context *sim, float cursorX, float cursorY, bool mouseDown) {
+  atomic_store_explicit(&sim->cursorX, floatBits(cursorX), memory_order_relaxed);
+  atomic_store_explicit(&sim->cursorY, floatBits(cursorY), memory_order_relaxed);
+  atomic_store_explicit(&sim->mouseDown, mouseDown, memory_order_relaxed);
+}
+
+void sim_set_bounds(Sim_Context *sim, float width, float height) {
+  atomic_store_explicit(&sim->width, floatBits(width), memory_order_relaxed);
+  atomic_store_explicit(&sim->height, floatBits(height), memory_order_relaxed);
+}
+
+float sim_alpha(const Sim_Context *sim, const Sim_State *state, double nowMs) {
+  float alpha = (float)((nowMs - state->timeMs) / sim->tickMs);
+  if (alpha < 0.0f) return 0.0f;
+  if (alpha > 1.0f) return 1.0f;
+  return alpha;
+}
@@ -0,0 +1,78 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "profiler.h"
+
+#define SIM_MAX_BODIES 4096
+#define SIM_TICK_HZ 120
+#define SIM_MAX_CATCHUP 8   // ticks run back to back after a stall before the backlog is dropped
+#define SIM_SLOT_FRESH 4u   // set on Sim_Triple_Buffer.shared when it holds an unread state
+
+typedef struct {
+  float x, y;
+  float prevX, prevY;  // position one tick earlier, for interpolation
+  float vx, vy;
+  float size;
+  uint32_t color;
+} Sim_Body;
+
+typedef struct {
+  uint64_t tick;
+  double timeMs;  // profiler clock time this tick was scheduled for
+  uint32_t bodyCount;
+  Sim_Body bodies[SIM_MAX_BODIES];
+} Sim_State;
+
+// Single-producer/single-consumer handoff. Each side owns one slot; the third
+// is exchanged atomically, so neither thread ever waits for the other and the
+// reader always gets the newest complete state.
+typedef struct {
+  Sim_State slots[3];
+  _Atomic uint32_t shared;  // slot index | SIM_SLOT_FRESH
+  uint32_t back;            // written by the simulation thread
+  uint32_t front;           // read by the render thread
+} Sim_Triple_Buffer;
+
+// Fixed-timestep simulation on its own thread. Input and bounds come in
+// through atomics, states go out through the triple buffer, so a slow or
+// throttled frame never holds back a tick.
+typedef struct Sim_Context Sim_Context;
+struct Sim_Context {
+  Sim_Triple_Buffer buffer;
+  Sim_State work;  // owned by the simulation thread
+  double tickMs;
+
+  pthread_t thread;
+  bool started;
+  atomic_bool quit;
+
+  // Packed float bits, written by the render thread
+  _Atomic uint32_t cursorX;
+  _Atomic uint32_t cursorY;
+  atomic_bool mouseDown;
+  _Atomic uint32_t width;
+  _Atomic uint32_t height;
+
+  // Simulation thread only; read after sim_destroy
+  Profiler_Stat stepStat;
+  uint64_t droppedTicks;
+};
+
+bool sim_create(Sim_Context *sim, uint32_t bodyCount, float width, float height);
+void sim_destroy(Sim_Context *sim);
+
+void sim_set_input(Sim_Context *sim, float cursorX, float cursorY, bool mouseDown);
+void sim_set_bounds(Sim_Context *sim, float width, float height);
+
+// Newest published state, valid until the next call. Render thread only.
+const Sim_State *sim_acquire(Sim_Context *sim);
+
+// How far past state->timeMs we are, in ticks, clamped to [0, 1]. Positions
+// are drawn at lerp(prev, current, alpha), i.e. one tick behind real time.
+float sim_alpha(const Sim_Context *sim, const Sim_State *state, double nowMs);
+
+#endif
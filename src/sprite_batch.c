@@ -0,0 +1,677 @@
+#include "sprite_batch.h"
+#include "color.h"
+#include "trace.h"
+#include "arena.h"
+#include <float.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *sprite_vert_path = "external/shaders/sprite.vert.spv";
+static const char *sprite_frag_path = "external/shaders/sprite.frag.spv";
+static const char *sdf_frag_path = "external/shaders/sdf_text.frag.spv";
+
+typedef struct {
+  float scale[2];
+} Sprite_Push_Constants;
+
+static inline uint32_t spriteKey(const Sprite *sprite) {
+  return ((uint32_t)sprite->layer << 16) | ((uint32_t)sprite->blend << 8) | (uint32_t)(sprite->texture & 0xFF);
+}
+
+// ========== RADIX SORT ==========
+
+// Stable LSD radix sort of 32-bit keys, 8 bits per pass. Produces the sorted
+// keys and the permutation; passes where every key shares the digit are
+// skipped, which for (layer, blend, texture) keys means at most three.
+static void radixSort(uint32_t *keys, uint32_t *indices, uint32_t *tmpKeys, uint32_t *tmpIndices, uint32_t count) {
+  uint32_t histogram[4][256];
+  memset(histogram, 0, sizeof(histogram));
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t k = keys[i];
+    histogram[0][k & 0xFF]++;
+    histogram[1][(k >> 8) & 0xFF]++;
+    histogram[2][(k >> 16) & 0xFF]++;
+    histogram[3][k >> 24]++;
+    indices[i] = i;
+  }
+
+  uint32_t *srcKeys = keys, *srcIndices = indices;
+  uint32_t *dstKeys = tmpKeys, *dstIndices = tmpIndices;
+
+  for (uint32_t pass = 0; pass < 4; pass++) {
+    uint32_t *counts = histogram[pass];
+    uint32_t shift = pass * 8;
+    if (counts[(srcKeys[0] >> shift) & 0xFF] == count) continue;
+
+    uint32_t offset = 0;
+    for (uint32_t b = 0; b < 256; b++) {
+      uint32_t c = counts[b];
+      counts[b] = offset;
+      offset += c;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t digit = (srcKeys[i] >> shift) & 0xFF;
+      uint32_t dst = counts[digit]++;
+      dstKeys[dst] = srcKeys[i];
+      dstIndices[dst] = srcIndices[i];
+    }
+
+    uint32_t *t = srcKeys; srcKeys = dstKeys; dstKeys = t;
+    t = srcIndices; srcIndices = dstIndices; dstIndices = t;
+  }
+
+  if (srcKeys != keys) {
+    memcpy(keys, srcKeys, count * sizeof(uint32_t));
+    memcpy(indices, srcIndices, count * sizeof(uint32_t));
+  }
+}
+
+// ========== RESOURCES ==========
+
+static bool growCpu(Sprite_Batch *batch, uint32_t capacity) {
+  Sprite_Instance *instances = realloc(batch->instances, capacity * sizeof(Sprite_Instance));
+  if (instances) batch->instances = instances;
+  uint32_t *keys = realloc(batch->keys, capacity * sizeof(uint32_t));
+  if (keys) batch->keys = keys;
+  arena_note_heap_allocation();
+
+  if (!instances || !keys) {
+    printf(RED "[ERROR] " RESET "failed to grow sprite batch to %u sprites\n", capacity);
+    return false;
+  }
+  batch->capacity = capacity;
+  return true;
+}
+
+static void destroyFrameBuffer(Sprite_Batch *batch, Sprite_Frame *frame) {
+  if (frame->memory != VK_NULL_HANDLE) {
+    vkUnmapMemory(batch->vk->device, frame->memory);
+    vulkan_free_memory(batch->vk, frame->memory);
+  }
+  if (frame->buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(batch->vk->device, frame->buffer, NULL);
+  }
+  frame->buffer = VK_NULL_HANDLE;
+  frame->memory = VK_NULL_HANDLE;
+  frame->mapped = NULL;
+  frame->capacity = 0;
+}
+
+// Only touches this frame's slot, which the caller has fenced
+static bool growFrameBuffer(Sprite_Batch *batch, Sprite_Frame *frame, uint32_t capacity) {
+  destroyFrameBuffer(batch, frame);
+  arena_note_heap_allocation();
+
+  VkDeviceSize size = (VkDeviceSize)capacity * sizeof(Sprite_Instance);
+  if (!vulkan_create_buffer(batch->vk, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &frame->buffer, &frame->memory)) {
+    return false;
+  }
+  void *mapped = NULL;
+  if (vkMapMemory(batch->vk->device, frame->memory, 0, size, 0, &mapped) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to map sprite instance buffer\n");
+    destroyFrameBuffer(batch, frame);
+    return false;
+  }
+  frame->mapped = mapped;
+  frame->capacity = capacity;
+  return true;
+}
+
+static bool createWhiteTexture(Sprite_Batch *batch) {
+  Vulkan_Context *vk = batch->vk;
+  const uint32_t white = 0xFFFFFFFF;
+
+  VkBuffer staging = VK_NULL_HANDLE;
+  VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+  if (!vulkan_create_buffer(vk, sizeof(white), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &staging, &stagingMemory)) {
+    return false;
+  }
+  void *data = NULL;
+  vkMapMemory(vk->device, stagingMemory, 0, sizeof(white), 0, &data);
+  memcpy(data, &white, sizeof(white));
+  vkUnmapMemory(vk->device, stagingMemory);
+
+  bool ok = vulkan_create_image(vk, 1, 1, 1, VK_FORMAT_R8G8B8A8_UNORM,
+                                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                &batch->whiteImage, &batch->whiteMemory);
+  if (ok) {
+    VkCommandBuffer cmd = vulkan_begin_one_time_commands(vk, batch->commandPool);
+    ok = cmd != VK_NULL_HANDLE;
+    if (ok) {
+      VkImageMemoryBarrier barrier = {0};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = batch->whiteImage;
+      barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      barrier.subresourceRange.levelCount = 1;
+      barrier.subresourceRange.layerCount = 1;
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      vk->dispatch.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           0, 0, NULL, 0, NULL, 1, &barrier);
+
+      VkBufferImageCopy region = {0};
+      region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.imageSubresource.layerCount = 1;
+      region.imageExtent.width = 1;
+      region.imageExtent.height = 1;
+      region.imageExtent.depth = 1;
+      vk->dispatch.vkCmdCopyBufferToImage(cmd, staging, batch->whiteImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+      vk->dispatch.vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                           0, 0, NULL, 0, NULL, 1, &barrier);
+
+      ok = vulkan_end_one_time_commands(vk, batch->commandPool, cmd);
+    }
+  }
+
+  vkDestroyBuffer(vk->device, staging, NULL);
+  vulkan_free_memory(vk, stagingMemory);
+  if (!ok) return false;
+
+  batch->whiteView = vulkan_create_image_view(vk, batch->whiteImage, VK_FORMAT_R8G8B8A8_UNORM,
+                                              VK_IMAGE_ASPECT_COLOR_BIT, 1);
+  return batch->whiteView != VK_NULL_HANDLE;
+}
+
+static bool createDescriptors(Sprite_Batch *batch) {
+  VkDescriptorSetLayoutBinding samplerBinding = {0};
+  samplerBinding.binding = 0;
+  samplerBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  samplerBinding.descriptorCount = 1;
+  samplerBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {0};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = 1;
+  layoutInfo.pBindings = &samplerBinding;
+
+  if (vkCreateDescriptorSetLayout(batch->vk->device, &layoutInfo, NULL, &batch->descriptorSetLayout) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create sprite descriptor set layout\n");
+    return false;
+  }
+
+  VkDescriptorPoolSize poolSize = {0};
+  poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSize.descriptorCount = SPRITE_MAX_TEXTURES;
+
+  VkDescriptorPoolCreateInfo poolInfo = {0};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+  poolInfo.maxSets = SPRITE_MAX_TEXTURES;
+
+  if (vkCreateDescriptorPool(batch->vk->device, &poolInfo, NULL, &batch->descriptorPool) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create sprite descriptor pool\n");
+    return false;
+  }
+
+  VkSamplerCreateInfo samplerInfo = {0};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  if (vkCreateSampler(batch->vk->device, &samplerInfo, NULL, &batch->sampler) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create sprite sampler\n");
+    return false;
+  }
+  return true;
+}
+
+static void destroyPipelines(Sprite_Batch *batch) {
+  VkDevice device = batch->vk->device;
+  for (uint32_t i = 0; i < SPRITE_BLEND_COUNT; i++) {
+    if (batch->pipelines[i] != VK_NULL_HANDLE) {
+      vkDestroyPipeline(device, batch->pipelines[i], NULL);
+      batch->pipelines[i] = VK_NULL_HANDLE;
+    }
+  }
+}
+
+bool sprite_batch_rebuild_pipelines(Sprite_Batch *batch, VkRenderPass renderPass, VkFormat colorFormat) {
+  if (!batch) return false;
+  destroyPipelines(batch);
+
+  VkPipelineShaderStageCreateInfo shaderStages[2] = {{0}, {0}};
+  shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  shaderStages[0].module = batch->vertShaderModule;
+  shaderStages[0].pName = "main";
+  shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  shaderStages[1].module = batch->fragShaderModule;
+  shaderStages[1].pName = "main";
+
+  VkVertexInputBindingDescription binding = {0};
+  binding.binding = 0;
+  binding.stride = sizeof(Sprite_Instance);
+  binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+  VkVertexInputAttributeDescription attributes[4] = {{0}};
+  attributes[0].location = 0;
+  attributes[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  attributes[0].offset = offsetof(Sprite_Instance, rect);
+  attributes[1].location = 1;
+  attributes[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+  attributes[1].offset = offsetof(Sprite_Instance, uv);
+  attributes[2].location = 2;
+  attributes[2].format = VK_FORMAT_R8G8B8A8_UNORM;
+  attributes[2].offset = offsetof(Sprite_Instance, color);
+  attributes[3].location = 3;
+  attributes[3].format = VK_FORMAT_R32_SFLOAT;
+  attributes[3].offset = offsetof(Sprite_Instance, rotation);
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo = {0};
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.pVertexBindingDescriptions = &binding;
+  vertexInputInfo.vertexAttributeDescriptionCount = 4;
+  vertexInputInfo.pVertexAttributeDescriptions = attributes;
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly = {0};
+  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  VkPipelineViewportStateCreateInfo viewportState = {0};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer = {0};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  // Rotated or mirrored sprites flip winding
+  rasterizer.cullMode = VK_CULL_MODE_NONE;
+  rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling = {0};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.rasterizationSamples = batch->samples;
+  multisampling.minSampleShading = 1.0f;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment = {0};
+  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.blendEnable = VK_TRUE;
+  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  VkPipelineColorBlendStateCreateInfo colorBlending = {0};
+  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.attachmentCount = 1;
+  colorBlending.pAttachments = &colorBlendAttachment;
+
+  VkDynamicState dynamicStates[] = {
+    VK_DYNAMIC_STATE_VIEWPORT,
+    VK_DYNAMIC_STATE_SCISSOR
+  };
+  VkPipelineDynamicStateCreateInfo dynamicState = {0};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
+
+  VkPipelineRenderingCreateInfo renderingInfo = {0};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachmentFormats = &colorFormat;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo = {0};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = renderPass == VK_NULL_HANDLE ? &renderingInfo : NULL;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = batch->pipelineLayout;
+  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.basePipelineIndex = -1;
+
+  for (uint32_t i = 0; i < SPRITE_BLEND_COUNT; i++) {
+    colorBlendAttachment.dstColorBlendFactor = i == SPRITE_BLEND_ADDITIVE
+        ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    shaderStages[1].module = i == SPRITE_BLEND_SDF ? batch->sdfFragShaderModule : batch->fragShaderModule;
+    if (vkCreateGraphicsPipelines(batch->vk->device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &batch->pipelines[i]) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to create sprite pipeline\n");
+      return false;
+    }
+  }
+  return true;
+}
+
+bool sprite_batch_create(Sprite_Batch *batch, Vulkan_Context *vk, VkCommandPool commandPool,
+                         uint32_t framesInFlight, VkRenderPass renderPass, VkFormat colorFormat,
+                         VkSampleCountFlagBits samples) {
+  if (!batch || !vk || framesInFlight == 0 || framesInFlight > SPRITE_MAX_FRAMES) return false;
+
+  memset(batch, 0, sizeof(*batch));
+  batch->vk = vk;
+  batch->commandPool = commandPool;
+  batch->frameCount = framesInFlight;
+  batch->samples = samples;
+
+  if (!growCpu(batch, SPRITE_INITIAL_CAPACITY)) return false;
+  if (!createDescriptors(batch)) return false;
+  if (!createWhiteTexture(batch)) return false;
+
+  VkPushConstantRange pushRange = {0};
+  pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushRange.offset = 0;
+  pushRange.size = sizeof(Sprite_Push_Constants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {0};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &batch->descriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+  if (vkCreatePipelineLayout(vk->device, &pipelineLayoutInfo, NULL, &batch->pipelineLayout) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create sprite pipeline layout\n");
+    return false;
+  }
+
+  size_t vertSize, fragSize;
+  char *vertCode = readFile(sprite_vert_path, &vertSize);
+  char *fragCode = readFile(sprite_frag_path, &fragSize);
+  size_t sdfSize;
+  char *sdfCode = readFile(sdf_frag_path, &sdfSize);
+  if (!vertCode || !fragCode || !sdfCode) {
+    free(vertCode);
+    free(fragCode);
+    free(sdfCode);
+    return false;
+  }
+  batch->vertShaderModule = createShaderModule(vertCode, vertSize, vk);
+  batch->fragShaderModule = createShaderModule(fragCode, fragSize, vk);
+  batch->sdfFragShaderModule = createShaderModule(sdfCode, sdfSize, vk);
+  free(vertCode);
+  free(fragCode);
+  free(sdfCode);
+
+  if (!sprite_batch_rebuild_pipelines(batch, renderPass, colorFormat)) return false;
+
+  if (sprite_batch_add_texture(batch, batch->whiteView, VK_NULL_HANDLE) != SPRITE_WHITE_TEXTURE) return false;
+
+  for (uint32_t i = 0; i < batch->frameCount; i++) {
+    if (!growFrameBuffer(batch, &batch->frames[i], SPRITE_INITIAL_CAPACITY)) return false;
+  }
+
+  printf(GREEN "[OK] " RESET "Sprite Batch\n");
+  return true;
+}
+
+void sprite_batch_destroy(Sprite_Batch *batch) {
+  if (!batch || !batch->vk) return;
+  VkDevice device = batch->vk->device;
+
+  for (uint32_t i = 0; i < batch->frameCount; i++) {
+    destroyFrameBuffer(batch, &batch->frames[i]);
+    free(batch->frames[i].draws);
+    batch->frames[i].draws = NULL;
+  }
+
+  destroyPipelines(batch);
+  if (batch->pipelineLayout != VK_NULL_HANDLE) vkDestroyPipelineLayout(device, batch->pipelineLayout, NULL);
+  if (batch->vertShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, batch->vertShaderModule, NULL);
+  if (batch->fragShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, batch->fragShaderModule, NULL);
+  if (batch->sdfFragShaderModule != VK_NULL_HANDLE) vkDestroyShaderModule(device, batch->sdfFragShaderModule, NULL);
+  if (batch->descriptorPool != VK_NULL_HANDLE) vkDestroyDescriptorPool(device, batch->descriptorPool, NULL);
+  if (batch->descriptorSetLayout != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(device, batch->descriptorSetLayout, NULL);
+  if (batch->sampler != VK_NULL_HANDLE) vkDestroySampler(device, batch->sampler, NULL);
+  if (batch->whiteView != VK_NULL_HANDLE) vkDestroyImageView(device, batch->whiteView, NULL);
+  if (batch->whiteImage != VK_NULL_HANDLE) vkDestroyImage(device, batch->whiteImage, NULL);
+  if (batch->whiteMemory != VK_NULL_HANDLE) vulkan_free_memory(batch->vk, batch->whiteMemory);
+
+  free(batch->instances);
+  free(batch->keys);
+  memset(batch, 0, sizeof(*batch));
+}
+
+uint16_t sprite_batch_add_texture(Sprite_Batch *batch, VkImageView view, VkSampler sampler) {
+  if (!batch || batch->textureCount >= SPRITE_MAX_TEXTURES) {
+    printf(YELLOW "[WARNING] " RESET "sprite texture limit reached, using white\n");
+    return SPRITE_WHITE_TEXTURE;
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = batch->descriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &batch->descriptorSetLayout;
+
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  if (vkAllocateDescriptorSets(batch->vk->device, &allocInfo, &set) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to allocate sprite descriptor set\n");
+    return SPRITE_WHITE_TEXTURE;
+  }
+
+  VkDescriptorImageInfo imageInfo = {0};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = view;
+  imageInfo.sampler = sampler != VK_NULL_HANDLE ? sampler : batch->sampler;
+
+  VkWriteDescriptorSet write = {0};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = set;
+  write.dstBinding = 0;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.descriptorCount = 1;
+  write.pImageInfo = &imageInfo;
+  vkUpdateDescriptorSets(batch->vk->device, 1, &write, 0, NULL);
+
+  batch->textures[batch->textureCount] = set;
+  if (batch->trace) trace_write_texture(batch->trace, (uint16_t)batch->textureCount);
+  return (uint16_t)batch->textureCount++;
+}
+
+// ========== SUBMISSION ==========
+
+void sprite_batch_push(Sprite_Batch *batch, const Sprite *sprite) {
+  if (batch->count == batch->capacity && !growCpu(batch, batch->capacity * 2)) return;
+  if (batch->trace) trace_write_sprite(batch->trace, sprite);
+
+  Sprite_Instance *inst = &batch->instances[batch->count];
+  inst->rect[0] = sprite->x;
+  inst->rect[1] = sprite->y;
+  inst->rect[2] = sprite->w;
+  inst->rect[3] = sprite->h;
+  inst->uv[0] = sprite->u0;
+  inst->uv[1] = sprite->v0;
+  inst->uv[2] = sprite->u1;
+  inst->uv[3] = sprite->v1;
+  inst->color = sprite->color;
+  inst->rotation = sprite->rotation;
+  batch->keys[batch->count] = spriteKey(sprite);
+  batch->count++;
+}
+
+void sprite_batch_quad(Sprite_Batch *batch, float x, float y, float w, float h, uint32_t color, uint16_t texture) {
+  Sprite sprite = {0};
+  sprite.x = x;
+  sprite.y = y;
+  sprite.w = w;
+  sprite.h = h;
+  sprite.u1 = 1.0f;
+  sprite.v1 = 1.0f;
+  sprite.color = color;
+  sprite.texture = texture;
+  sprite_batch_push(batch, &sprite);
+}
+
+static bool pushDraw(Sprite_Frame *frame, uint32_t first, uint32_t count, uint32_t key) {
+  if (frame->drawCount == frame->drawCapacity) {
+    uint32_t capacity = frame->drawCapacity ? frame->drawCapacity * 2 : 64;
+    Sprite_Draw *draws = realloc(frame->draws, capacity * sizeof(Sprite_Draw));
+    if (!draws) return false;
+    arena_note_heap_allocation();
+    frame->draws = draws;
+    frame->drawCapacity = capacity;
+  }
+  Sprite_Draw *draw = &frame->draws[frame->drawCount++];
+  draw->firstInstance = first;
+  draw->instanceCount = count;
+  draw->texture = (uint16_t)(key & 0xFF);
+  draw->blend = (uint8_t)((key >> 8) & 0xFF);
+  return true;
+}
+
+uint32_t sprite_batch_flush(Sprite_Batch *batch, uint32_t frameIndex) {
+  if (!batch || frameIndex >= batch->frameCount) return 0;
+  Sprite_Frame *frame = &batch->frames[frameIndex];
+  frame->drawCount = 0;
+
+  uint32_t count = batch->count;
+  batch->count = 0;
+  batch->lastSpriteCount = count;
+  batch->lastDrawCount = 0;
+  float *bounds = batch->bounds;
+  bounds[0] = bounds[1] = FLT_MAX;
+  bounds[2] = bounds[3] = -FLT_MAX;
+  if (count == 0) return 0;
+
+  double start = profiler_now_ms();
+
+  if (count > frame->capacity) {
+    uint32_t capacity = frame->capacity ? frame->capacity : SPRITE_INITIAL_CAPACITY;
+    while (capacity < count) capacity *= 2;
+    if (!growFrameBuffer(batch, frame, capacity)) return 0;
+  }
+
+  // Sort scratch only lives through this call; the frame arena is reset
+  // once per frame, the scratch arena fallback right here
+  Arena *arena = batch->frameArena ? batch->frameArena : arena_scratch();
+  size_t mark = arena_mark(arena);
+  uint32_t *sortKeys = ARENA_ALLOC(arena, uint32_t, count);
+  uint32_t *indices = ARENA_ALLOC(arena, uint32_t, count);
+  uint32_t *tmp = ARENA_ALLOC(arena, uint32_t, 2 * (size_t)count);
+  if (!sortKeys || !indices || !tmp) {
+    arena_reset_to(arena, mark);
+    return 0;
+  }
+  memcpy(sortKeys, batch->keys, count * sizeof(uint32_t));
+  radixSort(sortKeys, indices, tmp, tmp + count, count);
+
+  // Gather straight into the mapped ring slot and cut a draw at every key change
+  Sprite_Instance *dst = frame->mapped;
+  uint32_t runStart = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const Sprite_Instance *src = &batch->instances[indices[i]];
+    dst[i] = *src;
+
+    // Conservative damage: rotated sprites get a box around their center
+    // with half-extent (w + h) / 2, which covers the half diagonal
+    float x0 = src->rect[0], y0 = src->rect[1];
+    float x1 = x0 + src->rect[2], y1 = y0 + src->rect[3];
+    if (src->rotation != 0.0f) {
+      float cx = (x0 + x1) * 0.5f, cy = (y0 + y1) * 0.5f;
+      float r = (src->rect[2] + src->rect[3]) * 0.5f;
+      x0 = cx - r; y0 = cy - r; x1 = cx + r; y1 = cy + r;
+    }
+    if (x0 < bounds[0]) bounds[0] = x0;
+    if (y0 < bounds[1]) bounds[1] = y0;
+    if (x1 > bounds[2]) bounds[2] = x1;
+    if (y1 > bounds[3]) bounds[3] = y1;
+
+    if (i > 0 && sortKeys[i] != sortKeys[i - 1]) {
+      pushDraw(frame, runStart, i - runStart, sortKeys[runStart]);
+      runStart = i;
+    }
+  }
+  pushDraw(frame, runStart, count - runStart, sortKeys[runStart]);
+  if (!batch->frameArena) arena_reset_to(arena, mark);
+
+  profiler_stat_add(&batch->flushStat, profiler_now_ms() - start);
+  batch->lastDrawCount = frame->drawCount;
+  return frame->drawCount;
+}
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Covers everything sprite_batch_draw reads besides the extent
+uint64_t sprite_batch_signature(const Sprite_Batch *batch, uint32_t frameIndex) {
+  if (!batch || frameIndex >= batch->frameCount) return 0;
+  const Sprite_Frame *frame = &batch->frames[frameIndex];
+  uint64_t hash = 14695981039346656037ULL;
+  hash = hashBytes(hash, &frame->drawCount, sizeof(frame->drawCount));
+  if (frame->drawCount == 0) return hash;
+  hash = hashBytes(hash, &frame->buffer, sizeof(frame->buffer));
+  hash = hashBytes(hash, &batch->textureCount, sizeof(batch->textureCount));
+  for (uint32_t i = 0; i < frame->drawCount; i++) {
+    const Sprite_Draw *draw = &frame->draws[i];
+    hash = hashBytes(hash, &draw->firstInstance, sizeof(draw->firstInstance));
+    hash = hashBytes(hash, &draw->instanceCount, sizeof(draw->instanceCount));
+    hash = hashBytes(hash, &draw->texture, sizeof(draw->texture));
+    hash = hashBytes(hash, &draw->blend, sizeof(draw->blend));
+  }
+  return hash;
+}
+
+void sprite_batch_draw(Sprite_Batch *batch, VkCommandBuffer cmd, uint32_t frameIndex, VkExtent2D extent) {
+  if (!batch || frameIndex >= batch->frameCount) return;
+  Sprite_Frame *frame = &batch->frames[frameIndex];
+  if (frame->drawCount == 0) return;
+  const Vulkan_Dispatch *vkd = &batch->vk->dispatch;
+
+  Sprite_Push_Constants push = {0};
+  push.scale[0] = 2.0f / (float)extent.width;
+  push.scale[1] = 2.0f / (float)extent.height;
+
+  VkDeviceSize offset = 0;
+  vkd->vkCmdBindVertexBuffers(cmd, 0, 1, &frame->buffer, &offset);
+
+  uint32_t boundBlend = UINT32_MAX;
+  uint32_t boundTexture = UINT32_MAX;
+  for (uint32_t i = 0; i < frame->drawCount; i++) {
+    const Sprite_Draw *draw = &frame->draws[i];
+    uint32_t blend = draw->blend < SPRITE_BLEND_COUNT ? draw->blend : SPRITE_BLEND_ALPHA;
+    if (blend != boundBlend) {
+      vkd->vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch->pipelines[blend]);
+      if (boundBlend == UINT32_MAX) {
+        vkd->vkCmdPushConstants(cmd, batch->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+      }
+      boundBlend = blend;
+    }
+    uint32_t texture = draw->texture < batch->textureCount ? draw->texture : SPRITE_WHITE_TEXTURE;
+    if (texture != boundTexture) {
+      vkd->vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch->pipelineLayout,
+                              0, 1, &batch->textures[texture], 0, NULL);
+      boundTexture = texture;
+    }
+    vkd->vkCmdDraw(cmd, 6, draw->instanceCount, 0, draw->firstInstance);
+  }
+}
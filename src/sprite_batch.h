@@ -0,0 +1,136 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "vulkan_init.h"
+#include "profiler.h"
+#include "arena.h"
+
+#define SPRITE_MAX_TEXTURES 256
+#define SPRITE_INITIAL_CAPACITY 4096
+#define SPRITE_WHITE_TEXTURE 0
+#define SPRITE_MAX_FRAMES 3
+
+typedef struct Trace_Writer Trace_Writer;
+
+typedef enum {
+  SPRITE_BLEND_ALPHA,
+  SPRITE_BLEND_ADDITIVE,
+  SPRITE_BLEND_SDF,  // alpha blend, coverage from a single-channel distance field
+  SPRITE_BLEND_COUNT,
+} Sprite_Blend;
+
+// What gets submitted. x/y is the top-left corner in pixels, rotation is in
+// radians around the center, color is packed RGBA8 (0xAABBGGRR).
+typedef struct {
+  float x, y, w, h;
+  float u0, v0, u1, v1;
+  uint32_t color;
+  float rotation;
+  uint16_t texture;
+  uint8_t layer;
+  uint8_t blend;
+} Sprite;
+
+// Per-instance vertex data as laid out in the GPU ring
+typedef struct {
+  float rect[4];
+  float uv[4];
+  uint32_t color;
+  float rotation;
+} Sprite_Instance;
+
+typedef struct {
+  uint32_t firstInstance;
+  uint32_t instanceCount;
+  uint16_t texture;
+  uint8_t blend;
+} Sprite_Draw;
+
+typedef struct {
+  VkBuffer buffer;
+  VkDeviceMemory memory;
+  Sprite_Instance *mapped;
+  uint32_t capacity;
+
+  Sprite_Draw *draws;
+  uint32_t drawCount;
+  uint32_t drawCapacity;
+} Sprite_Frame;
+
+// Immediate-mode sprite renderer. Sprites pushed between frames are sorted by
+// (layer, blend, texture) with a stable radix sort at flush time and written
+// into the frame's persistently mapped instance buffer, so a frame costs one
+// instanced draw per distinct key. Order is only guaranteed across layers and
+// for sprites sharing a key.
+typedef struct Sprite_Batch Sprite_Batch;
+struct Sprite_Batch {
+  Vulkan_Context *vk;
+  VkCommandPool commandPool;
+
+  VkDescriptorSetLayout descriptorSetLayout;
+  VkDescriptorPool descriptorPool;
+  VkDescriptorSet textures[SPRITE_MAX_TEXTURES];
+  uint32_t textureCount;
+
+  VkPipelineLayout pipelineLayout;
+  VkPipeline pipelines[SPRITE_BLEND_COUNT];
+  VkSampleCountFlagBits samples;  // of the pass the pipelines draw in
+  VkShaderModule vertShaderModule;
+  VkShaderModule fragShaderModule;
+  VkShaderModule sdfFragShaderModule;
+
+  VkImage whiteImage;
+  VkDeviceMemory whiteMemory;
+  VkImageView whiteView;
+  VkSampler sampler;
+
+  // CPU side of the current frame
+  Sprite_Instance *instances;
+  uint32_t *keys;
+  uint32_t count;
+  uint32_t capacity;
+
+  // Radix sort scratch comes from here; reset by the owner every frame
+  Arena *frameArena;
+
+  Sprite_Frame frames[SPRITE_MAX_FRAMES];
+  uint32_t frameCount;
+
+  Trace_Writer *trace;  // records pushes and texture ids when set
+
+  Profiler_Stat flushStat;
+  uint32_t lastSpriteCount;
+  uint32_t lastDrawCount;
+  float bounds[4];  // x0, y0, x1, y1 covering the last flush; x0 > x1 when empty
+};
+
+// renderPass is VK_NULL_HANDLE when drawing with dynamic rendering
+bool sprite_batch_create(Sprite_Batch *batch, Vulkan_Context *vk, VkCommandPool commandPool,
+                         uint32_t framesInFlight, VkRenderPass renderPass, VkFormat colorFormat,
+                         VkSampleCountFlagBits samples);
+bool sprite_batch_rebuild_pipelines(Sprite_Batch *batch, VkRenderPass renderPass, VkFormat colorFormat);
+void sprite_batch_destroy(Sprite_Batch *batch);
+
+// Returns the texture id to use in Sprite.texture, or SPRITE_WHITE_TEXTURE on
+// failure. The view must stay alive as long as the batch. sampler may be
+// VK_NULL_HANDLE for the default linear/clamp sampler.
+uint16_t sprite_batch_add_texture(Sprite_Batch *batch, VkImageView view, VkSampler sampler);
+
+void sprite_batch_push(Sprite_Batch *batch, const Sprite *sprite);
+void sprite_batch_quad(Sprite_Batch *batch, float x, float y, float w, float h, uint32_t color, uint16_t texture);
+
+// Sorts the pending sprites into the frame's ring slot. The frame's fence must
+// have been waited on. Returns the number of draw calls the frame will issue.
+uint32_t sprite_batch_flush(Sprite_Batch *batch, uint32_t frame);
+
+// Records the flushed draws; call inside the render pass / rendering scope.
+void sprite_batch_draw(Sprite_Batch *batch, VkCommandBuffer cmd, uint32_t frame, VkExtent2D extent);
+
+// Identifies the commands sprite_batch_draw records for the frame: equal
+// signatures record the same commands, whatever the instance data holds.
+uint64_t sprite_batch_signature(const Sprite_Batch *batch, uint32_t frame);
+
+#endif
@@ -0,0 +1,366 @@
+#include "text.h"
+#include "color.h"
+#include "font8x8.h"
+#include "trace.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ========== DISTANCE FIELD ==========
+
+static void rasterizeGlyph(Text_Font *font, uint16_t slot, char c) {
+  const uint8_t *rows = font8x8['?' - FONT8X8_FIRST];
+  if (c >= FONT8X8_FIRST && c <= FONT8X8_LAST) rows = font8x8[c - FONT8X8_FIRST];
+
+  // Upsampled coverage of the padded cell
+  bool inside[TEXT_GLYPH_CELL][TEXT_GLYPH_CELL];
+  for (int y = 0; y < TEXT_GLYPH_CELL; y++) {
+    for (int x = 0; x < TEXT_GLYPH_CELL; x++) {
+      int fx = x - TEXT_GLYPH_PADDING;
+      int fy = y - TEXT_GLYPH_PADDING;
+      inside[y][x] = fx >= 0 && fy >= 0 && fx < TEXT_GLYPH_BODY && fy < TEXT_GLYPH_BODY &&
+                     (rows[fy / TEXT_GLYPH_SCALE] >> (fx / TEXT_GLYPH_SCALE)) & 1;
+    }
+  }
+
+  uint32_t originX = (slot % TEXT_ATLAS_CELLS) * TEXT_GLYPH_CELL;
+  uint32_t originY = (slot / TEXT_ATLAS_CELLS) * TEXT_GLYPH_CELL;
+  const int spread = TEXT_GLYPH_PADDING;
+
+  // Brute force over the spread window; cells are tiny and this only runs
+  // the first time a glyph is used
+  for (int y = 0; y < TEXT_GLYPH_CELL; y++) {
+    for (int x = 0; x < TEXT_GLYPH_CELL; x++) {
+      bool in = inside[y][x];
+      float best = (float)spread + 0.5f;
+      for (int dy = -spread; dy <= spread; dy++) {
+        int sy = y + dy;
+        for (int dx = -spread; dx <= spread; dx++) {
+          int sx = x + dx;
+          bool other = (sx >= 0 && sy >= 0 && sx < TEXT_GLYPH_CELL && sy < TEXT_GLYPH_CELL) ? inside[sy][sx] : false;
+          if (other == in) continue;
+          float d = sqrtf((float)(dx * dx + dy * dy));
+          if (d < best) best = d;
+        }
+      }
+      // Edge sits halfway between the two pixel centers
+      float signedDistance = in ? best - 0.5f : -(best - 0.5f);
+      float v = 0.5f + signedDistance / (2.0f * (float)spread);
+      if (v < 0.0f) v = 0.0f;
+      if (v > 1.0f) v = 1.0f;
+      font->pixels[(originY + y) * TEXT_ATLAS_SIZE + originX + x] = (uint8_t)(v * 255.0f + 0.5f);
+    }
+  }
+
+  if (!font->dirty) {
+    font->dirtyX0 = originX;
+    font->dirtyY0 = originY;
+    font->dirtyX1 = originX + TEXT_GLYPH_CELL;
+    font->dirtyY1 = originY + TEXT_GLYPH_CELL;
+    font->dirty = true;
+  } else {
+    if (originX < font->dirtyX0) font->dirtyX0 = originX;
+    if (originY < font->dirtyY0) font->dirtyY0 = originY;
+    if (originX + TEXT_GLYPH_CELL > font->dirtyX1) font->dirtyX1 = originX + TEXT_GLYPH_CELL;
+    if (originY + TEXT_GLYPH_CELL > font->dirtyY1) font->dirtyY1 = originY + TEXT_GLYPH_CELL;
+  }
+}
+
+static uint16_t glyphSlot(Text_Font *font, char c) {
+  unsigned char code = (unsigned char)c;
+  if (code >= 128) code = '?';
+  if (font->glyphSlots[code] != 0) return font->glyphSlots[code] - 1;
+
+  if (font->slotCount >= TEXT_ATLAS_CELLS * TEXT_ATLAS_CELLS) {
+    // Cannot happen with the ASCII font, but keep the atlas bounds safe
+    return font->glyphSlots['?'] ? font->glyphSlots['?'] - 1 : 0;
+  }
+  uint16_t slot = (uint16_t)font->slotCount++;
+  rasterizeGlyph(font, slot, (char)code);
+  font->glyphSlots[code] = slot + 1;
+  return slot;
+}
+
+// ========== ATLAS ==========
+
+static void atlasBarrier(Text_Context *text, VkCommandBuffer cmd, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                         VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                         VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+  VkImageMemoryBarrier barrier = {0};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  text->vk->dispatch.vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+static bool createFont(Text_Context *text, Text_Font *font) {
+  Vulkan_Context *vk = text->vk;
+  VkDeviceSize size = (VkDeviceSize)TEXT_ATLAS_SIZE * TEXT_ATLAS_SIZE;
+
+  if (!vulkan_create_buffer(vk, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &font->staging, &font->stagingMemory)) {
+    return false;
+  }
+  void *mapped = NULL;
+  if (vkMapMemory(vk->device, font->stagingMemory, 0, size, 0, &mapped) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to map font atlas staging buffer\n");
+    return false;
+  }
+  font->pixels = mapped;
+  memset(font->pixels, 0, (size_t)size);
+
+  if (!vulkan_create_image(vk, TEXT_ATLAS_SIZE, TEXT_ATLAS_SIZE, 1, VK_FORMAT_R8_UNORM,
+                           VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                           &font->image, &font->memory)) {
+    return false;
+  }
+  font->view = vulkan_create_image_view(vk, font->image, VK_FORMAT_R8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+  if (font->view == VK_NULL_HANDLE) return false;
+
+  // Pre-rasterize printable ASCII so the common case needs no uploads later
+  for (char c = FONT8X8_FIRST; c <= FONT8X8_LAST; c++) {
+    glyphSlot(font, c);
+  }
+
+  VkCommandBuffer cmd = vulkan_begin_one_time_commands(vk, text->commandPool);
+  if (cmd == VK_NULL_HANDLE) return false;
+  atlasBarrier(text, cmd, font->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+               0, VK_ACCESS_TRANSFER_WRITE_BIT,
+               VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+  VkBufferImageCopy region = {0};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent.width = TEXT_ATLAS_SIZE;
+  region.imageExtent.height = TEXT_ATLAS_SIZE;
+  region.imageExtent.depth = 1;
+  text->vk->dispatch.vkCmdCopyBufferToImage(cmd, font->staging, font->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  atlasBarrier(text, cmd, font->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+               VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+               VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  if (!vulkan_end_one_time_commands(vk, text->commandPool, cmd)) return false;
+  font->dirty = false;
+  text->uploadedBytes += size;
+
+  font->texture = sprite_batch_add_texture(text->sprites, font->view, VK_NULL_HANDLE);
+  return font->texture != SPRITE_WHITE_TEXTURE;
+}
+
+static void destroyFont(Text_Context *text, Text_Font *font) {
+  VkDevice device = text->vk->device;
+  if (font->view != VK_NULL_HANDLE) vkDestroyImageView(device, font->view, NULL);
+  if (font->image != VK_NULL_HANDLE) vkDestroyImage(device, font->image, NULL);
+  if (font->memory != VK_NULL_HANDLE) vulkan_free_memory(text->vk, font->memory);
+  if (font->stagingMemory != VK_NULL_HANDLE) {
+    if (font->pixels) vkUnmapMemory(device, font->stagingMemory);
+    vulkan_free_memory(text->vk, font->stagingMemory);
+  }
+  if (font->staging != VK_NULL_HANDLE) vkDestroyBuffer(device, font->staging, NULL);
+  memset(font, 0, sizeof(*font));
+}
+
+void text_record_uploads(Text_Context *text, VkCommandBuffer cmd) {
+  if (!text || !text->font.dirty) return;
+  Text_Font *font = &text->font;
+
+  atlasBarrier(text, cmd, font->image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+               VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+               VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+  // Staging mirrors the atlas, so the dirty rectangle is a strided sub-copy
+  VkBufferImageCopy region = {0};
+  region.bufferOffset = (VkDeviceSize)font->dirtyY0 * TEXT_ATLAS_SIZE + font->dirtyX0;
+  region.bufferRowLength = TEXT_ATLAS_SIZE;
+  region.bufferImageHeight = TEXT_ATLAS_SIZE;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset.x = (int32_t)font->dirtyX0;
+  region.imageOffset.y = (int32_t)font->dirtyY0;
+  region.imageExtent.width = font->dirtyX1 - font->dirtyX0;
+  region.imageExtent.height = font->dirtyY1 - font->dirtyY0;
+  region.imageExtent.depth = 1;
+  text->vk->dispatch.vkCmdCopyBufferToImage(cmd, font->staging, font->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  atlasBarrier(text, cmd, font->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+               VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+               VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+  text->uploadedBytes += (uint64_t)region.imageExtent.width * region.imageExtent.height;
+  font->dirty = false;
+}
+
+// ========== SHAPING CACHE ==========
+
+static uint64_t hashString(const char *str, uint32_t length) {
+  uint64_t hash = 1469598103934665603ull;
+  for (uint32_t i = 0; i < length; i++) {
+    hash ^= (uint8_t)str[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static void clearCache(Text_Context *text) {
+  memset(text->cache, 0, sizeof(text->cache));
+  text->cacheEntries = 0;
+  text->glyphPoolUsed = 0;
+  text->charPoolUsed = 0;
+}
+
+// Monospace layout in atlas pixels; newlines start a new line
+static const Text_Shaped *shape(Text_Context *text, const char *str) {
+  uint32_t length = (uint32_t)strlen(str);
+  uint64_t hash = hashString(str, length);
+  uint32_t index = (uint32_t)hash & (TEXT_CACHE_SLOTS - 1);
+
+  for (uint32_t probe = 0; probe < TEXT_CACHE_SLOTS; probe++) {
+    Text_Shaped *entry = &text->cache[(index + probe) & (TEXT_CACHE_SLOTS - 1)];
+    if (!entry->used) break;
+    if (entry->hash == hash && entry->length == length &&
+        memcmp(text->charPool + entry->charOffset, str, length) == 0) {
+      text->cacheHits++;
+      return entry;
+    }
+  }
+  text->cacheMisses++;
+
+  // Whole-cache flush keeps this simple; overlays reuse a small working set
+  if (text->cacheEntries >= TEXT_CACHE_SLOTS / 2 ||
+      text->glyphPoolUsed + length > TEXT_CACHE_GLYPHS ||
+      text->charPoolUsed + length > TEXT_CACHE_CHARS) {
+    clearCache(text);
+    if (length > TEXT_CACHE_GLYPHS || length > TEXT_CACHE_CHARS) return NULL;
+  }
+
+  Text_Shaped *entry = &text->cache[index];
+  while (entry->used) {
+    index = (index + 1) & (TEXT_CACHE_SLOTS - 1);
+    entry = &text->cache[index];
+  }
+
+  entry->used = true;
+  entry->hash = hash;
+  entry->length = length;
+  entry->charOffset = text->charPoolUsed;
+  entry->glyphOffset = text->glyphPoolUsed;
+  memcpy(text->charPool + text->charPoolUsed, str, length);
+  text->charPoolUsed += length;
+
+  float penX = 0.0f, penY = 0.0f;
+  const float lineHeight = (float)TEXT_GLYPH_BODY * 1.25f;
+  for (uint32_t i = 0; i < length; i++) {
+    char c = str[i];
+    if (c == '\n') {
+      penX = 0.0f;
+      penY += lineHeight;
+      continue;
+    }
+    if (c != ' ' && c != '\t') {
+      Text_Glyph *glyph = &text->glyphPool[text->glyphPoolUsed++];
+      glyph->x = penX - (float)TEXT_GLYPH_PADDING;
+      glyph->y = penY - (float)TEXT_GLYPH_PADDING;
+      glyph->slot = glyphSlot(&text->font, c);
+    }
+    penX += (float)TEXT_GLYPH_BODY * (c == '\t' ? 4.0f : 1.0f);
+  }
+  entry->glyphCount = text->glyphPoolUsed - entry->glyphOffset;
+  text->cacheEntries++;
+  return entry;
+}
+
+// ========== PUBLIC API ==========
+
+bool text_create(Text_Context *text, Vulkan_Context *vk, VkCommandPool commandPool, Sprite_Batch *sprites) {
+  if (!text || !vk || !sprites) return false;
+  memset(text, 0, sizeof(*text));
+  text->vk = vk;
+  text->commandPool = commandPool;
+  text->sprites = sprites;
+
+  text->glyphPool = malloc(TEXT_CACHE_GLYPHS * sizeof(Text_Glyph));
+  text->charPool = malloc(TEXT_CACHE_CHARS);
+  if (!text->glyphPool || !text->charPool) {
+    printf(RED "[ERROR] " RESET "failed to allocate text cache\n");
+    return false;
+  }
+
+  if (!createFont(text, &text->font)) {
+    printf(RED "[ERROR] " RESET "failed to create font atlas\n");
+    return false;
+  }
+  printf(GREEN "[OK] " RESET "Text (%u glyphs in %ux%u SDF atlas)\n",
+         text->font.slotCount, TEXT_ATLAS_SIZE, TEXT_ATLAS_SIZE);
+  return true;
+}
+
+void text_destroy(Text_Context *text) {
+  if (!text || !text->vk) return;
+  destroyFont(text, &text->font);
+  free(text->glyphPool);
+  free(text->charPool);
+  memset(text, 0, sizeof(*text));
+}
+
+float text_draw(Text_Context *text, float x, float y, float size, uint32_t color, const char *str) {
+  if (!text || !str || !*str) return 0.0f;
+  const Text_Shaped *shaped = shape(text, str);
+  if (!shaped) return 0.0f;
+
+  // Replay re-shapes the string, so the glyph sprites aren't recorded
+  Trace_Writer *trace = text->sprites->trace;
+  if (trace) {
+    trace_write_text(trace, x, y, size, color, str);
+    trace->muted = true;
+  }
+
+  const float scale = size / (float)TEXT_GLYPH_BODY;
+  const float cell = (float)TEXT_GLYPH_CELL * scale;
+  const float uvCell = (float)TEXT_GLYPH_CELL / (float)TEXT_ATLAS_SIZE;
+
+  Sprite sprite = {0};
+  sprite.w = cell;
+  sprite.h = cell;
+  sprite.color = color;
+  sprite.texture = text->font.texture;
+  sprite.layer = TEXT_LAYER;
+  sprite.blend = SPRITE_BLEND_SDF;
+
+  float width = 0.0f;
+  const Text_Glyph *glyphs = text->glyphPool + shaped->glyphOffset;
+  for (uint32_t i = 0; i < shaped->glyphCount; i++) {
+    const Text_Glyph *glyph = &glyphs[i];
+    sprite.x = x + glyph->x * scale;
+    sprite.y = y + glyph->y * scale;
+    sprite.u0 = (float)(glyph->slot % TEXT_ATLAS_CELLS) * uvCell;
+    sprite.v0 = (float)(glyph->slot / TEXT_ATLAS_CELLS) * uvCell;
+    sprite.u1 = sprite.u0 + uvCell;
+    sprite.v1 = sprite.v0 + uvCell;
+    sprite_batch_push(text->sprites, &sprite);
+
+    float right = (glyph->x + (float)TEXT_GLYPH_PADDING + (float)TEXT_GLYPH_BODY) * scale;
+    if (right > width) width = right;
+  }
+  if (trace) trace->muted = false;
+  return width;
+}
+
+float text_printf(Text_Context *text, float x, float y, float size, uint32_t color, const char *fmt, ...) {
+  char buffer[1024];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buffer, sizeof(buffer), fmt, args);
+  va_end(args);
+  return text_draw(text, x, y, size, color, buffer);
+}
@@ -0,0 +1,92 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "vulkan_init.h"
+#include "sprite_batch.h"
+
+#define TEXT_ATLAS_SIZE 512
+#define TEXT_GLYPH_SCALE 3                                  // atlas pixels per font pixel
+#define TEXT_GLYPH_PADDING 4                                // distance field spread, in atlas pixels
+#define TEXT_GLYPH_BODY (8 * TEXT_GLYPH_SCALE)
+#define TEXT_GLYPH_CELL (TEXT_GLYPH_BODY + 2 * TEXT_GLYPH_PADDING)
+#define TEXT_ATLAS_CELLS (TEXT_ATLAS_SIZE / TEXT_GLYPH_CELL)
+
+#define TEXT_CACHE_SLOTS 1024   // power of two
+#define TEXT_CACHE_GLYPHS 65536
+#define TEXT_CACHE_CHARS 65536
+
+#define TEXT_LAYER 255          // sprite layer; text draws over everything else
+
+// Glyph position inside a shaped string, in atlas pixels from the origin
+typedef struct {
+  float x, y;
+  uint16_t slot;
+} Text_Glyph;
+
+typedef struct {
+  uint64_t hash;
+  uint32_t charOffset;
+  uint32_t length;
+  uint32_t glyphOffset;
+  uint32_t glyphCount;
+  bool used;
+} Text_Shaped;
+
+// Signed distance field atlas. Glyphs are rasterized on first use into the
+// host-visible staging copy; only the dirty rectangle is copied to the image.
+typedef struct {
+  VkImage image;
+  VkDeviceMemory memory;
+  VkImageView view;
+  VkBuffer staging;
+  VkDeviceMemory stagingMemory;
+  uint8_t *pixels;  // mapped staging, TEXT_ATLAS_SIZE^2 bytes
+
+  uint16_t glyphSlots[128];  // per ASCII code, slot + 1 (0 = not rasterized)
+  uint32_t slotCount;
+
+  bool dirty;
+  uint32_t dirtyX0, dirtyY0, dirtyX1, dirtyY1;
+
+  uint16_t texture;  // id in the sprite batch
+} Text_Font;
+
+// Text overlay on top of the sprite batch. Strings are shaped once and cached
+// by content; every glyph becomes an SDF sprite sharing the font's texture and
+// layer, so all text of one font sorts into a single instanced draw.
+typedef struct Text_Context Text_Context;
+struct Text_Context {
+  Vulkan_Context *vk;
+  VkCommandPool commandPool;
+  Sprite_Batch *sprites;
+
+  Text_Font font;
+
+  Text_Shaped cache[TEXT_CACHE_SLOTS];
+  uint32_t cacheEntries;
+  Text_Glyph *glyphPool;
+  uint32_t glyphPoolUsed;
+  char *charPool;
+  uint32_t charPoolUsed;
+
+  uint64_t cacheHits;
+  uint64_t cacheMisses;
+  uint64_t uploadedBytes;
+};
+
+bool text_create(Text_Context *text, Vulkan_Context *vk, VkCommandPool commandPool, Sprite_Batch *sprites);
+void text_destroy(Text_Context *text);
+
+// size is the glyph height in pixels; color is packed RGBA8 like Sprite.color.
+// Returns the pen advance in pixels of the widest line.
+float text_draw(Text_Context *text, float x, float y, float size, uint32_t color, const char *str);
+float text_printf(Text_Context *text, float x, float y, float size, uint32_t color, const char *fmt, ...);
+
+// Records the copy of newly rasterized glyphs into the atlas. Call outside a
+// render pass, before anything samples the atlas this frame.
+void text_record_uploads(Text_Context *text, VkCommandBuffer cmd);
+
+#endif
@@ -0,0 +1,765 @@
+#include "texture.h"
+#include "color.h"
+#include "golden.h"
+#include "profiler.h"
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ========== FORMATS ==========
+
+// Block footprint of the formats the loader knows; false for anything else
+static bool formatBlock(VkFormat format, uint32_t *blockWidth, uint32_t *blockHeight, uint32_t *blockBytes) {
+  *blockWidth = 4;
+  *blockHeight = 4;
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+      *blockWidth = 1;
+      *blockHeight = 1;
+      *blockBytes = 4;
+      return true;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+      *blockBytes = 8;
+      return true;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+      *blockBytes = 16;
+      return true;
+    default:
+      break;
+  }
+
+  // ASTC LDR comes in UNORM/SRGB pairs, ordered by footprint; always 16 bytes
+  static const uint8_t astcBlocks[][2] = {
+    {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6}, {8, 8},
+    {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12},
+  };
+  if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK) {
+    uint32_t index = (uint32_t)(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2;
+    *blockWidth = astcBlocks[index][0];
+    *blockHeight = astcBlocks[index][1];
+    *blockBytes = 16;
+    return true;
+  }
+  return false;
+}
+
+VkDeviceSize texture_level_size(VkFormat format, uint32_t width, uint32_t height) {
+  uint32_t blockWidth, blockHeight, blockBytes;
+  if (!formatBlock(format, &blockWidth, &blockHeight, &blockBytes)) return 0;
+  VkDeviceSize blocksX = (width + blockWidth - 1) / blockWidth;
+  VkDeviceSize blocksY = (height + blockHeight - 1) / blockHeight;
+  return blocksX * blocksY * blockBytes;
+}
+
+uint32_t texture_mip_count(uint32_t width, uint32_t height) {
+  uint32_t size = width > height ? width : height;
+  uint32_t levels = 1;
+  while (size > 1 && levels < TEXTURE_MAX_LEVELS) {
+    size >>= 1;
+    levels++;
+  }
+  return levels;
+}
+
+bool texture_format_sampled(Vulkan_Context *vk, VkFormat format) {
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(vk->physicalDevice, format, &props);
+  return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+bool texture_format_blittable(Vulkan_Context *vk, VkFormat format) {
+  VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  VkFormatProperties props;
+  vkGetPhysicalDeviceFormatProperties(vk->physicalDevice, format, &props);
+  return (props.optimalTilingFeatures & required) == required;
+}
+
+static uint32_t levelExtent(uint32_t size, uint32_t level) {
+  size >>= level;
+  return size ? size : 1;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value) {
+  return (value + TEXTURE_STAGING_ALIGN - 1) & ~(VkDeviceSize)(TEXTURE_STAGING_ALIGN - 1);
+}
+
+// ========== LOADER ==========
+
+bool texture_loader_create(Texture_Loader *loader, Vulkan_Context *vk, VkCommandPool commandPool) {
+  if (!loader || !vk) return false;
+  memset(loader, 0, sizeof(*loader));
+  loader->vk = vk;
+  loader->commandPool = commandPool;
+  return true;
+}
+
+static void releasePending(Texture_Loader *loader) {
+  for (uint32_t i = 0; i < loader->pendingCount; i++) free(loader->pending[i].owned);
+  loader->pendingCount = 0;
+  loader->pendingBytes = 0;
+}
+
+void texture_loader_destroy(Texture_Loader *loader) {
+  if (!loader) return;
+  releasePending(loader);
+  free(loader->pending);
+  loader->pending = NULL;
+  loader->pendingCapacity = 0;
+}
+
+void texture_destroy(Vulkan_Context *vk, Texture *texture) {
+  if (!vk || !texture) return;
+  if (texture->view != VK_NULL_HANDLE) vkDestroyImageView(vk->device, texture->view, NULL);
+  if (texture->image != VK_NULL_HANDLE) vkDestroyImage(vk->device, texture->image, NULL);
+  if (texture->memory != VK_NULL_HANDLE) vulkan_free_memory(vk, texture->memory);
+  memset(texture, 0, sizeof(*texture));
+}
+
+void texture_retire(Deletion_Queue *queue, Texture *texture) {
+  if (!queue || !texture) return;
+  deletion_queue_push(queue, DELETION_IMAGE_VIEW, (uint64_t)texture->view);
+  deletion_queue_push(queue, DELETION_IMAGE, (uint64_t)texture->image);
+  deletion_queue_push(queue, DELETION_MEMORY, (uint64_t)texture->memory);
+  memset(texture, 0, sizeof(*texture));
+}
+
+// Creates the image and queues its contents. storedLevels of data are
+// uploaded; with fewer than levels the rest are blitted from level 0.
+static bool queueUpload(Texture_Loader *loader, Texture *texture, VkFormat format, uint32_t width, uint32_t height,
+                        uint32_t levels, uint32_t storedLevels, const uint8_t *data,
+                        const VkDeviceSize *offsets, const VkDeviceSize *sizes, void *owned) {
+  Vulkan_Context *vk = loader->vk;
+  memset(texture, 0, sizeof(*texture));
+  uint32_t blockWidth, blockHeight, blockBytes;
+  formatBlock(format, &blockWidth, &blockHeight, &blockBytes);
+  bool compressed = blockWidth > 1;
+
+  if (storedLevels < levels && (compressed || !texture_format_blittable(vk, format))) {
+    printf(YELLOW "[WARNING] " RESET "texture: format %d can't be blitted, keeping %u of %u levels\n",
+           (int)format, storedLevels, levels);
+    levels = storedLevels;
+  }
+  if (storedLevels > 1) {
+    // A partial chain from the source is dropped in favour of a generated one
+    if (storedLevels < levels) storedLevels = 1;
+  }
+
+  if (loader->pendingCount == loader->pendingCapacity) {
+    uint32_t capacity = loader->pendingCapacity ? loader->pendingCapacity * 2 : 16;
+    Texture_Upload *pending = realloc(loader->pending, capacity * sizeof(Texture_Upload));
+    if (!pending) {
+      printf(RED "[ERROR] " RESET "texture: failed to grow the upload queue\n");
+      free(owned);
+      return false;
+    }
+    loader->pending = pending;
+    loader->pendingCapacity = capacity;
+  }
+
+  // Transfer source for the mip blits and for residency downgrades
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                            VK_IMAGE_USAGE_SAMPLED_BIT;
+  if (!vulkan_create_image(vk, width, height, levels, format, usage, &texture->image, &texture->memory)) {
+    free(owned);
+    return false;
+  }
+  texture->view = vulkan_create_image_view(vk, texture->image, format, VK_IMAGE_ASPECT_COLOR_BIT, levels);
+  if (texture->view == VK_NULL_HANDLE) {
+    texture_destroy(vk, texture);
+    free(owned);
+    return false;
+  }
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(vk->device, texture->image, &requirements);
+  texture->format = format;
+  texture->width = width;
+  texture->height = height;
+  texture->levels = levels;
+  texture->memorySize = requirements.size;
+  texture->compressed = compressed;
+
+  Texture_Upload *upload = &loader->pending[loader->pendingCount++];
+  memset(upload, 0, sizeof(*upload));
+  upload->texture = texture;
+  upload->data = data;
+  upload->levelCount = storedLevels;
+  upload->owned = owned;
+  for (uint32_t l = 0; l < storedLevels; l++) {
+    upload->levelOffsets[l] = offsets[l];
+    upload->levelSizes[l] = sizes[l];
+    loader->pendingBytes += alignUp(sizes[l]);
+  }
+
+  if (compressed) {
+    loader->compressedCount++;
+    loader->compressedMemory += texture->memorySize;
+  } else {
+    loader->uncompressedCount++;
+    loader->uncompressedMemory += texture->memorySize;
+    if (storedLevels < levels) loader->generatedLevels += levels - storedLevels;
+  }
+  return true;
+}
+
+bool texture_loader_add_rgba8(Texture_Loader *loader, Texture *texture, uint32_t width, uint32_t height,
+                              bool srgb, uint32_t mips, const void *pixels) {
+  if (!loader || !texture || !pixels || width == 0 || height == 0) return false;
+  double start = profiler_now_ms();
+  uint32_t levels = mips ? mips : texture_mip_count(width, height);
+  if (levels > texture_mip_count(width, height)) levels = texture_mip_count(width, height);
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = (VkDeviceSize)width * height * 4;
+  bool ok = queueUpload(loader, texture, srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM,
+                        width, height, levels, 1, pixels, &offset, &size, NULL);
+  loader->loadMs += profiler_now_ms() - start;
+  return ok;
+}
+
+bool texture_loader_add_compressed(Texture_Loader *loader, Texture *texture, VkFormat format,
+                                   uint32_t width, uint32_t height, uint32_t levels, const void *data, size_t size) {
+  if (!loader || !texture || !data || width == 0 || height == 0 || levels == 0) return false;
+  double start = profiler_now_ms();
+  if (levels > TEXTURE_MAX_LEVELS) levels = TEXTURE_MAX_LEVELS;
+  if (!texture_format_sampled(loader->vk, format)) {
+    printf(RED "[ERROR] " RESET "texture: format %d can't be sampled on this device\n", (int)format);
+    return false;
+  }
+
+  VkDeviceSize offsets[TEXTURE_MAX_LEVELS];
+  VkDeviceSize sizes[TEXTURE_MAX_LEVELS];
+  VkDeviceSize offset = 0;
+  for (uint32_t l = 0; l < levels; l++) {
+    sizes[l] = texture_level_size(format, levelExtent(width, l), levelExtent(height, l));
+    offsets[l] = offset;
+    offset += sizes[l];
+  }
+  if (sizes[0] == 0 || offset > size) {
+    printf(RED "[ERROR] " RESET "texture: %zu bytes don't hold %u levels of format %d\n", size, levels, (int)format);
+    return false;
+  }
+  bool ok = queueUpload(loader, texture, format, width, height, levels, levels, data, offsets, sizes, NULL);
+  loader->loadMs += profiler_now_ms() - start;
+  return ok;
+}
+
+// ========== KTX2 ==========
+
+static const uint8_t ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+#define KTX2_HEADER_SIZE 80
+#define KTX2_LEVEL_SIZE 24
+
+static uint32_t readLE32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t readLE64(const uint8_t *p) {
+  return (uint64_t)readLE32(p) | ((uint64_t)readLE32(p + 4) << 32);
+}
+
+// Takes ownership of bytes
+static bool addKtx2(Texture_Loader *loader, Texture *texture, uint8_t *bytes, size_t size, const char *name) {
+  if (size < KTX2_HEADER_SIZE || memcmp(bytes, ktx2Identifier, sizeof(ktx2Identifier)) != 0) {
+    printf(RED "[ERROR] " RESET "texture: %s is not a KTX2 file\n", name);
+    free(bytes);
+    return false;
+  }
+  VkFormat format = (VkFormat)readLE32(bytes + 12);
+  uint32_t width = readLE32(bytes + 20);
+  uint32_t height = readLE32(bytes + 24);
+  uint32_t depth = readLE32(bytes + 28);
+  uint32_t layers = readLE32(bytes + 32);
+  uint32_t faces = readLE32(bytes + 36);
+  uint32_t levelCount = readLE32(bytes + 40);
+  uint32_t supercompression = readLE32(bytes + 44);
+
+  // Basis Universal (format 0) and supercompressed payloads need a transcoder
+  uint32_t blockWidth, blockHeight, blockBytes;
+  if (format == VK_FORMAT_UNDEFINED || supercompression != 0 || depth > 1 || layers > 1 || faces != 1 ||
+      width == 0 || height == 0 || !formatBlock(format, &blockWidth, &blockHeight, &blockBytes)) {
+    printf(RED "[ERROR] " RESET "texture: %s: only plain 2D KTX2 in a known format is supported\n", name);
+    free(bytes);
+    return false;
+  }
+
+  // levelCount 0 asks the loader to generate the chain
+  uint32_t stored = levelCount ? levelCount : 1;
+  if (stored > TEXTURE_MAX_LEVELS || size < KTX2_HEADER_SIZE + (size_t)stored * KTX2_LEVEL_SIZE) {
+    printf(RED "[ERROR] " RESET "texture: %s: bad level index\n", name);
+    free(bytes);
+    return false;
+  }
+  VkDeviceSize offsets[TEXTURE_MAX_LEVELS];
+  VkDeviceSize sizes[TEXTURE_MAX_LEVELS];
+  for (uint32_t l = 0; l < stored; l++) {
+    const uint8_t *entry = bytes + KTX2_HEADER_SIZE + l * KTX2_LEVEL_SIZE;
+    offsets[l] = readLE64(entry);
+    sizes[l] = readLE64(entry + 8);
+    VkDeviceSize expected = texture_level_size(format, levelExtent(width, l), levelExtent(height, l));
+    if (sizes[l] < expected || offsets[l] > size || sizes[l] > size - offsets[l]) {
+      printf(RED "[ERROR] " RESET "texture: %s: level %u is out of bounds\n", name, l);
+      free(bytes);
+      return false;
+    }
+    sizes[l] = expected;
+  }
+
+  bool compressed = blockWidth > 1;
+  if (compressed && !texture_format_sampled(loader->vk, format)) {
+    printf(RED "[ERROR] " RESET "texture: %s: format %d can't be sampled on this device\n", name, (int)format);
+    free(bytes);
+    return false;
+  }
+  uint32_t levels = compressed ? stored : texture_mip_count(width, height);
+  return queueUpload(loader, texture, format, width, height, levels, stored, bytes, offsets, sizes, bytes);
+}
+
+bool texture_loader_add_ktx2(Texture_Loader *loader, Texture *texture, const void *data, size_t size) {
+  if (!loader || !texture || !data) return false;
+  double start = profiler_now_ms();
+  uint8_t *bytes = malloc(size ? size : 1);
+  if (!bytes) return false;
+  memcpy(bytes, data, size);
+  bool ok = addKtx2(loader, texture, bytes, size, "memory");
+  loader->loadMs += profiler_now_ms() - start;
+  return ok;
+}
+
+bool texture_loader_add_file(Texture_Loader *loader, Texture *texture, const char *path) {
+  if (!loader || !texture || !path) return false;
+  double start = profiler_now_ms();
+  const char *ext = strrchr(path, '.');
+  bool ok = false;
+
+  if (ext && strcmp(ext, ".ppm") == 0) {
+    Golden_Image image;
+    if (!golden_load_ppm(path, &image)) return false;
+    size_t pixelCount = (size_t)image.width * image.height;
+    uint8_t *rgba = malloc(pixelCount * 4);
+    if (rgba) {
+      for (size_t i = 0; i < pixelCount; i++) {
+        rgba[i * 4 + 0] = image.pixels[i * 3 + 0];
+        rgba[i * 4 + 1] = image.pixels[i * 3 + 1];
+        rgba[i * 4 + 2] = image.pixels[i * 3 + 2];
+        rgba[i * 4 + 3] = 0xFF;
+      }
+      VkDeviceSize offset = 0;
+      VkDeviceSize size = (VkDeviceSize)pixelCount * 4;
+      ok = queueUpload(loader, texture, VK_FORMAT_R8G8B8A8_SRGB, image.width, image.height,
+                       texture_mip_count(image.width, image.height), 1, rgba, &offset, &size, rgba);
+    }
+    golden_free(&image);
+  } else if (ext && strcmp(ext, ".ktx2") == 0) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+      printf(RED "[ERROR] " RESET "texture: failed to open %s\n", path);
+      return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *bytes = size > 0 ? malloc((size_t)size) : NULL;
+    bool read = bytes && fread(bytes, 1, (size_t)size, file) == (size_t)size;
+    fclose(file);
+    if (!read) {
+      printf(RED "[ERROR] " RESET "texture: failed to read %s\n", path);
+      free(bytes);
+      return false;
+    }
+    ok = addKtx2(loader, texture, bytes, (size_t)size, path);
+  } else {
+    printf(RED "[ERROR] " RESET "texture: unsupported file %s (expected .ktx2 or .ppm)\n", path);
+  }
+  loader->loadMs += profiler_now_ms() - start;
+  return ok;
+}
+
+// ========== FLUSH ==========
+
+static void levelBarrier(Vulkan_Context *vk, VkCommandBuffer cmd, VkImage image, uint32_t baseLevel,
+                         uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+                         VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                         VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+  VkImageMemoryBarrier barrier = {0};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = baseLevel;
+  barrier.subresourceRange.levelCount = levelCount;
+  barrier.subresourceRange.layerCount = 1;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = dstAccess;
+  vk->dispatch.vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+// Each level is a linear downsample of the one above, read as TRANSFER_SRC
+static void recordMipChain(Texture_Loader *loader, VkCommandBuffer cmd, const Texture *texture) {
+  for (uint32_t l = 1; l < texture->levels; l++) {
+    levelBarrier(loader->vk, cmd, texture->image, l - 1, 1,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkImageBlit blit = {0};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.mipLevel = l - 1;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[1].x = (int32_t)levelExtent(texture->width, l - 1);
+    blit.srcOffsets[1].y = (int32_t)levelExtent(texture->height, l - 1);
+    blit.srcOffsets[1].z = 1;
+    blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.dstSubresource.mipLevel = l;
+    blit.dstSubresource.layerCount = 1;
+    blit.dstOffsets[1].x = (int32_t)levelExtent(texture->width, l);
+    blit.dstOffsets[1].y = (int32_t)levelExtent(texture->height, l);
+    blit.dstOffsets[1].z = 1;
+    loader->vk->dispatch.vkCmdBlitImage(cmd, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                        texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        1, &blit, VK_FILTER_LINEAR);
+  }
+  levelBarrier(loader->vk, cmd, texture->image, 0, texture->levels - 1,
+               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+               VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+               VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  levelBarrier(loader->vk, cmd, texture->image, texture->levels - 1, 1,
+               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+               VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+               VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+}
+
+bool texture_loader_flush(Texture_Loader *loader) {
+  if (!loader) return false;
+  if (loader->pendingCount == 0) return true;
+  Vulkan_Context *vk = loader->vk;
+  double start = profiler_now_ms();
+
+  VkBuffer staging = VK_NULL_HANDLE;
+  VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+  uint8_t *mapped = NULL;
+  if (!vulkan_create_buffer(vk, loader->pendingBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                            &staging, &stagingMemory)) {
+    releasePending(loader);
+    return false;
+  }
+  if (vkMapMemory(vk->device, stagingMemory, 0, loader->pendingBytes, 0, (void **)&mapped) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "texture: failed to map the staging buffer\n");
+    vkDestroyBuffer(vk->device, staging, NULL);
+    vulkan_free_memory(vk, stagingMemory);
+    releasePending(loader);
+    return false;
+  }
+
+  VkCommandBuffer cmd = vulkan_begin_one_time_commands(vk, loader->commandPool);
+  bool ok = cmd != VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  for (uint32_t i = 0; ok && i < loader->pendingCount; i++) {
+    const Texture_Upload *upload = &loader->pending[i];
+    const Texture *texture = upload->texture;
+    levelBarrier(loader->vk, cmd, texture->image, 0, texture->levels,
+                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    VkBufferImageCopy regions[TEXTURE_MAX_LEVELS];
+    for (uint32_t l = 0; l < upload->levelCount; l++) {
+      memcpy(mapped + offset, upload->data + upload->levelOffsets[l], (size_t)upload->levelSizes[l]);
+      VkBufferImageCopy *region = &regions[l];
+      memset(region, 0, sizeof(*region));
+      region->bufferOffset = offset;
+      region->imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region->imageSubresource.mipLevel = l;
+      region->imageSubresource.layerCount = 1;
+      region->imageExtent.width = levelExtent(texture->width, l);
+      region->imageExtent.height = levelExtent(texture->height, l);
+      region->imageExtent.depth = 1;
+      offset += alignUp(upload->levelSizes[l]);
+    }
+    vk->dispatch.vkCmdCopyBufferToImage(cmd, staging, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                        upload->levelCount, regions);
+
+    if (upload->levelCount < texture->levels) {
+      recordMipChain(loader, cmd, texture);
+    } else {
+      levelBarrier(loader->vk, cmd, texture->image, 0, texture->levels,
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                   VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                   VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+  }
+  // One submit for the whole batch
+  if (ok) ok = vulkan_end_one_time_commands(vk, loader->commandPool, cmd);
+
+  vkUnmapMemory(vk->device, stagingMemory);
+  vkDestroyBuffer(vk->device, staging, NULL);
+  vulkan_free_memory(vk, stagingMemory);
+  loader->uploadedBytes += loader->pendingBytes;
+  releasePending(loader);
+  loader->loadMs += profiler_now_ms() - start;
+  return ok;
+}
+
+// ========== RESIDENCY ==========
+
+bool texture_residency_create(Texture_Residency *residency, Vulkan_Context *vk, VkCommandPool commandPool,
+                              Deletion_Queue *deletion) {
+  if (!residency || !vk) return false;
+  memset(residency, 0, sizeof(*residency));
+  residency->vk = vk;
+  residency->commandPool = commandPool;
+  residency->deletion = deletion;
+  return true;
+}
+
+void texture_residency_destroy(Texture_Residency *residency) {
+  if (!residency) return;
+  free(residency->textures);
+  residency->textures = NULL;
+  residency->count = 0;
+  residency->capacity = 0;
+}
+
+bool texture_residency_add(Texture_Residency *residency, Texture *texture) {
+  if (!residency || !texture) return false;
+  if (residency->count == residency->capacity) {
+    uint32_t capacity = residency->capacity ? residency->capacity * 2 : 64;
+    Texture **textures = realloc(residency->textures, capacity * sizeof(Texture *));
+    if (!textures) {
+      printf(RED "[ERROR] " RESET "texture residency: failed to grow the texture list\n");
+      return false;
+    }
+    residency->textures = textures;
+    residency->capacity = capacity;
+  }
+  texture->lastUsed = residency->frame;
+  residency->textures[residency->count++] = texture;
+  return true;
+}
+
+void texture_residency_remove(Texture_Residency *residency, Texture *texture) {
+  if (!residency || !texture) return;
+  for (uint32_t i = 0; i < residency->count; i++) {
+    if (residency->textures[i] != texture) continue;
+    residency->textures[i] = residency->textures[--residency->count];
+    return;
+  }
+}
+
+void texture_residency_touch(const Texture_Residency *residency, Texture *texture) {
+  if (residency && texture) texture->lastUsed = residency->frame;
+}
+
+static int compareLastUsed(const void *a, const void *b) {
+  uint64_t x = (*(Texture *const *)a)->lastUsed;
+  uint64_t y = (*(Texture *const *)b)->lastUsed;
+  return x < y ? -1 : x > y;
+}
+
+// Without a deletion queue the frames in flight are waited for once
+static void releaseOld(Texture_Residency *residency, Texture *old, uint32_t count, bool idle) {
+  Vulkan_Context *vk = residency->vk;
+  if (!residency->deletion && !idle && count > 0) vk->dispatch.vkQueueWaitIdle(vk->queue);
+  for (uint32_t i = 0; i < count; i++) {
+    if (residency->deletion) {
+      texture_retire(residency->deletion, &old[i]);
+    } else {
+      texture_destroy(vk, &old[i]);
+    }
+  }
+}
+
+// Replaces each texture with a copy of its levels below the top one, all in
+// one command buffer. Returns the bytes saved.
+static VkDeviceSize dropTopLevels(Texture_Residency *residency, Texture **textures, uint32_t count) {
+  Vulkan_Context *vk = residency->vk;
+  Arena *scratch = arena_scratch();
+  size_t mark = arena_mark(scratch);
+  Texture *old = ARENA_ALLOC(scratch, Texture, count);
+  VkCommandBuffer cmd = old ? vulkan_begin_one_time_commands(vk, residency->commandPool) : VK_NULL_HANDLE;
+  if (cmd == VK_NULL_HANDLE) {
+    arena_reset_to(scratch, mark);
+    return 0;
+  }
+
+  uint32_t done = 0;
+  for (; done < count; done++) {
+    Texture *texture = textures[done];
+    Texture next = *texture;
+    next.width = levelExtent(texture->width, 1);
+    next.height = levelExtent(texture->height, 1);
+    next.levels = texture->levels - 1;
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                              VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (!vulkan_create_image(vk, next.width, next.height, next.levels, next.format, usage,
+                             &next.image, &next.memory)) {
+      break;
+    }
+    next.view = vulkan_create_image_view(vk, next.image, next.format, VK_IMAGE_ASPECT_COLOR_BIT, next.levels);
+    if (next.view == VK_NULL_HANDLE) {
+      texture_destroy(vk, &next);
+      break;
+    }
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(vk->device, next.image, &requirements);
+    next.memorySize = requirements.size;
+    next.droppedLevels++;
+
+    // Frames submitted earlier may still be sampling the old image
+    levelBarrier(vk, cmd, texture->image, 1, next.levels,
+                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    levelBarrier(vk, cmd, next.image, 0, next.levels,
+                 VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    VkImageCopy regions[TEXTURE_MAX_LEVELS];
+    memset(regions, 0, sizeof(regions));
+    for (uint32_t l = 0; l < next.levels; l++) {
+      regions[l].srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      regions[l].srcSubresource.mipLevel = l + 1;
+      regions[l].srcSubresource.layerCount = 1;
+      regions[l].dstSubresource = regions[l].srcSubresource;
+      regions[l].dstSubresource.mipLevel = l;
+      regions[l].extent.width = levelExtent(next.width, l);
+      regions[l].extent.height = levelExtent(next.height, l);
+      regions[l].extent.depth = 1;
+    }
+    vk->dispatch.vkCmdCopyImage(cmd, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                next.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, next.levels, regions);
+    levelBarrier(vk, cmd, next.image, 0, next.levels,
+                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                 VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    old[done] = *texture;
+    *texture = next;
+  }
+
+  VkDeviceSize saved = 0;
+  if (vulkan_end_one_time_commands(vk, residency->commandPool, cmd)) {
+    for (uint32_t i = 0; i < done; i++) saved += old[i].memorySize - textures[i]->memorySize;
+    residency->downgrades += done;
+    // The copy was waited on, and with it every frame before it
+    releaseOld(residency, old, done, true);
+  } else {
+    // Contents never made it; keep the full textures
+    for (uint32_t i = 0; i < done; i++) {
+      texture_destroy(vk, textures[i]);
+      *textures[i] = old[i];
+    }
+  }
+  arena_reset_to(scratch, mark);
+  return saved;
+}
+
+uint32_t texture_residency_update(Texture_Residency *residency) {
+  if (!residency) return 0;
+  double start = profiler_now_ms();
+  residency->frame++;
+
+  Memory_Budget *budget = residency->vk->budget;
+  double pressure = memory_budget_pressure(budget);
+  if (pressure <= TEXTURE_RESIDENCY_HIGH || residency->count == 0) {
+    residency->shedding = false;
+    profiler_stat_add(&residency->updateStat, profiler_now_ms() - start);
+    return 0;
+  }
+  // Retired memory is only freed (and reported) once the frames using it are done
+  if (residency->frame < residency->settleUntil) {
+    profiler_stat_add(&residency->updateStat, profiler_now_ms() - start);
+    return 0;
+  }
+  VkDeviceSize excess = memory_budget_excess(budget, TEXTURE_RESIDENCY_LOW);
+  if (!residency->shedding) {
+    printf(YELLOW "[WARNING] " RESET "texture residency: at %.0f%% of the memory budget, freeing %.1f MB\n",
+           pressure * 100.0, (double)excess / (1024.0 * 1024.0));
+  }
+  residency->shedding = true;
+
+  // Least recently used first
+  qsort(residency->textures, residency->count, sizeof(Texture *), compareLastUsed);
+
+  // Textures nobody has asked for in a while go entirely
+  Arena *scratch = arena_scratch();
+  size_t mark = arena_mark(scratch);
+  Texture *evicted = ARENA_ALLOC(scratch, Texture, residency->count);
+  uint32_t evictedCount = 0;
+  VkDeviceSize freed = 0;
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < residency->count; i++) {
+    Texture *texture = residency->textures[i];
+    if (evicted && freed < excess && texture->lastUsed + TEXTURE_RESIDENCY_IDLE <= residency->frame) {
+      freed += texture->memorySize;
+      evicted[evictedCount++] = *texture;
+      memset(texture, 0, sizeof(*texture));
+      continue;
+    }
+    residency->textures[kept++] = texture;
+  }
+  residency->count = kept;
+  releaseOld(residency, evicted, evictedCount, false);
+  residency->evictions += evictedCount;
+  residency->evictedBytes += freed;
+  arena_reset_to(scratch, mark);
+
+  // Then the least recently used of the rest lose their top level, which is
+  // about three quarters of their memory
+  uint32_t downgradeCount = 0;
+  VkDeviceSize expected = freed;
+  while (expected < excess && downgradeCount < residency->count) {
+    Texture *texture = residency->textures[downgradeCount];
+    if (texture->levels < 2 || texture->width / 2 < TEXTURE_RESIDENCY_MIN_SIZE ||
+        texture->height / 2 < TEXTURE_RESIDENCY_MIN_SIZE) {
+      break;
+    }
+    expected += texture->memorySize - texture->memorySize / 4;
+    downgradeCount++;
+  }
+  uint32_t downgrades = residency->downgrades;
+  if (downgradeCount > 0) residency->downgradedBytes += dropTopLevels(residency, residency->textures, downgradeCount);
+  residency->settleUntil = residency->frame + TEXTURE_RESIDENCY_SETTLE;
+
+  profiler_stat_add(&residency->updateStat, profiler_now_ms() - start);
+  return evictedCount + residency->downgrades - downgrades;
+}
+
+void texture_residency_print_stats(const Texture_Residency *residency) {
+  if (!residency) return;
+  printf(CYAN "[PROFILE] " RESET "texture residency: %u tracked, %u evicted (%.1f MB), %u downgrades (%.1f MB saved)\n",
+         residency->count, residency->evictions, (double)residency->evictedBytes / (1024.0 * 1024.0),
+         residency->downgrades, (double)residency->downgradedBytes / (1024.0 * 1024.0));
+  profiler_stat_print("texture residency update", &residency->updateStat);
+}
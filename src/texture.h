@@ -0,0 +1,145 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+#include "vulkan_init.h"
+#include "deletion.h"
+#include "profiler.h"
+
+#define TEXTURE_MAX_LEVELS 16
+#define TEXTURE_STAGING_ALIGN 16  // covers every BC/ETC2/ASTC block size and the 4-byte copy rule
+#define TEXTURE_RESIDENCY_HIGH 0.9  // share of the budget above which residency starts shedding
+#define TEXTURE_RESIDENCY_LOW 0.8  // and the share it sheds down to
+#define TEXTURE_RESIDENCY_IDLE 120  // frames unused before a texture may be evicted outright
+#define TEXTURE_RESIDENCY_MIN_SIZE 64  // downgrades stop at this base level size
+#define TEXTURE_RESIDENCY_SETTLE 4  // frames after shedding before the budget is trusted again
+
+typedef struct {
+  VkImage image;
+  VkDeviceMemory memory;
+  VkImageView view;
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t levels;
+  VkDeviceSize memorySize;  // device memory bound to the image
+  bool compressed;          // levels came from a block-compressed payload
+  uint64_t lastUsed;        // residency frame it was last touched in
+  uint32_t droppedLevels;   // top mips given up to residency
+} Texture;
+
+// A texture whose contents are recorded by the next texture_loader_flush
+typedef struct {
+  Texture *texture;
+  const uint8_t *data;  // levels back to back, largest first
+  VkDeviceSize levelOffsets[TEXTURE_MAX_LEVELS];
+  VkDeviceSize levelSizes[TEXTURE_MAX_LEVELS];
+  uint32_t levelCount;  // levels in data; the rest are generated
+  void *owned;          // freed after the flush
+} Texture_Upload;
+
+// Batched load-time uploads. Textures are created (and usable as handles)
+// when added; their contents go through one staging buffer, one command
+// buffer and one submit at texture_loader_flush. Uncompressed sources get
+// their base level uploaded and the mip chain blitted on the GPU; block
+// compressed payloads are uploaded as is, if the device can sample them.
+typedef struct {
+  Vulkan_Context *vk;
+  VkCommandPool commandPool;
+
+  Texture_Upload *pending;
+  uint32_t pendingCount;
+  uint32_t pendingCapacity;
+  VkDeviceSize pendingBytes;  // staging needed, alignment included
+
+  // Totals over every flush, split by path
+  uint32_t uncompressedCount;
+  uint32_t compressedCount;
+  uint32_t generatedLevels;  // mips blitted on the GPU
+  VkDeviceSize uncompressedMemory;
+  VkDeviceSize compressedMemory;
+  VkDeviceSize uploadedBytes;
+  double loadMs;  // adding (image creation, parsing) and flushing
+} Texture_Loader;
+
+bool texture_loader_create(Texture_Loader *loader, Vulkan_Context *vk, VkCommandPool commandPool);
+void texture_loader_destroy(Texture_Loader *loader);
+
+// Whether images of this format can be sampled, and blitted for mip generation
+bool texture_format_sampled(Vulkan_Context *vk, VkFormat format);
+bool texture_format_blittable(Vulkan_Context *vk, VkFormat format);
+
+// Tightly packed RGBA8 base level; mips = 0 generates the full chain. pixels
+// must stay valid until the flush.
+bool texture_loader_add_rgba8(Texture_Loader *loader, Texture *texture, uint32_t width, uint32_t height,
+                              bool srgb, uint32_t mips, const void *pixels);
+// Pre-compressed (BC, ETC2, ASTC) levels back to back, largest first. Fails
+// when the device can't sample the format. data must stay valid until the flush.
+bool texture_loader_add_compressed(Texture_Loader *loader, Texture *texture, VkFormat format,
+                                   uint32_t width, uint32_t height, uint32_t levels, const void *data, size_t size);
+// KTX2 container without supercompression, one 2D layer and face. Compressed
+// formats are uploaded as stored; RGBA8 with fewer levels than the full chain
+// gets the rest generated. The bytes are copied.
+bool texture_loader_add_ktx2(Texture_Loader *loader, Texture *texture, const void *data, size_t size);
+// .ktx2, or .ppm through the uncompressed path
+bool texture_loader_add_file(Texture_Loader *loader, Texture *texture, const char *path);
+
+// Records and submits every pending upload at once and waits for it
+bool texture_loader_flush(Texture_Loader *loader);
+
+void texture_destroy(Vulkan_Context *vk, Texture *texture);
+// For streaming: hands the texture to the queue instead of waiting until no
+// frame in flight samples it
+void texture_retire(Deletion_Queue *queue, Texture *texture);
+
+// ========== RESIDENCY ==========
+
+// Keeps streamed textures under the memory budget. Once device-local usage
+// passes TEXTURE_RESIDENCY_HIGH of the budget, update frees memory until it
+// is back to TEXTURE_RESIDENCY_LOW: first by evicting textures unused for
+// TEXTURE_RESIDENCY_IDLE frames, least recently used first, then by dropping
+// the top mip of the least recently used ones still in use. Evicted textures
+// are zeroed and forgotten (reload them to bring them back); downgraded ones
+// get a new image and view, so descriptors pointing at them must be rewritten.
+// Downgrades are copied on the GPU in one submit that is waited on; that only
+// happens under pressure.
+typedef struct {
+  Vulkan_Context *vk;
+  VkCommandPool commandPool;
+  Deletion_Queue *deletion;  // old images go here when set, else after the downgrade's wait
+
+  Texture **textures;
+  uint32_t count;
+  uint32_t capacity;
+  uint64_t frame;
+
+  uint32_t evictions;
+  uint32_t downgrades;
+  VkDeviceSize evictedBytes;
+  VkDeviceSize downgradedBytes;  // saved by downgrades
+  bool shedding;                 // over the high mark at the last update
+  uint64_t settleUntil;          // no shedding before this frame
+  Profiler_Stat updateStat;
+} Texture_Residency;
+
+bool texture_residency_create(Texture_Residency *residency, Vulkan_Context *vk, VkCommandPool commandPool,
+                              Deletion_Queue *deletion);
+void texture_residency_destroy(Texture_Residency *residency);
+// The texture must stay at the same address while tracked
+bool texture_residency_add(Texture_Residency *residency, Texture *texture);
+void texture_residency_remove(Texture_Residency *residency, Texture *texture);
+// Marks the texture as used this frame
+void texture_residency_touch(const Texture_Residency *residency, Texture *texture);
+// Once per frame, after memory_budget_update. Returns how many textures were
+// evicted or downgraded.
+uint32_t texture_residency_update(Texture_Residency *residency);
+void texture_residency_print_stats(const Texture_Residency *residency);
+
+// Bytes of one level; block formats round up to whole blocks. 0 for unknown formats.
+VkDeviceSize texture_level_size(VkFormat format, uint32_t width, uint32_t height);
+uint32_t texture_mip_count(uint32_t width, uint32_t height);
+
+#endif
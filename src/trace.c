@@ -0,0 +1,229 @@
+#include "trace.h"
+#include "color.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_HEADER_SIZE 16
+#define TRACE_SPRITE_SIZE 44
+#define TRACE_TEXT_SIZE 18      // x, y, size, color, length
+#define TRACE_MAX_TEXT 4096
+
+// ========== WRITER ==========
+
+static uint8_t *put32(uint8_t *p, const void *value) {
+  memcpy(p, value, 4);
+  return p + 4;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t value) {
+  memcpy(p, &value, 2);
+  return p + 2;
+}
+
+static void writeRecord(Trace_Writer *trace, const uint8_t *data, size_t size) {
+  fwrite(data, 1, size, trace->file);
+  trace->records++;
+  trace->bytes += size;
+}
+
+bool trace_writer_open(Trace_Writer *trace, const char *path, VkExtent2D extent) {
+  memset(trace, 0, sizeof(*trace));
+  trace->file = fopen(path, "wb");
+  if (!trace->file) {
+    printf(RED "[ERROR] " RESET "failed to open trace %s\n", path);
+    return false;
+  }
+  // Records are small; let stdio batch them into large writes
+  setvbuf(trace->file, NULL, _IOFBF, 1 << 20);
+
+  uint32_t header[4] = {TRACE_MAGIC, TRACE_VERSION, extent.width, extent.height};
+  fwrite(header, 1, sizeof(header), trace->file);
+  trace->bytes = sizeof(header);
+
+  printf(GREEN "[OK] " RESET "Recording trace to %s\n", path);
+  return true;
+}
+
+void trace_writer_close(Trace_Writer *trace) {
+  if (!trace || !trace->file) return;
+  fclose(trace->file);
+  trace->file = NULL;
+  printf(CYAN "[PROFILE] " RESET "trace: %llu frames, %llu records, %.1f KiB\n",
+         (unsigned long long)trace->frames, (unsigned long long)trace->records, (double)trace->bytes / 1024.0);
+}
+
+void trace_write_frame(Trace_Writer *trace) {
+  if (!trace || !trace->file) return;
+  uint8_t type = TRACE_RECORD_FRAME;
+  writeRecord(trace, &type, 1);
+  trace->frames++;
+}
+
+void trace_write_sprite(Trace_Writer *trace, const Sprite *sprite) {
+  if (!trace || !trace->file || trace->muted) return;
+  uint8_t record[1 + TRACE_SPRITE_SIZE];
+  uint8_t *p = record;
+  *p++ = TRACE_RECORD_SPRITE;
+  p = put32(p, &sprite->x);
+  p = put32(p, &sprite->y);
+  p = put32(p, &sprite->w);
+  p = put32(p, &sprite->h);
+  p = put32(p, &sprite->u0);
+  p = put32(p, &sprite->v0);
+  p = put32(p, &sprite->u1);
+  p = put32(p, &sprite->v1);
+  p = put32(p, &sprite->color);
+  p = put32(p, &sprite->rotation);
+  p = put16(p, sprite->texture);
+  *p++ = sprite->layer;
+  *p++ = sprite->blend;
+  writeRecord(trace, record, sizeof(record));
+}
+
+void trace_write_text(Trace_Writer *trace, float x, float y, float size, uint32_t color, const char *str) {
+  if (!trace || !trace->file || trace->muted) return;
+  size_t length = strlen(str) + 1;
+  if (length > TRACE_MAX_TEXT) length = TRACE_MAX_TEXT;
+
+  uint8_t record[1 + TRACE_TEXT_SIZE];
+  uint8_t *p = record;
+  *p++ = TRACE_RECORD_TEXT;
+  p = put32(p, &x);
+  p = put32(p, &y);
+  p = put32(p, &size);
+  p = put32(p, &color);
+  put16(p, (uint16_t)length);
+  fwrite(record, 1, sizeof(record), trace->file);
+  // Truncated strings still end in NUL
+  fwrite(str, 1, length - 1, trace->file);
+  fputc('\0', trace->file);
+  trace->records++;
+  trace->bytes += sizeof(record) + length;
+}
+
+void trace_write_texture(Trace_Writer *trace, uint16_t texture) {
+  if (!trace || !trace->file) return;
+  uint8_t record[3];
+  record[0] = TRACE_RECORD_TEXTURE;
+  put16(record + 1, texture);
+  writeRecord(trace, record, sizeof(record));
+}
+
+// ========== READER ==========
+
+static const uint8_t *get32(const uint8_t *p, void *value) {
+  memcpy(value, p, 4);
+  return p + 4;
+}
+
+static uint16_t get16(const uint8_t *p) {
+  uint16_t value;
+  memcpy(&value, p, 2);
+  return value;
+}
+
+bool trace_next(const Trace *trace, size_t *cursor, Trace_Record *record) {
+  size_t offset = *cursor;
+  if (offset >= trace->size) return false;
+
+  const uint8_t *p = trace->data + offset;
+  size_t left = trace->size - offset - 1;
+  record->type = (Trace_Record_Type)*p++;
+
+  switch (record->type) {
+    case TRACE_RECORD_FRAME:
+      *cursor = offset + 1;
+      return true;
+    case TRACE_RECORD_SPRITE: {
+      if (left < TRACE_SPRITE_SIZE) return false;
+      Sprite *sprite = &record->sprite;
+      p = get32(p, &sprite->x);
+      p = get32(p, &sprite->y);
+      p = get32(p, &sprite->w);
+      p = get32(p, &sprite->h);
+      p = get32(p, &sprite->u0);
+      p = get32(p, &sprite->v0);
+      p = get32(p, &sprite->u1);
+      p = get32(p, &sprite->v1);
+      p = get32(p, &sprite->color);
+      p = get32(p, &sprite->rotation);
+      sprite->texture = get16(p);
+      sprite->layer = p[2];
+      sprite->blend = p[3];
+      *cursor = offset + 1 + TRACE_SPRITE_SIZE;
+      return true;
+    }
+    case TRACE_RECORD_TEXT: {
+      if (left < TRACE_TEXT_SIZE) return false;
+      p = get32(p, &record->x);
+      p = get32(p, &record->y);
+      p = get32(p, &record->size);
+      p = get32(p, &record->color);
+      uint16_t length = get16(p);
+      p += 2;
+      if (length == 0 || left - TRACE_TEXT_SIZE < length || p[length - 1] != '\0') return false;
+      record->text = (const char *)p;
+      *cursor = offset + 1 + TRACE_TEXT_SIZE + length;
+      return true;
+    }
+    case TRACE_RECORD_TEXTURE:
+      if (left < 2) return false;
+      record->texture = get16(p);
+      *cursor = offset + 3;
+      return true;
+  }
+  return false;
+}
+
+bool trace_load(const char *path, Trace *trace) {
+  memset(trace, 0, sizeof(*trace));
+
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    printf(RED "[ERROR] " RESET "failed to open trace %s\n", path);
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  long fileSize = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  uint32_t header[4];
+  if (fileSize < TRACE_HEADER_SIZE || fread(header, 1, sizeof(header), file) != sizeof(header) ||
+      header[0] != TRACE_MAGIC || header[1] != TRACE_VERSION) {
+    printf(RED "[ERROR] " RESET "%s is not a version %d trace\n", path, TRACE_VERSION);
+    fclose(file);
+    return false;
+  }
+
+  trace->size = (size_t)fileSize - TRACE_HEADER_SIZE;
+  trace->data = malloc(trace->size ? trace->size : 1);
+  if (!trace->data || fread(trace->data, 1, trace->size, file) != trace->size) {
+    printf(RED "[ERROR] " RESET "failed to read trace %s\n", path);
+    fclose(file);
+    trace_free(trace);
+    return false;
+  }
+  fclose(file);
+  trace->extent.width = header[2];
+  trace->extent.height = header[3];
+
+  // Validate once so the replay loop can trust every record
+  size_t cursor = 0;
+  Trace_Record record;
+  while (trace_next(trace, &cursor, &record)) {
+    trace->records++;
+    if (record.type == TRACE_RECORD_FRAME) trace->frames++;
+  }
+  if (cursor != trace->size) {
+    printf(RED "[ERROR] " RESET "trace %s is corrupt at byte %zu\n", path, cursor + TRACE_HEADER_SIZE);
+    trace_free(trace);
+    return false;
+  }
+  return true;
+}
+
+void trace_free(Trace *trace) {
+  if (!trace) return;
+  free(trace->data);
+  memset(trace, 0, sizeof(*trace));
+}
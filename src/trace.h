@@ -0,0 +1,69 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+#include "sprite_batch.h"
+
+// File layout (host byte order): a 16-byte header
+//   magic, version, width, height   (uint32 each)
+// followed by records, each a one-byte type and a fixed or length-prefixed body.
+#define TRACE_MAGIC 0x52545356u  // "VSTR"
+#define TRACE_VERSION 1
+
+typedef enum {
+  TRACE_RECORD_FRAME = 1,   // end of a frame: everything since the last one was flushed together
+  TRACE_RECORD_SPRITE,      // Sprite as pushed; carries the instance data and the draw key
+  TRACE_RECORD_TEXT,        // text_draw call; its glyph sprites are not recorded separately
+  TRACE_RECORD_TEXTURE,     // sprite texture id registered by the application
+} Trace_Record_Type;
+
+// Records sprite API calls, not GPU commands. Attach it to a sprite batch and
+// every push, text draw and texture registration is appended to the file;
+// rendering writes the frame boundaries. The triangle, meshes, particles and
+// post processing are not in the trace; replay redraws what the batch saw.
+typedef struct Trace_Writer Trace_Writer;
+struct Trace_Writer {
+  FILE *file;
+  bool muted;  // set while text_draw emits the glyphs it already recorded
+  uint64_t frames;
+  uint64_t records;
+  uint64_t bytes;
+};
+
+bool trace_writer_open(Trace_Writer *trace, const char *path, VkExtent2D extent);
+void trace_writer_close(Trace_Writer *trace);
+
+void trace_write_frame(Trace_Writer *trace);
+void trace_write_sprite(Trace_Writer *trace, const Sprite *sprite);
+void trace_write_text(Trace_Writer *trace, float x, float y, float size, uint32_t color, const char *str);
+void trace_write_texture(Trace_Writer *trace, uint16_t texture);
+
+// Whole trace in memory, validated on load, so replay never touches the file
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  VkExtent2D extent;
+  uint64_t frames;
+  uint64_t records;
+} Trace;
+
+typedef struct {
+  Trace_Record_Type type;
+  Sprite sprite;
+  float x, y, size;
+  uint32_t color;
+  const char *text;  // NUL-terminated, points into Trace.data
+  uint16_t texture;
+} Trace_Record;
+
+bool trace_load(const char *path, Trace *trace);
+void trace_free(Trace *trace);
+
+// Decodes the record at *cursor and advances it. Start at 0; returns false at the end.
+bool trace_next(const Trace *trace, size_t *cursor, Trace_Record *record);
+
+#endif
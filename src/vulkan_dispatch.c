@@ -0,0 +1,24 @@
+#include "vulkan_dispatch.h"
+#include "color.h"
+#include <stdio.h>
+#include <string.h>
+
+bool vulkan_dispatch_load(Vulkan_Dispatch *table, VkDevice device, bool swapchain) {
+  if (!table || device == VK_NULL_HANDLE) return false;
+  memset(table, 0, sizeof(*table));
+  bool ok = true;
+
+#define VULKAN_DISPATCH_LOAD(name)                                                 \
+  table->name = (PFN_##name)vkGetDeviceProcAddr(device, #name);                    \
+  if (!table->name) {                                                              \
+    printf(RED "[ERROR] " RESET "missing device entry point %s\n", #name);        \
+    ok = false;                                                                    \
+  }
+  VULKAN_DISPATCH_FUNCTIONS(VULKAN_DISPATCH_LOAD)
+  if (swapchain) {
+    VULKAN_DISPATCH_SWAPCHAIN_FUNCTIONS(VULKAN_DISPATCH_LOAD)
+  }
+#undef VULKAN_DISPATCH_LOAD
+
+  return ok;
+}
@@ -0,0 +1,57 @@
+#ifndef VULKAN_DISPATCH_H
+#define VULKAN_DISPATCH_H
+
+#include <stdbool.h>
+#include <vulkan/vulkan_core.h>
+
+// Device-level entry points on the per-frame path. The exported prototypes
+// go through a loader trampoline that looks up the device's dispatch table on
+// every call; pointers from vkGetDeviceProcAddr call the driver directly.
+#define VULKAN_DISPATCH_FUNCTIONS(X)  \
+  X(vkQueueSubmit)                    \
+  X(vkQueueWaitIdle)                  \
+  X(vkWaitForFences)                  \
+  X(vkResetFences)                    \
+  X(vkResetCommandBuffer)             \
+  X(vkBeginCommandBuffer)             \
+  X(vkEndCommandBuffer)               \
+  X(vkInvalidateMappedMemoryRanges)   \
+  X(vkCmdBeginRenderPass)             \
+  X(vkCmdEndRenderPass)               \
+  X(vkCmdBindPipeline)                \
+  X(vkCmdBindVertexBuffers)           \
+  X(vkCmdBindIndexBuffer)             \
+  X(vkCmdBindDescriptorSets)          \
+  X(vkCmdPushConstants)               \
+  X(vkCmdSetViewport)                 \
+  X(vkCmdSetScissor)                  \
+  X(vkCmdDraw)                        \
+  X(vkCmdDrawIndirect)                \
+  X(vkCmdDrawIndexedIndirect)         \
+  X(vkCmdDispatch)                    \
+  X(vkCmdDispatchIndirect)            \
+  X(vkCmdPipelineBarrier)             \
+  X(vkCmdCopyBuffer)                  \
+  X(vkCmdCopyBufferToImage)           \
+  X(vkCmdCopyImage)                   \
+  X(vkCmdCopyImageToBuffer)           \
+  X(vkCmdBlitImage)                   \
+  X(vkCmdResetQueryPool)              \
+  X(vkCmdWriteTimestamp)
+
+// Only present when VK_KHR_swapchain is enabled (not in headless mode)
+#define VULKAN_DISPATCH_SWAPCHAIN_FUNCTIONS(X) \
+  X(vkAcquireNextImageKHR)                     \
+  X(vkQueuePresentKHR)
+
+typedef struct {
+#define VULKAN_DISPATCH_MEMBER(name) PFN_##name name;
+  VULKAN_DISPATCH_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+  VULKAN_DISPATCH_SWAPCHAIN_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+#undef VULKAN_DISPATCH_MEMBER
+} Vulkan_Dispatch;
+
+// Fills the table for device; fails if any required entry point is missing
+bool vulkan_dispatch_load(Vulkan_Dispatch *table, VkDevice device, bool swapchain);
+
+#endif
@@ -1,4 +1,5 @@
 #include "vulkan_init.h"
+#include "arena.h"
 #include "color.h"
 #include "platform.h"
 #include <GLFW/glfw3.h>
@@ -28,7 +29,9 @@ bool checkValidationLayerSupport(void) {
   uint32_t layerCount;
   vkEnumerateInstanceLayerProperties(&layerCount, NULL);
 
-  VkLayerProperties *availableLayers = malloc(layerCount * sizeof(VkLayerProperties));
+  Arena *scratch = arena_scratch();
+  size_t mark = arena_mark(scratch);
+  VkLayerProperties *availableLayers = ARENA_ALLOC(scratch, VkLayerProperties, layerCount);
   if (!availableLayers) {
     printf(RED "[ERROR] " RESET "failed to allocate memory for layers\n");
     return false;
@@ -44,7 +47,7 @@ bool checkValidationLayerSupport(void) {
     }
   }
 
-  free(availableLayers);
+  arena_reset_to(scratch, mark);
   return layerFound;
 }
 
@@ -53,7 +56,9 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
   uint32_t queueFamilyCount = 0;
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, NULL);
 
-  VkQueueFamilyProperties *queueFamilies = malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
+  Arena *scratch = arena_scratch();
+  size_t mark = arena_mark(scratch);
+  VkQueueFamilyProperties *queueFamilies = ARENA_ALLOC(scratch, VkQueueFamilyProperties, queueFamilyCount);
   if (!queueFamilies) {
     printf(RED "[ERROR] " RESET "failed to allocate memory for queueFamilies\n");
     return indices;
@@ -65,8 +70,13 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
       indices.graphicsFamily = i;
     }
     
+    // Headless: nothing is presented, the graphics queue stands in
     VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+    if (surface == VK_NULL_HANDLE) {
+      presentSupport = (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+    } else {
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+    }
     if (presentSupport) {
       indices.presentFamily = i;
     }
@@ -76,10 +86,231 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
     }
   }
   
-  free(queueFamilies);
+  arena_reset_to(scratch, mark);
   return indices;
 }
 
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1u << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+  return UINT32_MAX;
+}
+
+char* readFile(const char *path, size_t *outSize)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    printf(RED "[ERROR] " RESET "failed to open file: %s\n", path);
+    return NULL;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long fileSize = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  if (fileSize < 0) {
+    printf(RED "[ERROR] " RESET "failed to determine file size: %s\n", path);
+    fclose(file);
+    return NULL;
+  }
+
+  char *buffer = malloc(fileSize);
+  if (!buffer) {
+    printf(RED "[ERROR] " RESET "failed to allocate memory for file: %s\n", path);
+    fclose(file);
+    return NULL;
+  }
+
+  size_t bytesRead = fread(buffer, 1, fileSize, file);
+  if (bytesRead != (size_t)fileSize) {
+    printf(RED "[ERROR] " RESET "failed to read file: %s\n", path);
+    free(buffer);
+    fclose(file);
+    return NULL;
+  }
+
+  fclose(file);
+
+  if (outSize) {
+    *outSize = fileSize;
+  }
+
+  return buffer;
+}
+
+VkShaderModule createShaderModule(const char *code, size_t codeSize, Vulkan_Context *vk_ctx) {
+  VkShaderModuleCreateInfo createInfo = {0};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = codeSize;
+  createInfo.pCode = (const uint32_t*)code;
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(vk_ctx->device, &createInfo, NULL, &shaderModule) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create shader module\n");
+  }
+  return shaderModule;
+}
+
+VkResult vulkan_allocate_memory(Vulkan_Context *ctx, const VkMemoryAllocateInfo *info, VkDeviceMemory *memory) {
+  VkResult result = vkAllocateMemory(ctx->device, info, NULL, memory);
+  if (result == VK_SUCCESS) {
+    memory_budget_track(ctx->budget, *memory, info->allocationSize, info->memoryTypeIndex);
+  } else if (ctx->budget) {
+    ctx->budget->failedAllocations++;
+    memory_budget_update(ctx->budget);
+    printf(YELLOW "[WARNING] " RESET "memory: %.1f MB allocation failed (%d) at %.0f%% of the budget\n",
+           (double)info->allocationSize / (1024.0 * 1024.0), (int)result,
+           memory_budget_pressure(ctx->budget) * 100.0);
+  }
+  return result;
+}
+
+void vulkan_free_memory(Vulkan_Context *ctx, VkDeviceMemory memory) {
+  if (memory == VK_NULL_HANDLE) return;
+  memory_budget_untrack(ctx->budget, memory);
+  vkFreeMemory(ctx->device, memory, NULL);
+}
+
+bool vulkan_create_buffer(Vulkan_Context *ctx, VkDeviceSize size, VkBufferUsageFlags usage,
+                          VkMemoryPropertyFlags properties, VkBuffer *buffer, VkDeviceMemory *memory) {
+  VkBufferCreateInfo bufferInfo = {0};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(ctx->device, &bufferInfo, NULL, buffer) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create buffer\n");
+    return false;
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(ctx->device, *buffer, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits, properties);
+
+  if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+      vulkan_allocate_memory(ctx, &allocInfo, memory) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to allocate buffer memory\n");
+    vkDestroyBuffer(ctx->device, *buffer, NULL);
+    *buffer = VK_NULL_HANDLE;
+    return false;
+  }
+  vkBindBufferMemory(ctx->device, *buffer, *memory, 0);
+  return true;
+}
+
+bool vulkan_create_image(Vulkan_Context *ctx, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format,
+                         VkImageUsageFlags usage, VkImage *image, VkDeviceMemory *memory) {
+  VkImageCreateInfo imageInfo = {0};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = width;
+  imageInfo.extent.height = height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = mipLevels;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = usage;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateImage(ctx->device, &imageInfo, NULL, image) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create image\n");
+    return false;
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetImageMemoryRequirements(ctx->device, *image, &memRequirements);
+
+  VkMemoryAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = memRequirements.size;
+  allocInfo.memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+      vulkan_allocate_memory(ctx, &allocInfo, memory) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to allocate image memory\n");
+    vkDestroyImage(ctx->device, *image, NULL);
+    *image = VK_NULL_HANDLE;
+    return false;
+  }
+  vkBindImageMemory(ctx->device, *image, *memory, 0);
+  return true;
+}
+
+VkImageView vulkan_create_image_view(Vulkan_Context *ctx, VkImage image, VkFormat format,
+                                     VkImageAspectFlags aspect, uint32_t mipLevels) {
+  VkImageViewCreateInfo viewInfo = {0};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = format;
+  viewInfo.subresourceRange.aspectMask = aspect;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = mipLevels;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  VkImageView view = VK_NULL_HANDLE;
+  if (vkCreateImageView(ctx->device, &viewInfo, NULL, &view) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create image view\n");
+    return VK_NULL_HANDLE;
+  }
+  return view;
+}
+
+// For uploads at load time; waits for the queue to go idle
+VkCommandBuffer vulkan_begin_one_time_commands(Vulkan_Context *ctx, VkCommandPool pool) {
+  VkCommandBufferAllocateInfo allocInfo = {0};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = pool;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer cmd = VK_NULL_HANDLE;
+  if (vkAllocateCommandBuffers(ctx->device, &allocInfo, &cmd) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to allocate one-time command buffer\n");
+    return VK_NULL_HANDLE;
+  }
+
+  VkCommandBufferBeginInfo beginInfo = {0};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  ctx->dispatch.vkBeginCommandBuffer(cmd, &beginInfo);
+  return cmd;
+}
+
+bool vulkan_end_one_time_commands(Vulkan_Context *ctx, VkCommandPool pool, VkCommandBuffer cmd) {
+  ctx->dispatch.vkEndCommandBuffer(cmd);
+
+  VkSubmitInfo submitInfo = {0};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &cmd;
+
+  bool ok = ctx->dispatch.vkQueueSubmit(ctx->queue, 1, &submitInfo, VK_NULL_HANDLE) == VK_SUCCESS;
+  if (ok) {
+    ctx->dispatch.vkQueueWaitIdle(ctx->queue);
+  } else {
+    printf(RED "[ERROR] " RESET "failed to submit one-time command buffer\n");
+  }
+  vkFreeCommandBuffers(ctx->device, pool, 1, &cmd);
+  return ok;
+}
+
+
 bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface) {
   VkPhysicalDeviceProperties deviceProperties;
   VkPhysicalDeviceFeatures deviceFeatures;
@@ -88,17 +319,65 @@ bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface) {
 
   QueueFamilyIndices indices = findQueueFamilies(device, surface);
 
+  // Headless runs target whatever ICD is installed, e.g. lavapipe on CI
+  if (surface == VK_NULL_HANDLE) {
+    return indices.graphicsFamily != UINT32_MAX;
+  }
+
   return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
     deviceFeatures.geometryShader &&
     indices.graphicsFamily != UINT32_MAX &&
     indices.presentFamily != UINT32_MAX;
 }
 
+bool vulkan_has_device_extension(VkPhysicalDevice device, const char *name) {
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
+  Arena *scratch = arena_scratch();
+  size_t mark = arena_mark(scratch);
+  VkExtensionProperties *extensions = ARENA_ALLOC(scratch, VkExtensionProperties, extensionCount);
+  if (!extensions) {
+    printf(RED "[ERROR] " RESET "failed to allocate memory for device extensions\n");
+    return false;
+  }
+  vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, extensions);
+
+  bool found = false;
+  for (uint32_t i = 0; i < extensionCount; i++) {
+    if (strcmp(extensions[i].extensionName, name) == 0) {
+      found = true;
+      break;
+    }
+  }
+  arena_reset_to(scratch, mark);
+  return found;
+}
+
+// Highest instance version we can ask for, capped at 1.3. A 1.0 loader has no
+// vkEnumerateInstanceVersion and rejects anything but 1.0.
+static uint32_t instanceApiVersion(void) {
+  PFN_vkEnumerateInstanceVersion enumerateInstanceVersion =
+    (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(NULL, "vkEnumerateInstanceVersion");
+  uint32_t version = VK_API_VERSION_1_0;
+  if (enumerateInstanceVersion && enumerateInstanceVersion(&version) != VK_SUCCESS) {
+    version = VK_API_VERSION_1_0;
+  }
+  return version > VK_API_VERSION_1_3 ? VK_API_VERSION_1_3 : version;
+}
+
 bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform) {
+  // No platform means headless: no surface, no swapchain
+  ctx->headless = platform == NULL;
+
   // Vulkan instance 
+  bool useValidation = enableValidationLayers;
   if (enableValidationLayers && !checkValidationLayerSupport()) {
-    printf(RED "[ERROR] " RESET "validation layers requested, but not available!\n");
-    return false;
+    if (!ctx->headless) {
+      printf(RED "[ERROR] " RESET "validation layers requested, but not available!\n");
+      return false;
+    }
+    printf(YELLOW "[WARNING] " RESET "validation layers not available, continuing without\n");
+    useValidation = false;
   }
   
   VkApplicationInfo appInfo = {0};
@@ -107,7 +386,7 @@ bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform) {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+  appInfo.apiVersion = instanceApiVersion();
 
   VkInstanceCreateInfo createInfo = {0};
   createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -115,13 +394,16 @@ bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform) {
   
   // Get GLFW required extensions
   uint32_t glfwExtensionCount = 0;
-  const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+  const char** glfwExtensions = NULL;
+  if (!ctx->headless) {
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+  }
   
   // GLFW extensions already include VK_KHR_surface and platform-specific surface extensions
   createInfo.enabledExtensionCount = glfwExtensionCount;
   createInfo.ppEnabledExtensionNames = glfwExtensions;
   
-  if (enableValidationLayers) {
+  if (useValidation) {
     createInfo.enabledLayerCount = sizeof(validationLayers) / sizeof(validationLayers[0]);
     createInfo.ppEnabledLayerNames = validationLayers;
   } else {
@@ -133,9 +415,11 @@ bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform) {
     return false;
   }
   
+  Arena *scratch = arena_scratch();
+  size_t mark = arena_mark(scratch);
   uint32_t extensionCount = 0;
   vkEnumerateInstanceExtensionProperties(NULL, &extensionCount, NULL);
-  VkExtensionProperties *extensions = malloc(extensionCount * sizeof(VkExtensionProperties));
+  VkExtensionProperties *extensions = ARENA_ALLOC(scratch, VkExtensionProperties, extensionCount);
   if (!extensions) {
     printf(RED "[ERROR] " RESET "failed to allocate memory for extensions\n");
     return false;
@@ -146,22 +430,21 @@ bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform) {
   for (uint32_t i = 0; i < extensionCount; i++) {
     printf("\t%s\n", extensions[i].extensionName);
   }
-  free(extensions);
+  arena_reset_to(scratch, mark);
   printf(GREEN "[OK] " RESET "Instance\n");
   
   // Surface
-  if (platform == NULL) {
-    printf(RED "[ERROR] " RESET "platform context is NULL\n");
-    return false;
-  }
-  
-  if (glfwCreateWindowSurface(ctx->instance, platform->window, NULL, &ctx->surface) != VK_SUCCESS) {
-    printf(RED "[ERROR] " RESET "failed to create window surface\n");
-    return false;
+  if (ctx->headless) {
+    ctx->surface = VK_NULL_HANDLE;
+    printf(GREEN "[OK] " RESET "Headless (no surface)\n");
+  } else {
+    if (glfwCreateWindowSurface(ctx->instance, platform->window, NULL, &ctx->surface) != VK_SUCCESS) {
+      printf(RED "[ERROR] " RESET "failed to create window surface\n");
+      return false;
+    }
+    printf(GREEN "[OK] " RESET "Surface\n");
   }
 
-  printf(GREEN "[OK] " RESET "Surface\n");
-
   // Vulkan physical device 
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   uint32_t deviceCount = 0;
@@ -171,7 +454,7 @@ bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform) {
     return false;
   }
 
-  VkPhysicalDevice *devices = malloc(deviceCount * sizeof(VkPhysicalDevice));
+  VkPhysicalDevice *devices = ARENA_ALLOC(scratch, VkPhysicalDevice, deviceCount);
   if (!devices) {
     printf(RED "[ERROR] " RESET "failed to allocate memory for devices\n");
     return false;
@@ -179,15 +462,14 @@ bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform) {
 
   vkEnumeratePhysicalDevices(ctx->instance, &deviceCount, devices);
 
-  // Select a suitable physical device
+  // Select a suitable physical device; batch contexts spread over all of them
+  uint32_t suitableCount = 0;
   for (uint32_t i = 0; i < deviceCount; i++) {
-    if (isDeviceSuitable(devices[i], ctx->surface)) {
-      physicalDevice = devices[i];
-      break;
-    }
+    if (isDeviceSuitable(devices[i], ctx->surface)) devices[suitableCount++] = devices[i];
   }
+  if (suitableCount > 0) physicalDevice = devices[ctx->deviceIndex % suitableCount];
 
-  free(devices);
+  arena_reset_to(scratch, mark);
 
   if (physicalDevice == VK_NULL_HANDLE) {
     printf(RED "[ERROR] " RESET "failed to find a suitable GPU\n");
@@ -224,17 +506,121 @@ bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform) {
     queueCreateInfos[queueCreateInfoCount++] = queueCreateInfo;
   }
 
+  // Optional features, probed through vkGetPhysicalDeviceFeatures2 (1.1+)
+  ctx->apiVersion = deviceProperties.apiVersion < appInfo.apiVersion ? deviceProperties.apiVersion : appInfo.apiVersion;
+
+  const char *enabledExtensions[8];
+  uint32_t enabledExtensionCount = 0;
+  for (size_t i = 0; i < sizeof(deviceExtensions) / sizeof(deviceExtensions[0]) && !ctx->headless; i++) {
+    enabledExtensions[enabledExtensionCount++] = deviceExtensions[i];
+  }
+
+  VkPhysicalDeviceVulkan13Features features13 = {0};
+  features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+  VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures = {0};
+  dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+  const void *featureChain = NULL;
+  bool dynamicRenderingKHR = false;
+
+  if (ctx->apiVersion >= VK_API_VERSION_1_3) {
+    VkPhysicalDeviceFeatures2 features2 = {0};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &features13;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+    ctx->dynamicRendering = features13.dynamicRendering == VK_TRUE;
+    VkPhysicalDeviceVulkan13Features enable13 = {0};
+    features13 = enable13;
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    features13.dynamicRendering = ctx->dynamicRendering ? VK_TRUE : VK_FALSE;
+    featureChain = &features13;
+  } else if (ctx->apiVersion >= VK_API_VERSION_1_2 &&
+             vulkan_has_device_extension(physicalDevice, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+    VkPhysicalDeviceFeatures2 features2 = {0};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &dynamicRenderingFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+    if (dynamicRenderingFeatures.dynamicRendering == VK_TRUE) {
+      ctx->dynamicRendering = true;
+      dynamicRenderingKHR = true;
+      dynamicRenderingFeatures.pNext = NULL;
+      enabledExtensions[enabledExtensionCount++] = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+      featureChain = &dynamicRenderingFeatures;
+    }
+  }
+
+  // Budget queries go through vkGetPhysicalDeviceMemoryProperties2 (1.1+)
+  ctx->memoryBudget = ctx->apiVersion >= VK_API_VERSION_1_1 &&
+      vulkan_has_device_extension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+  if (ctx->memoryBudget) {
+    enabledExtensions[enabledExtensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+  }
+
+  // Damage hints for the compositor; advisory, so only used where offered
+  ctx->incrementalPresent = !ctx->headless &&
+      vulkan_has_device_extension(physicalDevice, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+  if (ctx->incrementalPresent) {
+    enabledExtensions[enabledExtensionCount++] = VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME;
+  }
+
+  // Host pointer imports build on VK_KHR_external_memory, core from 1.1
+  if (ctx->apiVersion >= VK_API_VERSION_1_1 &&
+      vulkan_has_device_extension(physicalDevice, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME)) {
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProperties = {0};
+    hostProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties2 = {0};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &hostProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+    ctx->externalMemoryHost = hostProperties.minImportedHostPointerAlignment > 0;
+    ctx->hostPointerAlignment = hostProperties.minImportedHostPointerAlignment;
+    if (ctx->externalMemoryHost) {
+      enabledExtensions[enabledExtensionCount++] = VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME;
+    }
+  }
+
+  // Task + mesh shaders need SPIR-V 1.4, which is core from 1.2
+  VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {0};
+  meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+  if (ctx->apiVersion >= VK_API_VERSION_1_2 &&
+      vulkan_has_device_extension(physicalDevice, VK_EXT_MESH_SHADER_EXTENSION_NAME)) {
+    VkPhysicalDeviceFeatures2 features2 = {0};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &meshShaderFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+    ctx->meshShader = meshShaderFeatures.taskShader == VK_TRUE && meshShaderFeatures.meshShader == VK_TRUE;
+    if (ctx->meshShader) {
+      // Only the two stages; the multiview and query features stay off
+      memset(&meshShaderFeatures, 0, sizeof(meshShaderFeatures));
+      meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+      meshShaderFeatures.taskShader = VK_TRUE;
+      meshShaderFeatures.meshShader = VK_TRUE;
+      meshShaderFeatures.pNext = (void *)featureChain;
+      featureChain = &meshShaderFeatures;
+      enabledExtensions[enabledExtensionCount++] = VK_EXT_MESH_SHADER_EXTENSION_NAME;
+    }
+  }
+
+  VkPhysicalDeviceFeatures supportedFeatures = {0};
+  vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+  ctx->multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+  ctx->drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+  ctx->storageWriteWithoutFormat = supportedFeatures.shaderStorageImageWriteWithoutFormat == VK_TRUE;
+
   VkPhysicalDeviceFeatures requestedFeatures = {0};
+  requestedFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+  requestedFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+  requestedFeatures.shaderStorageImageWriteWithoutFormat = supportedFeatures.shaderStorageImageWriteWithoutFormat;
   VkDeviceCreateInfo createInfo2 = {0};
   createInfo2.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo2.pNext = featureChain;
   createInfo2.pQueueCreateInfos = queueCreateInfos;
   createInfo2.queueCreateInfoCount = queueCreateInfoCount;
 
   createInfo2.pEnabledFeatures = &requestedFeatures;
-  createInfo2.enabledExtensionCount = sizeof(deviceExtensions) / sizeof(deviceExtensions[0]);
-  createInfo2.ppEnabledExtensionNames = deviceExtensions;
+  createInfo2.enabledExtensionCount = enabledExtensionCount;
+  createInfo2.ppEnabledExtensionNames = enabledExtensions;
 
-  if (enableValidationLayers) {
+  if (useValidation) {
     createInfo2.enabledLayerCount = sizeof(validationLayers) / sizeof(validationLayers[0]);
     createInfo2.ppEnabledLayerNames = validationLayers;
   } else {
@@ -246,6 +632,39 @@ bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform) {
     return false;
   }
 
+  if (!vulkan_dispatch_load(&ctx->dispatch, ctx->device, !ctx->headless)) {
+    printf(RED "[ERROR] " RESET "failed to load device dispatch table\n");
+    return false;
+  }
+
+  if (ctx->dynamicRendering) {
+    ctx->cmdBeginRendering = (PFN_vkCmdBeginRendering)vkGetDeviceProcAddr(ctx->device,
+        dynamicRenderingKHR ? "vkCmdBeginRenderingKHR" : "vkCmdBeginRendering");
+    ctx->cmdEndRendering = (PFN_vkCmdEndRendering)vkGetDeviceProcAddr(ctx->device,
+        dynamicRenderingKHR ? "vkCmdEndRenderingKHR" : "vkCmdEndRendering");
+    ctx->dynamicRendering = ctx->cmdBeginRendering && ctx->cmdEndRendering;
+  }
+  if (ctx->meshShader) {
+    ctx->cmdDrawMeshTasks = (PFN_vkCmdDrawMeshTasksEXT)vkGetDeviceProcAddr(ctx->device, "vkCmdDrawMeshTasksEXT");
+    ctx->meshShader = ctx->cmdDrawMeshTasks != NULL;
+  }
+  if (ctx->externalMemoryHost) {
+    ctx->getMemoryHostPointerProperties = (PFN_vkGetMemoryHostPointerPropertiesEXT)vkGetDeviceProcAddr(
+        ctx->device, "vkGetMemoryHostPointerPropertiesEXT");
+    ctx->externalMemoryHost = ctx->getMemoryHostPointerProperties != NULL;
+  }
+  printf("Dynamic rendering: %s\n", ctx->dynamicRendering ? (dynamicRenderingKHR ? "VK_KHR_dynamic_rendering" : "core 1.3") : "unavailable");
+  printf("Incremental present: %s\n", ctx->incrementalPresent ? "available" : "unavailable");
+  printf("Mesh shaders: %s\n", ctx->meshShader ? "VK_EXT_mesh_shader" : "unavailable");
+  printf("Host memory import: %s\n", ctx->externalMemoryHost ? "VK_EXT_external_memory_host" : "unavailable");
+
+  ctx->budget = malloc(sizeof(Memory_Budget));
+  if (!ctx->budget || !memory_budget_create(ctx->budget, physicalDevice, ctx->memoryBudget, ctx->memoryLimit)) {
+    printf(RED "[ERROR] " RESET "failed to create memory budget\n");
+    return false;
+  }
+  printf("Memory budget: %s\n", ctx->memoryBudget ? "VK_EXT_memory_budget" : "estimated");
+
   vkGetDeviceQueue(ctx->device, indices.graphicsFamily, 0, &ctx->queue);
   vkGetDeviceQueue(ctx->device, indices.presentFamily, 0, &ctx->presentQueue);
   
@@ -254,9 +673,36 @@ bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform) {
   return true;
 }
 
+// Further windows present through the queue picked for the first one
+bool vulkan_create_surface(Vulkan_Context *ctx, Platform_Context *platform, VkSurfaceKHR *surface) {
+  if (!ctx || !platform || ctx->headless) return false;
+  if (glfwCreateWindowSurface(ctx->instance, platform->window, NULL, surface) != VK_SUCCESS) {
+    printf(RED "[ERROR] " RESET "failed to create window surface\n");
+    return false;
+  }
+  QueueFamilyIndices indices = findQueueFamilies(ctx->physicalDevice, ctx->surface);
+  VkBool32 presentSupport = VK_FALSE;
+  vkGetPhysicalDeviceSurfaceSupportKHR(ctx->physicalDevice, indices.presentFamily, *surface, &presentSupport);
+  if (!presentSupport) {
+    printf(RED "[ERROR] " RESET "present queue can't present to the new window\n");
+    vkDestroySurfaceKHR(ctx->instance, *surface, NULL);
+    *surface = VK_NULL_HANDLE;
+    return false;
+  }
+  return true;
+}
+
 void vulkan_destroy(Vulkan_Context *ctx) {
   if (!ctx) return;
+  if (ctx->budget) {
+    memory_budget_print(ctx->budget);
+    memory_budget_destroy(ctx->budget);
+    free(ctx->budget);
+    ctx->budget = NULL;
+  }
   vkDestroyDevice(ctx->device, NULL);
-  vkDestroySurfaceKHR(ctx->instance, ctx->surface, NULL);
+  if (ctx->surface != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(ctx->instance, ctx->surface, NULL);
+  }
   vkDestroyInstance(ctx->instance, NULL);
 }
@@ -6,6 +6,8 @@
 #include <GLFW/glfw3.h>
 #include "color.h"
 #include "platform.h"
+#include "vulkan_dispatch.h"
+#include "memory_budget.h"
 
 typedef struct {
   uint32_t graphicsFamily;
@@ -24,11 +26,69 @@ struct Vulkan_Context {
   VkQueue presentQueue;
   VkSurfaceKHR surface;
   VkDebugUtilsMessengerEXT debugMessenger;
+  bool headless;  // created without a platform: no surface or swapchain
+  uint32_t deviceIndex;  // set before vulkan_create: use the Nth suitable device, wrapping around
+  VkDeviceSize memoryLimit;  // set before vulkan_create: caps the device-local budget (0 = driver's)
+
+  uint32_t apiVersion;  // min(instance, device) version actually usable
+
+  // Dynamic rendering (core 1.3 or VK_KHR_dynamic_rendering); NULL when absent
+  bool dynamicRendering;
+  PFN_vkCmdBeginRendering cmdBeginRendering;
+  PFN_vkCmdEndRendering cmdEndRendering;
+
+  // VK_KHR_incremental_present: present can carry damage rectangles
+  bool incrementalPresent;
+
+  // VK_EXT_mesh_shader with task shaders; NULL when absent
+  bool meshShader;
+  PFN_vkCmdDrawMeshTasksEXT cmdDrawMeshTasks;
+  // Core features the indirect meshlet path relies on
+  bool multiDrawIndirect;
+  bool drawIndirectFirstInstance;
+  // Compute can store to images declared without a format (e.g. the swapchain)
+  bool storageWriteWithoutFormat;
+
+  // VK_EXT_memory_budget: per-heap budget and usage from the driver
+  bool memoryBudget;
+  // Heap usage against budget; a pointer so copies of the context share it
+  Memory_Budget *budget;
+
+  // VK_EXT_external_memory_host: buffers can be bound to memory the
+  // application mapped itself (e.g. a shared-memory ring); NULL when absent
+  bool externalMemoryHost;
+  PFN_vkGetMemoryHostPointerPropertiesEXT getMemoryHostPointerProperties;
+  VkDeviceSize hostPointerAlignment;  // imported pointers and sizes are multiples of this
+
+  // Direct device entry points; use these instead of the exported prototypes
+  // on anything that runs per frame or per draw
+  Vulkan_Dispatch dispatch;
 };
 
+// platform may be NULL for headless (offscreen) use
 bool vulkan_create(Vulkan_Context *ctx, Platform_Context *platform);
+bool vulkan_has_device_extension(VkPhysicalDevice device, const char *name);
+// Surface for an additional window; fails if the present queue can't use it
+bool vulkan_create_surface(Vulkan_Context *ctx, Platform_Context *platform, VkSurfaceKHR *surface);
 void vulkan_destroy(Vulkan_Context *ctx);
 
 QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+char *readFile(const char *path, size_t *outSize);
+VkShaderModule createShaderModule(const char *code, size_t codeSize, Vulkan_Context *vk_ctx);
+
+// vkAllocateMemory / vkFreeMemory, counted against ctx->budget
+VkResult vulkan_allocate_memory(Vulkan_Context *ctx, const VkMemoryAllocateInfo *info, VkDeviceMemory *memory);
+void vulkan_free_memory(Vulkan_Context *ctx, VkDeviceMemory memory);
+
+bool vulkan_create_buffer(Vulkan_Context *ctx, VkDeviceSize size, VkBufferUsageFlags usage,
+                          VkMemoryPropertyFlags properties, VkBuffer *buffer, VkDeviceMemory *memory);
+bool vulkan_create_image(Vulkan_Context *ctx, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format,
+                         VkImageUsageFlags usage, VkImage *image, VkDeviceMemory *memory);
+VkImageView vulkan_create_image_view(Vulkan_Context *ctx, VkImage image, VkFormat format,
+                                     VkImageAspectFlags aspect, uint32_t mipLevels);
+VkCommandBuffer vulkan_begin_one_time_commands(Vulkan_Context *ctx, VkCommandPool pool);
+bool vulkan_end_one_time_commands(Vulkan_Context *ctx, VkCommandPool pool, VkCommandBuffer cmd);
 
 #endif